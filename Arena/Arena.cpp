@@ -0,0 +1,80 @@
+//
+// Created by Damian Li on 2024-09-24.
+//
+
+#include "Arena.h"
+#include <cstdint>
+
+Arena::~Arena() {
+    for (Cleanup* c = cleanups; c != nullptr; c = c->next) {
+        c->fn(c->arg);
+    }
+}
+
+char* Arena::bump(Block* block, size_t bytes, size_t align) {
+    size_t used = block->used.load(std::memory_order_relaxed);
+    while (true) {
+        uintptr_t ptr = reinterpret_cast<uintptr_t>(block->data.get()) + used;
+        size_t padding = (align - (ptr & (align - 1))) & (align - 1);
+        if (used + padding + bytes > block->size) {
+            return nullptr;
+        }
+        // On failure used is reloaded and the padding recomputed
+        if (block->used.compare_exchange_weak(used, used + padding + bytes, std::memory_order_relaxed)) {
+            return block->data.get() + used + padding;
+        }
+    }
+}
+
+char* Arena::allocate(size_t bytes, size_t align) {
+    // Fast path: bump the current block without a lock
+    Block* block = current.load(std::memory_order_acquire);
+    if (block != nullptr) {
+        if (char* result = bump(block, bytes, align)) {
+            return result;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (bytes > BLOCK_SIZE / 4) {
+        // Large objects get their own block so the current block's tail isn't wasted
+        return newBlock(bytes)->data.get();
+    }
+    // Another thread may have started a block meanwhile
+    block = current.load(std::memory_order_relaxed);
+    if (block != nullptr) {
+        if (char* result = bump(block, bytes, align)) {
+            return result;
+        }
+    }
+    // Blocks come from operator new[], which is aligned for any fundamental type
+    block = newBlock(BLOCK_SIZE);
+    block->used.store(bytes, std::memory_order_relaxed);
+    current.store(block, std::memory_order_release);
+    return block->data.get();
+}
+
+Arena::Block* Arena::newBlock(size_t bytes) {
+    auto block = std::make_unique<Block>();
+    block->data.reset(new char[bytes]);
+    block->size = bytes;
+    blocks.push_back(std::move(block));
+    usage.fetch_add(bytes + sizeof(Block) + sizeof(std::unique_ptr<Block>), std::memory_order_relaxed);
+    return blocks.back().get();
+}
+
+void Arena::addCleanup(void (*fn)(void*), void* arg) {
+    auto* c = new (allocate(sizeof(Cleanup), alignof(Cleanup))) Cleanup{fn, arg, nullptr};
+    std::lock_guard<std::mutex> lock(mutex);
+    c->next = cleanups;
+    cleanups = c;
+}
+
+size_t Arena::memoryUsage() const {
+    return usage.load(std::memory_order_relaxed);
+}
+
+size_t Arena::getNumBlocks() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return blocks.size();
+}
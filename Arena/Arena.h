@@ -0,0 +1,82 @@
+//
+// Created by Damian Li on 2024-09-24.
+//
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/*
+ * Bump allocator owned by one memtable.
+ *
+ * Memory is carved out of BLOCK_SIZE blocks and is only given back when the
+ * arena is destroyed, which frees every block at once. Objects are never
+ * destroyed one by one: objects that own memory outside the arena register a
+ * cleanup that runs when the arena goes away. Only nodes live in the arena: a
+ * KeyValue whose key or value string is too long for its in-object buffer
+ * keeps that string on the heap (the memtable counts those bytes separately).
+ *
+ * allocate() is thread-safe and lock-free unless it has to start a block, so
+ * concurrent skiplist inserts can share one arena.
+ */
+class Arena {
+public:
+    static constexpr size_t BLOCK_SIZE = 4096;
+
+    Arena() = default;
+    ~Arena();
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    // bytes of uninitialized memory aligned to align (a power of two)
+    char* allocate(size_t bytes, size_t align = alignof(std::max_align_t));
+
+    // Construct a T in the arena; its destructor is not run unless registered with addCleanup()
+    template<typename T, typename... Args>
+    T* make(Args&&... args) {
+        return new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+    }
+    // Run obj->~T() when the arena is destroyed
+    template<typename T>
+    void addCleanup(T* obj) {
+        addCleanup([](void* p) { static_cast<T*>(p)->~T(); }, obj);
+    }
+    void addCleanup(void (*fn)(void*), void* arg);
+
+    // Bytes reserved from the system (blocks plus bookkeeping)
+    size_t memoryUsage() const;
+    size_t getNumBlocks() const;
+
+private:
+    struct Cleanup {
+        void (*fn)(void*);
+        void* arg;
+        Cleanup* next;
+    };
+    // Block small allocations are bumped from: used is advanced with a CAS
+    struct Block {
+        std::unique_ptr<char[]> data;
+        size_t size = 0;
+        std::atomic<size_t> used{0};
+    };
+
+    mutable std::mutex mutex;  // guards blocks and cleanups, and starting a block
+    std::vector<std::unique_ptr<Block>> blocks;
+    std::atomic<Block*> current{nullptr};
+    std::atomic<size_t> usage{0};
+    Cleanup* cleanups = nullptr;  // newest first, allocated in the arena
+
+    // bytes out of block, or nullptr when they don't fit
+    static char* bump(Block* block, size_t bytes, size_t align);
+    Block* newBlock(size_t bytes);
+};
+
+#endif //ARENA_H
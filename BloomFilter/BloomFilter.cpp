@@ -0,0 +1,137 @@
+//
+// Created by Damian Li on 2024-09-15.
+//
+
+#include "BloomFilter.h"
+#include <algorithm>
+#include <cstring>
+#include <type_traits>
+#include <variant>
+
+BloomFilter::BloomFilter(size_t num_keys, int bits_per_key) {
+    // k = bits_per_key * ln(2) minimizes the false positive rate
+    num_probes = static_cast<uint32_t>(std::clamp(static_cast<int>(bits_per_key * 0.69), 1, 30));
+    // Keep a minimum size so tiny SSTs still get a useful filter
+    size_t num_bits = std::max<size_t>(num_keys * std::max(bits_per_key, 1), 64);
+    bits.assign((num_bits + 7) / 8, 0);
+}
+
+std::string BloomFilter::keyBytes(const KeyValue& kv) {
+    return std::visit([](auto&& arg) -> std::string {
+        using T = std::decay_t<decltype(arg)>;
+        if constexpr (std::is_same_v<T, std::string>) {
+            return "S" + arg;
+        } else {
+            // All numeric types (char included) compare as double
+            double d = static_cast<double>(arg);
+            if (d == 0) d = 0;  // fold -0.0 into 0.0
+            std::string bytes(1 + sizeof(d), 'N');
+            std::memcpy(&bytes[1], &d, sizeof(d));
+            return bytes;
+        }
+    }, kv.getKey());
+}
+
+// MurmurHash64A
+uint64_t BloomFilter::hash(const std::string& bytes) {
+    const uint64_t m = 0xc6a4a7935bd1e995ULL;
+    const int r = 47;
+    const size_t len = bytes.size();
+    const auto* data = reinterpret_cast<const unsigned char*>(bytes.data());
+    uint64_t h = 0x8445d61a4e774912ULL ^ (len * m);
+
+    size_t i = 0;
+    for (; i + 8 <= len; i += 8) {
+        uint64_t k;
+        std::memcpy(&k, data + i, sizeof(k));
+        k *= m;
+        k ^= k >> r;
+        k *= m;
+        h ^= k;
+        h *= m;
+    }
+    uint64_t tail = 0;
+    for (size_t j = len - i; j > 0; --j) {
+        tail = (tail << 8) | data[i + j - 1];
+    }
+    if (len - i > 0) {
+        h ^= tail;
+        h *= m;
+    }
+    h ^= h >> r;
+    h *= m;
+    h ^= h >> r;
+    return h;
+}
+
+void BloomFilter::addKey(const KeyValue& kv) {
+    addKey(keyBytes(kv));
+}
+
+void BloomFilter::addKey(const std::string& key_bytes) {
+    if (bits.empty()) return;
+    const uint64_t num_bits = bits.size() * 8;
+    // Double hashing: probe i uses h1 + i * h2
+    uint64_t h = hash(key_bytes);
+    const uint64_t delta = (h >> 33) | (h << 31);
+    for (uint32_t i = 0; i < num_probes; ++i) {
+        uint64_t bit = h % num_bits;
+        bits[bit / 8] |= static_cast<uint8_t>(1u << (bit % 8));
+        h += delta;
+    }
+}
+
+bool BloomFilter::mayContain(const KeyValue& kv) const {
+    return mayContain(keyBytes(kv));
+}
+
+bool BloomFilter::mayContain(const std::string& key_bytes) const {
+    if (bits.empty()) return true;  // no filter: cannot rule anything out
+    const uint64_t num_bits = bits.size() * 8;
+    uint64_t h = hash(key_bytes);
+    const uint64_t delta = (h >> 33) | (h << 31);
+    for (uint32_t i = 0; i < num_probes; ++i) {
+        uint64_t bit = h % num_bits;
+        if ((bits[bit / 8] & (1u << (bit % 8))) == 0) {
+            return false;
+        }
+        h += delta;
+    }
+    return true;
+}
+
+void BloomFilter::serialize(std::ostream& file) const {
+    uint32_t num_bytes = bits.size();
+    file.write(reinterpret_cast<const char*>(&num_probes), sizeof(num_probes));
+    file.write(reinterpret_cast<const char*>(&num_bytes), sizeof(num_bytes));
+    file.write(reinterpret_cast<const char*>(bits.data()), num_bytes);
+}
+
+BloomFilter BloomFilter::deserialize(std::istream& file) {
+    BloomFilter filter;
+    uint32_t num_bytes = 0;
+    file.read(reinterpret_cast<char*>(&filter.num_probes), sizeof(filter.num_probes));
+    file.read(reinterpret_cast<char*>(&num_bytes), sizeof(num_bytes));
+    filter.bits.resize(num_bytes);
+    file.read(reinterpret_cast<char*>(filter.bits.data()), num_bytes);
+    if (!file) {
+        return BloomFilter();
+    }
+    return filter;
+}
+
+BloomFilter BloomFilter::decode(const char* data, size_t size) {
+    BloomFilter filter;
+    uint32_t num_bytes = 0;
+    if (size < sizeof(filter.num_probes) + sizeof(num_bytes)) {
+        return filter;
+    }
+    std::memcpy(&filter.num_probes, data, sizeof(filter.num_probes));
+    std::memcpy(&num_bytes, data + sizeof(filter.num_probes), sizeof(num_bytes));
+    const size_t header = sizeof(filter.num_probes) + sizeof(num_bytes);
+    if (size - header < num_bytes) {
+        return BloomFilter();
+    }
+    filter.bits.assign(data + header, data + header + num_bytes);
+    return filter;
+}
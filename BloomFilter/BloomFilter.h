@@ -0,0 +1,61 @@
+//
+// Created by Damian Li on 2024-09-15.
+//
+
+#ifndef BLOOMFILTER_H
+#define BLOOMFILTER_H
+
+#include "KeyValue.h"
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/*
+ * Per-SST Bloom filter over the key bytes of every record in the file.
+ *
+ * Keys that compare equal through KeyValue::operator== (e.g. int 5, 5LL and 5.0)
+ * must land on the same bits, so numeric keys are hashed through one canonical
+ * encoding instead of their raw on-disk type.
+ */
+class BloomFilter {
+public:
+    static constexpr int DEFAULT_BITS_PER_KEY = 10;
+
+    BloomFilter() = default;
+    // Size the bit array for num_keys keys at bits_per_key bits each
+    BloomFilter(size_t num_keys, int bits_per_key);
+
+    void addKey(const KeyValue& kv);
+    void addKey(const std::string& key_bytes);
+    // false means the key is definitely not in the file
+    bool mayContain(const KeyValue& kv) const;
+    bool mayContain(const std::string& key_bytes) const;
+
+    // Canonical bytes hashed into the filter for a key
+    static std::string keyBytes(const KeyValue& kv);
+
+    size_t getNumBits() const {return bits.size() * 8;};
+    int getNumProbes() const {return num_probes;};
+    bool empty() const {return bits.empty();};
+
+    /*
+     * .sst File Filter Block Structure
+     * ==============================================================================
+     * num_probes | num_bytes | (bytes) bit array |
+     * ==============================================================================
+     */
+    void serialize(std::ostream& file) const;
+    static BloomFilter deserialize(std::istream& file);
+    // Decode a filter block from in-memory (mapped) bytes; empty filter if malformed
+    static BloomFilter decode(const char* data, size_t size);
+
+private:
+    std::vector<uint8_t> bits;
+    uint32_t num_probes = 0;
+
+    static uint64_t hash(const std::string& bytes);
+};
+
+#endif //BLOOMFILTER_H
@@ -0,0 +1,129 @@
+//
+// Created by Damian Li on 2024-09-17.
+//
+
+#include "BlockCache.h"
+
+BlockCache::BlockCache(size_t capacity, int num_shard_bits)
+    : shards(static_cast<size_t>(1) << num_shard_bits), capacity(0) {
+    setCapacity(capacity);
+}
+
+size_t BlockCache::CacheKeyHash::operator()(const CacheKey& key) const {
+    // 64-bit mix of both halves (splitmix64 finalizer)
+    uint64_t h = key.file_id * 0x9E3779B97F4A7C15ULL ^ key.offset;
+    h ^= h >> 30;
+    h *= 0xBF58476D1CE4E5B9ULL;
+    h ^= h >> 27;
+    h *= 0x94D049BB133111EBULL;
+    h ^= h >> 31;
+    return static_cast<size_t>(h);
+}
+
+BlockCache::Shard& BlockCache::shardFor(const CacheKey& key) {
+    // Use the high bits for the shard; the table uses the low bits
+    uint64_t h = CacheKeyHash()(key);
+    return shards[(h >> 32) & (shards.size() - 1)];
+}
+
+void BlockCache::Shard::evict() {
+    while (usage > capacity && !lru.empty()) {
+        Entry& victim = lru.back();
+        usage -= victim.charge;
+        table.erase(victim.key);
+        lru.pop_back();
+    }
+}
+
+BlockCache::BlockPtr BlockCache::lookup(uint64_t file_id, uint64_t offset) {
+    CacheKey key{file_id, offset};
+    Shard& shard = shardFor(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.table.find(key);
+    if (it == shard.table.end()) {
+        shard.misses++;
+        if (statistics) {
+            statistics->recordTick(Ticker::BLOCK_CACHE_MISS);
+        }
+        return nullptr;
+    }
+    shard.hits++;
+    if (statistics) {
+        statistics->recordTick(Ticker::BLOCK_CACHE_HIT);
+    }
+    shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+    return it->second->block;
+}
+
+void BlockCache::insert(uint64_t file_id, uint64_t offset, BlockPtr block, size_t charge) {
+    CacheKey key{file_id, offset};
+    Shard& shard = shardFor(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.table.find(key);
+    if (it != shard.table.end()) {
+        shard.usage -= it->second->charge;
+        shard.lru.erase(it->second);
+        shard.table.erase(it);
+    }
+    if (charge > shard.capacity) {
+        return;  // would evict the whole shard for a single block
+    }
+    shard.lru.push_front(Entry{key, std::move(block), charge});
+    shard.table[key] = shard.lru.begin();
+    shard.usage += charge;
+    shard.evict();
+}
+
+void BlockCache::erase(uint64_t file_id, uint64_t offset) {
+    CacheKey key{file_id, offset};
+    Shard& shard = shardFor(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.table.find(key);
+    if (it != shard.table.end()) {
+        shard.usage -= it->second->charge;
+        shard.lru.erase(it->second);
+        shard.table.erase(it);
+    }
+}
+
+void BlockCache::setCapacity(size_t new_capacity) {
+    capacity = new_capacity;
+    // Split the capacity evenly, rounding up so the total is never below the request
+    size_t per_shard = (new_capacity + shards.size() - 1) / shards.size();
+    for (Shard& shard : shards) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        shard.capacity = per_shard;
+        shard.evict();
+    }
+}
+
+size_t BlockCache::getCapacity() const {
+    return capacity;
+}
+
+size_t BlockCache::getUsage() const {
+    size_t usage = 0;
+    for (const Shard& shard : shards) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        usage += shard.usage;
+    }
+    return usage;
+}
+
+uint64_t BlockCache::getHits() const {
+    uint64_t hits = 0;
+    for (const Shard& shard : shards) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        hits += shard.hits;
+    }
+    return hits;
+}
+
+uint64_t BlockCache::getMisses() const {
+    uint64_t misses = 0;
+    for (const Shard& shard : shards) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        misses += shard.misses;
+    }
+    return misses;
+}
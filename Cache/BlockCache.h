@@ -0,0 +1,87 @@
+//
+// Created by Damian Li on 2024-09-17.
+//
+
+#ifndef BLOCKCACHE_H
+#define BLOCKCACHE_H
+
+#include "KeyValue.h"
+#include "Statistics.h"
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+/*
+ * Capacity-bounded cache of decoded SST data blocks, shared by all SSTs.
+ *
+ * Entries are keyed by (file id, block offset) and charged their approximate
+ * decoded size. The cache is split into 2^num_shard_bits shards, each with its
+ * own mutex and LRU list, so concurrent readers rarely contend.
+ */
+class BlockCache {
+public:
+    using Block = std::vector<KeyValue>;           // decoded records of one data block, in key order
+    using BlockPtr = std::shared_ptr<const Block>;
+
+    static constexpr size_t DEFAULT_CAPACITY = 8 * 1024 * 1024;
+    static constexpr int DEFAULT_SHARD_BITS = 4;
+
+    explicit BlockCache(size_t capacity = DEFAULT_CAPACITY, int num_shard_bits = DEFAULT_SHARD_BITS);
+
+    // Cached block or nullptr; a hit moves the block to the front of its shard's LRU list
+    BlockPtr lookup(uint64_t file_id, uint64_t offset);
+    // Insert (or replace) a block, evicting least recently used blocks of the shard if needed
+    void insert(uint64_t file_id, uint64_t offset, BlockPtr block, size_t charge);
+    void erase(uint64_t file_id, uint64_t offset);
+
+    // Unique id for a file, so blocks of different files (or databases sharing the cache) never collide
+    uint64_t newId() {return next_id.fetch_add(1, std::memory_order_relaxed);};
+
+    void setCapacity(size_t capacity);
+    size_t getCapacity() const;
+    size_t getUsage() const;
+    uint64_t getHits() const;
+    uint64_t getMisses() const;
+    size_t getNumShards() const {return shards.size();};
+    // Lookups also count into statistics' BLOCK_CACHE_HIT / BLOCK_CACHE_MISS (nullptr: not);
+    // set before the cache is shared with readers
+    void setStatistics(std::shared_ptr<Statistics> stats) {statistics = std::move(stats);};
+
+private:
+    struct CacheKey {
+        uint64_t file_id;
+        uint64_t offset;
+        bool operator==(const CacheKey& other) const {return file_id == other.file_id && offset == other.offset;};
+    };
+    struct CacheKeyHash {
+        size_t operator()(const CacheKey& key) const;
+    };
+    struct Entry {
+        CacheKey key;
+        BlockPtr block;
+        size_t charge;
+    };
+    struct Shard {
+        mutable std::mutex mutex;
+        std::list<Entry> lru;  // front = most recently used
+        std::unordered_map<CacheKey, std::list<Entry>::iterator, CacheKeyHash> table;
+        size_t usage = 0;
+        size_t capacity = 0;
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        void evict();
+    };
+
+    std::vector<Shard> shards;
+    size_t capacity;
+    std::atomic<uint64_t> next_id{1};
+    std::shared_ptr<Statistics> statistics;
+
+    Shard& shardFor(const CacheKey& key);
+};
+
+#endif //BLOCKCACHE_H
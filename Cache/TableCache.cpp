@@ -0,0 +1,117 @@
+//
+// Created by Damian Li on 2024-09-18.
+//
+
+#include "TableCache.h"
+
+TableCache::TableCache(fs::path directory, size_t max_open_files, std::shared_ptr<BlockCache> block_cache)
+    : directory(std::move(directory)), maxOpenFiles(max_open_files), blockCache(std::move(block_cache)) {}
+
+std::shared_ptr<SSTable> TableCache::findTable(const std::string& filename) {
+    std::unique_lock<std::mutex> lock(mutex);
+    auto it = table.find(filename);
+    if (it != table.end()) {
+        hits++;
+        lru.splice(lru.begin(), lru, it->second);
+        return it->second->table;
+    }
+    misses++;
+    fs::path file_path = directory / filename;
+    std::shared_ptr<BlockCache> cache = blockCache;
+    uint64_t cache_id = 0;
+    if (cache) {
+        auto id = cacheIds.find(filename);
+        cache_id = id != cacheIds.end() ? id->second : cacheIds.emplace(filename, cache->newId()).first->second;
+    }
+
+    // Map and parse outside the lock so a slow open doesn't block hits on other files
+    lock.unlock();
+    std::shared_ptr<SSTable> sst = SSTable::open(file_path, cache, cache_id);
+    lock.lock();
+
+    // Another thread may have opened the same file meanwhile
+    it = table.find(filename);
+    if (it != table.end()) {
+        lru.splice(lru.begin(), lru, it->second);
+        return it->second->table;
+    }
+    if (maxOpenFiles == 0) {
+        return sst;  // caching disabled, the caller owns the only reference
+    }
+    lru.push_front(Entry{filename, sst});
+    table[filename] = lru.begin();
+    evictLocked();
+    return sst;
+}
+
+void TableCache::evict(const std::string& filename) {
+    std::lock_guard<std::mutex> lock(mutex);
+    // A new file of the same name gets a new id; the old blocks age out of the block cache
+    cacheIds.erase(filename);
+    auto it = table.find(filename);
+    if (it != table.end()) {
+        lru.erase(it->second);
+        table.erase(it);
+    }
+}
+
+void TableCache::clear() {
+    std::lock_guard<std::mutex> lock(mutex);
+    cacheIds.clear();
+    table.clear();
+    lru.clear();
+}
+
+void TableCache::evictLocked() {
+    while (lru.size() > maxOpenFiles) {
+        table.erase(lru.back().filename);
+        lru.pop_back();
+    }
+}
+
+void TableCache::setDirectory(const fs::path& new_directory) {
+    std::lock_guard<std::mutex> lock(mutex);
+    directory = new_directory;
+    cacheIds.clear();
+    table.clear();
+    lru.clear();
+}
+
+void TableCache::setBlockCache(std::shared_ptr<BlockCache> cache) {
+    std::lock_guard<std::mutex> lock(mutex);
+    blockCache = std::move(cache);
+    cacheIds.clear();
+    table.clear();
+    lru.clear();
+}
+
+std::shared_ptr<BlockCache> TableCache::getBlockCache() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return blockCache;
+}
+
+void TableCache::setMaxOpenFiles(size_t max_open_files) {
+    std::lock_guard<std::mutex> lock(mutex);
+    maxOpenFiles = max_open_files;
+    evictLocked();
+}
+
+size_t TableCache::getMaxOpenFiles() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return maxOpenFiles;
+}
+
+size_t TableCache::getNumOpen() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return lru.size();
+}
+
+uint64_t TableCache::getHits() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return hits;
+}
+
+uint64_t TableCache::getMisses() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return misses;
+}
@@ -0,0 +1,79 @@
+//
+// Created by Damian Li on 2024-09-18.
+//
+
+#ifndef TABLECACHE_H
+#define TABLECACHE_H
+
+#include "SSTable.h"
+#include "BlockCache.h"
+#include <cstdint>
+#include <filesystem>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace fs = std::filesystem;
+
+/*
+ * Bounded LRU of open SST readers, keyed by file name.
+ *
+ * A cached SSTable keeps the file mapped together with its parsed footer and
+ * index block, so a lookup against a recently used SST costs no open/stat/read
+ * syscalls. At most max_open_files readers are kept; the least recently used
+ * one is closed when a new file has to be opened. Readers handed out stay valid
+ * after eviction until the caller drops them.
+ *
+ * Each file keeps one block cache id while it is known here, so a reader that is
+ * closed and reopened still hits the blocks cached through the old one.
+ */
+class TableCache {
+public:
+    static constexpr size_t DEFAULT_MAX_OPEN_FILES = 1000;
+
+    explicit TableCache(fs::path directory = fs::path("defaultDB"),
+                        size_t max_open_files = DEFAULT_MAX_OPEN_FILES,
+                        std::shared_ptr<BlockCache> block_cache = nullptr);
+
+    // Reader of directory/filename, opened (and cached) on a miss; throws if the file can't be opened
+    std::shared_ptr<SSTable> findTable(const std::string& filename);
+    // Close the reader of filename because the file was rewritten or deleted: its cached
+    // blocks won't be read again
+    void evict(const std::string& filename);
+    // Close every reader (and forget the files)
+    void clear();
+
+    // Changing the directory or the block cache closes every reader
+    void setDirectory(const fs::path& directory);
+    void setBlockCache(std::shared_ptr<BlockCache> cache);
+    std::shared_ptr<BlockCache> getBlockCache() const;
+    void setMaxOpenFiles(size_t max_open_files);
+    size_t getMaxOpenFiles() const;
+
+    size_t getNumOpen() const;
+    uint64_t getHits() const;
+    uint64_t getMisses() const;
+
+private:
+    struct Entry {
+        std::string filename;
+        std::shared_ptr<SSTable> table;
+    };
+
+    mutable std::mutex mutex;
+    fs::path directory;
+    size_t maxOpenFiles;
+    std::shared_ptr<BlockCache> blockCache;
+    std::list<Entry> lru;  // front = most recently used
+    std::unordered_map<std::string, std::list<Entry>::iterator> table;
+    std::unordered_map<std::string, uint64_t> cacheIds;  // block cache id of each file name
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+
+    // Close least recently used readers until at most maxOpenFiles are open (mutex held)
+    void evictLocked();
+};
+
+#endif //TABLECACHE_H
@@ -0,0 +1,202 @@
+//
+// Created by Damian Li on 2024-09-20.
+//
+
+#include "Compaction.h"
+#include "Snapshot.h"
+#include <algorithm>
+#include <queue>
+#include <string>
+#include <system_error>
+#include <type_traits>
+#include <variant>
+
+uint64_t Compaction::maxBytesForLevel(const CompactionOptions& options, int level) {
+    uint64_t bytes = options.max_bytes_for_level_base;
+    for (int l = 1; l < level; ++l) {
+        bytes *= options.max_bytes_for_level_multiplier;
+    }
+    return bytes;
+}
+
+size_t Compaction::approximateSize(const KeyValue& kv) {
+    // checksum + key type + value type + sequence, then both fields
+    size_t size = sizeof(uint32_t) + 2 * sizeof(KeyValue::KeyValueType) + sizeof(uint64_t);
+    auto fieldSize = [](auto&& field) -> size_t {
+        using T = std::decay_t<decltype(field)>;
+        if constexpr (std::is_same_v<T, std::string>) {
+            return sizeof(uint32_t) + field.size();
+        } else {
+            return sizeof(T);
+        }
+    };
+    size += std::visit(fieldSize, kv.getKey());
+    if (kv.isRangeTombstone()) {
+        size += sizeof(KeyValue::KeyValueType);  // type of the end key
+    }
+    if (!kv.isTombstone()) {
+        size += std::visit(fieldSize, kv.getValue());
+    }
+    return size;
+}
+
+std::vector<FlushSSTInfo> Compaction::merge(const std::vector<std::shared_ptr<SSTable>>& inputs,
+                                            FileManager& fileManager,
+                                            uint64_t target_file_size,
+                                            bool bottommost,
+                                            const std::vector<uint64_t>& snapshots) {
+    auto stripe = [&snapshots](const KeyValue& kv) {return SnapshotList::stripe(snapshots, kv.getSequence());};
+    // Nothing older than the inputs is left to delete, nor any snapshot to see it
+    auto obsolete = [&](const KeyValue& tombstone) {
+        return bottommost && (snapshots.empty() || tombstone.getSequence() <= snapshots.front());
+    };
+
+    // Inputs are streamed a data block at a time, without filling the block cache
+    std::vector<std::unique_ptr<Iterator>> sources;
+    sources.reserve(inputs.size());
+    std::vector<KeyValue> ranges;  // range tombstones of the inputs still needed, sorted by start
+    for (const auto& table : inputs) {
+        sources.push_back(SSTable::newIterator(table));
+        for (const KeyValue& range : table->getRangeDeletions()) {
+            if (!obsolete(range)) {
+                ranges.push_back(range);
+            }
+        }
+    }
+    std::stable_sort(ranges.begin(), ranges.end());
+
+    /*
+     * Records arrive in key order, so each input's range tombstones are walked
+     * once: a tombstone becomes active when the keys reach its start and is
+     * dropped once they pass its end.
+     */
+    struct RangeCursor {
+        size_t next = 0;
+        std::vector<const KeyValue*> active;
+    };
+    std::vector<RangeCursor> range_cursors(inputs.size());
+    // A record is dropped when a newer range tombstone of the same stripe covers it
+    auto rangeDeleted = [&](const KeyValue& kv, size_t source) {
+        bool deleted = false;
+        for (size_t i = 0; i < inputs.size(); ++i) {
+            const std::vector<KeyValue>& file_ranges = inputs[i]->getRangeDeletions();
+            RangeCursor& cursor = range_cursors[i];
+            for (; cursor.next < file_ranges.size() && !(kv < file_ranges[cursor.next]); ++cursor.next) {
+                cursor.active.push_back(&file_ranges[cursor.next]);
+            }
+            cursor.active.erase(std::remove_if(cursor.active.begin(), cursor.active.end(),
+                                               [&kv](const KeyValue* range) {return !range->covers(kv);}),
+                                cursor.active.end());
+            for (const KeyValue* range : cursor.active) {
+                // Equal sequence numbers (files written before them): the newer input wins
+                bool newer = kv.getSequence() < range->getSequence() || (kv.getSequence() == range->getSequence() && i < source);
+                if (newer && stripe(*range) == stripe(kv)) {
+                    deleted = true;
+                }
+            }
+        }
+        return deleted;
+    };
+
+    // Min-heap on (key, newest sequence, source); a lower source index is a newer input
+    auto later = [&sources](size_t a, size_t b) {
+        const KeyValue& ka = sources[a]->kv();
+        const KeyValue& kb = sources[b]->kv();
+        if (ka < kb) return false;
+        if (kb < ka) return true;
+        if (ka.getSequence() != kb.getSequence()) return ka.getSequence() < kb.getSequence();
+        return a > b;
+    };
+    std::priority_queue<size_t, std::vector<size_t>, decltype(later)> heap(later);
+    for (size_t i = 0; i < sources.size(); ++i) {
+        sources[i]->SeekToFirst();
+        if (sources[i]->Valid()) {
+            heap.push(i);
+        }
+    }
+
+    /*
+     * Unless the output is the bottommost data for its range, the tombstones
+     * still have to shadow deeper levels: each output file keeps the part of
+     * every range tombstone that lies in [its first key, next file's first key),
+     * so files of the output level stay disjoint. Files are cut in key order,
+     * so a tombstone is picked up once and let go after the file its end falls in.
+     */
+    std::vector<FlushSSTInfo> outputs;
+    KeyValue lower;
+    bool has_lower = false;
+    size_t next_range = 0;
+    std::vector<const KeyValue*> open_ranges;
+    auto flush = [&](const std::vector<KeyValue>& chunk, const KeyValue* upper) {
+        for (; next_range < ranges.size() && (!upper || ranges[next_range] < *upper); ++next_range) {
+            open_ranges.push_back(&ranges[next_range]);
+        }
+        std::vector<KeyValue> chunk_ranges;
+        for (const KeyValue* range : open_ranges) {
+            KeyValue start = has_lower && *range < lower ? lower : *range;
+            KeyValue end = range->rangeEnd();
+            if (upper && *upper < end) {
+                end = *upper;
+            }
+            if (start < end) {
+                chunk_ranges.push_back(KeyValue::RangeTombstone(start.getKey(), end.getKey()));
+                chunk_ranges.back().setSequence(range->getSequence());
+            }
+        }
+        if (!chunk.empty() || !chunk_ranges.empty()) {
+            outputs.push_back(fileManager.flushToDisk(chunk, chunk_ranges));
+        }
+        if (upper) {
+            lower = *upper;
+            has_lower = true;
+            open_ranges.erase(std::remove_if(open_ranges.begin(), open_ranges.end(),
+                                             [upper](const KeyValue* range) {return !(*upper < range->rangeEnd());}),
+                              open_ranges.end());
+        }
+    };
+
+    try {
+        std::vector<KeyValue> chunk;
+        size_t chunk_bytes = 0;
+        KeyValue last;  // a copy: the block holding it may be gone once its source moves on
+        bool has_last = false;
+        uint64_t last_stripe = 0;
+        while (!heap.empty()) {
+            size_t source = heap.top();
+            heap.pop();
+            const KeyValue& kv = sources[source]->kv();
+            // Older versions no snapshot tells apart from the one just seen are shadowed
+            if (!has_last || last < kv || stripe(kv) != last_stripe) {
+                last = kv;
+                has_last = true;
+                last_stripe = stripe(kv);
+                // Tombstones without older data left below can go
+                bool dropped = rangeDeleted(kv, source) || (kv.isTombstone() && obsolete(kv));
+                if (!dropped) {
+                    // A full file is cut before the next key, never between versions of a key
+                    if (chunk_bytes >= target_file_size && chunk.back() < kv) {
+                        flush(chunk, &kv);
+                        chunk.clear();
+                        chunk_bytes = 0;
+                    }
+                    chunk.push_back(kv);
+                    chunk_bytes += approximateSize(kv);
+                }
+            }
+            sources[source]->Next();
+            if (sources[source]->Valid()) {
+                heap.push(source);
+            }
+        }
+        if (!chunk.empty() || outputs.empty()) {
+            flush(chunk, nullptr);
+        }
+    } catch (...) {
+        for (const FlushSSTInfo& info : outputs) {
+            std::error_code ec;
+            fs::remove(fileManager.getDirectory() / info.fileName, ec);
+        }
+        throw;
+    }
+    return outputs;
+}
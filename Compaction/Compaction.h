@@ -0,0 +1,53 @@
+//
+// Created by Damian Li on 2024-09-20.
+//
+
+#ifndef COMPACTION_H
+#define COMPACTION_H
+
+#include "FileManager.h"
+#include "SSTable.h"
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+/*
+ * Leveled compaction settings.
+ *
+ * L0 holds the SSTs written by memtable flushes; their key ranges may overlap.
+ * L1 and deeper levels hold non-overlapping SSTs, and level n (n >= 1) aims for
+ * max_bytes_for_level_base * max_bytes_for_level_multiplier^(n-1) bytes.
+ */
+struct CompactionOptions {
+    int num_levels = 7;
+    size_t level0_file_num_trigger = 4;                    // compact L0 into L1 once it has this many files
+    uint64_t max_bytes_for_level_base = 10 * 1024 * 1024;  // target size of L1
+    int max_bytes_for_level_multiplier = 10;
+    uint64_t target_file_size = 2 * 1024 * 1024;          // compaction output files are cut at this size
+};
+
+class Compaction {
+public:
+    // Target size in bytes of level (level >= 1)
+    static uint64_t maxBytesForLevel(const CompactionOptions& options, int level);
+
+    /*
+     * Merge sorted SSTs into new SSTs of about target_file_size bytes.
+     * inputs are ordered newest first; for a key present in several inputs only
+     * the newest version is written, plus the newest version each snapshot
+     * (sequence numbers, ascending) can see. Records covered by a newer range
+     * tombstone that no snapshot tells apart from them are dropped. Tombstones
+     * are kept unless bottommost (no older data below the inputs) and older
+     * than every snapshot. Written files are removed again if the merge fails.
+     */
+    static std::vector<FlushSSTInfo> merge(const std::vector<std::shared_ptr<SSTable>>& inputs,
+                                           FileManager& fileManager,
+                                           uint64_t target_file_size,
+                                           bool bottommost = false,
+                                           const std::vector<uint64_t>& snapshots = {});
+
+    // Approximate serialized size of one record
+    static size_t approximateSize(const KeyValue& kv);
+};
+
+#endif //COMPACTION_H
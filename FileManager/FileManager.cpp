@@ -6,6 +6,23 @@
 #include <stdexcept>
 #include <functional>
 #include <cstdint>
+#include <sstream>
+#include <algorithm>
+#include <cstring>
+#include <system_error>
+#include "SSTable.h"
+
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace {
+    std::function<void(const fs::path&, bool)> sync_observer;
+}
 
 // Constructor
 FileManager::FileManager() : directory("defaultDB") {}
@@ -28,9 +45,38 @@ fs::path FileManager::getDirectory() const {
     return directory;
 }
 
+void FileManager::syncPath(const fs::path& path, bool directory) {
+#ifdef _WIN32
+    // Windows can't open a directory as a file; new entries are made durable by the file system
+    if (directory) return;
+    int fd = _wopen(path.c_str(), _O_RDWR | _O_BINARY);
+    int rc = fd < 0 ? -1 : _commit(fd);
+    if (fd >= 0) _close(fd);
+#else
+    int fd = ::open(path.c_str(), directory ? O_RDONLY : O_RDWR);
+    int rc = fd < 0 ? -1 : ::fsync(fd);
+    if (fd >= 0) ::close(fd);
+#endif
+    if (rc != 0) {
+        throw std::runtime_error("FileManager::syncPath() >>>> Failed to sync " + path.string());
+    }
+    if (sync_observer) {
+        sync_observer(path, directory);
+    }
+}
+
+void FileManager::setSyncObserver(std::function<void(const fs::path&, bool)> observer) {
+    sync_observer = std::move(observer);
+}
+
 // Generate a unique filename for an SST file
 std::string FileManager::generateSstFilename() {
-    return "sst_" + std::to_string(increaseFileCounter()) + ".sst";
+    // Skip names already on disk (e.g. written before the database was reopened)
+    std::string filename;
+    do {
+        filename = "sst_" + std::to_string(increaseFileCounter()) + ".sst";
+    } while (fs::exists(directory / filename));
+    return filename;
 }
 
 /*
@@ -50,12 +96,12 @@ uint32_t SSTHeader::calculateChecksum() const {
  * num_key_values | header_checksum |
  * ==============================================================================
  */
-void SSTHeader::serialize(std::ofstream& file) const {
+void SSTHeader::serialize(std::ostream& file) const {
     file.write(reinterpret_cast<const char*>(&num_key_values), sizeof(num_key_values));
     file.write(reinterpret_cast<const char*>(&header_checksum), sizeof(header_checksum));
 }
 
-SSTHeader SSTHeader::deserialize(std::ifstream& file) {
+SSTHeader SSTHeader::deserialize(std::istream& file) {
     SSTHeader header;
     file.read(reinterpret_cast<char*>(&header.num_key_values), sizeof(header.num_key_values));
     file.read(reinterpret_cast<char*>(&header.header_checksum), sizeof(header.header_checksum));
@@ -63,6 +109,56 @@ SSTHeader SSTHeader::deserialize(std::ifstream& file) {
 }
 
 
+/*
+ * Field helpers shared by records, index entries and the Index.sst file
+ */
+namespace {
+    // Write a key or a value based on its type
+    void writeField(std::ostream& file, const KeyValue::KeyType& field) {
+        std::visit([&file](auto&& arg) {
+            using T = std::decay_t<decltype(arg)>;
+            if constexpr (std::is_same_v<T, std::string>) {
+                uint32_t str_len = arg.size();
+                file.write(reinterpret_cast<const char*>(&str_len), sizeof(str_len));  // Write string length
+                file.write(arg.data(), str_len);  // Write string data
+            } else {
+                file.write(reinterpret_cast<const char*>(&arg), sizeof(arg));  // Write other types (int, double, etc.)
+            }
+        }, field);
+    }
+
+    template<typename T>
+    T readPod(std::istream& file) {
+        T v;
+        file.read(reinterpret_cast<char*>(&v), sizeof(v));
+        return v;
+    }
+
+    // Read a key or a value of the given type
+    KeyValue::KeyType readField(std::istream& file, KeyValue::KeyValueType type, const char* what) {
+        switch (type) {
+            case KeyValue::KeyValueType::INT:
+                return readPod<int>(file);
+            case KeyValue::KeyValueType::LONG:
+                return readPod<long long>(file);
+            case KeyValue::KeyValueType::DOUBLE:
+                return readPod<double>(file);
+            case KeyValue::KeyValueType::CHAR:
+                return readPod<char>(file);
+            case KeyValue::KeyValueType::STRING: {
+                std::string str;
+                uint32_t str_len = readPod<uint32_t>(file);  // Read string length
+                str.resize(str_len);
+                file.read(&str[0], str_len);  // Read string content
+                return str;
+            }
+            default:
+                throw std::runtime_error(std::string("FileManager::SerializedKeyValue::deserialize()::") + what + " >>>> Unsupported type");
+        }
+    }
+}
+
+
 /*
  * Serialized Key Value
  *
@@ -94,7 +190,7 @@ uint32_t SerializedKeyValue::calculateChecksum() const {
 
 /*
  * .sst File SerializedKeyValue Structure
- * void SerializedKeyValue::serialize(ofstream&)
+ * void SerializedKeyValue::serialize(ostream&)
  * ==============================================================================
  * String Type:
  * kv_checksum | keyType | str_len | (string) keyValue | valueType | valueValue |
@@ -103,152 +199,232 @@ uint32_t SerializedKeyValue::calculateChecksum() const {
  * kv_checksum | keyType | (T) keyValue | valueType | valueValue |
  * ==============================================================================
  */
-void SerializedKeyValue::serialize(std::ofstream& file) const {
+void SerializedKeyValue::serialize(std::ostream& file) const {
     // Write the checksum (total length of the key-value block)
     file.write(reinterpret_cast<const char*>(&kv_checksum), sizeof(kv_checksum));
 
-    // Write the key type
-    KeyValue::KeyValueType keyType = kv.getKeyType();
-    file.write(reinterpret_cast<const char*>(&keyType), sizeof(KeyValue::KeyValueType));
-
-    // Write the key based on its type
-    std::visit([&file](auto&& arg) {
-        using T = std::decay_t<decltype(arg)>;
-        if constexpr (std::is_same_v<T, std::string>) {
-            uint32_t str_len = arg.size();
-            file.write(reinterpret_cast<const char*>(&str_len), sizeof(str_len));  // Write string length
-            file.write(arg.data(), str_len);  // Write string data
-        } else {
-            file.write(reinterpret_cast<const char*>(&arg), sizeof(arg));  // Write other types (int, double, etc.)
-        }
-    }, kv.getKey());
+    // Write the key type and the key
+    serializeKey(file, kv);
 
     // Write the value type
     KeyValue::KeyValueType valueType = kv.getValueType();
     file.write(reinterpret_cast<const char*>(&valueType), sizeof(KeyValue::KeyValueType));
 
-    // Write the value based on its type
-    std::visit([&file](auto&& arg) {
-        using T = std::decay_t<decltype(arg)>;
-        if constexpr (std::is_same_v<T, std::string>) {
-            uint32_t str_len = arg.size();
-            file.write(reinterpret_cast<const char*>(&str_len), sizeof(str_len));  // Write string length
-            file.write(arg.data(), str_len);  // Write string data
-        } else {
-            file.write(reinterpret_cast<const char*>(&arg), sizeof(arg));  // Write other types (int, double, etc.)
-        }
-    }, kv.getValue());
+    // Write the value based on its type: nothing for a tombstone, the typed end key for a range tombstone
+    if (valueType == KeyValue::KeyValueType::RANGE_DELETION) {
+        KeyValue::KeyValueType endType = KeyValue::fieldType(kv.getValue());
+        file.write(reinterpret_cast<const char*>(&endType), sizeof(KeyValue::KeyValueType));
+    }
+    if (valueType != KeyValue::KeyValueType::DELETION) {
+        writeField(file, kv.getValue());
+    }
 }
 
 
-SerializedKeyValue SerializedKeyValue::deserialize(std::ifstream& file) {
+SerializedKeyValue SerializedKeyValue::deserialize(std::istream& file) {
     SerializedKeyValue skv;
 
     // Read the checksum
     file.read(reinterpret_cast<char*>(&skv.kv_checksum), sizeof(skv.kv_checksum));
 
-    // Read the key type
-    KeyValue::KeyValueType keyType;
-    file.read(reinterpret_cast<char*>(&keyType), sizeof(KeyValue::KeyValueType));
-
-    // Deserialize the key based on its type
-    KeyValue::KeyType key;
-    switch (keyType) {
-        case KeyValue::KeyValueType::INT: {
-            int k;
-            file.read(reinterpret_cast<char*>(&k), sizeof(k));
-            key = k;
-            break;
-        }
-        case KeyValue::KeyValueType::LONG: {
-            long long k;
-            file.read(reinterpret_cast<char*>(&k), sizeof(k));
-            key = k;
-            break;
-        }
-        case KeyValue::KeyValueType::DOUBLE: {
-            double k;
-            file.read(reinterpret_cast<char*>(&k), sizeof(k));
-            key = k;
-            break;
-        }
-        case KeyValue::KeyValueType::CHAR: {
-            char k;
-            file.read(reinterpret_cast<char*>(&k), sizeof(k));
-            key = k;
-            break;
+    // Read the key type and deserialize the key based on its type
+    auto keyType = readPod<KeyValue::KeyValueType>(file);
+    KeyValue::KeyType key = readField(file, keyType, "Key");
+
+    // Read the value type and deserialize the value based on its type
+    auto valueType = readPod<KeyValue::KeyValueType>(file);
+    if (valueType == KeyValue::KeyValueType::DELETION) {
+        skv.kv = KeyValue::Tombstone(key);
+    } else if (valueType == KeyValue::KeyValueType::RANGE_DELETION) {
+        auto endType = readPod<KeyValue::KeyValueType>(file);
+        skv.kv = KeyValue::RangeTombstone(key, readField(file, endType, "Value"));
+    } else {
+        KeyValue::ValueType value = readField(file, valueType, "Value");
+        // Now use the KeyValue constructor to set the key and value
+        skv.kv = KeyValue(key, value);
+    }
+
+    return skv;
+}
+
+void SerializedKeyValue::serializeKey(std::ostream& file, const KeyValue& kv) {
+    KeyValue::KeyValueType keyType = kv.getKeyType();
+    file.write(reinterpret_cast<const char*>(&keyType), sizeof(KeyValue::KeyValueType));
+    writeField(file, kv.getKey());
+}
+
+KeyValue SerializedKeyValue::deserializeKey(std::istream& file) {
+    auto keyType = readPod<KeyValue::KeyValueType>(file);
+    return KeyValue(readField(file, keyType, "Key"), 0);
+}
+
+
+/*
+ * In-memory decoding (mapped SST files)
+ *
+ * Same record layout as SerializedKeyValue::deserialize, but fixed-width fields
+ * are copied straight from the mapped bytes into the variant.
+ */
+namespace {
+    void checkBounds(const char* ptr, const char* end, size_t n) {
+        if (ptr > end || static_cast<size_t>(end - ptr) < n) {
+            throw std::runtime_error("FileManager::SerializedKeyValue::decode() >>>> Truncated record");
         }
+    }
+
+    template<typename T>
+    T decodePod(const char*& ptr, const char* end) {
+        checkBounds(ptr, end, sizeof(T));
+        T v;
+        std::memcpy(&v, ptr, sizeof(T));
+        ptr += sizeof(T);
+        return v;
+    }
+}
+
+KeyValue::KeyType SerializedKeyValue::decodeField(const char*& ptr, const char* end) {
+    switch (decodePod<KeyValue::KeyValueType>(ptr, end)) {
+        case KeyValue::KeyValueType::INT:
+            return decodePod<int>(ptr, end);
+        case KeyValue::KeyValueType::LONG:
+            return decodePod<long long>(ptr, end);
+        case KeyValue::KeyValueType::DOUBLE:
+            return decodePod<double>(ptr, end);
+        case KeyValue::KeyValueType::CHAR:
+            return decodePod<char>(ptr, end);
         case KeyValue::KeyValueType::STRING: {
-            std::string k;
-            uint32_t str_len;
-            file.read(reinterpret_cast<char*>(&str_len), sizeof(str_len));  // Read string length
-            k.resize(str_len);
-            file.read(&k[0], str_len);  // Read string content
-            key = k;
-            break;
+            uint32_t str_len = decodePod<uint32_t>(ptr, end);
+            checkBounds(ptr, end, str_len);
+            std::string str(ptr, str_len);
+            ptr += str_len;
+            return str;
         }
         default:
-            throw std::runtime_error("FileManager::SerializedKeyValue::deserialize()::Key >>>> Unsupported key type");
+            throw std::runtime_error("FileManager::SerializedKeyValue::decodeField() >>>> Unsupported type");
     }
+}
 
-    // Read the value type
-    KeyValue::KeyValueType valueType;
-    file.read(reinterpret_cast<char*>(&valueType), sizeof(KeyValue::KeyValueType));
-
-    // Deserialize the value based on its type
-    KeyValue::ValueType value;
-    switch (valueType) {
-        case KeyValue::KeyValueType::INT: {
-            int v;
-            file.read(reinterpret_cast<char*>(&v), sizeof(v));
-            value = v;
-            break;
-        }
-        case KeyValue::KeyValueType::LONG: {
-            long long v;
-            file.read(reinterpret_cast<char*>(&v), sizeof(v));
-            value = v;
-            break;
-        }
-        case KeyValue::KeyValueType::DOUBLE: {
-            double v;
-            file.read(reinterpret_cast<char*>(&v), sizeof(v));
-            value = v;
-            break;
-        }
-        case KeyValue::KeyValueType::CHAR: {
-            char v;
-            file.read(reinterpret_cast<char*>(&v), sizeof(v));
-            value = v;
-            break;
-        }
-        case KeyValue::KeyValueType::STRING: {
-            std::string v;
-            uint32_t str_len;
-            file.read(reinterpret_cast<char*>(&str_len), sizeof(str_len));  // Read string length
-            v.resize(str_len);
-            file.read(&v[0], str_len);  // Read string content
-            value = v;
-            break;
-        }
+void SerializedKeyValue::skipField(const char*& ptr, const char* end) {
+    size_t n;
+    switch (decodePod<KeyValue::KeyValueType>(ptr, end)) {
+        case KeyValue::KeyValueType::INT: n = sizeof(int); break;
+        case KeyValue::KeyValueType::LONG: n = sizeof(long long); break;
+        case KeyValue::KeyValueType::DOUBLE: n = sizeof(double); break;
+        case KeyValue::KeyValueType::CHAR: n = sizeof(char); break;
+        case KeyValue::KeyValueType::STRING: n = decodePod<uint32_t>(ptr, end); break;
+        case KeyValue::KeyValueType::DELETION: n = 0; break;
+        case KeyValue::KeyValueType::RANGE_DELETION: skipField(ptr, end); return;
         default:
-            throw std::runtime_error("FileManager::SerializedKeyValue::deserialize()::Value >>>> Unsupported value type");
+            throw std::runtime_error("FileManager::SerializedKeyValue::skipField() >>>> Unsupported type");
     }
+    checkBounds(ptr, end, n);
+    ptr += n;
+}
 
-    // Now use the KeyValue constructor to set the key and value
-    skv.kv = KeyValue(key, value);
+KeyValue SerializedKeyValue::decodeValue(KeyValue::KeyType key, const char*& ptr, const char* end) {
+    checkBounds(ptr, end, sizeof(KeyValue::KeyValueType));
+    KeyValue::KeyValueType valueType;
+    std::memcpy(&valueType, ptr, sizeof(valueType));
+    if (valueType == KeyValue::KeyValueType::DELETION) {
+        ptr += sizeof(valueType);
+        return KeyValue::Tombstone(key);
+    }
+    if (valueType == KeyValue::KeyValueType::RANGE_DELETION) {
+        ptr += sizeof(valueType);
+        return KeyValue::RangeTombstone(key, decodeField(ptr, end));
+    }
+    return KeyValue(std::move(key), decodeField(ptr, end));
+}
 
+SerializedKeyValue SerializedKeyValue::decode(const char*& ptr, const char* end) {
+    SerializedKeyValue skv;
+    skv.kv_checksum = decodePod<uint32_t>(ptr, end);
+    KeyValue::KeyType key = decodeField(ptr, end);
+    skv.kv = decodeValue(std::move(key), ptr, end);
     return skv;
 }
 
+/*
+ * Sequenced record
+ * ==============================================================================
+ * SerializedKeyValue | sequence |
+ * ==============================================================================
+ */
+void SerializedKeyValue::serializeSequenced(std::ostream& file, const KeyValue& kv) {
+    SerializedKeyValue skv{kv, 0};
+    skv.kv_checksum = skv.calculateChecksum();
+    skv.serialize(file);
+    uint64_t sequence = kv.getSequence();
+    file.write(reinterpret_cast<const char*>(&sequence), sizeof(sequence));
+}
+
+KeyValue SerializedKeyValue::decodeSequenced(const char*& ptr, const char* end) {
+    KeyValue kv = decode(ptr, end).kv;
+    kv.setSequence(decodeSequence(ptr, end));
+    return kv;
+}
+
+uint64_t SerializedKeyValue::decodeSequence(const char*& ptr, const char* end) {
+    return decodePod<uint64_t>(ptr, end);
+}
+
+
+/*
+ * Block Handle & Footer
+ *
+ */
+void BlockHandle::serialize(std::ostream& file) const {
+    file.write(reinterpret_cast<const char*>(&offset), sizeof(offset));
+    file.write(reinterpret_cast<const char*>(&size), sizeof(size));
+    file.write(reinterpret_cast<const char*>(&num_entries), sizeof(num_entries));
+}
+
+BlockHandle BlockHandle::deserialize(std::istream& file) {
+    BlockHandle handle;
+    handle.offset = readPod<uint64_t>(file);
+    handle.size = readPod<uint32_t>(file);
+    handle.num_entries = readPod<uint32_t>(file);
+    return handle;
+}
+
+void SSTFooter::serialize(std::ostream& file) const {
+    file.write(reinterpret_cast<const char*>(&index_offset), sizeof(index_offset));
+    file.write(reinterpret_cast<const char*>(&index_size), sizeof(index_size));
+    file.write(reinterpret_cast<const char*>(&filter_offset), sizeof(filter_offset));
+    file.write(reinterpret_cast<const char*>(&filter_size), sizeof(filter_size));
+    file.write(reinterpret_cast<const char*>(&largest_sequence), sizeof(largest_sequence));
+    file.write(reinterpret_cast<const char*>(&magic), sizeof(magic));
+}
+
+SSTFooter SSTFooter::deserialize(std::istream& file) {
+    SSTFooter footer;
+    footer.index_offset = readPod<uint64_t>(file);
+    footer.index_size = readPod<uint64_t>(file);
+    footer.filter_offset = readPod<uint64_t>(file);
+    footer.filter_size = readPod<uint64_t>(file);
+    footer.largest_sequence = readPod<uint64_t>(file);
+    footer.magic = readPod<uint64_t>(file);
+    return footer;
+}
+
 
 
 
 
 /*
  * File Manager Public Methods
+ *
+ * .sst File Layout (block based)
+ * ==============================================================================
+ * SSTHeader | data block 0 | ... | data block n | index block | filter block | SSTFooter |
+ * ==============================================================================
+ * Each data block is a run of sequenced records (SerializedKeyValue | sequence),
+ * cut once it reaches blockSize bytes, but never between two versions of a key:
+ * a lookup only has to search one block. The index block holds the BlockHandle and first key of every
+ * data block, so a lookup only decodes one block instead of the whole file.
+ * The filter block is a BloomFilter over the point keys of the file.
  */
-FlushSSTInfo FileManager::flushToDisk(const std::vector<KeyValue>& kv_pairs) {
+FlushSSTInfo FileManager::flushToDisk(const std::vector<KeyValue>& kv_pairs, const std::vector<KeyValue>& range_deletions) {
     FlushSSTInfo flushInfo;
     flushInfo.fileName = generateSstFilename();
 
@@ -262,10 +438,23 @@ FlushSSTInfo FileManager::flushToDisk(const std::vector<KeyValue>& kv_pairs) {
         throw std::runtime_error("FileManager::flushToDisk() >>>> Could not open SST file for writing.");
     }
 
-    if (kv_pairs.size() < 1) return flushInfo;
-    // Set the smallest and largest keys
-    flushInfo.smallest_key = kv_pairs.front();
-    flushInfo.largest_key = kv_pairs.back();
+    if (kv_pairs.empty() && range_deletions.empty()) return flushInfo;
+    // Set the smallest and largest keys; the file's range also spans its range tombstones
+    bool first = kv_pairs.empty();
+    if (!first) {
+        flushInfo.smallest_key = kv_pairs.front();
+        flushInfo.largest_key = kv_pairs.back();
+    }
+    for (const auto& kv : kv_pairs) {
+        flushInfo.largest_sequence = std::max(flushInfo.largest_sequence, kv.getSequence());
+    }
+    for (const auto& range : range_deletions) {
+        flushInfo.largest_sequence = std::max(flushInfo.largest_sequence, range.getSequence());
+        KeyValue end = range.rangeEnd();
+        if (first || range < flushInfo.smallest_key) flushInfo.smallest_key = KeyValue(range.getKey(), 0);
+        if (first || flushInfo.largest_key < end) flushInfo.largest_key = end;
+        first = false;
+    }
 
     // Create the header
     sstHeader.num_key_values = kv_pairs.size();
@@ -273,56 +462,126 @@ FlushSSTInfo FileManager::flushToDisk(const std::vector<KeyValue>& kv_pairs) {
 
     // Write header to disk
     sstHeader.serialize(file);
+    uint64_t offset = sizeof(sstHeader.num_key_values) + sizeof(sstHeader.header_checksum);
 
-    // Write each serialized key-value pair
-    for (const auto& kv : kv_pairs) {
-        SerializedKeyValue skv;
-        skv.kv = kv;
-        skv.kv_checksum = skv.calculateChecksum();
-        skv.serialize(file);
+    // Bloom filter over the point keys of the file; the range tombstones are kept
+    // in the index block, where lookups the filter turns away still check them
+    flushInfo.has_range_deletions = !range_deletions.empty();
+    if (bloomBitsPerKey > 0 && !kv_pairs.empty()) {
+        flushInfo.filter = std::make_shared<BloomFilter>(kv_pairs.size(), bloomBitsPerKey);
     }
 
-    file.close();
-    return flushInfo;
-}
+    // Write serialized key-value pairs, cut into data blocks of ~blockSize bytes
+    std::vector<BlockIndexEntry> blocks;
+    std::ostringstream block;
+    BlockIndexEntry current;
+    auto finishBlock = [&]() {
+        std::string bytes = block.str();
+        current.handle.offset = offset;
+        current.handle.size = bytes.size();
+        file.write(bytes.data(), bytes.size());
+        offset += bytes.size();
+        blocks.push_back(current);
+        current.handle.num_entries = 0;
+        block.str("");
+    };
+    for (size_t i = 0; i < kv_pairs.size(); ++i) {
+        const KeyValue& kv = kv_pairs[i];
+        if (current.handle.num_entries == 0) {
+            current.first_key = kv;
+        }
+        if (flushInfo.filter) {
+            flushInfo.filter->addKey(kv);
+        }
+        SerializedKeyValue::serializeSequenced(block, kv);
+        current.handle.num_entries++;
+        bool same_key_next = i + 1 < kv_pairs.size() && !(kv < kv_pairs[i + 1]);
+        if (static_cast<size_t>(block.tellp()) >= blockSize && !same_key_next) {
+            finishBlock();
+        }
+    }
+    if (current.handle.num_entries > 0) {
+        finishBlock();
+    }
 
-RedBlackTree* FileManager::loadFromDisk(const std::string& sst_filename) {
-    // Open the SST file
-    std::ifstream file(directory / sst_filename, std::ios::binary);
-    if (!file.is_open()) {
-        throw std::runtime_error("FileManager::loadFromDisk() >>>> Could not open SST file for reading.");
+    /*
+     * Index block
+     * ==============================================================================
+     * num_blocks | { BlockHandle | keyType | [str_len] | first key } * num_blocks |
+     * [ num_range_deletions | (SerializedKeyValue | sequence) * num_range_deletions ] |
+     * ==============================================================================
+     * The range tombstones (sorted by start key) only follow when the file has any.
+     */
+    std::ostringstream index;
+    uint32_t num_blocks = blocks.size();
+    index.write(reinterpret_cast<const char*>(&num_blocks), sizeof(num_blocks));
+    for (const auto& entry : blocks) {
+        entry.handle.serialize(index);
+        SerializedKeyValue::serializeKey(index, entry.first_key);
+    }
+    if (!range_deletions.empty()) {
+        uint32_t num_range_deletions = range_deletions.size();
+        index.write(reinterpret_cast<const char*>(&num_range_deletions), sizeof(num_range_deletions));
+        for (const auto& range : range_deletions) {
+            SerializedKeyValue::serializeSequenced(index, range);
+        }
+    }
+    std::string indexBytes = index.str();
+    file.write(indexBytes.data(), indexBytes.size());
+
+    SSTFooter footer;
+    footer.largest_sequence = flushInfo.largest_sequence;
+    footer.index_offset = offset;
+    footer.index_size = indexBytes.size();
+    offset += indexBytes.size();
+
+    // Filter block
+    if (flushInfo.filter) {
+        std::ostringstream filter;
+        flushInfo.filter->serialize(filter);
+        std::string filterBytes = filter.str();
+        file.write(filterBytes.data(), filterBytes.size());
+        footer.filter_offset = offset;
+        footer.filter_size = filterBytes.size();
     }
 
-    // Check if the file is empty
-    file.seekg(0, std::ios::end);  // Move to the end of the file
-    std::streampos file_size = file.tellg();  // Get the size of the file
-    file.seekg(0, std::ios::beg);  // Move back to the beginning of the file
+    // Footer
+    footer.serialize(file);
 
-    if (file_size == 0) {
-        // If the file is empty, return an empty RedBlackTree
-        file.close();
-        return new RedBlackTree();  // Returning an empty tree
+    // Durable before the caller makes it part of the database (and drops the WAL or inputs behind it)
+    file.close();
+    if (!file) {
+        std::error_code ec;
+        fs::remove(directory / flushInfo.fileName, ec);
+        throw std::runtime_error("FileManager::flushToDisk() >>>> Failed to write " + (directory / flushInfo.fileName).string());
     }
+    syncPath(directory / flushInfo.fileName, false);
+    syncPath(directory, true);
+    return flushInfo;
+}
 
-    // Deserialize the SST header
-    SSTHeader sstHeader = SSTHeader::deserialize(file);
+RedBlackTree* FileManager::loadFromDisk(const std::string& sst_filename) {
+    // Map the SST file and decode every record from the mapped bytes
+    std::shared_ptr<SSTable> table = SSTable::open(directory / sst_filename);
 
     // Create a new RedBlackTree to hold the KeyValue pairs
     auto* tree = new RedBlackTree();
-
-    // Loop through the number of KeyValue pairs
-    for (uint32_t i = 0; i < sstHeader.num_key_values; ++i) {
-        // Deserialize each SerializedKeyValue from the file
-        SerializedKeyValue skv = SerializedKeyValue::deserialize(file);
-
-        // Insert the deserialized KeyValue into the RedBlackTree
-        tree->insert(skv.kv);
+    for (const auto& kv : table->readAll()) {
+        tree->insert(kv);
     }
 
-    // Close the file
-    file.close();
-
-    // Return the populated RedBlackTree
+    // Return the populated RedBlackTree (empty for an empty file)
     return tree;
 }
 
+KeyValue FileManager::searchInSST(const std::string& sst_filename, const KeyValue& kv) {
+    return SSTable::open(directory / sst_filename)->get(kv);
+}
+
+void FileManager::scanInSST(const std::string& sst_filename, const KeyValue& small_key, const KeyValue& large_key, std::set<KeyValue>& res) {
+    SSTable::open(directory / sst_filename)->scan(small_key, large_key, res);
+}
+
+std::shared_ptr<BloomFilter> FileManager::loadFilter(const std::string& sst_filename) {
+    return SSTable::open(directory / sst_filename)->readFilter();
+}
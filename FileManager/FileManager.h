@@ -11,7 +11,13 @@
 #include <fstream>
 #include <string>
 #include <iostream>
+#include <istream>
+#include <ostream>
+#include <set>
+#include <memory>
+#include <functional>
 #include <RedBlackTree.h>
+#include "BloomFilter.h"
 
 namespace fs = std::filesystem;
 
@@ -19,6 +25,9 @@ struct FlushSSTInfo {
     std::string fileName;
     KeyValue smallest_key;
     KeyValue largest_key;
+    std::shared_ptr<BloomFilter> filter;  // filter written into the SST (nullptr if disabled)
+    uint64_t largest_sequence = 0;
+    bool has_range_deletions = false;
 };
 
 // struct SSTInfileIndex {
@@ -36,9 +45,9 @@ struct SSTHeader {
     // Helper method to calculate checksum for the header
     uint32_t calculateChecksum() const;
     // Serialize the header to a binary file
-    void serialize(std::ofstream& file) const;
+    void serialize(std::ostream& file) const;
     // Deserialize the header from a binary file
-    static SSTHeader deserialize(std::ifstream& file);
+    static SSTHeader deserialize(std::istream& file);
 };
 
 
@@ -48,9 +57,66 @@ struct SerializedKeyValue {
     // Helper method to calculate checksum for KeyValue pair
     uint32_t calculateChecksum() const;
     // Serialize KeyValue pair
-    void serialize(std::ofstream& file) const;
+    void serialize(std::ostream& file) const;
     // Deserialize KeyValue pair
-    static SerializedKeyValue deserialize(std::ifstream& file);
+    static SerializedKeyValue deserialize(std::istream& file);
+    // Serialize / deserialize only the key part (keyType | [str_len] | key)
+    static void serializeKey(std::ostream& file, const KeyValue& kv);
+    static KeyValue deserializeKey(std::istream& file);
+    // Decode directly from in-memory (mapped) bytes, advancing ptr; throws on truncated input
+    static SerializedKeyValue decode(const char*& ptr, const char* end);
+    // Decode / skip one typed field (type | [str_len] | field)
+    static KeyValue::KeyType decodeField(const char*& ptr, const char* end);
+    static void skipField(const char*& ptr, const char* end);
+    // Decode the value part of a record for key (a tombstone when its type says so)
+    static KeyValue decodeValue(KeyValue::KeyType key, const char*& ptr, const char* end);
+    // Record followed by the sequence number of kv (WAL records and v3 SST records)
+    static void serializeSequenced(std::ostream& file, const KeyValue& kv);
+    static KeyValue decodeSequenced(const char*& ptr, const char* end);
+    static uint64_t decodeSequence(const char*& ptr, const char* end);
+};
+
+
+/*
+ * .sst File BlockHandle Structure
+ * ==============================================================================
+ * offset | size | num_entries |
+ * ==============================================================================
+ */
+struct BlockHandle {
+    uint64_t offset = 0;       // Byte offset of the block inside the .sst file
+    uint32_t size = 0;         // Size of the block in bytes
+    uint32_t num_entries = 0;  // Number of SerializedKeyValue records in the block
+    void serialize(std::ostream& file) const;
+    static BlockHandle deserialize(std::istream& file);
+};
+
+// One entry of the in-file index block: the first key of a data block and where to find it
+struct BlockIndexEntry {
+    KeyValue first_key;
+    BlockHandle handle;
+};
+
+/*
+ * .sst File SSTFooter Structure (fixed size, last bytes of the file)
+ * ==============================================================================
+ * index_offset | index_size | filter_offset | filter_size | largest_sequence | magic |
+ * ==============================================================================
+ * v2 files ("kvdb_st2") have no largest_sequence and no sequence numbers in their records.
+ */
+struct SSTFooter {
+    static constexpr uint64_t MAGIC = 0x6B7664625F737433ULL;  // "kvdb_st3"
+    static constexpr std::streamoff ENCODED_SIZE = 6 * sizeof(uint64_t);
+    static constexpr uint64_t V2_MAGIC = 0x6B7664625F737432ULL;  // "kvdb_st2"
+    static constexpr std::streamoff V2_ENCODED_SIZE = 5 * sizeof(uint64_t);
+    uint64_t index_offset = 0;
+    uint64_t index_size = 0;
+    uint64_t filter_offset = 0;
+    uint64_t filter_size = 0;  // 0 when the SST has no filter block
+    uint64_t largest_sequence = 0;
+    uint64_t magic = MAGIC;
+    void serialize(std::ostream& file) const;
+    static SSTFooter deserialize(std::istream& file);
 };
 
 
@@ -59,10 +125,25 @@ class FileManager {
 public:
     FileManager(); // added
     explicit FileManager(fs::path directory); // added
-    // Flush KeyValue pairs to disk and return metadata about the SST file
-    FlushSSTInfo flushToDisk(const std::vector<KeyValue>& kv_pairs);
+    // Flush KeyValue pairs (and the range tombstones covering older files) to disk
+    // and return metadata about the SST file. Versions of a key follow each other,
+    // newest first, and always share a data block.
+    FlushSSTInfo flushToDisk(const std::vector<KeyValue>& kv_pairs, const std::vector<KeyValue>& range_deletions = {});
     // Load KeyValue pairs from disk into memory
     RedBlackTree* loadFromDisk(const std::string& sst_filename);
+    // One-shot readers over a freshly mapped SSTable (see SSTable.h for long-lived readers)
+    // Point lookup: read footer + index block, then decode only the matching data block
+    KeyValue searchInSST(const std::string& sst_filename, const KeyValue& kv);
+    // Range scan: decode only the data blocks overlapping [small_key, large_key]
+    void scanInSST(const std::string& sst_filename, const KeyValue& small_key, const KeyValue& large_key, std::set<KeyValue>& res);
+    // Load the Bloom filter block of an SST (nullptr if the file has none)
+    std::shared_ptr<BloomFilter> loadFilter(const std::string& sst_filename);
+    // Target size in bytes of each data block
+    void setBlockSize(size_t size) {blockSize = size;};
+    size_t getBlockSize() const {return blockSize;};
+    // Bloom filter bits per key, 0 disables filters
+    void setBloomBitsPerKey(int bits) {bloomBitsPerKey = bits;};
+    int getBloomBitsPerKey() const {return bloomBitsPerKey;};
     // Generate name for SST
     std::string generateSstFilename(); // added
     // Set the directory for storing SST files
@@ -71,11 +152,19 @@ public:
     fs::path getDirectory() const; // added
     // Increase file counter
     int increaseFileCounter() {return ++sstFileCounter - 1;};
+    // Make the data of path (a file, or the entries of a directory) durable; throws on failure
+    static void syncPath(const fs::path& path, bool directory);
+    // Called after every syncPath() with what it made durable (tests check the order of syncs)
+    static void setSyncObserver(std::function<void(const fs::path&, bool directory)> observer);
+
+    static constexpr size_t DEFAULT_BLOCK_SIZE = 4096;
 
 private:
     fs::path directory;
     int sstFileCounter = 0;  // To keep track of SST file names
     SSTHeader sstHeader;
+    size_t blockSize = DEFAULT_BLOCK_SIZE;
+    int bloomBitsPerKey = BloomFilter::DEFAULT_BITS_PER_KEY;
 
 };
 
@@ -0,0 +1,78 @@
+//
+// Created by Damian Li on 2024-09-16.
+//
+
+#include "MappedFile.h"
+#include <stdexcept>
+#include <string>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+std::shared_ptr<MappedFile> MappedFile::open(const fs::path& path) {
+    std::shared_ptr<MappedFile> file(new MappedFile());
+#ifdef _WIN32
+    HANDLE handle = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE,
+                                nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (handle == INVALID_HANDLE_VALUE) {
+        throw std::runtime_error("MappedFile::open() >>>> Could not open file: " + path.string());
+    }
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(handle, &file_size)) {
+        CloseHandle(handle);
+        throw std::runtime_error("MappedFile::open() >>>> Could not stat file: " + path.string());
+    }
+    file->length = static_cast<size_t>(file_size.QuadPart);
+    if (file->length > 0) {
+        HANDLE mapping = CreateFileMappingW(handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (mapping != nullptr) {
+            file->base = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+            CloseHandle(mapping);  // the view keeps the mapping alive
+        }
+        if (file->base == nullptr) {
+            CloseHandle(handle);
+            throw std::runtime_error("MappedFile::open() >>>> Could not map file: " + path.string());
+        }
+    }
+    CloseHandle(handle);
+#else
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("MappedFile::open() >>>> Could not open file: " + path.string());
+    }
+    struct stat st {};
+    if (fstat(fd, &st) != 0) {
+        ::close(fd);
+        throw std::runtime_error("MappedFile::open() >>>> Could not stat file: " + path.string());
+    }
+    file->length = static_cast<size_t>(st.st_size);
+    if (file->length > 0) {
+        void* addr = mmap(nullptr, file->length, PROT_READ, MAP_SHARED, fd, 0);
+        if (addr == MAP_FAILED) {
+            ::close(fd);
+            throw std::runtime_error("MappedFile::open() >>>> Could not map file: " + path.string());
+        }
+        file->base = static_cast<const char*>(addr);
+    }
+    ::close(fd);  // the mapping keeps the file referenced
+#endif
+    return file;
+}
+
+MappedFile::~MappedFile() {
+    if (base == nullptr) return;
+#ifdef _WIN32
+    UnmapViewOfFile(base);
+#else
+    munmap(const_cast<char*>(base), length);
+#endif
+}
@@ -0,0 +1,37 @@
+//
+// Created by Damian Li on 2024-09-16.
+//
+
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <cstddef>
+#include <filesystem>
+#include <memory>
+
+namespace fs = std::filesystem;
+
+/*
+ * Read-only memory mapping of a whole file.
+ * The mapping stays valid for the lifetime of the object, so readers can decode
+ * records directly from data() without any stream or read() calls.
+ */
+class MappedFile {
+public:
+    // Map the file at path; throws std::runtime_error if it can't be opened
+    static std::shared_ptr<MappedFile> open(const fs::path& path);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const char* data() const {return base;};
+    size_t size() const {return length;};
+
+private:
+    MappedFile() = default;
+    const char* base = nullptr;
+    size_t length = 0;
+};
+
+#endif //MAPPEDFILE_H
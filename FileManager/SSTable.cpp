@@ -0,0 +1,379 @@
+//
+// Created by Damian Li on 2024-09-16.
+//
+
+#include "SSTable.h"
+#include "PerfContext.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+    template<typename T>
+    T readAt(const char* ptr) {
+        T v;
+        std::memcpy(&v, ptr, sizeof(T));
+        return v;
+    }
+
+    constexpr size_t HEADER_SIZE = 2 * sizeof(uint32_t);
+    constexpr size_t BLOCK_HANDLE_SIZE = sizeof(uint64_t) + 2 * sizeof(uint32_t);
+}
+
+std::shared_ptr<SSTable> SSTable::open(const fs::path& file_path, std::shared_ptr<BlockCache> cache, uint64_t cache_id) {
+    PERF_TIMER_GUARD(file_open_nanos);
+    PERF_COUNTER_ADD(file_open_count, 1);
+    std::shared_ptr<SSTable> table(new SSTable());
+    table->file = MappedFile::open(file_path);
+    if (cache) {
+        table->cacheId = cache_id != 0 ? cache_id : cache->newId();
+        table->blockCache = std::move(cache);
+    }
+
+    const char* base = table->file->data();
+    const size_t size = table->file->size();
+    if (size == 0) {
+        return table;  // empty SST
+    }
+
+    // Footer at the tail of the file, identified by its magic
+    if (size >= static_cast<size_t>(SSTFooter::V2_ENCODED_SIZE) + HEADER_SIZE) {
+        uint64_t magic = readAt<uint64_t>(base + size - sizeof(uint64_t));
+        table->sequenced = magic == SSTFooter::MAGIC && size >= static_cast<size_t>(SSTFooter::ENCODED_SIZE) + HEADER_SIZE;
+        table->blockBased = table->sequenced || magic == SSTFooter::V2_MAGIC;
+    }
+    if (table->blockBased) {
+        const char* p = base + size - (table->sequenced ? SSTFooter::ENCODED_SIZE : SSTFooter::V2_ENCODED_SIZE);
+        table->footer.index_offset = readAt<uint64_t>(p);
+        table->footer.index_size = readAt<uint64_t>(p + 8);
+        table->footer.filter_offset = readAt<uint64_t>(p + 16);
+        table->footer.filter_size = readAt<uint64_t>(p + 24);
+        table->footer.largest_sequence = table->sequenced ? readAt<uint64_t>(p + 32) : 0;
+        table->footer.magic = readAt<uint64_t>(base + size - sizeof(uint64_t));
+    }
+
+    if (!table->blockBased) {
+        // Legacy SST: header followed by records, exposed as one data block
+        if (size < HEADER_SIZE) {
+            throw std::runtime_error("SSTable::open() >>>> Corrupted SST file: " + file_path.string());
+        }
+        BlockIndexEntry entry;
+        entry.handle.offset = HEADER_SIZE;
+        entry.handle.size = size - HEADER_SIZE;
+        entry.handle.num_entries = readAt<uint32_t>(base);
+        if (entry.handle.num_entries > 0) {
+            const char* p = base + HEADER_SIZE + sizeof(uint32_t);
+            entry.first_key = KeyValue(SerializedKeyValue::decodeField(p, base + size), 0);
+            table->blocks.push_back(std::move(entry));
+        }
+        return table;
+    }
+
+    // Index block
+    const SSTFooter& footer = table->footer;
+    if (footer.index_offset + footer.index_size > size) {
+        throw std::runtime_error("SSTable::open() >>>> Corrupted index block: " + file_path.string());
+    }
+    const char* p = base + footer.index_offset;
+    const char* end = p + footer.index_size;
+    uint32_t num_blocks = readAt<uint32_t>(p);
+    p += sizeof(num_blocks);
+    table->blocks.reserve(num_blocks);
+    for (uint32_t i = 0; i < num_blocks; ++i) {
+        if (static_cast<size_t>(end - p) < BLOCK_HANDLE_SIZE) {
+            throw std::runtime_error("SSTable::open() >>>> Corrupted index block: " + file_path.string());
+        }
+        BlockIndexEntry entry;
+        entry.handle.offset = readAt<uint64_t>(p);
+        entry.handle.size = readAt<uint32_t>(p + 8);
+        entry.handle.num_entries = readAt<uint32_t>(p + 12);
+        p += BLOCK_HANDLE_SIZE;
+        entry.first_key = KeyValue(SerializedKeyValue::decodeField(p, end), 0);
+        if (entry.handle.offset + entry.handle.size > footer.index_offset) {
+            throw std::runtime_error("SSTable::open() >>>> Corrupted block handle: " + file_path.string());
+        }
+        table->blocks.push_back(std::move(entry));
+    }
+    // Range tombstones, if any, follow the block entries
+    if (p < end) {
+        if (static_cast<size_t>(end - p) < sizeof(uint32_t)) {
+            throw std::runtime_error("SSTable::open() >>>> Corrupted index block: " + file_path.string());
+        }
+        uint32_t num_range_deletions = readAt<uint32_t>(p);
+        p += sizeof(num_range_deletions);
+        table->rangeDeletions.reserve(num_range_deletions);
+        for (uint32_t i = 0; i < num_range_deletions; ++i) {
+            table->rangeDeletions.push_back(table->decodeRecord(p, end));
+        }
+    }
+    return table;
+}
+
+const KeyValue* SSTable::newestRangeDeletion(const KeyValue& kv, uint64_t sequence) const {
+    // Sorted by start: only tombstones starting at or before kv can cover it
+    const KeyValue* newest = nullptr;
+    for (const KeyValue& range : rangeDeletions) {
+        if (kv < range) {
+            break;
+        }
+        if (range.getSequence() <= sequence && range.covers(kv)
+            && (!newest || newest->getSequence() < range.getSequence())) {
+            newest = &range;
+        }
+    }
+    return newest;
+}
+
+KeyValue SSTable::applyRangeDeletions(const KeyValue& key, KeyValue point, uint64_t sequence) const {
+    if (rangeDeletions.empty()) {
+        return point;
+    }
+    // Before v3 every record of a file is newer than the file's range tombstones (both sequence 0)
+    const KeyValue* range = newestRangeDeletion(key, sequence);
+    if (range && (point.isEmpty() || point.getSequence() < range->getSequence())) {
+        KeyValue tombstone = KeyValue::Tombstone(key.getKey());
+        tombstone.setSequence(range->getSequence());
+        return tombstone;
+    }
+    return point;
+}
+
+long SSTable::findBlock(const KeyValue& kv) const {
+    // First block whose first key is greater than kv; the block before it is the candidate
+    auto it = std::upper_bound(blocks.begin(), blocks.end(), kv,
+        [](const KeyValue& key, const BlockIndexEntry& entry) { return key < entry.first_key; });
+    return static_cast<long>(it - blocks.begin()) - 1;
+}
+
+BlockCache::BlockPtr SSTable::readBlock(size_t idx, bool fill_cache) const {
+    const BlockHandle& handle = blocks[idx].handle;
+    BlockCache::BlockPtr block = blockCache->lookup(cacheId, handle.offset);
+    if (block) {
+        PERF_COUNTER_ADD(block_cache_hit_count, 1);
+    }
+    if (block || !fill_cache) {
+        return block;
+    }
+
+    BlockCache::BlockPtr decoded = decodeBlock(idx);
+    // Charge the decoded size: encoded bytes plus one KeyValue per record
+    blockCache->insert(cacheId, handle.offset, decoded, handle.size + handle.num_entries * sizeof(KeyValue));
+    return decoded;
+}
+
+BlockCache::BlockPtr SSTable::decodeBlock(size_t idx) const {
+    PERF_TIMER_GUARD(block_decode_nanos);
+    const BlockHandle& handle = blocks[idx].handle;
+    PERF_COUNTER_ADD(block_decode_count, 1);
+    PERF_COUNTER_ADD(records_decoded_count, handle.num_entries);
+    auto decoded = std::make_shared<BlockCache::Block>();
+    decoded->reserve(handle.num_entries);
+    const char* p = blockBegin(handle);
+    const char* end = blockEnd(handle);
+    for (uint32_t i = 0; i < handle.num_entries; ++i) {
+        decoded->push_back(decodeRecord(p, end));
+    }
+    return decoded;
+}
+
+KeyValue SSTable::get(const KeyValue& kv, uint64_t sequence) const {
+    return applyRangeDeletions(kv, getPoint(kv, sequence), sequence);
+}
+
+KeyValue SSTable::getPoint(const KeyValue& kv, uint64_t sequence) const {
+    PERF_TIMER_GUARD(block_seek_nanos);
+    long idx = findBlock(kv);
+    PERF_TIMER_STOP(block_seek_nanos);
+    if (idx < 0) {
+        return KeyValue();
+    }
+
+    if (blockCache) {
+        BlockCache::BlockPtr block = readBlock(idx, true);
+        // Versions of a key are newest first
+        PERF_TIMER_START(block_seek_nanos);
+        for (auto it = std::lower_bound(block->begin(), block->end(), kv); it != block->end() && *it == kv; ++it) {
+            if (it->getSequence() <= sequence) {
+                return *it;
+            }
+        }
+        return KeyValue();
+    }
+
+    // Records are sorted: compare keys only and skip values until the key is reached
+    PERF_TIMER_GUARD(block_decode_nanos);
+    PERF_COUNTER_ADD(block_decode_count, 1);
+    const BlockHandle& handle = blocks[idx].handle;
+    const char* p = blockBegin(handle);
+    const char* end = blockEnd(handle);
+    for (uint32_t i = 0; i < handle.num_entries; ++i) {
+        PERF_COUNTER_ADD(records_decoded_count, 1);
+        p += sizeof(uint32_t);  // kv_checksum
+        KeyValue key(SerializedKeyValue::decodeField(p, end), 0);
+        if (kv < key) {
+            break;
+        }
+        if (key == kv) {
+            KeyValue result = SerializedKeyValue::decodeValue(key.getKey(), p, end);
+            if (!sequenced) {
+                return result;
+            }
+            result.setSequence(SerializedKeyValue::decodeSequence(p, end));
+            if (result.getSequence() <= sequence) {
+                return result;
+            }
+            continue;  // too new: an older version may follow
+        }
+        SerializedKeyValue::skipField(p, end);
+        if (sequenced) {
+            SerializedKeyValue::decodeSequence(p, end);
+        }
+    }
+    return KeyValue();
+}
+
+void SSTable::multiGet(const std::vector<KeyValue>& sorted_keys, std::vector<KeyValue>& results,
+                       uint64_t sequence) const {
+    BlockCache::BlockPtr block;
+    long blockIdx = -1;
+    for (size_t i = 0; i < sorted_keys.size(); ++i) {
+        KeyValue point;
+        long idx = findBlock(sorted_keys[i]);
+        if (idx >= 0) {
+            // Keys are sorted: consecutive keys of the same block share one decode
+            if (idx != blockIdx) {
+                blockIdx = idx;
+                block = blockCache ? readBlock(idx, true) : decodeBlock(idx);
+            }
+            for (auto it = std::lower_bound(block->begin(), block->end(), sorted_keys[i]);
+                 it != block->end() && *it == sorted_keys[i]; ++it) {
+                if (it->getSequence() <= sequence) {
+                    point = *it;
+                    break;
+                }
+            }
+        }
+        KeyValue result = applyRangeDeletions(sorted_keys[i], std::move(point), sequence);
+        if (!result.isEmpty()) {
+            results[i] = std::move(result);
+        }
+    }
+}
+
+void SSTable::scan(const KeyValue& small_key, const KeyValue& large_key, std::set<KeyValue>& res) const {
+    // Start from the block that may contain small_key, stop after passing large_key
+    for (size_t idx = std::max(findBlock(small_key), 0L); idx < blocks.size(); ++idx) {
+        if (large_key < blocks[idx].first_key) {
+            return;
+        }
+        if (blockCache) {
+            if (BlockCache::BlockPtr block = readBlock(idx, false)) {
+                for (auto it = std::lower_bound(block->begin(), block->end(), small_key); it != block->end(); ++it) {
+                    if (large_key < *it) {
+                        return;
+                    }
+                    res.insert(*it);
+                }
+                continue;
+            }
+        }
+        const BlockHandle& handle = blocks[idx].handle;
+        const char* p = blockBegin(handle);
+        const char* end = blockEnd(handle);
+        for (uint32_t i = 0; i < handle.num_entries; ++i) {
+            p += sizeof(uint32_t);  // kv_checksum
+            KeyValue key(SerializedKeyValue::decodeField(p, end), 0);
+            if (large_key < key) {
+                return;
+            }
+            if (key < small_key) {
+                SerializedKeyValue::skipField(p, end);
+                if (sequenced) {
+                    SerializedKeyValue::decodeSequence(p, end);
+                }
+                continue;
+            }
+            // Versions are newest first: set::insert keeps the first one
+            KeyValue record = SerializedKeyValue::decodeValue(key.getKey(), p, end);
+            if (sequenced) {
+                record.setSequence(SerializedKeyValue::decodeSequence(p, end));
+            }
+            res.insert(std::move(record));
+        }
+    }
+}
+
+std::vector<KeyValue> SSTable::readAll() const {
+    std::vector<KeyValue> kv_pairs;
+    for (const auto& entry : blocks) {
+        const char* p = blockBegin(entry.handle);
+        const char* end = blockEnd(entry.handle);
+        for (uint32_t i = 0; i < entry.handle.num_entries; ++i) {
+            kv_pairs.push_back(decodeRecord(p, end));
+        }
+    }
+    return kv_pairs;
+}
+
+std::shared_ptr<BloomFilter> SSTable::readFilter() const {
+    if (!blockBased || footer.filter_size == 0 || footer.filter_offset + footer.filter_size > file->size()) {
+        return nullptr;
+    }
+    auto filter = std::make_shared<BloomFilter>(
+        BloomFilter::decode(file->data() + footer.filter_offset, footer.filter_size));
+    return filter->empty() ? nullptr : filter;
+}
+
+/*
+ * Cursor over one SSTable: holds the decoded records of the current data block
+ * only. Cached blocks are reused, but blocks read by the cursor are not cached.
+ */
+class TableIterator : public Iterator {
+public:
+    explicit TableIterator(std::shared_ptr<const SSTable> _table) : table(std::move(_table)) {}
+
+    bool Valid() const override {return block && pos < block->size();};
+    void SeekToFirst() override {
+        loadBlock(0);
+    }
+    void Seek(const KeyValue& target) override {
+        loadBlock(std::max(table->findBlock(target), 0L));
+        if (!block) return;
+        pos = std::lower_bound(block->begin(), block->end(), target) - block->begin();
+        if (pos == block->size()) {
+            loadBlock(blockIdx + 1);  // every key of the block is smaller: first key of the next block
+        }
+    }
+    void Next() override {
+        if (++pos == block->size()) {
+            loadBlock(blockIdx + 1);
+        }
+    }
+    const KeyValue& kv() const override {return (*block)[pos];};
+
+private:
+    std::shared_ptr<const SSTable> table;
+    BlockCache::BlockPtr block;
+    size_t blockIdx = 0;
+    size_t pos = 0;
+
+    // Position on the first record of the first non-empty block from idx on
+    void loadBlock(size_t idx) {
+        block = nullptr;
+        pos = 0;
+        for (blockIdx = idx; blockIdx < table->blocks.size(); ++blockIdx) {
+            block = table->blockCache ? table->readBlock(blockIdx, false) : nullptr;
+            if (!block) {
+                block = table->decodeBlock(blockIdx);
+            }
+            if (!block->empty()) {
+                return;
+            }
+        }
+        block = nullptr;
+    }
+};
+
+std::unique_ptr<Iterator> SSTable::newIterator(std::shared_ptr<const SSTable> table) {
+    return std::make_unique<TableIterator>(std::move(table));
+}
@@ -0,0 +1,96 @@
+//
+// Created by Damian Li on 2024-09-16.
+//
+
+#ifndef SSTABLE_H
+#define SSTABLE_H
+
+#include "FileManager.h"
+#include "MappedFile.h"
+#include "BloomFilter.h"
+#include "BlockCache.h"
+#include "Iterator.h"
+#include <memory>
+#include <set>
+#include <vector>
+
+/*
+ * Read side of one .sst file.
+ *
+ * The file is memory mapped once; the footer and index block are parsed at open
+ * and records are decoded straight from the mapped bytes. Legacy (v1.1) files
+ * without footer are exposed as a single data block; records of files older than
+ * v3 carry no sequence number and read back with sequence 0.
+ *
+ * With a BlockCache, point lookups decode a whole data block once, cache it and
+ * binary search the decoded records; scans reuse cached blocks but do not fill
+ * the cache, so one large scan can't evict the hot set.
+ */
+class SSTable {
+public:
+    // Map the file and parse its footer and index block. Its blocks are cached under cache_id:
+    // the same file must get the same id each time it is opened (0 = a new id from cache)
+    static std::shared_ptr<SSTable> open(const fs::path& file_path, std::shared_ptr<BlockCache> cache = nullptr,
+                                         uint64_t cache_id = 0);
+
+    // Point lookup: binary search the index block, then decode one data block.
+    // Newest version with a sequence number <= sequence; a key deleted in this
+    // file comes back as a tombstone.
+    KeyValue get(const KeyValue& kv, uint64_t sequence = KeyValue::MAX_SEQUENCE) const;
+    // Batched lookup of sorted keys: each data block is decoded at most once;
+    // results[i] is set when sorted_keys[i] is found (or deleted) and left untouched otherwise
+    void multiGet(const std::vector<KeyValue>& sorted_keys, std::vector<KeyValue>& results,
+                  uint64_t sequence = KeyValue::MAX_SEQUENCE) const;
+    // Insert every record in [small_key, large_key] into res
+    void scan(const KeyValue& small_key, const KeyValue& large_key, std::set<KeyValue>& res) const;
+    // Every record of the file in key order
+    std::vector<KeyValue> readAll() const;
+    // Filter block of the file (nullptr if it has none)
+    std::shared_ptr<BloomFilter> readFilter() const;
+    // Cursor decoding one data block at a time; keeps table (and its mapping) alive
+    static std::unique_ptr<Iterator> newIterator(std::shared_ptr<const SSTable> table);
+
+    // Range tombstones of the file, sorted by start key; they only shadow older data
+    const std::vector<KeyValue>& getRangeDeletions() const {return rangeDeletions;};
+    // Newest range tombstone covering kv with a sequence number <= sequence (nullptr if none)
+    const KeyValue* newestRangeDeletion(const KeyValue& kv, uint64_t sequence = KeyValue::MAX_SEQUENCE) const;
+    // What get returns for a key the data blocks don't hold: a tombstone if a range
+    // tombstone of the file covers kv, else an empty KeyValue. No data block is read.
+    KeyValue getRangeTombstone(const KeyValue& kv, uint64_t sequence = KeyValue::MAX_SEQUENCE) const {
+        return applyRangeDeletions(kv, KeyValue(), sequence);
+    };
+    // Largest sequence number in the file (0 before v3)
+    uint64_t getLargestSequence() const {return footer.largest_sequence;};
+
+    const std::vector<BlockIndexEntry>& getBlocks() const {return blocks;};
+    size_t getFileSize() const {return file->size();};
+
+private:
+    friend class TableIterator;
+    std::shared_ptr<MappedFile> file;
+    SSTFooter footer;
+    bool blockBased = false;
+    bool sequenced = false;  // v3: every record is followed by its sequence number
+    std::vector<BlockIndexEntry> blocks;
+    std::vector<KeyValue> rangeDeletions;
+    std::shared_ptr<BlockCache> blockCache;
+    uint64_t cacheId = 0;
+
+    // Decoded records of block idx, from the cache when possible
+    BlockCache::BlockPtr readBlock(size_t idx, bool fill_cache) const;
+    // Decoded records of block idx, bypassing the cache
+    BlockCache::BlockPtr decodeBlock(size_t idx) const;
+    // Newest record <= sequence stored for kv in the data blocks, ignoring range tombstones
+    KeyValue getPoint(const KeyValue& kv, uint64_t sequence) const;
+    // point (possibly empty) unless a newer range tombstone visible at sequence deletes key
+    KeyValue applyRangeDeletions(const KeyValue& key, KeyValue point, uint64_t sequence) const;
+    KeyValue decodeRecord(const char*& ptr, const char* end) const {
+        return sequenced ? SerializedKeyValue::decodeSequenced(ptr, end) : SerializedKeyValue::decode(ptr, end).kv;
+    };
+    // Index of the data block that may contain kv, or -1 if kv is smaller than every key
+    long findBlock(const KeyValue& kv) const;
+    const char* blockBegin(const BlockHandle& handle) const {return file->data() + handle.offset;};
+    const char* blockEnd(const BlockHandle& handle) const {return file->data() + handle.offset + handle.size;};
+};
+
+#endif //SSTABLE_H
@@ -0,0 +1,13 @@
+//
+// Created by Damian Li on 2024-09-21.
+//
+
+#include "Iterator.h"
+#include <algorithm>
+
+VectorIterator::VectorIterator(std::vector<KeyValue> sorted_entries)
+    : entries(std::move(sorted_entries)), pos(entries.size()) {}
+
+void VectorIterator::Seek(const KeyValue& target) {
+    pos = std::lower_bound(entries.begin(), entries.end(), target) - entries.begin();
+}
@@ -0,0 +1,49 @@
+//
+// Created by Damian Li on 2024-09-21.
+//
+
+#ifndef ITERATOR_H
+#define ITERATOR_H
+
+#include "KeyValue.h"
+#include <vector>
+
+/*
+ * Forward cursor over key-value pairs in key order.
+ *
+ * Usage:
+ *   for (it->Seek(small_key); it->Valid() && it->kv() <= large_key; it->Next()) {...}
+ */
+class Iterator {
+public:
+    virtual ~Iterator() = default;
+
+    virtual bool Valid() const = 0;
+    virtual void SeekToFirst() = 0;
+    // Position at the first entry whose key is >= target
+    virtual void Seek(const KeyValue& target) = 0;
+    virtual void Next() = 0;
+    // Current entry; only while Valid()
+    virtual const KeyValue& kv() const = 0;
+
+    KeyValue::KeyType key() const {return kv().getKey();};
+    KeyValue::ValueType value() const {return kv().getValue();};
+};
+
+// Iterator over a sorted vector it owns (e.g. a memtable snapshot)
+class VectorIterator : public Iterator {
+public:
+    explicit VectorIterator(std::vector<KeyValue> sorted_entries);
+
+    bool Valid() const override {return pos < entries.size();};
+    void SeekToFirst() override {pos = 0;};
+    void Seek(const KeyValue& target) override;
+    void Next() override {++pos;};
+    const KeyValue& kv() const override {return entries[pos];};
+
+private:
+    std::vector<KeyValue> entries;
+    size_t pos = 0;
+};
+
+#endif //ITERATOR_H
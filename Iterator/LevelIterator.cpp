@@ -0,0 +1,46 @@
+//
+// Created by Damian Li on 2024-09-21.
+//
+
+#include "LevelIterator.h"
+#include <algorithm>
+
+LevelIterator::LevelIterator(std::vector<File> _files) : files(std::move(_files)) {}
+
+void LevelIterator::openFile(size_t idx) {
+    fileIdx = idx;
+    current = idx < files.size() ? SSTable::newIterator(files[idx].table) : nullptr;
+}
+
+void LevelIterator::skipExhaustedFiles() {
+    while (current && !current->Valid()) {
+        openFile(fileIdx + 1);
+        if (current) {
+            current->SeekToFirst();
+        }
+    }
+}
+
+void LevelIterator::SeekToFirst() {
+    openFile(0);
+    if (current) {
+        current->SeekToFirst();
+    }
+    skipExhaustedFiles();
+}
+
+void LevelIterator::Seek(const KeyValue& target) {
+    // First file whose largest key is >= target
+    auto it = std::lower_bound(files.begin(), files.end(), target,
+        [](const File& file, const KeyValue& key) { return file.largest_key < key; });
+    openFile(it - files.begin());
+    if (current) {
+        current->Seek(target);
+    }
+    skipExhaustedFiles();
+}
+
+void LevelIterator::Next() {
+    current->Next();
+    skipExhaustedFiles();
+}
@@ -0,0 +1,44 @@
+//
+// Created by Damian Li on 2024-09-21.
+//
+
+#ifndef LEVELITERATOR_H
+#define LEVELITERATOR_H
+
+#include "Iterator.h"
+#include "SSTable.h"
+#include <memory>
+#include <vector>
+
+/*
+ * Iterator over one level >= 1: the files are sorted and never overlap, so the
+ * level is the concatenation of its files. Only the file holding the current
+ * position has a cursor; Seek binary searches the files' largest keys.
+ */
+class LevelIterator : public Iterator {
+public:
+    struct File {
+        KeyValue largest_key;
+        std::shared_ptr<const SSTable> table;
+    };
+
+    // files sorted by key range
+    explicit LevelIterator(std::vector<File> files);
+
+    bool Valid() const override {return current && current->Valid();};
+    void SeekToFirst() override;
+    void Seek(const KeyValue& target) override;
+    void Next() override;
+    const KeyValue& kv() const override {return current->kv();};
+
+private:
+    std::vector<File> files;
+    size_t fileIdx = 0;
+    std::unique_ptr<Iterator> current;
+
+    void openFile(size_t idx);
+    // Move to the following files while the current one is exhausted
+    void skipExhaustedFiles();
+};
+
+#endif //LEVELITERATOR_H
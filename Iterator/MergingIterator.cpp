@@ -0,0 +1,123 @@
+//
+// Created by Damian Li on 2024-09-21.
+//
+
+#include "MergingIterator.h"
+#include <algorithm>
+
+MergingIterator::MergingIterator(std::vector<std::unique_ptr<Iterator>> _children,
+                                 std::vector<std::vector<KeyValue>> range_deletions,
+                                 uint64_t _sequence)
+    : children(std::move(_children)), rangeDeletions(std::move(range_deletions)), sequence(_sequence) {
+    heap.reserve(children.size());
+    // Trailing lists without tombstones never cover anything
+    while (!rangeDeletions.empty() && rangeDeletions.back().empty()) {
+        rangeDeletions.pop_back();
+    }
+    rangeCursors.resize(rangeDeletions.size());
+}
+
+bool MergingIterator::after(size_t a, size_t b) const {
+    const KeyValue& ka = children[a]->kv();
+    const KeyValue& kb = children[b]->kv();
+    if (ka < kb) return false;
+    if (kb < ka) return true;
+    // same key: the newer version comes first, then the newer (lower index) child
+    if (ka.getSequence() != kb.getSequence()) return ka.getSequence() < kb.getSequence();
+    return a > b;
+}
+
+void MergingIterator::rebuildHeap() {
+    for (RangeCursor& cursor : rangeCursors) {
+        cursor.next = 0;
+        cursor.active.clear();
+    }
+    heap.clear();
+    for (size_t i = 0; i < children.size(); ++i) {
+        if (children[i]->Valid()) {
+            heap.push_back(i);
+        }
+    }
+    std::make_heap(heap.begin(), heap.end(), [this](size_t a, size_t b) {return after(a, b);});
+}
+
+void MergingIterator::SeekToFirst() {
+    for (auto& child : children) {
+        child->SeekToFirst();
+    }
+    rebuildHeap();
+    skipDeleted();
+}
+
+void MergingIterator::Seek(const KeyValue& target) {
+    for (auto& child : children) {
+        child->Seek(target);
+    }
+    rebuildHeap();
+    skipDeleted();
+}
+
+void MergingIterator::Next() {
+    advance();
+    skipDeleted();
+}
+
+bool MergingIterator::rangeDeleted(size_t child) {
+    const KeyValue& kv = children[child]->kv();
+    bool deleted = false;
+    for (size_t i = 0; i < rangeDeletions.size(); ++i) {
+        const std::vector<KeyValue>& ranges = rangeDeletions[i];
+        RangeCursor& cursor = rangeCursors[i];
+        for (; cursor.next < ranges.size() && !(kv < ranges[cursor.next]); ++cursor.next) {
+            cursor.active.push_back(&ranges[cursor.next]);  // sorted by start
+        }
+        // A tombstone ending at or before kv covers none of the keys still to come
+        cursor.active.erase(std::remove_if(cursor.active.begin(), cursor.active.end(),
+                                           [&kv](const KeyValue* range) {return !range->covers(kv);}),
+                            cursor.active.end());
+        for (const KeyValue* range : cursor.active) {
+            // Equal sequence numbers (files written before them): the newer child wins
+            bool newer = kv.getSequence() < range->getSequence() || (kv.getSequence() == range->getSequence() && i < child);
+            if (newer && range->getSequence() <= sequence) {
+                deleted = true;
+            }
+        }
+    }
+    return deleted;
+}
+
+void MergingIterator::skipDeleted() {
+    while (!heap.empty()) {
+        if (kv().getSequence() > sequence) {
+            advanceTop();  // written after the reader's snapshot: an older version may follow
+        } else if (kv().isTombstone() || rangeDeleted(heap.front())) {
+            advance();
+        } else {
+            return;
+        }
+    }
+}
+
+void MergingIterator::advanceTop() {
+    auto cmp = [this](size_t a, size_t b) {return after(a, b);};
+    size_t top = heap.front();
+    std::pop_heap(heap.begin(), heap.end(), cmp);
+    heap.pop_back();
+    children[top]->Next();
+    if (children[top]->Valid()) {
+        heap.push_back(top);
+        std::push_heap(heap.begin(), heap.end(), cmp);
+    }
+}
+
+void MergingIterator::advance() {
+    // Advance every child positioned on the current key: older versions are shadowed
+    const KeyValue current = kv();
+    while (!heap.empty()) {
+        size_t top = heap.front();
+        if (current < children[top]->kv()) {
+            break;
+        }
+        advanceTop();
+    }
+}
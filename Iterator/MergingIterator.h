@@ -0,0 +1,67 @@
+//
+// Created by Damian Li on 2024-09-21.
+//
+
+#ifndef MERGINGITERATOR_H
+#define MERGINGITERATOR_H
+
+#include "Iterator.h"
+#include <memory>
+#include <vector>
+
+/*
+ * k-way merge of sorted iterators with newest-wins semantics.
+ *
+ * children are ordered newest first, and a child holding several versions of
+ * a key returns them newest first. Only the newest version with a sequence
+ * number <= sequence is returned (the newest child wins between equal
+ * sequence numbers, e.g. files written before sequence numbers); the others
+ * are skipped. A binary heap keyed on (key, sequence, child index) keeps
+ * Next() at O(log k); nothing is materialised beyond what the children hold.
+ *
+ * Deleted keys are hidden: a key whose newest visible entry is a tombstone,
+ * or is covered by a newer visible range tombstone, is skipped.
+ * range_deletions[i] holds the range tombstones of children[i] (sorted by
+ * start key); it may be shorter than children. Entries come out in key order,
+ * so each tombstone is looked at once per Seek: it becomes active when the keys
+ * reach its start and is dropped once they pass its end.
+ */
+class MergingIterator : public Iterator {
+public:
+    explicit MergingIterator(std::vector<std::unique_ptr<Iterator>> children,
+                             std::vector<std::vector<KeyValue>> range_deletions = {},
+                             uint64_t sequence = KeyValue::MAX_SEQUENCE);
+
+    bool Valid() const override {return !heap.empty();};
+    void SeekToFirst() override;
+    void Seek(const KeyValue& target) override;
+    void Next() override;
+    const KeyValue& kv() const override {return children[heap.front()]->kv();};
+
+private:
+    std::vector<std::unique_ptr<Iterator>> children;
+    std::vector<std::vector<KeyValue>> rangeDeletions;
+    struct RangeCursor {
+        size_t next = 0;                       // first tombstone of the list not reached yet
+        std::vector<const KeyValue*> active;   // reached and not yet passed
+    };
+    std::vector<RangeCursor> rangeCursors;  // one per list of rangeDeletions
+    uint64_t sequence;
+    std::vector<size_t> heap;  // indices of valid children, top = smallest key (newest on ties)
+
+    // Heap "less" for a min-heap: a comes after b
+    bool after(size_t a, size_t b) const;
+    // Rebuild the heap after the children moved, and restart the tombstone cursors
+    void rebuildHeap();
+    // Pop every child positioned on the current key
+    void advance();
+    // Move the top child one entry forward
+    void advanceTop();
+    // Advance until the current entry is visible and live
+    void skipDeleted();
+    // Entry of child is covered by a newer visible range tombstone; keys must not go down
+    // between calls (until the next rebuildHeap)
+    bool rangeDeleted(size_t child);
+};
+
+#endif //MERGINGITERATOR_H
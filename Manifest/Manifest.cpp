@@ -0,0 +1,191 @@
+//
+// Created by Damian Li on 2024-09-29.
+//
+
+#include "Manifest.h"
+#include "FileManager.h"
+#include <cctype>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+namespace {
+    template<typename T>
+    void writePod(std::ostream& out, T v) {
+        out.write(reinterpret_cast<const char*>(&v), sizeof(v));
+    }
+
+    template<typename T>
+    T readPod(const char*& ptr, const char* end) {
+        if (static_cast<size_t>(end - ptr) < sizeof(T)) {
+            throw std::runtime_error("VersionEdit::decode() >>>> Truncated edit");
+        }
+        T v;
+        std::memcpy(&v, ptr, sizeof(T));
+        ptr += sizeof(T);
+        return v;
+    }
+
+    void writeString(std::ostream& out, const std::string& str) {
+        writePod<uint32_t>(out, str.size());
+        out.write(str.data(), str.size());
+    }
+
+    std::string readString(const char*& ptr, const char* end) {
+        uint32_t len = readPod<uint32_t>(ptr, end);
+        if (static_cast<size_t>(end - ptr) < len) {
+            throw std::runtime_error("VersionEdit::decode() >>>> Truncated edit");
+        }
+        std::string str(ptr, len);
+        ptr += len;
+        return str;
+    }
+
+}
+
+/*
+ * VersionEdit
+ */
+std::string VersionEdit::encode() const {
+    std::ostringstream out;
+    writePod<uint32_t>(out, deleted_files.size());
+    for (const std::string& filename : deleted_files) {
+        writeString(out, filename);
+    }
+    writePod<uint32_t>(out, static_cast<uint32_t>(new_files.size()) | FILE_METADATA);
+    for (const NewFile& file : new_files) {
+        writePod<int32_t>(out, file.level);
+        writeString(out, file.filename);
+        SerializedKeyValue::serializeSequenced(out, file.smallest_key);
+        SerializedKeyValue::serializeSequenced(out, file.largest_key);
+        writePod<uint64_t>(out, file.file_size);
+        writePod<uint64_t>(out, file.largest_sequence);
+    }
+    writePod<uint32_t>(out, compact_pointers.size());
+    for (const auto& pointer : compact_pointers) {
+        writePod<int32_t>(out, pointer.first);
+        SerializedKeyValue::serializeSequenced(out, pointer.second);
+    }
+    return out.str();
+}
+
+VersionEdit VersionEdit::decode(const std::string& payload) {
+    VersionEdit edit;
+    const char* ptr = payload.data();
+    const char* end = payload.data() + payload.size();
+    uint32_t num_deleted = readPod<uint32_t>(ptr, end);
+    for (uint32_t i = 0; i < num_deleted; ++i) {
+        edit.deleted_files.push_back(readString(ptr, end));
+    }
+    uint32_t num_new = readPod<uint32_t>(ptr, end);
+    bool has_metadata = num_new & FILE_METADATA;
+    num_new &= ~FILE_METADATA;
+    for (uint32_t i = 0; i < num_new; ++i) {
+        NewFile file;
+        file.level = readPod<int32_t>(ptr, end);
+        file.filename = readString(ptr, end);
+        file.smallest_key = SerializedKeyValue::decodeSequenced(ptr, end);
+        file.largest_key = SerializedKeyValue::decodeSequenced(ptr, end);
+        file.has_metadata = has_metadata;
+        if (has_metadata) {
+            file.file_size = readPod<uint64_t>(ptr, end);
+            file.largest_sequence = readPod<uint64_t>(ptr, end);
+        }
+        edit.new_files.push_back(std::move(file));
+    }
+    uint32_t num_pointers = readPod<uint32_t>(ptr, end);
+    for (uint32_t i = 0; i < num_pointers; ++i) {
+        int level = readPod<int32_t>(ptr, end);
+        edit.compact_pointers.emplace_back(level, SerializedKeyValue::decodeSequenced(ptr, end));
+    }
+    if (ptr != end) {
+        throw std::runtime_error("VersionEdit::decode() >>>> Trailing bytes in edit");
+    }
+    return edit;
+}
+
+/*
+ * Manifest
+ */
+fs::path Manifest::manifestPath(const fs::path& directory, uint64_t number) {
+    return directory / ("MANIFEST_" + std::to_string(number));
+}
+
+std::vector<uint64_t> Manifest::listManifests(const fs::path& directory) {
+    std::vector<uint64_t> numbers;
+    if (!fs::exists(directory)) {
+        return numbers;
+    }
+    for (const auto& entry : fs::directory_iterator(directory)) {
+        std::string name = entry.path().filename().string();
+        if (name.size() > 9 && name.compare(0, 9, "MANIFEST_") == 0) {
+            std::string digits = name.substr(9);
+            if (std::all_of(digits.begin(), digits.end(), ::isdigit)) {
+                numbers.push_back(std::stoull(digits));
+            }
+        }
+    }
+    std::sort(numbers.begin(), numbers.end());
+    return numbers;
+}
+
+bool Manifest::recover(const fs::path& directory, std::vector<VersionEdit>& edits) {
+    std::ifstream current(currentPath(directory));
+    if (!current.is_open()) {
+        return false;
+    }
+    std::string name;
+    std::getline(current, name);
+    if (name.empty() || !fs::exists(directory / name)) {
+        throw std::runtime_error("Manifest::recover() >>>> CURRENT names a missing manifest: " + name);
+    }
+    edits.clear();
+    for (const std::string& payload : WAL::readRecords(directory / name)) {
+        try {
+            edits.push_back(VersionEdit::decode(payload));
+        } catch (const std::runtime_error&) {
+            break;
+        }
+    }
+    if (edits.empty()) {
+        throw std::runtime_error("Manifest::recover() >>>> Manifest without snapshot: " + name);
+    }
+    return true;
+}
+
+Manifest::Manifest(const fs::path& directory, uint64_t number, const VersionEdit& snapshot)
+    : directory(directory), number(number) {
+    fs::path path = manifestPath(directory, number);
+    // A leftover of a crash before CURRENT switched to it
+    std::error_code ec;
+    fs::remove(path, ec);
+    log = std::make_unique<WAL>(path);
+    std::string payload = snapshot.encode();
+    log->addRecord(payload);
+    log->sync();
+    snapshot_bytes = payload.size();
+    setCurrent();
+}
+
+void Manifest::logEdit(const VersionEdit& edit) {
+    std::string payload = edit.encode();
+    log->addRecord(payload);
+    log->sync();
+    edit_bytes += payload.size();
+}
+
+void Manifest::setCurrent() const {
+    fs::path tmp = directory / "CURRENT.tmp";
+    {
+        std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+        out << manifestPath(directory, number).filename().string() << '\n';
+        out.close();
+        if (!out) {
+            throw std::runtime_error("Manifest::setCurrent() >>>> Failed to write " + tmp.string());
+        }
+    }
+    FileManager::syncPath(tmp, false);
+    fs::rename(tmp, currentPath(directory));
+    FileManager::syncPath(directory, true);
+}
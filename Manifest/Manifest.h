@@ -0,0 +1,98 @@
+//
+// Created by Damian Li on 2024-09-29.
+//
+
+#ifndef MANIFEST_H
+#define MANIFEST_H
+
+#include "KeyValue.h"
+#include "WAL.h"
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+/*
+ * VersionEdit Structure (payload of one MANIFEST record)
+ * std::string VersionEdit::encode()
+ * ==============================================================================
+ * num_deleted | (filename_len | filename) ... |
+ * num_new | (level | filename_len | filename | smallest_key | largest_key |
+ *            file_size | largest_sequence) ... |
+ * num_pointers | (level | key) ... |
+ * ==============================================================================
+ * Keys are sequenced SerializedKeyValue records. The top bit of num_new is set
+ * when new files carry file_size and largest_sequence; edits written without
+ * them decode with has_metadata = false.
+ */
+struct VersionEdit {
+    struct NewFile {
+        int level = 0;
+        std::string filename;
+        KeyValue smallest_key;
+        KeyValue largest_key;
+        uint64_t file_size = 0;
+        uint64_t largest_sequence = 0;
+        bool has_metadata = true;  // false: file_size and largest_sequence were not logged
+    };
+    std::vector<std::string> deleted_files;
+    std::vector<NewFile> new_files;                          // in index order: L0 files oldest first
+    std::vector<std::pair<int, KeyValue>> compact_pointers;  // per level: largest key of the last compacted file
+    std::string encode() const;
+    // Throws on a truncated or malformed payload
+    static VersionEdit decode(const std::string& payload);
+
+private:
+    static constexpr uint32_t FILE_METADATA = 1u << 31;
+};
+
+/*
+ * Append-only log of the changes to the set of SSTs.
+ *
+ * A MANIFEST_<n> file starts with a snapshot (one edit adding every live SST)
+ * followed by one edit per flush or compaction, each synced before the change
+ * is used. CURRENT names the manifest to recover from and is only ever
+ * replaced by renaming a fully written and synced temporary file, so a crash
+ * leaves either the old or the new manifest in charge.
+ */
+class Manifest {
+public:
+    static fs::path manifestPath(const fs::path& directory, uint64_t number);
+    static fs::path currentPath(const fs::path& directory) {return directory / "CURRENT";};
+    // Numbers of the MANIFEST_<n> files in directory, ascending
+    static std::vector<uint64_t> listManifests(const fs::path& directory);
+    // Edits of the manifest CURRENT points to, oldest first (a torn last edit is left out);
+    // false if the directory has no CURRENT
+    static bool recover(const fs::path& directory, std::vector<VersionEdit>& edits);
+
+    // Write MANIFEST_<number> holding snapshot, sync it and point CURRENT at it
+    Manifest(const fs::path& directory, uint64_t number, const VersionEdit& snapshot);
+    Manifest(const Manifest&) = delete;
+    Manifest& operator=(const Manifest&) = delete;
+
+    // Append edit and make it durable
+    void logEdit(const VersionEdit& edit);
+    // The edits logged since the snapshot outweigh both min_bytes and the snapshot itself:
+    // writing a new snapshot now keeps the cost of recovery and of snapshotting O(change)
+    bool needsSnapshot(uint64_t min_bytes) const {return edit_bytes >= std::max(min_bytes, snapshot_bytes);};
+
+    uint64_t getNumber() const {return number;};
+    uint64_t getNumEdits() const {return log->getNumRecords() - 1;};
+    uint64_t getNumSyncs() const {return log->getNumSyncs();};
+
+private:
+    fs::path directory;
+    uint64_t number;
+    std::unique_ptr<WAL> log;
+    uint64_t snapshot_bytes = 0;
+    uint64_t edit_bytes = 0;
+    // Atomically replace CURRENT with the name of MANIFEST_<number>
+    void setCurrent() const;
+};
+
+#endif //MANIFEST_H
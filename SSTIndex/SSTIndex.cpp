@@ -3,16 +3,25 @@
 //
 
 #include "SSTIndex.h"
+#include "PerfContext.h"
 #include <fstream>
 #include <sstream>
 #include <iostream>
 #include <unordered_map>
 #include <string>
+#include <algorithm>
+#include <system_error>
 #include "FileManager.h"
 using namespace std;
 
 #define RECORDE_SIZE 18
 
+namespace {
+  bool bySmallestKey(const SSTInfo* a, const SSTInfo* b) {
+    return a->smallest_key < b->smallest_key;
+  }
+}
+
 /*
  * Index.sst SSTIndexHeader Methods
  *
@@ -52,6 +61,9 @@ void SerializedIndexSSTInfo::serialize(std::ofstream& file) const {
   // Serialize the filename
   serializeFileName(file);
 
+  // Serialize the level
+  file.write(reinterpret_cast<const char*>(&level), sizeof(level));
+
   // Serialize the smallest key
   smallest_key.serialize(file);
 
@@ -69,6 +81,9 @@ SerializedIndexSSTInfo SerializedIndexSSTInfo::deserialize(std::ifstream& file)
   sstInfo.filename.resize(filename_len);
   file.read(&sstInfo.filename[0], filename_len);  // Read the actual filename
 
+  // Deserialize the level
+  file.read(reinterpret_cast<char*>(&sstInfo.level), sizeof(sstInfo.level));
+
   // Deserialize the smallest key
   sstInfo.smallest_key = SerializedKeyValue::deserialize(file);
 
@@ -84,16 +99,204 @@ SSTIndex::SSTIndex() {
   if (!fs::exists(path)) {
     fs::create_directories(path);  // Ensure the directory exists
   }
+  tableCache.setDirectory(path);
+  levels.resize(std::max(options.num_levels, 1));
+  installVersion();
+}
+
+SSTIndex::~SSTIndex() {
+  clearIndex();
+  version.reset();
+}
+
+void SSTIndex::clearIndex() {
+  owners.clear();
+  warm_up_files.clear();
+  warm_up_cursor = 0;
+  warm_up_started = false;
+  levels.assign(std::max(options.num_levels, 1), Level());
+  installVersion();
+}
+
+void SSTIndex::own(SSTInfo* info) {
+  if (owners.count(info)) {
+    return;
+  }
+  owners.emplace(info, shared_ptr<SSTInfo>(info, [this](SSTInfo* released) {
+    if (released->obsolete) {
+      // No reader is left on the file a compaction replaced
+      tableCache.evict(released->filename);
+      std::error_code ec;
+      fs::remove(path / released->filename, ec);
+    }
+    delete released;
+  }));
+}
+
+void SSTIndex::installVersion() {
+  auto next = make_shared<Version>();
+  next->levels = levels;
+  for (const Level& level : levels) {
+    for (SSTInfo* info : level.files) {
+      next->files.push_back(owners.at(info));
+    }
+  }
+  version = std::move(next);
+}
+
+deque<SSTInfo*> SSTIndex::getSSTsIndex() const {
+  deque<SSTInfo*> index;
+  for (size_t level = levels.size(); level-- > 0;) {
+    index.insert(index.end(), levels[level].files.begin(), levels[level].files.end());
+  }
+  return index;
+}
+
+int SSTIndex::levelOf(const SSTInfo* info) const {
+  return std::min(std::max(info->level, 0), static_cast<int>(levels.size()) - 1);
+}
+
+void SSTIndex::setFiles(const vector<SSTInfo*>& files) {
+  levels.assign(std::max(options.num_levels, 1), Level());
+  for (SSTInfo* info : files) {
+    own(info);
+    levels[levelOf(info)].files.push_back(info);
+  }
+  for (size_t level = 0; level < levels.size(); ++level) {
+    sortLevel(level);
+  }
+  installVersion();
+}
+
+void SSTIndex::insertFile(SSTInfo* info) {
+  own(info);
+  int level = levelOf(info);
+  Level& target = levels[level];
+  target.bytes += info->file_size;
+  if (level == 0) {
+    target.files.push_back(info);
+    return;
+  }
+  auto pos = std::upper_bound(target.files.begin(), target.files.end(), info, bySmallestKey);
+  target.fences.insert(target.fences.begin() + (pos - target.files.begin()), info->largest_key);
+  target.files.insert(pos, info);
+}
+
+void SSTIndex::sortLevel(int level) {
+  Level& target = levels[level];
+  if (level > 0) {
+    std::stable_sort(target.files.begin(), target.files.end(), bySmallestKey);
+  }
+  target.fences.clear();
+  target.bytes = 0;
+  for (SSTInfo* info : target.files) {
+    if (level > 0) {
+      target.fences.push_back(info->largest_key);
+    }
+    target.bytes += info->file_size;
+  }
+}
+
+size_t SSTIndex::findFile(const Level& level, const KeyValue& key) {
+  const vector<KeyValue>& fences = level.fences;
+  return std::lower_bound(fences.begin(), fences.end(), key) - fences.begin();
+}
+
+void SSTIndex::setCompactionOptions(const CompactionOptions& _options) {
+  options = _options;
+  if (static_cast<int>(levels.size()) != std::max(options.num_levels, 1)) {
+    // Files already loaded move to their level of the new layout
+    deque<SSTInfo*> index = getSSTsIndex();
+    setFiles(vector<SSTInfo*>(index.begin(), index.end()));
+  }
+}
+
+SSTInfo* SSTIndex::newSSTInfo(const string& filename, const KeyValue& smallest_key, const KeyValue& largest_key,
+                              shared_ptr<BloomFilter> filter, int level) const {
+  SSTInfo* info = new SSTInfo{filename, smallest_key, largest_key, std::move(filter), level};
+  std::error_code ec;
+  uintmax_t size = fs::file_size(path / filename, ec);
+  info->file_size = ec ? 0 : size;
+  return info;
 }
 
 // Retrieve all SSTs into index (e.g., when reopening the database)
 void SSTIndex::getAllSSTs() {
+  vector<VersionEdit> edits;
+  if (Manifest::recover(path, edits)) {
+    // Replay the edits by name, remembering the order files were added in (L0 order)
+    unordered_map<string, pair<size_t, VersionEdit::NewFile>> live;
+    size_t added = 0;
+    compactPointer.clear();
+    for (const VersionEdit& edit : edits) {
+      for (const string& filename : edit.deleted_files) {
+        live.erase(filename);
+      }
+      for (const VersionEdit::NewFile& file : edit.new_files) {
+        live[file.filename] = {added++, file};
+      }
+      for (const auto& pointer : edit.compact_pointers) {
+        compactPointer[pointer.first] = pointer.second;
+      }
+    }
+    vector<const pair<size_t, VersionEdit::NewFile>*> files;
+    for (const auto& entry : live) {
+      files.push_back(&entry.second);
+    }
+    std::sort(files.begin(), files.end(), [](const auto* a, const auto* b) {return a->first < b->first;});
+
+    clearIndex();
+    vector<SSTInfo*> infos;
+    for (const auto* entry : files) {
+      const VersionEdit::NewFile& file = entry->second;
+      SSTInfo* info = new SSTInfo{file.filename, file.smallest_key, file.largest_key, nullptr, file.level,
+                                  file.file_size, file.largest_sequence, false};
+      infos.push_back(info);
+      tableCache.evict(file.filename);
+      if (!file.has_metadata) {
+        // Logged before the manifest carried sizes and sequence numbers: read them once
+        std::error_code ec;
+        uintmax_t size = fs::file_size(path / file.filename, ec);
+        info->file_size = ec ? 0 : size;
+        if (!ec) {
+          info->largest_sequence = SSTable::open(path / file.filename)->getLargestSequence();
+        }
+      }
+    }
+    setFiles(infos);
+  } else {
+    loadIndexFile();
+  }
+  if (loadMode == SSTLoadMode::EAGER) {
+    // Load the filter blocks so they stay resident
+    for (SSTInfo* info : getSSTsIndex()) {
+      if (!info->filter_loaded) {
+        if (fs::exists(path / info->filename)) {
+          shared_ptr<SSTable> table = SSTable::open(path / info->filename);
+          info->filter = table->readFilter();
+          info->has_range_deletions = !table->getRangeDeletions().empty();
+        }
+        info->filter_loaded = true;
+      }
+    }
+  }
+
+  // One snapshot record instead of the replayed history
+  {
+    lock_guard<mutex> lock(manifest_mutex);
+    writeSnapshot(snapshotRecord());
+  }
+  std::error_code ec;
+  fs::remove(path / "Index.sst", ec);
+}
+
+bool SSTIndex::loadIndexFile() {
   // Open the file "Index.sst" in binary mode
   std::ifstream infile(path / "Index.sst", std::ios::binary);
 
   if (!infile.is_open()) {
     // If the file doesn't exist, just return
-    return;
+    return false;
   }
 
   // Check if the file is empty
@@ -101,85 +304,195 @@ void SSTIndex::getAllSSTs() {
   if (infile.tellg() == 0) {
     // If the file is empty, close it and return
     infile.close();
-    return;
+    return false;
   }
 
   // Reset the file pointer to the beginning
   infile.seekg(0, std::ios::beg);
 
   // Clear the current index to avoid duplication
-  index.clear();
+  clearIndex();
 
   // Step 1: Deserialize the header
   SSTIndexHeader header = SSTIndexHeader::deserialize(infile);
 
   // Step 2: Loop through and deserialize each SST entry
+  vector<SSTInfo*> infos;
   for (uint32_t i = 0; i < header.num_files; ++i) {
     // Deserialize the individual SerializedIndexSSTInfo
     SerializedIndexSSTInfo sstInfo = SerializedIndexSSTInfo::deserialize(infile);
 
-    // Convert SerializedIndexSSTInfo into SSTInfo and add it to the index
-    addSST(sstInfo.filename, sstInfo.smallest_key.kv, sstInfo.largest_key.kv);
+    // Convert SerializedIndexSSTInfo into SSTInfo and add it to the index; Index.sst
+    // has no sequence numbers, so they are read from the SST
+    SSTInfo* info = newSSTInfo(sstInfo.filename, sstInfo.smallest_key.kv, sstInfo.largest_key.kv, nullptr, sstInfo.level);
+    info->filter_loaded = false;
+    infos.push_back(info);
+    tableCache.evict(sstInfo.filename);
+    if (fs::exists(path / sstInfo.filename)) {
+      info->largest_sequence = SSTable::open(path / sstInfo.filename)->getLargestSequence();
+    }
   }
 
+  setFiles(infos);
+
   // Close the input file
   infile.close();
+  return true;
 }
 
 
-
-// flush index info into "Index.sst"
+// Write the index into a new MANIFEST and unload it
 void SSTIndex::flushToDisk() {
-  // Attempt to open (or create) the file "Index.sst"
-  std::ofstream outfile(path / "Index.sst", std::ios::binary | std::ios::trunc);
+  {
+    lock_guard<mutex> lock(manifest_mutex);
+    writeSnapshot(snapshotRecord());
+  }
+  // clear index
+  clearIndex();
+}
 
-  if (!outfile.is_open()) {
-    throw std::runtime_error("SSTIndex::flushToDisk() >>>> Failed to open Index.sst for writing.");
+VersionEdit SSTIndex::snapshotRecord() const {
+  VersionEdit snapshot;
+  // Deepest level first, L0 oldest to newest last: replay adds them back in this order
+  for (const SSTInfo* info : getSSTsIndex()) {
+    snapshot.new_files.push_back({info->level, info->filename, info->smallest_key, info->largest_key,
+                                  info->file_size, info->largest_sequence});
+  }
+  for (const auto& pointer : compactPointer) {
+    snapshot.compact_pointers.emplace_back(pointer.first, pointer.second);
   }
+  return snapshot;
+}
 
-  // Step 1: Write the SSTIndexHeader
-  SSTIndexHeader header;
-  header.num_files = index.size();
-  header.header_checksum = header.calculateChecksum();
-  header.serialize(outfile);
+void SSTIndex::writeSnapshot(const VersionEdit& snapshot) {
+  vector<uint64_t> numbers = Manifest::listManifests(path);
+  uint64_t number = numbers.empty() ? 1 : numbers.back() + 1;
+  if (manifest) {
+    number = std::max(number, manifest->getNumber() + 1);
+  }
+  manifest = make_unique<Manifest>(path, number, snapshot);
+  // CURRENT names the new manifest: the older ones are garbage
+  for (uint64_t old : numbers) {
+    std::error_code ec;
+    fs::remove(Manifest::manifestPath(path, old), ec);
+  }
+}
 
-  // Step 2: Serialize and write each SSTInfo in the deque to the file
-  for (const auto& sst_info : index) {
-    SerializedIndexSSTInfo serialized_info;
-    serialized_info.filename = sst_info->filename;
-    serialized_info.smallest_key = SerializedKeyValue{sst_info->smallest_key, serialized_info.smallest_key.calculateChecksum()};
-    serialized_info.largest_key = SerializedKeyValue{sst_info->largest_key, serialized_info.largest_key.calculateChecksum()};
+SSTIndex::PendingEdit SSTIndex::stageEdit(VersionEdit edit) {
+  PendingEdit pending;
+  lock_guard<mutex> lock(manifest_mutex);
+  if (!manifest || manifest->needsSnapshot(manifestSnapshotBytes)) {
+    // levels already hold the change
+    pending.record = snapshotRecord();
+    pending.snapshot = true;
+  } else {
+    pending.record = std::move(edit);
+  }
+  return pending;
+}
 
-    serialized_info.serialize(outfile);  // Serialize and write to the file
+void SSTIndex::writeEdit(const PendingEdit& pending) {
+  lock_guard<mutex> lock(manifest_mutex);
+  if (pending.snapshot) {
+    writeSnapshot(pending.record);
+  } else {
+    manifest->logEdit(pending.record);
   }
+}
 
-  // Step 3: Close the file
-  outfile.close();
-  if (!outfile) {
-    throw std::runtime_error("SSTIndex::flushToDisk() >>>> Failed to write to Index.sst.");
+void SSTIndex::publishEdit(const PendingEdit& pending) {
+  // Deleted with the last version naming them: readers of older versions may still open them
+  for (SSTInfo* info : pending.obsolete) {
+    info->obsolete = true;
+    owners.erase(info);
   }
-  // clear index
-  index.clear();
+  installVersion();
 }
 
 
 // Add a new SST to the index
-void SSTIndex::addSST(const string& filename, KeyValue smallest_key, KeyValue largest_key){
-  SSTInfo* info = new SSTInfo{filename, smallest_key, largest_key};
-  index.push_back(info);
-
-  // // Debug Purpose :-D
-  // if (!index.empty()) {
-  //   SSTInfo* info = index.back();
-  //   cout << "\n-->Inside SSTIndex::addSST()" << endl;
-  //   std::cout << info->filename << endl << "Smallest KeyValue:" << endl;
-  //   info->smallest_key.printKeyValue();
-  //   cout << "\nLargest KeyValue:" << endl;
-  //   info->largest_key.printKeyValue();
-  //
-  // } else {
-  //   std::cout << "The deque is empty, no elements to print." << std::endl;
-  // }
+void SSTIndex::addSST(const string& filename, KeyValue smallest_key, KeyValue largest_key, shared_ptr<BloomFilter> filter, int level){
+  SSTInfo* info = newSSTInfo(filename, smallest_key, largest_key, std::move(filter), level);
+  // A reader cached under the same name belongs to an older file
+  tableCache.evict(filename);
+  if (info->file_size > 0) {
+    shared_ptr<SSTable> table = SSTable::open(path / filename);
+    info->largest_sequence = table->getLargestSequence();
+    info->has_range_deletions = !table->getRangeDeletions().empty();
+  }
+  insertFile(info);
+
+  VersionEdit edit;
+  edit.new_files.push_back({level, filename, smallest_key, largest_key, info->file_size, info->largest_sequence});
+  PendingEdit pending = stageEdit(std::move(edit));
+  writeEdit(pending);
+  publishEdit(pending);
+}
+
+void SSTIndex::addSST(const FlushSSTInfo& flushed, int level) {
+  PendingEdit pending = stageSST(flushed, level);
+  writeEdit(pending);
+  publishEdit(pending);
+}
+
+SSTIndex::PendingEdit SSTIndex::stageSST(const FlushSSTInfo& flushed, int level) {
+  SSTInfo* info = newSSTInfo(flushed.fileName, flushed.smallest_key, flushed.largest_key, flushed.filter, level);
+  info->largest_sequence = flushed.largest_sequence;
+  info->has_range_deletions = flushed.has_range_deletions;
+  tableCache.evict(flushed.fileName);
+  insertFile(info);
+
+  VersionEdit edit;
+  edit.new_files.push_back({level, info->filename, info->smallest_key, info->largest_key, info->file_size, info->largest_sequence});
+  return stageEdit(std::move(edit));
+}
+
+const BloomFilter* SSTIndex::filterOf(SSTInfo* info) {
+  if (!info->filter_loaded.load(std::memory_order_acquire)) {
+    // Readers of a pinned version get here without the index lock
+    lock_guard<mutex> lock(info->filter_mutex);
+    if (!info->filter_loaded.load(std::memory_order_relaxed)) {
+      // Opens the table handle too: the lookup that needs the filter reads the SST next
+      shared_ptr<SSTable> table = tableCache.findTable(info->filename);
+      info->filter = table->readFilter();
+      info->has_range_deletions = !table->getRangeDeletions().empty();
+      info->filter_loaded.store(true, std::memory_order_release);
+    }
+  }
+  return info->filter.get();
+}
+
+vector<shared_ptr<SSTInfo>> SSTIndex::nextToWarmUp(size_t max_files) {
+  if (!warm_up_started) {
+    // Only files found by a lazy open lack their filter: flushes and compactions build theirs
+    warm_up_started = true;
+    for (SSTInfo* info : getSSTsIndex()) {
+      if (!info->filter_loaded) {
+        warm_up_files.push_back(owners.at(info));
+      }
+    }
+  }
+  vector<shared_ptr<SSTInfo>> next;
+  for (; warm_up_cursor < warm_up_files.size() && next.size() < max_files; ++warm_up_cursor) {
+    // Skip files compacted away or loaded by a lookup since
+    shared_ptr<SSTInfo> info = warm_up_files[warm_up_cursor].lock();
+    if (info && !info->obsolete && !info->filter_loaded) {
+      next.push_back(std::move(info));
+    }
+  }
+  if (warm_up_cursor == warm_up_files.size()) {
+    warm_up_files.clear();
+    warm_up_cursor = 0;
+  }
+  return next;
+}
+
+size_t SSTIndex::warmUp(size_t max_files) {
+  vector<shared_ptr<SSTInfo>> next = nextToWarmUp(max_files);
+  for (const shared_ptr<SSTInfo>& info : next) {
+    loadFilter(info.get());
+  }
+  return next.size();
 }
 
 void SSTIndex::set_path(fs::path _path) {
@@ -189,111 +502,424 @@ void SSTIndex::set_path(fs::path _path) {
     fs::create_directories(_path);
   }
   fileManager.setDirectory(_path);
+  tableCache.setDirectory(_path);
   path = _path;
 }
 
 
-// SST file search by using RedBlackTree* FileManager::loadFromDisk(const std::string& sst_filename);
+// SST file search through the table cache: no open/stat syscalls once the file is cached
 KeyValue SSTIndex::SearchInSST(const string& filename, KeyValue _key) {
-  // Append the directory path to the filename
-  fs::path fullFilePath = path / filename;
-
-  // Check if the SST file exists
-  if (!fs::exists(fullFilePath)) {
-    throw std::runtime_error("SSTIndex::SearchInSST() >>>> SST file does not exist: " + fullFilePath.string());
-  }
-
-  // Use the FileManager to load the SST file into a RedBlackTree
-  RedBlackTree* tree = fileManager.loadFromDisk(filename);
-
-  // Check if the tree is null or empty (in case the file couldn't be loaded)
-  if (!tree) {
-    throw std::runtime_error("SSTIndex::SearchInSST() >>>> Failed to load SST file: " + fullFilePath.string());
-  }
-
-  // Search for the key in the loaded RedBlackTree
-  KeyValue result = tree->getValue(_key);
-
-  // Clean up: delete the tree once we're done
-  delete tree;
-
-  // Return the result of the search
-  return result;
+  // Binary search the in-file index and decode only the candidate block
+  return tableCache.findTable(filename)->get(_key);
 }
 
 
 
 
 // search value for key
-KeyValue SSTIndex::Search(KeyValue _key) {
-  // Traverse the deque from the youngest (back) to the oldest (front)
-  for (auto it = index.rbegin(); it != index.rend(); ++it) {
-    SSTInfo* sst_info = *it;
-
-    // Check if the range overlaps with the key range in this SST file
-    if (sst_info->largest_key < _key || sst_info->smallest_key > _key) {
-      // No overlap, skip this SST file
-      // cout << "skip" << ++i << endl;
+KeyValue SSTIndex::Search(KeyValue _key, uint64_t sequence, const Version* pinned) {
+  PERF_TIMER_GUARD(get_from_output_files_nanos);
+  const vector<Level>& read_levels = (pinned ? pinned : version.get())->levels;
+  // Runs while no file is being searched: the time spent picking files
+  PERF_TIMER_GUARD(find_file_nanos);
+  // Filter probes hash the same bytes for every file
+  const string keyBytes = BloomFilter::keyBytes(_key);
+  uint64_t probed = 0;
+  uint64_t filtered = 0;
+
+  auto searchFile = [&](SSTInfo* sst_info) {
+    PERF_TIMER_STOP(find_file_nanos);
+    KeyValue result;
+    // The key is definitely not in this SST file
+    const BloomFilter* filter = filterOf(sst_info);
+    if (filter && !filter->mayContain(keyBytes)) {
+      filtered++;
+      if (sst_info->has_range_deletions) {
+        result = tableCache.findTable(sst_info->filename)->getRangeTombstone(_key, sequence);
+      }
+    } else {
+      if (filter) {
+        PERF_COUNTER_ADD(bloom_sst_hit_count, 1);
+      }
+      // Search for the key in the mapped SST file
+      probed++;
+      result = tableCache.findTable(sst_info->filename)->get(_key, sequence);
+    }
+    PERF_TIMER_START(find_file_nanos);
+    return result;
+  };
+  auto done = [&](const KeyValue& result) {
+    PERF_COUNTER_ADD(sst_read_count, probed);
+    PERF_COUNTER_ADD(bloom_sst_miss_count, filtered);
+    if (statistics) {
+      statistics->recordTick(Ticker::SST_FILES_PROBED, probed);
+      statistics->recordTick(Ticker::BLOOM_FILTER_USEFUL, filtered);
+      statistics->recordInHistogram(HistogramType::SST_FILES_PER_GET, probed);
+    }
+    return result;
+  };
+
+  // L0 files may overlap each other: every one holding the key range, youngest first
+  const vector<SSTInfo*>& level0 = read_levels[0].files;
+  for (auto it = level0.rbegin(); it != level0.rend(); ++it) {
+    if ((*it)->largest_key < _key || (*it)->smallest_key > _key) {
+      PERF_COUNTER_ADD(sst_range_pruned_count, 1);
       continue;
     }
-    // Use SearchInSST to search for the key in the current SST file
-    KeyValue result = SearchInSST(sst_info->filename, _key);
-
-    // If the result is not empty, return the found key-value pair
+    KeyValue result = searchFile(*it);
     if (!result.isEmpty()) {
-      return result;
+      return done(result);
+    }
+  }
+
+  // Deeper levels: a binary search over the fences finds the candidate file. A file
+  // ending in a clipped range tombstone shares its largest key (the tombstone's
+  // exclusive end) with the next file's smallest, so that one is tried too.
+  for (size_t level = 1; level < read_levels.size(); ++level) {
+    const vector<SSTInfo*>& files = read_levels[level].files;
+    size_t i = findFile(read_levels[level], _key);
+    if (i == files.size() || files[i]->smallest_key > _key) {
+      if (!files.empty()) {
+        PERF_COUNTER_ADD(sst_range_pruned_count, 1);
+      }
+      continue;
+    }
+    for (; i < files.size() && !(files[i]->smallest_key > _key); ++i) {
+      KeyValue result = searchFile(files[i]);
+      if (!result.isEmpty()) {
+        return done(result);
+      }
     }
   }
 
   // If no result was found, return an empty KeyValue
-  return KeyValue();
+  return done(KeyValue());
 }
 
 
-// scan in all SST files [from OLDEST to YOUNGEST]
-void SSTIndex::Scan(KeyValue smallestKey, KeyValue largestKey, set<KeyValue>& res) {
-  int i = 0;
-  // Traverse the deque from the youngest (back) to the oldest (front)
-  for (auto it = index.rbegin(); it != index.rend(); ++it) {
-    SSTInfo* sst_info = *it;
+// batched search for sorted keys
+void SSTIndex::MultiSearch(const vector<KeyValue>& sorted_keys, vector<KeyValue>& results, uint64_t sequence,
+                           const Version* pinned) {
+  const vector<Level>& read_levels = (pinned ? pinned : version.get())->levels;
+  // Positions still to be found
+  vector<size_t> pending;
+  for (size_t i = 0; i < sorted_keys.size(); ++i) {
+    if (results[i].isEmpty()) {
+      pending.push_back(i);
+    }
+  }
 
-    // Check if the range overlaps with the key range in this SST file
-    if (sst_info->largest_key < smallestKey || sst_info->smallest_key > largestKey) {
-      // No overlap, skip this SST file
-      // cout << "skip" << ++i << endl;
-      continue;
+  auto searchFile = [&](SSTInfo* sst_info) {
+    // Pending keys inside the file's range (binary search: pending is sorted)
+    auto first = std::lower_bound(pending.begin(), pending.end(), sst_info->smallest_key,
+        [&](size_t i, const KeyValue& key) { return sorted_keys[i] < key; });
+    auto last = std::upper_bound(first, pending.end(), sst_info->largest_key,
+        [&](const KeyValue& key, size_t i) { return key < sorted_keys[i]; });
+
+    vector<size_t> candidates;
+    vector<KeyValue> keys;
+    bool any = false;
+    for (auto p = first; p != last; ++p) {
+      const BloomFilter* filter = filterOf(sst_info);
+      if (filter && !filter->mayContain(sorted_keys[*p])) {
+        if (statistics) {
+          statistics->recordTick(Ticker::BLOOM_FILTER_USEFUL);
+        }
+        if (sst_info->has_range_deletions) {
+          results[*p] = tableCache.findTable(sst_info->filename)->getRangeTombstone(sorted_keys[*p], sequence);
+          any = any || !results[*p].isEmpty();
+        }
+        continue;
+      }
+      candidates.push_back(*p);
+      keys.push_back(sorted_keys[*p]);
+    }
+    if (!candidates.empty()) {
+      // One table open and one pass over its blocks for the whole group
+      if (statistics) {
+        statistics->recordTick(Ticker::SST_FILES_PROBED);
+      }
+      vector<KeyValue> found(keys.size());
+      tableCache.findTable(sst_info->filename)->multiGet(keys, found, sequence);
+      for (size_t k = 0; k < candidates.size(); ++k) {
+        if (!found[k].isEmpty()) {
+          results[candidates[k]] = found[k];
+          any = true;
+        }
+      }
+    }
+    if (any) {
+      pending.erase(std::remove_if(pending.begin(), pending.end(),
+          [&](size_t i) { return !results[i].isEmpty(); }), pending.end());
     }
+  };
 
-    // Scan the key-value pairs in the current SST file that fall within the specified range
-    ScanInSST(smallestKey, largestKey, sst_info->filename, res);
+  // L0 from the youngest to the oldest file
+  const vector<SSTInfo*>& level0 = read_levels[0].files;
+  for (auto it = level0.rbegin(); it != level0.rend() && !pending.empty(); ++it) {
+    searchFile(*it);
+  }
+  // Deeper levels: only the files between the smallest and the largest pending key
+  for (size_t level = 1; level < read_levels.size() && !pending.empty(); ++level) {
+    const vector<SSTInfo*>& files = read_levels[level].files;
+    const KeyValue largest = sorted_keys[pending.back()];
+    for (size_t i = findFile(read_levels[level], sorted_keys[pending.front()]);
+         i < files.size() && !(files[i]->smallest_key > largest) && !pending.empty(); ++i) {
+      searchFile(files[i]);
+    }
+  }
+}
+
+
+// scan in all SST files, newest version of each key, deleted keys left out
+void SSTIndex::Scan(KeyValue smallestKey, KeyValue largestKey, set<KeyValue>& res, uint64_t sequence) {
+  vector<unique_ptr<Iterator>> iterators;
+  vector<vector<KeyValue>> range_deletions;
+  addIterators(iterators, range_deletions, &smallestKey, &largestKey);
+  MergingIterator it(std::move(iterators), std::move(range_deletions), sequence);
+  for (it.Seek(smallestKey); it.Valid() && !(largestKey < it.kv()); it.Next()) {
+    res.insert(res.end(), it.kv());
   }
 }
 
 
+void SSTIndex::addIterators(vector<unique_ptr<Iterator>>& iterators, vector<vector<KeyValue>>& range_deletions,
+                            const KeyValue* smallest_key, const KeyValue* largest_key, const Version* pinned) {
+  const vector<Level>& read_levels = (pinned ? pinned : version.get())->levels;
+  auto overlaps = [&](const SSTInfo* info) {
+    return !(smallest_key && info->largest_key < *smallest_key) && !(largest_key && info->smallest_key > *largest_key);
+  };
+  // One tombstone list per cursor, lined up with iterators
+  range_deletions.resize(iterators.size());
+  // L0 files may overlap each other: one cursor each, newest first
+  const vector<SSTInfo*>& level0 = read_levels[0].files;
+  for (auto it = level0.rbegin(); it != level0.rend(); ++it) {
+    if (overlaps(*it)) {
+      shared_ptr<SSTable> table = tableCache.findTable((*it)->filename);
+      range_deletions.push_back(table->getRangeDeletions());
+      iterators.push_back(SSTable::newIterator(std::move(table)));
+    }
+  }
+  // Deeper levels are sorted runs: one cursor per level, files opened as it gets there
+  for (size_t level = 1; level < read_levels.size(); ++level) {
+    vector<LevelIterator::File> files;
+    vector<KeyValue> level_deletions;
+    // From the first file reaching smallest_key to the last one starting at or before largest_key
+    const vector<SSTInfo*>& level_files = read_levels[level].files;
+    for (size_t i = smallest_key ? findFile(read_levels[level], *smallest_key) : 0; i < level_files.size(); ++i) {
+      SSTInfo* info = level_files[i];
+      if (largest_key && info->smallest_key > *largest_key) {
+        break;
+      }
+      shared_ptr<SSTable> table = tableCache.findTable(info->filename);
+      // Files of a level don't overlap, so their tombstones stay sorted when appended
+      const vector<KeyValue>& deletions = table->getRangeDeletions();
+      level_deletions.insert(level_deletions.end(), deletions.begin(), deletions.end());
+      files.push_back(LevelIterator::File{info->largest_key, std::move(table)});
+    }
+    if (!files.empty()) {
+      range_deletions.push_back(std::move(level_deletions));
+      iterators.push_back(make_unique<LevelIterator>(std::move(files)));
+    }
+  }
+}
+
 // scan kv-pairs inside sst file
 void SSTIndex::ScanInSST(KeyValue smallestKey, KeyValue largestKey, const string& filename, set<KeyValue>& resultSet) {
-  // Use the FileManager to load the SST file into a RedBlackTree
-  RedBlackTree* tree = fileManager.loadFromDisk(filename);
+  // Decode only the data blocks overlapping [smallestKey, largestKey]
+  tableCache.findTable(filename)->scan(smallestKey, largestKey, resultSet);
+}
 
-  // Check if the tree is null or empty (in case the file couldn't be loaded)
-  if (!tree) {
-    throw std::runtime_error("SSTIndex::ScanInSST() >>>> Failed to load SST file: " + filename);
+
+/*
+ * Leveled compaction
+ */
+int SSTIndex::pickLevel(double& score) const {
+  int best_level = -1;
+  score = 0;
+  // L0 by file count: every L0 file is another lookup
+  if (options.level0_file_num_trigger > 0) {
+    score = static_cast<double>(levels[0].files.size()) / options.level0_file_num_trigger;
+    best_level = 0;
   }
+  // The last level has nowhere to go
+  for (int level = 1; level + 1 < options.num_levels; ++level) {
+    double level_score = static_cast<double>(levels[level].bytes) / Compaction::maxBytesForLevel(options, level);
+    if (level_score > score) {
+      score = level_score;
+      best_level = level;
+    }
+  }
+  return best_level;
+}
 
-  // Perform an inorder traversal of the tree
-  tree->inOrderTraversal([&](const KeyValue& kv) {
-      // Print all traversed key-values to debug
-      // std::cout << "Traversed Key: " << std::get<int>(kv.getKey()) << ", Value: " << std::get<string>(kv.getValue()) << "\n";
+bool SSTIndex::needsCompaction() const {
+  if (compacting || options.num_levels < 2) {
+    return false;
+  }
+  double score;
+  pickLevel(score);
+  return score >= 1;
+}
 
-      // Check if the current key is within the specified range [smallestKey, largestKey]
-      if (kv >= smallestKey && kv <= largestKey) {
-          // std::cout << "Key within range: " << std::get<int>(kv.getKey()) << "\n";
-          resultSet.insert(kv);  // Insert into the result set if within range
+CompactionJob SSTIndex::pickCompaction() {
+  CompactionJob job;
+  if (!needsCompaction()) {
+    return job;
+  }
+  double score;
+  job.level = pickLevel(score);
+
+  KeyValue smallest, largest;
+  if (job.level == 0) {
+    // L0 files overlap each other: take them all
+    job.inputs = levels[0].files;
+  } else {
+    // Round robin over the level, starting after the last compacted key
+    const vector<SSTInfo*>& files = levels[job.level].files;
+    SSTInfo* picked = files.front();
+    auto pointer = compactPointer.find(job.level);
+    if (pointer != compactPointer.end()) {
+      auto next = std::upper_bound(files.begin(), files.end(), pointer->second,
+          [](const KeyValue& key, const SSTInfo* info) { return key < info->smallest_key; });
+      if (next != files.end()) {
+        picked = *next;
       }
-  });
+    }
+    job.inputs.push_back(picked);
+  }
+  smallest = job.inputs.front()->smallest_key;
+  largest = job.inputs.front()->largest_key;
+  for (SSTInfo* info : job.inputs) {
+    if (info->smallest_key < smallest) smallest = info->smallest_key;
+    if (info->largest_key > largest) largest = info->largest_key;
+  }
 
-  // Clean up: delete the tree once we're done
-  delete tree;
+  // Files of the next level overlapping the input range
+  const vector<SSTInfo*>& next_files = levels[job.level + 1].files;
+  for (size_t i = findFile(job.level + 1, smallest); i < next_files.size() && !(next_files[i]->smallest_key > largest); ++i) {
+    job.next_inputs.push_back(next_files[i]);
+  }
+  job.trivial_move = job.inputs.size() == 1 && job.next_inputs.empty();
+  // Tombstones can go once no deeper level holds data they would have to shadow
+  for (SSTInfo* info : job.next_inputs) {
+    if (info->smallest_key < smallest) smallest = info->smallest_key;
+    if (info->largest_key > largest) largest = info->largest_key;
+  }
+  for (size_t level = job.level + 2; level < levels.size() && job.bottommost; ++level) {
+    size_t i = findFile(level, smallest);
+    job.bottommost = i == levels[level].files.size() || levels[level].files[i]->smallest_key > largest;
+  }
+  compacting = true;
+  return job;
 }
 
+vector<FlushSSTInfo> SSTIndex::runCompaction(const CompactionJob& job) {
+  if (job.trivial_move) {
+    return {};
+  }
+  // Newest first: L0 newest to oldest, then the next level
+  vector<shared_ptr<SSTable>> tables;
+  for (auto it = job.inputs.rbegin(); it != job.inputs.rend(); ++it) {
+    tables.push_back(tableCache.findTable((*it)->filename));
+  }
+  for (SSTInfo* info : job.next_inputs) {
+    tables.push_back(tableCache.findTable(info->filename));
+  }
+  return Compaction::merge(tables, fileManager, options.target_file_size, job.bottommost, job.snapshots);
+}
 
+void SSTIndex::installCompaction(const CompactionJob& job, const vector<FlushSSTInfo>& outputs) {
+  PendingEdit pending = stageCompaction(job, outputs);
+  writeEdit(pending);
+  publishEdit(pending);
+}
+
+SSTIndex::PendingEdit SSTIndex::stageCompaction(const CompactionJob& job, const vector<FlushSSTInfo>& outputs) {
+  const int output_level = job.level + 1;
+  compactPointer[job.level] = job.inputs.back()->largest_key;
+  VersionEdit edit;
+  edit.compact_pointers.emplace_back(job.level, compactPointer[job.level]);
+
+  vector<SSTInfo*> obsolete(job.inputs.begin(), job.inputs.end());
+  obsolete.insert(obsolete.end(), job.next_inputs.begin(), job.next_inputs.end());
+  auto isObsolete = [&obsolete](SSTInfo* info) {
+    return std::find(obsolete.begin(), obsolete.end(), info) != obsolete.end();
+  };
+  for (int level : {job.level, output_level}) {
+    vector<SSTInfo*>& files = levels[level].files;
+    files.erase(std::remove_if(files.begin(), files.end(), isObsolete), files.end());
+  }
+
+  if (job.trivial_move) {
+    SSTInfo* moved = job.inputs.front();
+    moved->level = output_level;
+    levels[output_level].files.push_back(moved);
+    edit.deleted_files.push_back(moved->filename);
+    edit.new_files.push_back({output_level, moved->filename, moved->smallest_key, moved->largest_key,
+                              moved->file_size, moved->largest_sequence});
+  } else {
+    for (const FlushSSTInfo& output : outputs) {
+      SSTInfo* info = newSSTInfo(output.fileName, output.smallest_key, output.largest_key, output.filter, output_level);
+      info->largest_sequence = output.largest_sequence;
+      info->has_range_deletions = output.has_range_deletions;
+      own(info);
+      levels[output_level].files.push_back(info);
+      tableCache.evict(output.fileName);
+      edit.new_files.push_back({output_level, info->filename, info->smallest_key, info->largest_key,
+                                info->file_size, info->largest_sequence});
+    }
+    for (SSTInfo* info : obsolete) {
+      edit.deleted_files.push_back(info->filename);
+    }
+  }
+  sortLevel(job.level);
+  sortLevel(output_level);
+  compacting = false;
+  PendingEdit pending = stageEdit(std::move(edit));
+  // The inputs may only go once the MANIFEST no longer needs them
+  if (!job.trivial_move) {
+    pending.obsolete = std::move(obsolete);
+  }
+  return pending;
+}
+
+bool SSTIndex::compactOnce() {
+  CompactionJob job = pickCompaction();
+  if (!job.valid()) {
+    return false;
+  }
+  vector<FlushSSTInfo> outputs;
+  try {
+    outputs = runCompaction(job);
+  } catch (...) {
+    abortCompaction();
+    throw;
+  }
+  installCompaction(job, outputs);
+  return true;
+}
+
+size_t SSTIndex::getLevelFileCount(int level) const {
+  if (level < 0 || level >= static_cast<int>(levels.size())) {
+    return 0;
+  }
+  return levels[level].files.size();
+}
+
+uint64_t SSTIndex::getLevelBytes(int level) const {
+  if (level < 0 || level >= static_cast<int>(levels.size())) {
+    return 0;
+  }
+  return levels[level].bytes;
+}
+
+uint64_t SSTIndex::getLargestSequence() {
+  uint64_t largest = 0;
+  for (const Level& level : levels) {
+    for (SSTInfo* info : level.files) {
+      largest = std::max(largest, info->largest_sequence);
+    }
+  }
+  return largest;
+}
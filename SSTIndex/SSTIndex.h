@@ -5,11 +5,23 @@
 #include <string>
 #include <deque>
 #include <unordered_map>
+#include <map>
 #ifndef SSTINDEX_H
 #define SSTINDEX_H
 #include "FileManager.h"
+#include "SSTable.h"
 #include "KeyValue.h"
+#include "BloomFilter.h"
+#include "TableCache.h"
+#include "Compaction.h"
+#include "LevelIterator.h"
+#include "MergingIterator.h"
+#include "Manifest.h"
+#include "Statistics.h"
+#include <atomic>
 #include <filesystem> // C++17 lib
+#include <memory>
+#include <mutex>
 
 namespace fs = std::filesystem;
 using namespace std;
@@ -18,10 +30,41 @@ struct SSTInfo {
   std::string filename;
   KeyValue smallest_key;
   KeyValue largest_key;
+  std::shared_ptr<BloomFilter> filter;  // resident filter block, nullptr if the SST has none
+  int level = 0;                        // 0 = written by a memtable flush
+  uint64_t file_size = 0;
+  uint64_t largest_sequence = 0;
+  atomic<bool> filter_loaded{true};     // false until filter is read from the SST (lazy open)
+  bool has_range_deletions = true;      // the filter only holds point keys: if true, keys it
+                                        // rejects are still checked against the range tombstones
+  bool obsolete = false;                // replaced by a compaction: the file goes with the last reader
+  mutex filter_mutex{};                 // one thread reads the filter of a lazy open
+};
+
+// What SSTIndex::getAllSSTs() reads from the SSTs themselves; key ranges, sizes and
+// sequence numbers always come from the MANIFEST
+enum class SSTLoadMode {
+  EAGER,       // every filter block, before returning
+  LAZY,        // filter blocks and table handles on first touch
+  BACKGROUND   // LAZY, while API::Open starts a thread warming them up
+};
+
+// One compaction picked by SSTIndex::pickCompaction()
+struct CompactionJob {
+  int level = -1;                   // input level, -1 if there is nothing to compact
+  vector<SSTInfo*> inputs;          // files of level (for L0 oldest to newest)
+  vector<SSTInfo*> next_inputs;     // overlapping files of level + 1
+  bool trivial_move = false;        // single file without overlap: moved down without rewriting
+  bool bottommost = true;           // no deeper level overlaps: tombstones are dropped
+  vector<uint64_t> snapshots;       // live snapshots (ascending): the versions they read are kept
+  bool valid() const {return level >= 0;};
 };
 
 
 /*
+ * Index.sst is the index file written before the MANIFEST; it is only read,
+ * to migrate an existing database (see SSTIndex::getAllSSTs()).
+ *
  * Index.sst SSTIndexHeader Structure
  * void SSTHeader::serialize(ofstream&)
  * ==============================================================================
@@ -43,7 +86,7 @@ struct SSTIndexHeader {
  * Index.sst SerializedIndexSSTInfo Structure
  *
  * ===================================================================================
- * filename_len | (string) filename |
+ * filename_len | (string) filename | level |
  * ===================================================================================
  * ---->SerializedKeyValue::smallest_key
  *      ==============================================================================
@@ -65,6 +108,7 @@ struct SSTIndexHeader {
  */
 struct SerializedIndexSSTInfo {
     string filename;
+    uint32_t level = 0;
     SerializedKeyValue smallest_key;
     SerializedKeyValue largest_key;
     // serialize filename string
@@ -76,39 +120,189 @@ struct SerializedIndexSSTInfo {
 class SSTIndex {
   public:
   SSTIndex();
-  ~SSTIndex(){};
+  ~SSTIndex();
   /*
    * IO Operations
    */
-  // Retrieve all SSTs into index (e.g., when reopening the database)
+  // Retrieve all SSTs into index (e.g., when reopening the database) from the MANIFEST
+  // named by CURRENT (or a legacy Index.sst), then start a new MANIFEST holding them
   void getAllSSTs();  // updated with kv 2024-09-10
-  // flush index info into "Index.sst"
+  // Write the whole index as a snapshot into a new MANIFEST, then unload it
   void flushToDisk(); // updated with kv 2024-09-10
-  // Add a new SST to the index
-  void addSST(const string& filename, KeyValue smallest_key, KeyValue largest_key); // updated with kv 2024-09-10
-  // get index
-  deque<SSTInfo*> getSSTsIndex() {return index;};
+  // Add a new SST to the index; the change is synced to the MANIFEST before returning
+  void addSST(const string& filename, KeyValue smallest_key, KeyValue largest_key, shared_ptr<BloomFilter> filter = nullptr, int level = 0); // updated with kv 2024-09-10
+  void addSST(const FlushSSTInfo& info, int level = 0);
+
+  /*
+   * A change in three steps, so the MANIFEST I/O can run without the index lock:
+   * stage it under the lock (the levels change, readers still see the current
+   * Version), write it without the lock (writers of the MANIFEST are serialized
+   * by their own mutex), then publish it under the lock once it is durable.
+   * addSST and installCompaction do all three.
+   */
+  struct PendingEdit {
+    VersionEdit record;         // what goes into the MANIFEST: the edit, or a whole snapshot
+    bool snapshot = false;
+    vector<SSTInfo*> obsolete;  // compaction inputs, let go once the record is durable
+  };
+  PendingEdit stageSST(const FlushSSTInfo& info, int level = 0);
+  PendingEdit stageCompaction(const CompactionJob& job, const vector<FlushSSTInfo>& outputs);
+  void writeEdit(const PendingEdit& edit);
+  void publishEdit(const PendingEdit& edit);
+  void setLoadMode(SSTLoadMode mode) {loadMode = mode;};
+  SSTLoadMode getLoadMode() const {return loadMode;};
+  // Warm-up in rounds: under the index lock, take up to max_files files whose filter isn't
+  // loaded yet (a cursor walks the files there were at the first call, once), then load them
+  // with loadFilter() without the lock
+  vector<shared_ptr<SSTInfo>> nextToWarmUp(size_t max_files);
+  void loadFilter(SSTInfo* info) {filterOf(info);};
+  // Both steps at once; returns how many filters (and table handles) it loaded
+  size_t warmUp(size_t max_files);
+  // Every SST as [Lmax ... L1, L0 oldest ... L0 newest]
+  deque<SSTInfo*> getSSTsIndex() const;
+
+  // Files of one level. L0 files may overlap and are kept oldest to newest; the files of a
+  // deeper level don't, so they are sorted by key and their largest keys are fences that a
+  // binary search turns into the only file that can hold a key
+  struct Level {
+    vector<SSTInfo*> files;
+    vector<KeyValue> fences;  // fences[i] = files[i]->largest_key, levels >= 1 only
+    uint64_t bytes = 0;
+  };
+  // Every level as of one change of the index. Readers pin the current one under the
+  // lock guarding the index and search it without that lock: its SSTInfos, and the
+  // SSTs a compaction replaced meanwhile, stay around until the last reader drops it.
+  // A Version must not outlive its SSTIndex.
+  struct Version {
+    vector<Level> levels;
+    vector<shared_ptr<SSTInfo>> files;  // keeps the SSTInfos of levels alive
+  };
+  shared_ptr<const Version> current() const {return version;};
   /*
    * Search Operations
    */
-  // SST file search by using RedBlackTree* FileManager::loadFromDisk(const std::string& sst_filename);
+  // SST file search by using KeyValue FileManager::searchInSST(const std::string&, const KeyValue&);
   KeyValue SearchInSST(const string& filename, KeyValue _key); // updated with kv 2024-09-10
-  // Search in all SST files
-  KeyValue Search(KeyValue);
+  // Search in all SST files, skipping files whose Bloom filter rejects the key;
+  // stops at the newest entry with a sequence number <= sequence, which is a
+  // tombstone when the key was deleted. Counts the files probed into statistics.
+  // Search, MultiSearch and addIterators read pinned (a current() taken under the index
+  // lock) without that lock, or the current files under it when pinned is nullptr.
+  KeyValue Search(KeyValue, uint64_t sequence = KeyValue::MAX_SEQUENCE, const Version* pinned = nullptr);
+  // Batched Search of sorted keys: every SST (and each of its blocks) is read at most once;
+  // results[i] is set for each found sorted_keys[i] not already found (results[i] non-empty)
+  void MultiSearch(const vector<KeyValue>& sorted_keys, vector<KeyValue>& results,
+                   uint64_t sequence = KeyValue::MAX_SEQUENCE, const Version* pinned = nullptr);
   /*
    * Scan Operations
    */
-  // scan in all SST files [from YOUNGEST to OLDEST] [Note: currently I'm using set<KeyValue>]
-  void Scan(KeyValue smallestKey, KeyValue largestKey, set<KeyValue>&);
+  // scan in all SST files [from YOUNGEST to OLDEST] [Note: currently I'm using set<KeyValue>]; deleted keys are left out
+  void Scan(KeyValue smallestKey, KeyValue largestKey, set<KeyValue>&, uint64_t sequence = KeyValue::MAX_SEQUENCE);
+  // Cursors over the SSTs overlapping [smallest_key, largest_key] (nullptr = unbounded), newest first:
+  // one per L0 file, then one LevelIterator per deeper level. range_deletions gets the range
+  // tombstones of each cursor at the same position (see MergingIterator)
+  void addIterators(vector<unique_ptr<Iterator>>& iterators, vector<vector<KeyValue>>& range_deletions,
+                    const KeyValue* smallest_key = nullptr, const KeyValue* largest_key = nullptr,
+                    const Version* pinned = nullptr);
   // scan kv-pairs inside sst file
   void ScanInSST(KeyValue smallestKey, KeyValue largestKey, const string& filename, set<KeyValue>&);
   // helper function
   void set_path(fs::path);
+  // Block cache shared by every SST of the index (nullptr disables caching)
+  void setBlockCache(shared_ptr<BlockCache> cache) {tableCache.setBlockCache(std::move(cache));};
+  shared_ptr<BlockCache> getBlockCache() const {return tableCache.getBlockCache();};
+  // Maximum number of SSTs kept open (mapped, with parsed index block) at once
+  void setMaxOpenFiles(size_t max_open_files) {tableCache.setMaxOpenFiles(max_open_files);};
+  TableCache& getTableCache() {return tableCache;};
+  // Where Search and MultiSearch count SSTs probed and Bloom filter rejections (nullptr: nowhere)
+  void setStatistics(shared_ptr<Statistics> stats) {statistics = std::move(stats);};
+  // Bloom filter bits per key of compaction outputs
+  void setBloomBitsPerKey(int bits) {fileManager.setBloomBitsPerKey(bits);};
+  // A new MANIFEST snapshot is written once the edits logged after the current one
+  // reach both bytes and the size of the snapshot
+  void setManifestSnapshotBytes(uint64_t bytes) {manifestSnapshotBytes = bytes;};
+  // nullptr until the first change or getAllSSTs()
+  const Manifest* getManifest() const {return manifest.get();};
+  /*
+   * Compaction Operations
+   *
+   * Files are kept per level: L0 oldest to newest, deeper levels by smallest key,
+   * so newer data is in L0 and lower levels. A compaction is picked and installed
+   * by the caller holding the index (pick/install), while runCompaction only
+   * reads the input files and can run unlocked.
+   */
+  void setCompactionOptions(const CompactionOptions& _options);
+  const CompactionOptions& getCompactionOptions() const {return options;};
+  // Some level is over its target and no compaction is running
+  bool needsCompaction() const;
+  bool isCompacting() const {return compacting;};
+  // Pick the level with the highest score (>= 1) and its input files
+  CompactionJob pickCompaction();
+  // Merge the inputs into new SSTs (nothing for a trivial move)
+  vector<FlushSSTInfo> runCompaction(const CompactionJob& job);
+  // Replace the inputs by the outputs and delete the input files
+  void installCompaction(const CompactionJob& job, const vector<FlushSSTInfo>& outputs);
+  // Give up a picked compaction (e.g. runCompaction threw)
+  void abortCompaction() {compacting = false;};
+  // pick + run + install; returns false if nothing needed compaction
+  bool compactOnce();
+  size_t getLevelFileCount(int level) const;
+  // Largest sequence number written into any SST of the index (no SST is read)
+  uint64_t getLargestSequence();
+  uint64_t getLevelBytes(int level) const;
 
 private:
-  deque<SSTInfo*> index;
+  vector<Level> levels;
+  // Owners of the SSTInfos in levels; a Version shares them
+  unordered_map<SSTInfo*, shared_ptr<SSTInfo>> owners;
+  shared_ptr<const Version> version;
   fs::path path;
   FileManager fileManager;
+  TableCache tableCache;
+  CompactionOptions options;
+  bool compacting = false;
+  map<int, KeyValue> compactPointer;  // per level: largest key of the last compacted file
+  mutex manifest_mutex;  // guards manifest: its writes run without the index lock
+  unique_ptr<Manifest> manifest;
+  uint64_t manifestSnapshotBytes = 64 << 10;
+  SSTLoadMode loadMode = SSTLoadMode::EAGER;
+  shared_ptr<Statistics> statistics;
+  // Files left for nextToWarmUp(), from warm_up_cursor on
+  vector<weak_ptr<SSTInfo>> warm_up_files;
+  size_t warm_up_cursor = 0;
+  bool warm_up_started = false;
+  // Drop every SSTInfo (versions still pinned keep theirs)
+  void clearIndex();
+  // Make info owned by the index; freed once neither levels nor a Version holds it
+  void own(SSTInfo* info);
+  // Publish levels as the current Version; called after every change of levels
+  void installVersion();
+  SSTInfo* newSSTInfo(const string& filename, const KeyValue& smallest_key, const KeyValue& largest_key,
+                      shared_ptr<BloomFilter> filter, int level) const;
+  // Filter of info, read from the SST on first use after a lazy open (nullptr if it has none)
+  const BloomFilter* filterOf(SSTInfo* info);
+  // MANIFEST record of a change already applied to levels: edit, or a new snapshot holding it
+  PendingEdit stageEdit(VersionEdit edit);
+  // The whole index as one MANIFEST record
+  VersionEdit snapshotRecord() const;
+  // Start a new MANIFEST holding snapshot and drop the older ones; manifest_mutex held
+  void writeSnapshot(const VersionEdit& snapshot);
+  // Load a legacy Index.sst; false if there is none
+  bool loadIndexFile();
+  // Level of info within [0, num_levels - 1]
+  int levelOf(const SSTInfo* info) const;
+  // Replace the index by files (L0 files oldest to newest)
+  void setFiles(const vector<SSTInfo*>& files);
+  // Add info to its level: after the newest file for L0, in key order below
+  void insertFile(SSTInfo* info);
+  // Sort the files of a level (levels >= 1) and rebuild its fences and size
+  void sortLevel(int level);
+  // Index of the first file of level (>= 1) whose largest key is >= key (files.size() if none).
+  // The next file may start at that same key (see Search): callers walk on while smallest_key <= key
+  size_t findFile(int level, const KeyValue& key) const {return findFile(levels[level], key);};
+  static size_t findFile(const Level& level, const KeyValue& key);
+  // Level most in need of compaction and its score
+  int pickLevel(double& score) const;
 
 };
 
@@ -0,0 +1,69 @@
+//
+// Created by Damian Li on 2024-09-28.
+//
+
+#include "Snapshot.h"
+#include <algorithm>
+
+std::shared_ptr<const Snapshot> SnapshotList::create(uint64_t sequence) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        live.insert(sequence);
+    }
+    // The list may be gone before the snapshot (database closed first)
+    std::weak_ptr<SnapshotList> list = weak_from_this();
+    return std::shared_ptr<const Snapshot>(new Snapshot(sequence), [list](const Snapshot* snapshot) {
+        if (auto owner = list.lock()) {
+            owner->release(snapshot->getSequence());
+        }
+        delete snapshot;
+    });
+}
+
+void SnapshotList::release(uint64_t sequence) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = live.find(sequence);
+    if (it != live.end()) {
+        live.erase(it);
+    }
+}
+
+bool SnapshotList::empty() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return live.empty();
+}
+
+size_t SnapshotList::size() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return live.size();
+}
+
+std::vector<uint64_t> SnapshotList::sequences() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<uint64_t> result(live.begin(), live.end());
+    result.erase(std::unique(result.begin(), result.end()), result.end());
+    return result;
+}
+
+uint64_t SnapshotList::stripe(const std::vector<uint64_t>& snapshots, uint64_t sequence) {
+    auto it = std::lower_bound(snapshots.begin(), snapshots.end(), sequence);
+    return it == snapshots.end() ? KeyValue::MAX_SEQUENCE : *it;
+}
+
+void SnapshotList::dropShadowed(std::vector<KeyValue>& entries, const std::vector<uint64_t>& snapshots) {
+    size_t kept = 0;
+    uint64_t last_stripe = 0;
+    for (size_t i = 0; i < entries.size(); ++i) {
+        uint64_t current = stripe(snapshots, entries[i].getSequence());
+        // A newer version of the key in the same stripe hides this one from every reader
+        if (kept > 0 && entries[kept - 1] == entries[i] && current == last_stripe) {
+            continue;
+        }
+        last_stripe = current;
+        if (kept != i) {
+            entries[kept] = std::move(entries[i]);
+        }
+        kept++;
+    }
+    entries.resize(kept);
+}
@@ -0,0 +1,59 @@
+//
+// Created by Damian Li on 2024-09-28.
+//
+
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include "KeyValue.h"
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <vector>
+
+/*
+ * Read view pinned at a sequence number: reads through it see every write
+ * with a sequence number <= getSequence() and nothing newer.
+ */
+class Snapshot {
+public:
+    explicit Snapshot(uint64_t sequence) : sequence(sequence) {};
+    uint64_t getSequence() const {return sequence;};
+
+private:
+    const uint64_t sequence;
+};
+
+/*
+ * Snapshots alive in a database. Flushes and compactions keep, for every
+ * snapshot, the newest version of each key it can see; every other older
+ * version is dropped as before.
+ *
+ * A snapshot is released when the last copy of the pointer returned by
+ * create() goes away.
+ */
+class SnapshotList : public std::enable_shared_from_this<SnapshotList> {
+public:
+    std::shared_ptr<const Snapshot> create(uint64_t sequence);
+    bool empty() const;
+    size_t size() const;
+    // Sequence numbers of the live snapshots, ascending
+    std::vector<uint64_t> sequences() const;
+
+    /*
+     * Versions with the same stripe are told apart by no snapshot: only the
+     * newest of them is ever read. The stripe of sequence is the oldest
+     * snapshot at or above it (MAX_SEQUENCE above every snapshot).
+     */
+    static uint64_t stripe(const std::vector<uint64_t>& snapshots, uint64_t sequence);
+    // entries sorted by key, newest version first: drop the versions no reader can see
+    static void dropShadowed(std::vector<KeyValue>& entries, const std::vector<uint64_t>& snapshots);
+
+private:
+    mutable std::mutex mutex;
+    std::multiset<uint64_t> live;
+    void release(uint64_t sequence);
+};
+
+#endif //SNAPSHOT_H
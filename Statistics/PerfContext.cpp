@@ -0,0 +1,56 @@
+//
+// Created by Damian Li on 2024-10-05.
+//
+
+#include "PerfContext.h"
+#include <sstream>
+#include <utility>
+
+namespace perf_internal {
+    thread_local PerfLevel perf_level = PerfLevel::DISABLE;
+    thread_local PerfContext perf_context;
+}
+
+PerfContext* getPerfContext() {
+    return &perf_internal::perf_context;
+}
+
+void setPerfLevel(PerfLevel level) {
+    perf_internal::perf_level = level;
+}
+
+PerfLevel getPerfLevel() {
+    return perf_internal::perf_level;
+}
+
+std::string PerfContext::toString(bool exclude_zero) const {
+    const std::pair<const char*, uint64_t> counters[] = {
+        {"db_mutex_lock_nanos", db_mutex_lock_nanos},
+        {"get_from_memtable_nanos", get_from_memtable_nanos},
+        {"get_from_memtable_count", get_from_memtable_count},
+        {"get_from_output_files_nanos", get_from_output_files_nanos},
+        {"find_file_nanos", find_file_nanos},
+        {"sst_range_pruned_count", sst_range_pruned_count},
+        {"bloom_sst_hit_count", bloom_sst_hit_count},
+        {"bloom_sst_miss_count", bloom_sst_miss_count},
+        {"sst_read_count", sst_read_count},
+        {"file_open_nanos", file_open_nanos},
+        {"file_open_count", file_open_count},
+        {"block_cache_hit_count", block_cache_hit_count},
+        {"block_decode_nanos", block_decode_nanos},
+        {"block_decode_count", block_decode_count},
+        {"records_decoded_count", records_decoded_count},
+        {"block_seek_nanos", block_seek_nanos},
+    };
+    std::ostringstream out;
+    for (const auto& counter : counters) {
+        if (exclude_zero && counter.second == 0) {
+            continue;
+        }
+        if (out.tellp() > 0) {
+            out << ", ";
+        }
+        out << counter.first << " = " << counter.second;
+    }
+    return out.str();
+}
@@ -0,0 +1,119 @@
+//
+// Created by Damian Li on 2024-10-05.
+//
+
+#ifndef PERFCONTEXT_H
+#define PERFCONTEXT_H
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+// What the perf context of a thread measures
+enum class PerfLevel {
+    DISABLE,       // nothing (default)
+    ENABLE_COUNT,  // counters only
+    ENABLE_TIME    // counters and timers (two clock reads per timed step)
+};
+
+/*
+ * Where the time of this thread's operations went, step by step.
+ *
+ * Every thread has its own context, so a single slow Get can be broken down:
+ *
+ *   setPerfLevel(PerfLevel::ENABLE_TIME);
+ *   getPerfContext()->reset();
+ *   db->Get(key);
+ *   std::cout << getPerfContext()->toString();
+ *
+ * Nanosecond timers nest: get_from_output_files_nanos includes find_file_nanos,
+ * file_open_nanos, block_decode_nanos and block_seek_nanos of the SSTs read.
+ * With the level at DISABLE a step costs one thread-local load and a branch;
+ * building with NPERF_CONTEXT (cmake -DKVDB_PERF_CONTEXT=OFF) removes even that.
+ */
+struct PerfContext {
+    // API
+    uint64_t db_mutex_lock_nanos = 0;           // waiting for the database mutex in Get
+    // Memtable
+    uint64_t get_from_memtable_nanos = 0;
+    uint64_t get_from_memtable_count = 0;       // memtables probed
+    // SSTIndex
+    uint64_t get_from_output_files_nanos = 0;   // SSTIndex::Search as a whole
+    uint64_t find_file_nanos = 0;               // picking candidate SSTs by key range
+    uint64_t sst_range_pruned_count = 0;        // L0 SSTs and levels whose key range excludes the key
+    uint64_t bloom_sst_hit_count = 0;           // SSTs whose Bloom filter let the key through
+    uint64_t bloom_sst_miss_count = 0;          // SSTs skipped by their Bloom filter
+    uint64_t sst_read_count = 0;                // SSTs searched
+    // SSTable
+    uint64_t file_open_nanos = 0;               // mapping an SST and parsing its footer and index
+    uint64_t file_open_count = 0;
+    uint64_t block_cache_hit_count = 0;
+    uint64_t block_decode_nanos = 0;            // deserializing data blocks read from the file
+    uint64_t block_decode_count = 0;
+    uint64_t records_decoded_count = 0;
+    uint64_t block_seek_nanos = 0;              // binary searches of the index block and of data blocks
+
+    void reset() {*this = PerfContext();};
+    // "name = value" of every counter, separated by ", "; zero counters left out if exclude_zero
+    std::string toString(bool exclude_zero = false) const;
+};
+
+// The calling thread's context and level
+PerfContext* getPerfContext();
+void setPerfLevel(PerfLevel level);
+PerfLevel getPerfLevel();
+
+namespace perf_internal {
+    extern thread_local PerfLevel perf_level;
+    extern thread_local PerfContext perf_context;
+}
+
+// Adds the time between start() and stop() (or destruction) to a PerfContext timer,
+// if the level was ENABLE_TIME at start()
+class PerfStepTimer {
+public:
+    explicit PerfStepTimer(uint64_t* metric) : metric(metric) {};
+    ~PerfStepTimer() {stop();};
+    PerfStepTimer(const PerfStepTimer&) = delete;
+    PerfStepTimer& operator=(const PerfStepTimer&) = delete;
+
+    void start() {
+        if (perf_internal::perf_level >= PerfLevel::ENABLE_TIME) {
+            started = std::chrono::steady_clock::now();
+            running = true;
+        }
+    };
+    void stop() {
+        if (running) {
+            *metric += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - started).count();
+            running = false;
+        }
+    };
+
+private:
+    uint64_t* metric;
+    std::chrono::steady_clock::time_point started;
+    bool running = false;
+};
+
+#ifndef NPERF_CONTEXT
+// Times the rest of the scope (or up to PERF_TIMER_STOP) into getPerfContext()->metric
+#define PERF_TIMER_GUARD(metric) \
+    PerfStepTimer perf_step_timer_##metric(&perf_internal::perf_context.metric); \
+    perf_step_timer_##metric.start()
+#define PERF_TIMER_STOP(metric) perf_step_timer_##metric.stop()
+#define PERF_TIMER_START(metric) perf_step_timer_##metric.start()
+#define PERF_COUNTER_ADD(metric, value) \
+    do { \
+        if (perf_internal::perf_level >= PerfLevel::ENABLE_COUNT) { \
+            perf_internal::perf_context.metric += (value); \
+        } \
+    } while (0)
+#else
+#define PERF_TIMER_GUARD(metric)
+#define PERF_TIMER_STOP(metric)
+#define PERF_TIMER_START(metric)
+#define PERF_COUNTER_ADD(metric, value)
+#endif
+
+#endif //PERFCONTEXT_H
@@ -0,0 +1,180 @@
+//
+// Created by Damian Li on 2024-10-04.
+//
+
+#include "Statistics.h"
+#include <algorithm>
+#include <cstdio>
+#include <sstream>
+
+namespace {
+    // Index of the highest set bit of v > 0 (no compiler builtins: MSVC builds this too)
+    int floorLog2(uint64_t v) {
+        int log = 0;
+        for (int shift = 32; shift > 0; shift /= 2) {
+            if (v >> shift) {
+                v >>= shift;
+                log += shift;
+            }
+        }
+        return log;
+    }
+
+    const char* const TICKER_NAMES[] = {
+        "kvdb.number.keys.read",
+        "kvdb.number.keys.found",
+        "kvdb.memtable.hit",
+        "kvdb.memtable.miss",
+        "kvdb.sst.files.probed",
+        "kvdb.bloom.filter.useful",
+        "kvdb.block.cache.hit",
+        "kvdb.block.cache.miss",
+        "kvdb.bytes.read",
+        "kvdb.number.keys.written",
+        "kvdb.bytes.written",
+        "kvdb.number.scans",
+        "kvdb.number.keys.scanned",
+        "kvdb.flush.count",
+        "kvdb.flush.bytes.written",
+        "kvdb.compaction.count",
+        "kvdb.compaction.trivial.moves",
+        "kvdb.compaction.bytes.read",
+        "kvdb.compaction.bytes.written",
+    };
+    static_assert(sizeof(TICKER_NAMES) / sizeof(TICKER_NAMES[0]) == static_cast<size_t>(Ticker::TICKER_COUNT),
+                  "a ticker without a name");
+
+    const char* const HISTOGRAM_NAMES[] = {
+        "kvdb.get.nanos",
+        "kvdb.multiget.nanos",
+        "kvdb.write.nanos",
+        "kvdb.scan.nanos",
+        "kvdb.sst.files.per.get",
+        "kvdb.flush.nanos",
+        "kvdb.compaction.nanos",
+    };
+    static_assert(sizeof(HISTOGRAM_NAMES) / sizeof(HISTOGRAM_NAMES[0]) == static_cast<size_t>(HistogramType::HISTOGRAM_COUNT),
+                  "a histogram without a name");
+}
+
+/*
+ * AtomicHistogram
+ */
+size_t AtomicHistogram::bucketIndex(uint64_t value) {
+    if (value < SUB_BUCKETS) {
+        return value;
+    }
+    // 16 buckets per power of two: the 4 bits below the highest set bit pick one
+    int shift = floorLog2(value) - 4;
+    return SUB_BUCKETS + shift * SUB_BUCKETS + ((value >> shift) & (SUB_BUCKETS - 1));
+}
+
+uint64_t AtomicHistogram::bucketStart(size_t b) {
+    if (b < SUB_BUCKETS) {
+        return b;
+    }
+    size_t shift = (b - SUB_BUCKETS) / SUB_BUCKETS;
+    return (SUB_BUCKETS + (b - SUB_BUCKETS) % SUB_BUCKETS) << shift;
+}
+
+void AtomicHistogram::add(uint64_t value) {
+    buckets[bucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+    num.fetch_add(1, std::memory_order_relaxed);
+    total.fetch_add(value, std::memory_order_relaxed);
+    uint64_t current = min_.load(std::memory_order_relaxed);
+    while (value < current && !min_.compare_exchange_weak(current, value, std::memory_order_relaxed)) {}
+    current = max_.load(std::memory_order_relaxed);
+    while (value > current && !max_.compare_exchange_weak(current, value, std::memory_order_relaxed)) {}
+}
+
+double AtomicHistogram::percentile(double p) const {
+    uint64_t n = count();
+    if (n == 0) {
+        return 0;
+    }
+    double min_value = static_cast<double>(min_.load(std::memory_order_relaxed));
+    double max_value = static_cast<double>(max_.load(std::memory_order_relaxed));
+    double threshold = n * (p / 100.0);
+    uint64_t seen = 0;
+    for (size_t b = 0; b < NUM_BUCKETS; ++b) {
+        uint64_t in_bucket = buckets[b].load(std::memory_order_relaxed);
+        if (in_bucket == 0) {
+            continue;
+        }
+        if (seen + in_bucket >= threshold) {
+            double left = static_cast<double>(bucketStart(b));
+            double right = static_cast<double>(bucketLimit(b));
+            double value = left + (right - left) * ((threshold - seen) / in_bucket);
+            return std::min(std::max(value, min_value), max_value);
+        }
+        seen += in_bucket;
+    }
+    return max_value;
+}
+
+HistogramData AtomicHistogram::getData() const {
+    HistogramData data;
+    data.count = count();
+    if (data.count == 0) {
+        return data;
+    }
+    data.sum = sum();
+    data.min = min_.load(std::memory_order_relaxed);
+    data.max = max_.load(std::memory_order_relaxed);
+    data.average = static_cast<double>(data.sum) / data.count;
+    data.median = percentile(50);
+    data.p95 = percentile(95);
+    data.p99 = percentile(99);
+    data.p999 = percentile(99.9);
+    return data;
+}
+
+void AtomicHistogram::reset() {
+    for (std::atomic<uint64_t>& bucket : buckets) {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+    num.store(0, std::memory_order_relaxed);
+    total.store(0, std::memory_order_relaxed);
+    min_.store(UINT64_MAX, std::memory_order_relaxed);
+    max_.store(0, std::memory_order_relaxed);
+}
+
+/*
+ * Statistics
+ */
+std::string Statistics::toString() const {
+    std::ostringstream out;
+    for (size_t t = 0; t < static_cast<size_t>(Ticker::TICKER_COUNT); ++t) {
+        out << TICKER_NAMES[t] << " COUNT : " << tickers[t].value.load(std::memory_order_relaxed) << '\n';
+    }
+    for (size_t h = 0; h < static_cast<size_t>(HistogramType::HISTOGRAM_COUNT); ++h) {
+        HistogramData data = histograms[h].getData();
+        if (data.count == 0) {
+            continue;
+        }
+        char line[256];
+        std::snprintf(line, sizeof(line), "%s P50 : %.1f P95 : %.1f P99 : %.1f P99.9 : %.1f MAX : %llu COUNT : %llu SUM : %llu\n",
+                      HISTOGRAM_NAMES[h], data.median, data.p95, data.p99, data.p999,
+                      static_cast<unsigned long long>(data.max), static_cast<unsigned long long>(data.count),
+                      static_cast<unsigned long long>(data.sum));
+        out << line;
+    }
+    return out.str();
+}
+
+void Statistics::reset() {
+    for (PaddedCounter& ticker : tickers) {
+        ticker.value.store(0, std::memory_order_relaxed);
+    }
+    for (AtomicHistogram& histogram : histograms) {
+        histogram.reset();
+    }
+}
+
+const char* Statistics::tickerName(Ticker ticker) {
+    return TICKER_NAMES[static_cast<size_t>(ticker)];
+}
+
+const char* Statistics::histogramName(HistogramType type) {
+    return HISTOGRAM_NAMES[static_cast<size_t>(type)];
+}
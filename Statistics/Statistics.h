@@ -0,0 +1,175 @@
+//
+// Created by Damian Li on 2024-10-04.
+//
+
+#ifndef STATISTICS_H
+#define STATISTICS_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Event counters of a Statistics object
+enum class Ticker : uint32_t {
+    // Get / MultiGet
+    NUMBER_KEYS_READ,        // keys looked up
+    NUMBER_KEYS_FOUND,
+    MEMTABLE_HIT,            // answered by the active or the immutable memtable (tombstones too)
+    MEMTABLE_MISS,
+    SST_FILES_PROBED,        // SSTs read after their key range and Bloom filter admitted the key
+    BLOOM_FILTER_USEFUL,     // SSTs skipped because their filter rejected the key
+    BLOCK_CACHE_HIT,
+    BLOCK_CACHE_MISS,
+    BYTES_READ,              // key and value bytes returned by Get, MultiGet and Scan
+    // Writes
+    NUMBER_KEYS_WRITTEN,     // records of Put, Delete, DeleteRange and WriteBatch
+    BYTES_WRITTEN,           // their key and value bytes
+    // Scans
+    NUMBER_SCANS,
+    NUMBER_KEYS_SCANNED,
+    // Background work
+    FLUSH_COUNT,
+    FLUSH_BYTES_WRITTEN,     // bytes of the SSTs written by flushes
+    COMPACTION_COUNT,        // including trivial moves
+    COMPACTION_TRIVIAL_MOVES,
+    COMPACTION_BYTES_READ,   // bytes of the input SSTs of merges
+    COMPACTION_BYTES_WRITTEN,
+    TICKER_COUNT
+};
+
+// Value distributions of a Statistics object; latencies are in nanoseconds
+enum class HistogramType : uint32_t {
+    GET_NANOS,
+    MULTIGET_NANOS,
+    WRITE_NANOS,             // one Put, Delete, DeleteRange or WriteBatch
+    SCAN_NANOS,
+    SST_FILES_PER_GET,       // SSTs read by a Get that missed the memtables
+    FLUSH_NANOS,
+    COMPACTION_NANOS,        // merges only, not trivial moves
+    HISTOGRAM_COUNT
+};
+
+// Summary of one histogram
+struct HistogramData {
+    uint64_t count = 0;
+    uint64_t sum = 0;
+    uint64_t min = 0;
+    uint64_t max = 0;
+    double average = 0;
+    double median = 0;
+    double p95 = 0;
+    double p99 = 0;
+    double p999 = 0;
+};
+
+/*
+ * Lock-free histogram of non-negative integers with log-linear buckets, like
+ * HdrHistogram with one significant digit: values below 16 have a bucket each,
+ * every power of two above is split into 16 equal buckets. Any percentile is
+ * within 1/16 (6.25%) of the true value, whatever the range of the values.
+ */
+class AtomicHistogram {
+public:
+    static constexpr size_t SUB_BUCKETS = 16;
+    static constexpr size_t NUM_BUCKETS = SUB_BUCKETS + (64 - 4) * SUB_BUCKETS;
+
+    void add(uint64_t value);
+    // Interpolated within the bucket holding the p-th percentile (0 <= p <= 100)
+    double percentile(double p) const;
+    HistogramData getData() const;
+    void reset();
+
+    uint64_t count() const {return num.load(std::memory_order_relaxed);};
+    uint64_t sum() const {return total.load(std::memory_order_relaxed);};
+
+    static size_t bucketIndex(uint64_t value);
+    // Smallest value of bucket b; bucketLimit(b) is the first value of the next one
+    static uint64_t bucketStart(size_t b);
+    static uint64_t bucketLimit(size_t b) {return b + 1 < NUM_BUCKETS ? bucketStart(b + 1) : UINT64_MAX;};
+
+private:
+    std::atomic<uint64_t> buckets[NUM_BUCKETS] = {};
+    std::atomic<uint64_t> num{0};
+    std::atomic<uint64_t> total{0};
+    std::atomic<uint64_t> min_{UINT64_MAX};
+    std::atomic<uint64_t> max_{0};
+};
+
+/*
+ * Engine counters and histograms, shared by whoever records into them.
+ *
+ * Updates are relaxed atomic adds (each ticker on its own cache line), so
+ * threads recording at once don't serialize on a lock. A kvdb::API given a
+ * Statistics object (API::SetStatistics) records Get/MultiGet/write/Scan
+ * latencies, memtable hits, SSTs probed, Bloom filter and block cache results,
+ * and flush and compaction times and bytes. Without one nothing is measured.
+ */
+class Statistics {
+public:
+    Statistics() = default;
+    Statistics(const Statistics&) = delete;
+    Statistics& operator=(const Statistics&) = delete;
+
+    void recordTick(Ticker ticker, uint64_t count = 1) {
+        tickers[static_cast<size_t>(ticker)].value.fetch_add(count, std::memory_order_relaxed);
+    };
+    uint64_t getTickerCount(Ticker ticker) const {
+        return tickers[static_cast<size_t>(ticker)].value.load(std::memory_order_relaxed);
+    };
+    void recordInHistogram(HistogramType type, uint64_t value) {
+        histograms[static_cast<size_t>(type)].add(value);
+    };
+    HistogramData getHistogramData(HistogramType type) const {
+        return histograms[static_cast<size_t>(type)].getData();
+    };
+    const AtomicHistogram& getHistogram(HistogramType type) const {
+        return histograms[static_cast<size_t>(type)];
+    };
+
+    // Every ticker ("name COUNT : n") and non-empty histogram, one per line
+    std::string toString() const;
+    // Zero every ticker and histogram; updates racing with the reset may be half counted
+    void reset();
+
+    static const char* tickerName(Ticker ticker);
+    static const char* histogramName(HistogramType type);
+
+private:
+    struct alignas(64) PaddedCounter {
+        std::atomic<uint64_t> value{0};
+    };
+    PaddedCounter tickers[static_cast<size_t>(Ticker::TICKER_COUNT)];
+    AtomicHistogram histograms[static_cast<size_t>(HistogramType::HISTOGRAM_COUNT)];
+};
+
+// Records the nanoseconds from construction to destruction into a histogram; a no-op
+// without a Statistics object (the clock isn't read)
+class StopWatch {
+public:
+    StopWatch(Statistics* statistics, HistogramType type)
+        : statistics(statistics), type(type) {
+        if (statistics) {
+            start = std::chrono::steady_clock::now();
+        }
+    };
+    ~StopWatch() {
+        if (statistics) {
+            statistics->recordInHistogram(type, elapsedNanos());
+        }
+    };
+    StopWatch(const StopWatch&) = delete;
+    StopWatch& operator=(const StopWatch&) = delete;
+
+    uint64_t elapsedNanos() const {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+    };
+
+private:
+    Statistics* statistics;
+    HistogramType type;
+    std::chrono::steady_clock::time_point start;
+};
+
+#endif //STATISTICS_H
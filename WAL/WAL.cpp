@@ -0,0 +1,217 @@
+//
+// Created by Damian Li on 2024-09-19.
+//
+
+#include "WAL.h"
+#include "FileManager.h"
+#include <cctype>
+#include <cerrno>
+#include <cstring>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace {
+    constexpr size_t RECORD_HEADER_SIZE = 2 * sizeof(uint32_t);
+
+    void writeAll(int fd, const char* data, size_t n, const fs::path& path) {
+        while (n > 0) {
+#ifdef _WIN32
+            int written = _write(fd, data, static_cast<unsigned int>(n));
+#else
+            ssize_t written = ::write(fd, data, n);
+#endif
+            if (written < 0) {
+                if (errno == EINTR) continue;
+                throw std::runtime_error("WAL::addRecord() >>>> Failed to write to " + path.string());
+            }
+            data += written;
+            n -= static_cast<size_t>(written);
+        }
+    }
+}
+
+fs::path WAL::logPath(const fs::path& directory, uint64_t number) {
+    return directory / ("WAL_" + std::to_string(number) + ".log");
+}
+
+std::vector<uint64_t> WAL::listLogs(const fs::path& directory) {
+    std::vector<uint64_t> numbers;
+    if (!fs::exists(directory)) {
+        return numbers;
+    }
+    for (const auto& entry : fs::directory_iterator(directory)) {
+        std::string name = entry.path().filename().string();
+        if (name.size() > 8 && name.compare(0, 4, "WAL_") == 0 && name.compare(name.size() - 4, 4, ".log") == 0) {
+            std::string digits = name.substr(4, name.size() - 8);
+            if (std::all_of(digits.begin(), digits.end(), ::isdigit)) {
+                numbers.push_back(std::stoull(digits));
+            }
+        }
+    }
+    std::sort(numbers.begin(), numbers.end());
+    return numbers;
+}
+
+WAL::WAL(const fs::path& file_path) : path(file_path) {
+#ifdef _WIN32
+    fd = _wopen(path.c_str(), _O_WRONLY | _O_CREAT | _O_APPEND | _O_BINARY, _S_IREAD | _S_IWRITE);
+#else
+    fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+#endif
+    if (fd < 0) {
+        throw std::runtime_error("WAL::WAL() >>>> Could not open log file: " + path.string());
+    }
+}
+
+WAL::~WAL() {
+    if (fd < 0) return;
+#ifdef _WIN32
+    _close(fd);
+#else
+    ::close(fd);
+#endif
+}
+
+uint32_t WAL::crc32(const char* data, size_t n) {
+    // CRC-32 (IEEE 802.3), table built on first use
+    static const auto table = [] {
+        std::vector<uint32_t> t(256);
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; ++k) {
+                c = (c & 1) ? 0xEDB88320U ^ (c >> 1) : c >> 1;
+            }
+            t[i] = c;
+        }
+        return t;
+    }();
+    uint32_t crc = 0xFFFFFFFFU;
+    for (size_t i = 0; i < n; ++i) {
+        crc = table[(crc ^ static_cast<uint8_t>(data[i])) & 0xFF] ^ (crc >> 8);
+    }
+    return crc ^ 0xFFFFFFFFU;
+}
+
+void WAL::addRecord(const std::vector<KeyValue>& records) {
+    addRecord(records.data(), records.size());
+}
+
+void WAL::addRecord(const KeyValue* records, size_t count) {
+    if (count == 0) return;
+
+    // Build header and payload in one buffer so the record goes out in one write()
+    std::ostringstream buffer;
+    buffer.write(std::string(RECORD_HEADER_SIZE, '\0').data(), RECORD_HEADER_SIZE);
+    uint32_t num_key_values = static_cast<uint32_t>(count) | SEQUENCED;
+    buffer.write(reinterpret_cast<const char*>(&num_key_values), sizeof(num_key_values));
+    for (size_t i = 0; i < count; ++i) {
+        SerializedKeyValue::serializeSequenced(buffer, records[i]);
+    }
+    std::string record = buffer.str();
+    writeRecord(record);
+}
+
+void WAL::addRecord(const std::string& payload) {
+    std::string record(RECORD_HEADER_SIZE, '\0');
+    record += payload;
+    writeRecord(record);
+}
+
+void WAL::writeRecord(std::string& record) {
+    uint32_t payload_len = record.size() - RECORD_HEADER_SIZE;
+    uint32_t checksum = crc32(record.data() + RECORD_HEADER_SIZE, payload_len);
+    std::memcpy(&record[0], &payload_len, sizeof(payload_len));
+    std::memcpy(&record[sizeof(payload_len)], &checksum, sizeof(checksum));
+
+    writeAll(fd, record.data(), record.size(), path);
+    num_records++;
+}
+
+void WAL::sync() {
+#ifdef _WIN32
+    int rc = _commit(fd);
+#elif defined(__APPLE__)
+    int rc = ::fsync(fd);
+#else
+    int rc = ::fdatasync(fd);
+#endif
+    if (rc != 0) {
+        throw std::runtime_error("WAL::sync() >>>> Failed to sync " + path.string());
+    }
+    num_syncs++;
+}
+
+void WAL::reset() {
+#ifdef _WIN32
+    int rc = _chsize_s(fd, 0);
+#else
+    int rc = ::ftruncate(fd, 0);
+#endif
+    if (rc != 0) {
+        throw std::runtime_error("WAL::reset() >>>> Failed to truncate " + path.string());
+    }
+}
+
+std::vector<std::string> WAL::readRecords(const fs::path& file_path) {
+    std::vector<std::string> payloads;
+    std::ifstream file(file_path, std::ios::binary);
+    if (!file.is_open()) {
+        return payloads;
+    }
+    std::string log((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+    const char* ptr = log.data();
+    const char* end = log.data() + log.size();
+    while (static_cast<size_t>(end - ptr) >= RECORD_HEADER_SIZE) {
+        uint32_t payload_len;
+        uint32_t checksum;
+        std::memcpy(&payload_len, ptr, sizeof(payload_len));
+        std::memcpy(&checksum, ptr + sizeof(payload_len), sizeof(checksum));
+        const char* payload = ptr + RECORD_HEADER_SIZE;
+        // A torn tail (crash in the middle of a write) ends the log
+        if (static_cast<size_t>(end - payload) < payload_len || crc32(payload, payload_len) != checksum) {
+            break;
+        }
+        payloads.emplace_back(payload, payload_len);
+        ptr = payload + payload_len;
+    }
+    return payloads;
+}
+
+std::vector<KeyValue> WAL::replay(const fs::path& file_path) {
+    std::vector<KeyValue> records;
+    for (const std::string& payload : readRecords(file_path)) {
+        if (payload.size() < sizeof(uint32_t)) {
+            break;
+        }
+        const char* p = payload.data();
+        const char* payload_end = payload.data() + payload.size();
+        uint32_t num_key_values;
+        std::memcpy(&num_key_values, p, sizeof(num_key_values));
+        p += sizeof(num_key_values);
+        bool sequenced = num_key_values & SEQUENCED;
+        num_key_values &= ~SEQUENCED;
+        std::vector<KeyValue> batch;
+        try {
+            for (uint32_t i = 0; i < num_key_values; ++i) {
+                batch.push_back(sequenced ? SerializedKeyValue::decodeSequenced(p, payload_end)
+                                          : SerializedKeyValue::decode(p, payload_end).kv);
+            }
+        } catch (const std::runtime_error&) {
+            break;
+        }
+        records.insert(records.end(), batch.begin(), batch.end());
+    }
+    return records;
+}
@@ -0,0 +1,81 @@
+//
+// Created by Damian Li on 2024-09-19.
+//
+
+#ifndef WAL_H
+#define WAL_H
+
+#include "KeyValue.h"
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+// When API::Put makes its WAL record durable
+enum class WALSyncMode {
+    NONE,          // write() only: survives a process crash, not a power loss; concurrent Puts
+                   // are still written as one record
+    PER_WRITE,     // fdatasync after every Put (one record per Put)
+    GROUP_COMMIT   // concurrent Puts are written as one record and share one fdatasync
+};
+
+/*
+ * WAL.log Record Structure
+ * void WAL::addRecord(const std::vector<KeyValue>&)
+ * ==============================================================================
+ * payload_len | crc32(payload) | payload |
+ * ==============================================================================
+ * ---->payload
+ *      ==========================================================================
+ *      num_key_values | (SerializedKeyValue | sequence) | ... |
+ *      ==========================================================================
+ *      The top bit of num_key_values is set when the records carry sequence
+ *      numbers; logs written before sequence numbers replay them as 0.
+ */
+class WAL {
+public:
+    // Log files are named WAL_<number>.log; a higher number holds newer records
+    static fs::path logPath(const fs::path& directory, uint64_t number);
+    // Numbers of the log files in directory, ascending
+    static std::vector<uint64_t> listLogs(const fs::path& directory);
+
+    // Open (or create) the log for appending
+    explicit WAL(const fs::path& file_path);
+    ~WAL();
+    WAL(const WAL&) = delete;
+    WAL& operator=(const WAL&) = delete;
+
+    // Append the records as a single log record with a single write()
+    void addRecord(const std::vector<KeyValue>& records);
+    void addRecord(const KeyValue* records, size_t count);
+    // Append an opaque payload with the same framing (used by the MANIFEST)
+    void addRecord(const std::string& payload);
+    // Make every appended record durable
+    void sync();
+    // Drop every record (their data has been flushed into an SST)
+    void reset();
+
+    // Every record of the log in append order, with its sequence number; stops at the
+    // first torn or corrupted record
+    static std::vector<KeyValue> replay(const fs::path& file_path);
+    // Payload of every record in append order; stops at the first torn or corrupted record
+    static std::vector<std::string> readRecords(const fs::path& file_path);
+    static uint32_t crc32(const char* data, size_t n);
+
+    const fs::path& getPath() const {return path;};
+    uint64_t getNumRecords() const {return num_records;};
+    uint64_t getNumSyncs() const {return num_syncs;};
+
+private:
+    static constexpr uint32_t SEQUENCED = 1u << 31;
+    // Fill in the header of record (header bytes followed by the payload) and append it
+    void writeRecord(std::string& record);
+    fs::path path;
+    int fd = -1;
+    uint64_t num_records = 0;
+    uint64_t num_syncs = 0;
+};
+
+#endif //WAL_H
@@ -0,0 +1,51 @@
+//
+// Created by Damian Li on 2024-09-26.
+//
+
+#ifndef WRITEBATCH_H
+#define WRITEBATCH_H
+
+#include "KeyValue.h"
+#include <vector>
+
+/*
+ * Updates applied together by kvdb::API::Write(): the whole batch is one WAL
+ * record, is admitted into one memtable with a single check and becomes
+ * visible to readers at once. A later Put or Delete of the same key wins.
+ */
+class WriteBatch {
+public:
+    WriteBatch() = default;
+
+    template<typename K, typename V>
+    void Put(K key, V value) {
+        records.emplace_back(key, value);
+    }
+    void Put(const KeyValue& kv) {records.push_back(kv);};
+    template<typename K>
+    void Delete(K key) {
+        records.push_back(KeyValue::Tombstone(KeyValue(key, 0).getKey()));
+    }
+    // Delete every key in [start, end); only records added before it in the batch are affected
+    template<typename K>
+    void DeleteRange(K start, K end) {
+        records.push_back(KeyValue::RangeTombstone(KeyValue(start, 0).getKey(), KeyValue(end, 0).getKey()));
+        range_deletions++;
+    }
+    void Clear() {records.clear(); range_deletions = 0;};
+    // Pre-size for count updates
+    void Reserve(size_t count) {records.reserve(count);};
+
+    size_t Count() const {return records.size();};
+    bool Empty() const {return records.empty();};
+    bool HasRangeDeletions() const {return range_deletions > 0;};
+    // Updates in the order they were added; API::Write stamps their sequence numbers in place
+    const std::vector<KeyValue>& getRecords() const {return records;};
+    std::vector<KeyValue>& getRecords() {return records;};
+
+private:
+    std::vector<KeyValue> records;
+    size_t range_deletions = 0;
+};
+
+#endif //WRITEBATCH_H
@@ -0,0 +1,58 @@
+//
+// Created by Damian Li on 2024-09-25.
+//
+
+#include "WriteBufferManager.h"
+
+WriteBufferManager::WriteBufferManager(size_t buffer_size, bool allow_stall)
+    : buffer_size(buffer_size), allow_stall(allow_stall) {}
+
+void WriteBufferManager::reserveMem(size_t bytes) {
+    memory_used.fetch_add(bytes, std::memory_order_relaxed);
+    memory_active.fetch_add(bytes, std::memory_order_relaxed);
+}
+
+void WriteBufferManager::scheduleFreeMem(size_t bytes) {
+    memory_active.fetch_sub(bytes, std::memory_order_relaxed);
+}
+
+void WriteBufferManager::freeMem(size_t bytes) {
+    memory_used.fetch_sub(bytes, std::memory_order_relaxed);
+    if (allow_stall) {
+        // Take the mutex so a writer between its check and its wait can't miss the wakeup
+        std::lock_guard<std::mutex> lock(stall_mutex);
+        stall_cv.notify_all();
+    }
+}
+
+void WriteBufferManager::setBufferSize(size_t new_size) {
+    buffer_size.store(new_size, std::memory_order_relaxed);
+    std::lock_guard<std::mutex> lock(stall_mutex);
+    stall_cv.notify_all();
+}
+
+bool WriteBufferManager::overBudget() const {
+    return enabled() && memoryUsage() >= getBufferSize();
+}
+
+bool WriteBufferManager::shouldFlush() const {
+    if (!enabled()) {
+        return false;
+    }
+    const size_t size = getBufferSize();
+    const size_t active = mutableMemtableMemoryUsage();
+    if (active >= size - size / 8) {
+        return true;
+    }
+    // Over budget but mostly in immutable memtables: their flushes are what frees memory
+    return memoryUsage() >= size && active >= size / 2;
+}
+
+void WriteBufferManager::maybeStall() {
+    if (!allow_stall || !overBudget()) {
+        return;
+    }
+    num_stalls.fetch_add(1, std::memory_order_relaxed);
+    std::unique_lock<std::mutex> lock(stall_mutex);
+    stall_cv.wait(lock, [this] {return !overBudget();});
+}
@@ -0,0 +1,61 @@
+//
+// Created by Damian Li on 2024-09-25.
+//
+
+#ifndef WRITEBUFFERMANAGER_H
+#define WRITEBUFFERMANAGER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+
+/*
+ * Memtable memory budget shared by every kvdb::API instance it is given to.
+ *
+ * Each database charges the bytes of its memtables here: reserveMem() as the
+ * active memtable grows, scheduleFreeMem() when it becomes immutable and
+ * freeMem() once the immutable memtable is in an SST.
+ *
+ * - shouldFlush(): the active memtables use 7/8 of the budget, or everything
+ *   together is over the budget and the active memtables hold at least half of
+ *   it. A database that sees it flushes its own active memtable.
+ * - With allow_stall, writers block in maybeStall() while the total is over the
+ *   budget, until flushes bring it back under.
+ */
+class WriteBufferManager {
+public:
+    // buffer_size 0 disables the budget (usage is still tracked)
+    explicit WriteBufferManager(size_t buffer_size, bool allow_stall = false);
+    WriteBufferManager(const WriteBufferManager&) = delete;
+    WriteBufferManager& operator=(const WriteBufferManager&) = delete;
+
+    void reserveMem(size_t bytes);
+    // bytes stop counting as active memtable memory (still held until freeMem)
+    void scheduleFreeMem(size_t bytes);
+    void freeMem(size_t bytes);
+
+    bool shouldFlush() const;
+    // Block while the budget is exceeded (only with allow_stall)
+    void maybeStall();
+
+    bool enabled() const {return buffer_size.load(std::memory_order_relaxed) > 0;};
+    size_t getBufferSize() const {return buffer_size.load(std::memory_order_relaxed);};
+    void setBufferSize(size_t new_size);
+    size_t memoryUsage() const {return memory_used.load(std::memory_order_relaxed);};
+    size_t mutableMemtableMemoryUsage() const {return memory_active.load(std::memory_order_relaxed);};
+    uint64_t getNumStalls() const {return num_stalls.load(std::memory_order_relaxed);};
+
+private:
+    std::atomic<size_t> buffer_size;
+    std::atomic<size_t> memory_used{0};
+    std::atomic<size_t> memory_active{0};
+    std::atomic<uint64_t> num_stalls{0};
+    const bool allow_stall;
+    std::mutex stall_mutex;
+    std::condition_variable stall_cv;
+
+    bool overBudget() const;
+};
+
+#endif //WRITEBUFFERMANAGER_H
@@ -2,12 +2,19 @@
 // Created by Damian Li on 2024-08-26.
 //
 #include "api.h"
+#include "PerfContext.h"
 #include <iostream>
 #include <string>
 #include <filesystem> // C++17 lib
+#include <algorithm>
+#include <chrono>
 
 namespace fs = std::filesystem;
 namespace kvdb {
+  static uint64_t nanosSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+  }
+
   /*
    * void API::Open(string)
    *
@@ -22,11 +29,15 @@ namespace kvdb {
 
     // Allocate or reallocate memtable and index
     if (!memtable) {
-      memtable = make_unique<Memtable>();
+      memtable = make_unique<Memtable>(memtable_size, memtable_rep);
+      memtable->setWriteBufferSize(write_buffer_size);
     }
     if (!index) {
       index = make_unique<SSTIndex>();
+      index->setBlockCache(block_cache);
+      index->setStatistics(statistics);
     }
+    memtable->setSnapshotList(snapshot_list);
 
     // c++17 new feature
     // Define the path to the database directory
@@ -48,6 +59,52 @@ namespace kvdb {
     is_open = true;
     // retrieve all SST index
     index->getAllSSTs();
+
+    // Recover the memtables that were not flushed when the database went down, oldest log first
+    last_sequence = index->getLargestSequence();
+    vector<uint64_t> logs = WAL::listLogs(path);
+    for (uint64_t number : logs) {
+      for (const KeyValue& kv : WAL::replay(WAL::logPath(path, number))) {
+        if (memtable->needsFlush(kv)) {
+          flushMemtable();
+        }
+        memtable->insert(kv);
+        last_sequence = std::max(last_sequence, kv.getSequence());
+      }
+    }
+    visible_sequence = last_sequence;
+    // Start a fresh log holding what was recovered, then drop the old ones; openNextWAL()
+    // has synced the directory, so the new log can't go missing once they are gone
+    wal_number = logs.empty() ? 0 : logs.back();
+    openNextWAL();
+    if (memtable->get_currentSize() > 0) {
+      // Replay applies range tombstones by sequence number, whatever the record order
+      vector<KeyValue> records = memtable->getRangeDeletions();
+      vector<KeyValue> entries = memtable->inOrderEntries();
+      records.insert(records.end(), entries.begin(), entries.end());
+      wal->addRecord(records);
+      wal->sync();
+    }
+    for (uint64_t number : logs) {
+      fs::remove(WAL::logPath(path, number));
+    }
+
+    chargeMemtable();
+
+    shutting_down = false;
+    bg_error = nullptr;
+    flush_thread = thread(&API::backgroundFlush, this);
+    if (index->getLoadMode() == SSTLoadMode::BACKGROUND) {
+      warm_up_thread = thread(&API::backgroundWarmUp, this);
+    }
+  }
+
+  API::~API() {
+    stopBackgroundFlush();
+    if (write_buffer_manager) {
+      write_buffer_manager->scheduleFreeMem(mem_charged);
+      write_buffer_manager->freeMem(mem_charged + imm_charged);
+    }
   }
 
   /*
@@ -58,16 +115,24 @@ namespace kvdb {
   void API::Close(){
     check_if_open();
     std::cout << "Closing database " << std::endl;
-    // The close command should transform whatever is in the current Memtable into an SST
-    FlushSSTInfo info = memtable->file_manager.flushToDisk(memtable->getTree()->inOrderFlushToSst());
-    /*
-     *  Insert file into SSTIndex
-     *
-     */
-    if(info.largest_key >= info.smallest_key) {
-      // non-empty SST file
-      index->addSST(info.fileName, info.smallest_key, info.smallest_key);
+    {
+      // Let the background flush finish the immutable memtable first
+      unique_lock<mutex> lock(write_mutex);
+      bg_cv.wait(lock, [this] {return !imm || bg_error;});
+    }
+    stopBackgroundFlush();
+    if (bg_error) {
+      // imm stays in its log for the next Open
+      wal.reset();
+      is_open = false;
+      rethrow_exception(bg_error);
     }
+    // The close command should transform whatever is in the current Memtable into an SST
+    flushMemtable();
+    // Everything logged is now in an SST
+    fs::path log_path = wal->getPath();
+    wal.reset();
+    fs::remove(log_path);
     // set flag
     is_open = false;
   }
@@ -79,82 +144,644 @@ namespace kvdb {
    */
 // inside api.tpp
 
+  /*
+   * void API::write(KeyValue*, size_t)
+   *
+   * Writers queue up; the writer at the front becomes the leader, numbers the
+   * records of the group, appends one WAL record (for the whole queue unless
+   * in PER_WRITE mode), syncs once, applies the records to the memtable in
+   * queue order and wakes the followers. A writer's records (one Put or a whole
+   * WriteBatch) always land in one memtable and become visible together.
+   */
+  void API::write(KeyValue* records, size_t count, bool range_deletion) {
+    StopWatch timer(statistics.get(), HistogramType::WRITE_NANOS);
+    if (statistics) {
+      size_t bytes = 0;
+      for (size_t i = 0; i < count; ++i) {
+        bytes += records[i].byteSize();
+      }
+      statistics->recordTick(Ticker::NUMBER_KEYS_WRITTEN, count);
+      statistics->recordTick(Ticker::BYTES_WRITTEN, bytes);
+    }
+    if (write_buffer_manager) {
+      write_buffer_manager->maybeStall();
+    }
+    Writer w(records, count, range_deletion);
+    unique_lock<mutex> lock(write_mutex);
+    writers.push_back(&w);
+    while (!w.done && &w != writers.front()) {
+      w.cv.wait(lock);
+      if (w.insert_into) {
+        // The leader hands out the memtable insert of its group (SKIPLIST only)
+        Memtable* table = w.insert_into;
+        w.insert_into = nullptr;
+        lock.unlock();
+        try {
+          table->insert(*w.records);
+        } catch (...) {
+          w.error = current_exception();
+        }
+        lock.lock();
+        if (--w.leader->pending == 0) {
+          w.leader->cv.notify_one();
+        }
+      }
+    }
+    if (w.done) {
+      // committed by a leader
+      if (w.error) {
+        rethrow_exception(w.error);
+      }
+      return;
+    }
+
+    // Leader: take every queued writer, unless each write has to sync on its own
+    size_t group_size = wal_sync_mode != WALSyncMode::PER_WRITE ? writers.size() : 1;
+    vector<Writer*> group(writers.begin(), writers.begin() + group_size);
+
+    for (Writer* g : group) {
+      for (size_t i = 0; i < g->count; ++i) {
+        g->records[i].setSequence(++last_sequence);
+      }
+    }
+
+    exception_ptr error;
+    try {
+      // Writers arriving meanwhile queue up behind the group
+      lock.unlock();
+      logGroup(group.begin(), group.end());
+      lock.lock();
+
+      bool single_records = all_of(group.begin(), group.end(), [](const Writer* g) {return g->count == 1 && !g->range_deletion;});
+      if (memtable_rep == MemtableRep::SKIPLIST && group_size > 1 && single_records) {
+        insertGroup(lock, w, group);
+        visible_sequence = group.back()->records->getSequence();
+      } else {
+        for (auto it = group.begin(); it != group.end(); ++it) {
+          Writer* g = *it;
+          // One admission check per writer: a batch is never split across memtables
+          bool full = g->count == 1 ? memtable->needsFlush(*g->records) : memtable->isFull();
+          if (full) {
+            switchMemtable(lock);
+            // The rest of the group is only in imm's log, which goes away with imm: log it again
+            logGroup(it, group.end());
+          }
+          if (g->count == 1) {
+            memtable->insert(*g->records);
+          } else {
+            memtable->insertBatch(g->records, g->count);
+          }
+          // A switch above may let readers in: the writers before g are visible, not the ones after it
+          visible_sequence = g->records[g->count - 1].getSequence();
+        }
+      }
+      chargeMemtable();
+      if (write_buffer_manager && mem_charged > 0 && write_buffer_manager->shouldFlush()) {
+        // Over the shared budget: hand this memtable to the background flush
+        switchMemtable(lock);
+      }
+    } catch (...) {
+      if (!lock.owns_lock()) {
+        lock.lock();
+      }
+      error = current_exception();
+    }
+
+    for (size_t i = 0; i < group_size; ++i) {
+      Writer* ready = writers.front();
+      writers.pop_front();
+      if (ready != &w) {
+        if (!ready->error) {
+          ready->error = error;
+        }
+        ready->done = true;
+        ready->cv.notify_one();
+      }
+    }
+    if (!writers.empty()) {
+      writers.front()->cv.notify_one();
+    }
+    if (error) {
+      rethrow_exception(error);
+    }
+  }
+
+  void API::logGroup(vector<Writer*>::const_iterator first, vector<Writer*>::const_iterator last) {
+    if (last - first == 1) {
+      wal->addRecord((*first)->records, (*first)->count);
+    } else {
+      vector<KeyValue> records;
+      for (auto it = first; it != last; ++it) {
+        records.insert(records.end(), (*it)->records, (*it)->records + (*it)->count);
+      }
+      wal->addRecord(records);
+    }
+    if (wal_sync_mode != WALSyncMode::NONE) {
+      wal->sync();
+    }
+  }
+
+  void API::insertGroup(unique_lock<mutex>& lock, Writer& leader, const vector<Writer*>& group) {
+    // The memtable size is a soft limit here: the whole group goes into one memtable
+    if (memtable->needsFlush(*group.front()->records)) {
+      switchMemtable(lock);
+      logGroup(group.begin(), group.end());
+    }
+    // The group stays at the front of the queue, so the memtable can't be switched until every insert is done
+    Memtable* table = memtable.get();
+    leader.pending = group.size() - 1;
+    for (size_t i = 1; i < group.size(); ++i) {
+      group[i]->leader = &leader;
+      group[i]->insert_into = table;
+      group[i]->cv.notify_one();
+    }
+    lock.unlock();
+    table->insert(*group.front()->records);
+    lock.lock();
+    leader.cv.wait(lock, [&leader] {return leader.pending == 0;});
+  }
+
+  void API::Write(WriteBatch& batch) {
+    check_if_open();
+    if (batch.Empty()) {
+      return;
+    }
+    write(batch.getRecords().data(), batch.Count(), batch.HasRangeDeletions());
+  }
+
+  shared_ptr<const Snapshot> API::GetSnapshot() {
+    check_if_open();
+    lock_guard<mutex> lock(write_mutex);
+    return snapshot_list->create(visible_sequence);
+  }
+
+  uint64_t API::GetLatestSequenceNumber() {
+    lock_guard<mutex> lock(write_mutex);
+    return visible_sequence;
+  }
+
+  void API::switchMemtable(unique_lock<mutex>& lock) {
+    // Stall only if the previous memtable is still being flushed
+    bg_cv.wait(lock, [this] {return !imm || bg_error;});
+    if (bg_error) {
+      rethrow_exception(bg_error);
+    }
+    chargeMemtable();
+    if (write_buffer_manager) {
+      write_buffer_manager->scheduleFreeMem(mem_charged);
+    }
+    imm_charged = mem_charged;
+    mem_charged = 0;
+    imm = shared_ptr<Memtable>(std::move(memtable));
+    imm_log = wal->getPath();
+    memtable = newMemtable();
+    openNextWAL();
+    bg_cv.notify_all();
+  }
+
+  void API::flushMemtable() {
+    auto start = std::chrono::steady_clock::now();
+    FlushSSTInfo info = file_manager.flushToDisk(memtable->inOrderEntries(snapshot_list->sequences()),
+                                                 memtable->getRangeDeletions());
+    /*
+     *  Insert file into SSTIndex
+     *
+     */
+    if(info.largest_key >= info.smallest_key) {
+      // non-empty SST file
+      index->addSST(info);
+      recordFlush(info, nanosSince(start));
+    }
+    releaseMemtable();
+    memtable = newMemtable();
+  }
+
+  void API::recordFlush(const FlushSSTInfo& info, uint64_t nanos) {
+    if (!statistics) {
+      return;
+    }
+    std::error_code ec;
+    uintmax_t size = fs::file_size(path / info.fileName, ec);
+    statistics->recordTick(Ticker::FLUSH_COUNT);
+    statistics->recordTick(Ticker::FLUSH_BYTES_WRITTEN, ec ? 0 : size);
+    statistics->recordInHistogram(HistogramType::FLUSH_NANOS, nanos);
+  }
+
+  void API::recordRead(const KeyValue& result) {
+    statistics->recordTick(Ticker::NUMBER_KEYS_READ);
+    if (!result.isEmpty()) {
+      statistics->recordTick(Ticker::NUMBER_KEYS_FOUND);
+      statistics->recordTick(Ticker::BYTES_READ, result.byteSize());
+    }
+  }
+
+  void API::chargeMemtable() {
+    if (!write_buffer_manager) {
+      return;
+    }
+    size_t usage = memtable->approximateMemoryUsage();
+    if (usage > mem_charged) {
+      write_buffer_manager->reserveMem(usage - mem_charged);
+      mem_charged = usage;
+    }
+  }
+
+  void API::releaseMemtable() {
+    if (write_buffer_manager) {
+      write_buffer_manager->scheduleFreeMem(mem_charged);
+      write_buffer_manager->freeMem(mem_charged);
+    }
+    mem_charged = 0;
+  }
+
+  void API::SetWriteBufferSize(size_t bytes) {
+    lock_guard<mutex> lock(write_mutex);
+    write_buffer_size = bytes;
+    memtable->setWriteBufferSize(bytes);
+  }
+
+  unique_ptr<Memtable> API::newMemtable() const {
+    auto table = make_unique<Memtable>(memtable_size, memtable_rep);
+    table->setSnapshotList(snapshot_list);
+    table->set_path(path);
+    table->setWriteBufferSize(write_buffer_size);
+    return table;
+  }
+
+  void API::openNextWAL() {
+    wal = make_unique<WAL>(WAL::logPath(path, ++wal_number));
+    // Syncing the log only makes its data durable: its directory entry needs the directory synced
+    FileManager::syncPath(path, true);
+  }
+
+  void API::commitIndexEdit(unique_lock<mutex>& lock, const SSTIndex::PendingEdit& edit) {
+    // The MANIFEST append and sync hold up neither readers nor writers; they keep
+    // reading the current Version until the change is durable
+    lock.unlock();
+    try {
+      index->writeEdit(edit);
+    } catch (...) {
+      lock.lock();
+      throw;
+    }
+    lock.lock();
+    index->publishEdit(edit);
+  }
+
+  void API::backgroundFlush() {
+    unique_lock<mutex> lock(write_mutex);
+    while (true) {
+      bg_cv.wait(lock, [this] {return shutting_down || (!bg_error && (imm || index->needsCompaction()));});
+      if (shutting_down) {
+        return;
+      }
+      exception_ptr error;
+      if (imm) {
+        // imm is read-only from now on: write it without blocking writers and readers
+        shared_ptr<Memtable> table = imm;
+        // Snapshots taken from now on see imm whole: only the current ones need older versions
+        vector<uint64_t> snapshots = snapshot_list->sequences();
+        lock.unlock();
+        auto start = std::chrono::steady_clock::now();
+        FlushSSTInfo info;
+        try {
+          info = file_manager.flushToDisk(table->inOrderEntries(snapshots), table->getRangeDeletions());
+        } catch (...) {
+          error = current_exception();
+        }
+        lock.lock();
+
+        if (!error) {
+          try {
+            commitIndexEdit(lock, index->stageSST(info));
+            recordFlush(info, nanosSince(start));
+          } catch (...) {
+            // imm's log still holds it for the next Open
+            error = current_exception();
+          }
+        }
+        if (!error) {
+          // The MANIFEST has the new SST: imm's log is no longer needed
+          fs::remove(imm_log);
+          imm_log.clear();
+          imm.reset();
+          if (write_buffer_manager) {
+            write_buffer_manager->freeMem(imm_charged);
+          }
+          imm_charged = 0;
+        }
+      } else {
+        // One compaction at a time; a full memtable gets flushed before the next one
+        CompactionJob job = index->pickCompaction();
+        job.snapshots = snapshot_list->sequences();
+        lock.unlock();
+        auto start = std::chrono::steady_clock::now();
+        vector<FlushSSTInfo> outputs;
+        try {
+          outputs = index->runCompaction(job);
+        } catch (...) {
+          error = current_exception();
+        }
+        uint64_t nanos = nanosSince(start);
+        lock.lock();
+
+        if (error) {
+          index->abortCompaction();
+        } else {
+          // The inputs are deleted by the install
+          uint64_t bytes_read = 0;
+          for (const vector<SSTInfo*>* files : {&job.inputs, &job.next_inputs}) {
+            for (const SSTInfo* info : *files) {
+              bytes_read += info->file_size;
+            }
+          }
+          try {
+            commitIndexEdit(lock, index->stageCompaction(job, outputs));
+          } catch (...) {
+            error = current_exception();
+          }
+          if (!error && statistics) {
+            statistics->recordTick(Ticker::COMPACTION_COUNT);
+            if (job.trivial_move) {
+              statistics->recordTick(Ticker::COMPACTION_TRIVIAL_MOVES);
+            } else {
+              uint64_t bytes_written = 0;
+              for (const FlushSSTInfo& output : outputs) {
+                std::error_code ec;
+                uintmax_t size = fs::file_size(path / output.fileName, ec);
+                bytes_written += ec ? 0 : size;
+              }
+              statistics->recordTick(Ticker::COMPACTION_BYTES_READ, bytes_read);
+              statistics->recordTick(Ticker::COMPACTION_BYTES_WRITTEN, bytes_written);
+              statistics->recordInHistogram(HistogramType::COMPACTION_NANOS, nanos);
+            }
+          }
+        }
+      }
+      if (error) {
+        bg_error = error;
+      }
+      bg_cv.notify_all();
+    }
+  }
+
+  void API::SetCompactionOptions(const CompactionOptions& options) {
+    lock_guard<mutex> lock(write_mutex);
+    index->setCompactionOptions(options);
+    bg_cv.notify_all();
+  }
+
+  void API::SetStatistics(shared_ptr<Statistics> stats) {
+    statistics = stats;
+    index->setStatistics(stats);
+    block_cache->setStatistics(std::move(stats));
+  }
+
+  void API::WaitForCompaction() {
+    check_if_open();
+    unique_lock<mutex> lock(write_mutex);
+    bg_cv.wait(lock, [this] {
+      return bg_error || (!imm && !index->isCompacting() && !index->needsCompaction());
+    });
+    if (bg_error) {
+      rethrow_exception(bg_error);
+    }
+  }
+
+  void API::stopBackgroundFlush() {
+    if (!flush_thread.joinable()) {
+      return;
+    }
+    {
+      lock_guard<mutex> lock(write_mutex);
+      shutting_down = true;
+    }
+    bg_cv.notify_all();
+    flush_thread.join();
+    if (warm_up_thread.joinable()) {
+      warm_up_thread.join();
+    }
+  }
+
+  void API::backgroundWarmUp() {
+    static constexpr size_t FILES_PER_ROUND = 16;
+    while (true) {
+      vector<shared_ptr<SSTInfo>> next;
+      {
+        lock_guard<mutex> lock(write_mutex);
+        if (shutting_down) {
+          return;
+        }
+        next = index->nextToWarmUp(FILES_PER_ROUND);
+      }
+      if (next.empty()) {
+        return;
+      }
+      // Reading the filter blocks is file I/O: done without write_mutex. A file loads its
+      // filter once under its own lock, so readers of the file see it complete
+      try {
+        for (const shared_ptr<SSTInfo>& info : next) {
+          index->loadFilter(info.get());
+        }
+      } catch (const std::exception&) {
+        // The lookup that touches the file reports the error
+        return;
+      }
+    }
+  }
+
   /*
    * KeyValue API::Get(KeyValue&)
    *
    * Return the value of a key, return -1 if the key
    * doesn't exist in memtable or SSTs
    */
-  KeyValue API::Get(const KeyValue& keyValue) {
+  KeyValue API::Get(const KeyValue& keyValue, const shared_ptr<const Snapshot>& snapshot) {
     // Check if the database is open
     check_if_open();
+    StopWatch timer(statistics.get(), HistogramType::GET_NANOS);
+    PERF_TIMER_GUARD(db_mutex_lock_nanos);
+    unique_lock<mutex> lock(write_mutex);
+    PERF_TIMER_STOP(db_mutex_lock_nanos);
+    ReadView view = pinReadView(snapshot);
+    KeyValue result;
+    if (!view.mem) {
+      result = memtable->get(keyValue, view.sequence);
+    }
+    lock.unlock();
 
-    // Attempt to get the value from the memtable
-    KeyValue result = memtable->get(keyValue);
+    // Attempt to get the value from the memtable, then from the one being flushed
+    if (result.isEmpty() && view.mem) {
+      result = view.mem->get(keyValue, view.sequence);
+    }
+    if (result.isEmpty() && view.imm) {
+      result = view.imm->get(keyValue, view.sequence);
+    }
+    if (statistics) {
+      statistics->recordTick(result.isEmpty() ? Ticker::MEMTABLE_MISS : Ticker::MEMTABLE_HIT);
+    }
 
     // Check if the returned KeyValue is empty
     if (result.isEmpty()) {
-      // If the result is empty, check in the SSTs
-      result = index->Search(keyValue);
-      if (!result.isEmpty()) {
-          return result;
-      }
+      // If the result is empty, check in the SSTs of the pinned version
+      result = index->Search(keyValue, view.sequence, view.version.get());
     }
 
-    // Return the result (either from memtable or SSTs)
+    // Return the result (either from memtable or SSTs); the newest entry may say the key was deleted
+    if (result.isTombstone()) {
+      result = KeyValue();
+    }
+    if (statistics) {
+      recordRead(result);
+    }
     return result;
   }
 
   /*
-   * set<KeyValue> API::Scan(KeyValue, KeyValue)
+   * vector<KeyValue> API::MultiGet(const vector<KeyValue>&)
    *
-   * Search the memtable and the SSTs.
-   * step 1:
-   *    scan the memtable
-   * step 2:
-   *    scan the SSTs from oldest to youngest
+   * Sort and dedupe the keys, probe the memtables, then look the rest up per
+   * SST so each touched SST and block is read once for the whole batch.
    */
-  set<KeyValue> API::Scan(KeyValue small_key, KeyValue large_key) {
-    set<KeyValue> result;
+  vector<KeyValue> API::MultiGet(const vector<KeyValue>& keys, const shared_ptr<const Snapshot>& snapshot) {
+    check_if_open();
+    StopWatch timer(statistics.get(), HistogramType::MULTIGET_NANOS);
 
-    // step 1:
-    // scan the memtable
-    memtable->Scan(small_key, large_key, result);
+    vector<KeyValue> sorted_keys(keys);
+    std::sort(sorted_keys.begin(), sorted_keys.end());
+    sorted_keys.erase(std::unique(sorted_keys.begin(), sorted_keys.end(),
+        [](const KeyValue& a, const KeyValue& b) { return !(a < b) && !(b < a); }), sorted_keys.end());
 
-    // step 2:
-    // scan the SSTs from youngest to oldest
-    index->Scan(small_key, large_key, result);
+    vector<KeyValue> found(sorted_keys.size());
+    ReadView view;
+    {
+      lock_guard<mutex> lock(write_mutex);
+      view = pinReadView(snapshot);
+      if (!view.mem) {
+        for (size_t i = 0; i < sorted_keys.size(); ++i) {
+          found[i] = memtable->get(sorted_keys[i], view.sequence);
+        }
+      }
+    }
+    for (size_t i = 0; i < sorted_keys.size(); ++i) {
+      if (found[i].isEmpty() && view.mem) {
+        found[i] = view.mem->get(sorted_keys[i], view.sequence);
+      }
+      if (found[i].isEmpty() && view.imm) {
+        found[i] = view.imm->get(sorted_keys[i], view.sequence);
+      }
+      if (statistics) {
+        statistics->recordTick(found[i].isEmpty() ? Ticker::MEMTABLE_MISS : Ticker::MEMTABLE_HIT);
+      }
+    }
+    index->MultiSearch(sorted_keys, found, view.sequence, view.version.get());
 
+    // Back to input order
+    vector<KeyValue> results;
+    results.reserve(keys.size());
+    for (const KeyValue& key : keys) {
+      size_t i = std::lower_bound(sorted_keys.begin(), sorted_keys.end(), key) - sorted_keys.begin();
+      results.push_back(found[i].isTombstone() ? KeyValue() : found[i]);
+      if (statistics) {
+        recordRead(results.back());
+      }
+    }
+    return results;
+  }
+
+  /*
+   * set<KeyValue> API::Scan(KeyValue, KeyValue)
+   *
+   * Stream the range out of a merging iterator over the memtables and the
+   * SSTs; entries arrive in key order with only the newest version of a key.
+   */
+  set<KeyValue> API::Scan(KeyValue small_key, KeyValue large_key, const shared_ptr<const Snapshot>& snapshot) {
+    StopWatch timer(statistics.get(), HistogramType::SCAN_NANOS);
+    set<KeyValue> result;
+    unique_ptr<Iterator> it;
+    {
+      unique_lock<mutex> lock(write_mutex);
+      it = newIterator(lock, &small_key, &large_key, readSequence(snapshot));
+    }
+    for (it->Seek(small_key); it->Valid() && !(large_key < it->kv()); it->Next()) {
+      // in order: appending with the end hint is O(1)
+      result.insert(result.end(), it->kv());
+    }
+    if (statistics) {
+      size_t bytes = 0;
+      for (const KeyValue& kv : result) {
+        bytes += kv.byteSize();
+      }
+      statistics->recordTick(Ticker::NUMBER_SCANS);
+      statistics->recordTick(Ticker::NUMBER_KEYS_SCANNED, result.size());
+      statistics->recordTick(Ticker::BYTES_READ, bytes);
+    }
     return result;
   }
 
-  // helper function
-  void API::set_path(fs::path _path) {
-    path = _path;
-    memtable->set_path(_path);
-    index->set_path(_path);
+  unique_ptr<Iterator> API::NewIterator(const shared_ptr<const Snapshot>& snapshot) {
+    check_if_open();
+    unique_lock<mutex> lock(write_mutex);
+    return newIterator(lock, nullptr, nullptr, readSequence(snapshot));
+  }
 
-    // Construct the full path to the "Index.sst" file
-    fs::path indexFilePath = path / "Index.sst";
+  API::ReadView API::pinReadView(const shared_ptr<const Snapshot>& snapshot) const {
+    ReadView view;
+    view.sequence = readSequence(snapshot);
+    if (memtable->getRep() == MemtableRep::SKIPLIST) {
+      view.mem = memtable;
+    }
+    view.imm = imm;
+    view.version = index->current();
+    return view;
+  }
 
-    // Check if the "Index.sst" file exists
-    if (!fs::exists(indexFilePath)) {
-      // If the file does not exist, create an empty "Index.sst" file
-      std::ofstream outfile(indexFilePath);
-      if (!outfile.is_open()) {
-        throw std::runtime_error("API::set_path()-->> Failed to create Index.sst file at: " + indexFilePath.string());
-      }
-      outfile.close();  // Close the file after creation
-      std::cout << "API::set_path()-->> Created new Index.sst file at: " << indexFilePath << std::endl;
+  unique_ptr<Iterator> API::newIterator(unique_lock<mutex>& lock, const KeyValue* small_key, const KeyValue* large_key,
+                                        uint64_t sequence) {
+    vector<unique_ptr<Iterator>> children;
+    vector<vector<KeyValue>> range_deletions;
+    range_deletions.push_back(memtable->getRangeDeletions());
+    if (memtable->getRep() == MemtableRep::SKIPLIST) {
+      // Readable alongside inserts: entries newer than sequence are skipped
+      children.push_back(Memtable::newIterator(memtable, sequence));
     } else {
-      std::ofstream outfile(indexFilePath);
-      if (outfile.is_open()) {
-        cout << "API::set_path()-->> Existing Index.sst file at: " << indexFilePath << endl;
+      // A red-black tree keeps changing under writers: iterate over a copy of the range
+      vector<KeyValue> entries;
+      if (small_key && large_key) {
+        memtable->Scan(*small_key, *large_key, entries, sequence);
       } else {
-        std::cerr << "API::set_path()-->> Failed to open existed Index.sst file at: " << indexFilePath << std::endl;
+        // newest versions, plus the ones visible at sequence
+        entries = memtable->inOrderEntries({sequence});
       }
-      outfile.close();
+      children.push_back(make_unique<VectorIterator>(std::move(entries)));
     }
+    if (imm) {
+      // Read-only: iterated in place, and kept alive by the iterator
+      range_deletions.push_back(imm->getRangeDeletions());
+      children.push_back(Memtable::newIterator(imm, sequence));
+    }
+    // Opening the SSTs is file I/O: done unlocked, on the files pinned here. SST cursors
+    // hold their mapping, so compactions can't pull files away
+    shared_ptr<const SSTIndex::Version> version = index->current();
+    lock.unlock();
+    index->addIterators(children, range_deletions, small_key, large_key, version.get());
+    return make_unique<MergingIterator>(std::move(children), std::move(range_deletions), sequence);
+  }
+
+  void API::SetBloomFilterBitsPerKey(int bits_per_key) {
+    if (bits_per_key < 0) {
+      throw invalid_argument("API::SetBloomFilterBitsPerKey() >>>> bits_per_key must be >= 0");
+    }
+    file_manager.setBloomBitsPerKey(bits_per_key);
+    index->setBloomBitsPerKey(bits_per_key);
+  }
+
+  // helper function
+  void API::set_path(fs::path _path) {
+    path = _path;
+    memtable->set_path(_path);
+    file_manager.setDirectory(_path);
+    index->set_path(_path);
   }
 
 
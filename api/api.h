@@ -9,7 +9,18 @@
 #include <filesystem> // C++17 lib
 #include <unordered_map>
 #include "SSTIndex.h"
+#include "WAL.h"
+#include "MergingIterator.h"
+#include "WriteBufferManager.h"
+#include "WriteBatch.h"
+#include "Snapshot.h"
+#include "Statistics.h"
 #include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <thread>
 
 namespace fs = std::filesystem;
 using namespace std;
@@ -20,40 +31,195 @@ namespace kvdb {
         API()
                     : memtable_size(1e4),
                       memtable(make_unique<Memtable>(1e4)),
-                      index(make_unique<SSTIndex>())
-        {};
+                      index(make_unique<SSTIndex>()),
+                      block_cache(make_shared<BlockCache>())
+        {index->setBlockCache(block_cache); memtable->setWriteBufferSize(write_buffer_size);};
 
-        API(int memtable_size)
+        // rep selects the memtable data structure; SKIPLIST lets a write group insert in parallel
+        API(int memtable_size, MemtableRep rep = MemtableRep::RED_BLACK_TREE)
                     : memtable_size(memtable_size),
-                      memtable(make_unique<Memtable>(memtable_size)),
-                      index(make_unique<SSTIndex>())
-        {};
-        // destructor
-        ~API() = default;
+                      memtable_rep(rep),
+                      memtable(make_unique<Memtable>(memtable_size, rep)),
+                      index(make_unique<SSTIndex>()),
+                      block_cache(make_shared<BlockCache>())
+        {index->setBlockCache(block_cache); memtable->setWriteBufferSize(write_buffer_size);};
+        // destructor: stops the background flush; an open database is left for WAL recovery
+        ~API();
         void Open(string db_name);
         void Close();
 
 
         Memtable* GetMemtable() const {return memtable.get();};
         int SetMemtableSize(int memtable_size);
+        // Bloom filter bits per key for newly written SSTs, 0 disables filters
+        void SetBloomFilterBitsPerKey(int bits_per_key);
+        int GetBloomFilterBitsPerKey() const {return file_manager.getBloomBitsPerKey();};
+        // Capacity in bytes of the block cache shared by all SSTs (default 8 MB, 0 disables caching)
+        void SetBlockCacheCapacity(size_t capacity_bytes) {block_cache->setCapacity(capacity_bytes);};
+        // Maximum number of SST files kept open (mapped, with parsed index block) at once
+        void SetMaxOpenFiles(size_t max_open_files) {index->setMaxOpenFiles(max_open_files);};
+        // How Open loads the SSTs' filter blocks and handles (default EAGER); call before Open
+        void SetSSTLoadMode(SSTLoadMode mode) {index->setLoadMode(mode);};
+        // Block cache usage and hit/miss counters
+        shared_ptr<BlockCache> GetBlockCache() const {return block_cache;};
+        // When a Put is durable in the write-ahead log (default NONE)
+        void SetWALSyncMode(WALSyncMode mode) {wal_sync_mode = mode;};
+        WALSyncMode GetWALSyncMode() const {return wal_sync_mode;};
+        WAL* GetWAL() const {return wal.get();};
+        // Memory budget of one memtable in bytes (default 64 MB, 0 = entry count only); whichever
+        // of this and memtable_size is reached first makes the memtable full
+        void SetWriteBufferSize(size_t bytes);
+        size_t GetWriteBufferSize() const {return write_buffer_size;};
+        // Budget shared with every other API given the same manager; call before Open
+        void SetWriteBufferManager(shared_ptr<WriteBufferManager> manager) {write_buffer_manager = std::move(manager);};
+        shared_ptr<WriteBufferManager> GetWriteBufferManager() const {return write_buffer_manager;};
+        // Leveled compaction settings (see CompactionOptions), applied by the background thread
+        void SetCompactionOptions(const CompactionOptions& options);
+        // Block until no flush or compaction is pending
+        void WaitForCompaction();
+        SSTIndex* GetIndex() const {return index.get();};
+        // Tickers and latency histograms of this database, see Statistics (nullptr, the default,
+        // measures nothing); one object may be shared by several databases. Call before Open
+        void SetStatistics(shared_ptr<Statistics> stats);
+        shared_ptr<Statistics> GetStatistics() const {return statistics;};
         void IndexCheck();
 
         // update with KeyValue Class
         template<typename K, typename V>
         void Put(K key, V value);
-        KeyValue Get(const KeyValue& keyValue);
-        set<KeyValue> Scan(KeyValue small_key, KeyValue large_key);
+        // Write a tombstone for key: O(1), older versions go away in compaction
+        template<typename K>
+        void Delete(K key);
+        // Delete every key in [start, end) with one range tombstone, whatever the number of keys
+        template<typename K>
+        void DeleteRange(K start, K end);
+        // Apply every update of the batch atomically: one WAL record, one memtable.
+        // The records of batch get their sequence numbers.
+        void Write(WriteBatch& batch);
+        // Read view of the database as of now; reads given the snapshot ignore later writes.
+        // The versions it sees are kept until the last copy of the pointer is gone.
+        shared_ptr<const Snapshot> GetSnapshot();
+        // Empty KeyValue when the key is not found or deleted (as of snapshot, if given)
+        KeyValue Get(const KeyValue& keyValue, const shared_ptr<const Snapshot>& snapshot = nullptr);
+        // Get for many keys at once; results in input order (empty KeyValue when not found)
+        vector<KeyValue> MultiGet(const vector<KeyValue>& keys, const shared_ptr<const Snapshot>& snapshot = nullptr);
+        set<KeyValue> Scan(KeyValue small_key, KeyValue large_key, const shared_ptr<const Snapshot>& snapshot = nullptr);
+        // Iterator over the whole database in key order, newest version of each key;
+        // call Seek()/SeekToFirst() before use. Reads a consistent view taken at creation
+        // (or the snapshot's view), without holding up writers.
+        unique_ptr<Iterator> NewIterator(const shared_ptr<const Snapshot>& snapshot = nullptr);
+        // Sequence number of the last write visible to readers
+        uint64_t GetLatestSequenceNumber();
 
     private:
-        unique_ptr<Memtable> memtable;
+        // Declared before memtable: the constructors initialize them first
+        int memtable_size;
+        MemtableRep memtable_rep = MemtableRep::RED_BLACK_TREE;
+        shared_ptr<Memtable> memtable;  // shared with readers probing it without write_mutex
         unique_ptr<SSTIndex> index;
+        shared_ptr<BlockCache> block_cache;
+        shared_ptr<Statistics> statistics;
+        unique_ptr<WAL> wal;
+        WALSyncMode wal_sync_mode = WALSyncMode::NONE;
+        uint64_t wal_number = 0;
+        // Full memtable waiting for (or being written by) the background flush
+        shared_ptr<Memtable> imm;
+        fs::path imm_log;  // WAL file holding imm's records
+        // Writes every SST of the database
+        FileManager file_manager;
+        thread flush_thread;
+        thread warm_up_thread;  // SSTLoadMode::BACKGROUND: loads the filters Open left out
+        condition_variable bg_cv;  // imm filled / imm flushed / compaction done / shutdown
+        bool shutting_down = false;
+        exception_ptr bg_error;
 
-        int memtable_size;
+        // A Put waiting in the writer queue; the writer at the front commits for the whole group
+        struct Writer {
+            Writer(KeyValue* records, size_t count, bool range_deletion)
+                : records(records), count(count), range_deletion(range_deletion) {};
+            KeyValue* records;  // one Put, or the records of a WriteBatch; stamped by the leader
+            size_t count;
+            bool range_deletion;      // records hold a range tombstone
+            bool done = false;
+            exception_ptr error;
+            condition_variable cv;
+            // SKIPLIST: memtable this follower inserts its own kv into, set by the leader
+            Memtable* insert_into = nullptr;
+            Writer* leader = nullptr;
+            size_t pending = 0;  // leader only: follower inserts not finished yet
+        };
+        // Guards writers, memtable, imm, index and the sequence numbers. Readers hold it only
+        // to pin a ReadView (and to read a red-black tree memtable), not for SST I/O
+        mutex write_mutex;
+        deque<Writer*> writers;
+        // Every record written gets the next sequence number; readers without a snapshot
+        // see up to visible_sequence, which only covers fully inserted writes
+        uint64_t last_sequence = 0;
+        uint64_t visible_sequence = 0;
+        shared_ptr<SnapshotList> snapshot_list = make_shared<SnapshotList>();
+
+        static constexpr size_t DEFAULT_WRITE_BUFFER_SIZE = 64 << 20;
+        size_t write_buffer_size = DEFAULT_WRITE_BUFFER_SIZE;
+        shared_ptr<WriteBufferManager> write_buffer_manager;
+        // Bytes of memtable / imm charged to write_buffer_manager
+        size_t mem_charged = 0;
+        size_t imm_charged = 0;
         fs::path path; // path for store SSTs
         bool is_open = false;
         // helper function: set memtable_size
         void set_memtable_size(int memtable_size);
         void set_path(fs::path);
+        // Stamp the records with sequence numbers, log them in the WAL, then insert them into the memtable
+        void write(KeyValue* records, size_t count, bool range_deletion = false);
+        // Append the records of writers [first, last) as one WAL record, synced per wal_sync_mode
+        void logGroup(vector<Writer*>::const_iterator first, vector<Writer*>::const_iterator last);
+        // Move the full memtable into the imm slot (waiting while it is taken) and start a new memtable and WAL
+        void switchMemtable(unique_lock<mutex>& lock);
+        // Insert a logged group into the memtable, every writer its own record concurrently (SKIPLIST)
+        void insertGroup(unique_lock<mutex>& lock, Writer& leader, const vector<Writer*>& group);
+        // Write the memtable into an SST right away (recovery and Close)
+        void flushMemtable();
+        // Count a flushed SST (no-ops without statistics)
+        void recordFlush(const FlushSSTInfo& info, uint64_t nanos);
+        // Count the lookup of one key and its result
+        void recordRead(const KeyValue& result);
+        // Charge the memtable's growth to write_buffer_manager
+        void chargeMemtable();
+        // Give back the memtable's charge once its contents are in an SST
+        void releaseMemtable();
+        // Empty memtable for this database
+        unique_ptr<Memtable> newMemtable() const;
+        // Start the next log file and sync the directory holding it
+        void openNextWAL();
+        // Write a staged index change to the MANIFEST with lock released, then publish it
+        void commitIndexEdit(unique_lock<mutex>& lock, const SSTIndex::PendingEdit& edit);
+        // Body of flush_thread: writes imm into an SST and frees the slot, then compacts levels over their target
+        void backgroundFlush();
+        // Stops the warm-up too
+        void stopBackgroundFlush();
+        // Body of warm_up_thread: loads filters a few SSTs at a time, picking them under write_mutex
+        // and reading them without it
+        void backgroundWarmUp();
+        // What a read needs, pinned under write_mutex so the read can go on without it
+        struct ReadView {
+            uint64_t sequence = 0;
+            shared_ptr<Memtable> mem;  // the memtable if it is a SKIPLIST; a red-black tree may
+                                       // only be read under write_mutex, so it is left out
+            shared_ptr<Memtable> imm;  // read-only
+            shared_ptr<const SSTIndex::Version> version;
+        };
+        // Call with write_mutex held
+        ReadView pinReadView(const shared_ptr<const Snapshot>& snapshot) const;
+        // Merge of memtable, immutable memtable and SST cursors restricted to [small_key, large_key]
+        // (nullptr = unbounded), as of sequence. Called with lock held; the SSTs are opened after
+        // unlocking it. A SKIPLIST memtable and imm are read in place, only a red-black tree
+        // memtable is copied.
+        unique_ptr<Iterator> newIterator(unique_lock<mutex>& lock, const KeyValue* small_key, const KeyValue* large_key,
+                                         uint64_t sequence);
+        // Sequence a read given snapshot (nullptr = latest) sees; call with write_mutex held
+        uint64_t readSequence(const shared_ptr<const Snapshot>& snapshot) const {
+            return snapshot ? snapshot->getSequence() : visible_sequence;
+        }
         void check_if_open() const {
             if (!is_open) {
                 throw runtime_error("Database is not open. Please open the database before performing operations.");
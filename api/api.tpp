@@ -2,18 +2,26 @@ template<typename K, typename V>
 void kvdb::API::Put(K key, V value) {
     check_if_open();
 
-
     KeyValue kv(key, value);
-    FlushSSTInfo info = memtable->put(kv);
+    // WAL first, then memtable (see API::write)
+    write(&kv, 1);
+}
+
+template<typename K>
+void kvdb::API::Delete(K key) {
+    check_if_open();
 
-    if (!info.largest_key.isEmpty()) {
-        // Handle flush info...
+    KeyValue kv = KeyValue::Tombstone(KeyValue(key, 0).getKey());
+    write(&kv, 1);
+}
 
-        // Debug Purpose :-D
-        // cout << "\n>>>>>> Ready for flushing" << endl;
-        // cout << info->fileName << "'s smallest key: " << info->smallest_key << " and largest key: " << info->largest_key << endl;
+template<typename K>
+void kvdb::API::DeleteRange(K start, K end) {
+    check_if_open();
 
-        // flush happens and safe access info attribute
-          index->addSST(info.fileName, info.smallest_key, info.largest_key);
+    KeyValue range = KeyValue::RangeTombstone(KeyValue(start, 0).getKey(), KeyValue(end, 0).getKey());
+    if (!(range < range.rangeEnd())) {
+        return;  // empty range
     }
+    write(&range, 1, true);
 }
@@ -0,0 +1,297 @@
+//
+// Created by Damian Li on 2024-10-01.
+//
+// Pieces shared by the benchmark drivers: latency histogram, key choosers, flag parsing.
+//
+
+#ifndef BENCHUTIL_H
+#define BENCHUTIL_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <map>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace bench {
+
+using Clock = std::chrono::steady_clock;
+
+inline double microsSince(Clock::time_point start) {
+    return std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+}
+
+/*
+ * Latency histogram in microseconds: buckets growing by 10% from 0.1 us to ~100 s,
+ * so percentiles are within a few percent and histograms of threads can be merged.
+ */
+class Histogram {
+public:
+    Histogram() : buckets(limits().size(), 0) {}
+
+    void add(double micros) {
+        const std::vector<double>& bounds = limits();
+        size_t b = std::upper_bound(bounds.begin(), bounds.end() - 1, micros) - bounds.begin();
+        buckets[b]++;
+        min_ = std::min(min_, micros);
+        max_ = std::max(max_, micros);
+        num++;
+        sum += micros;
+    }
+
+    void merge(const Histogram& other) {
+        for (size_t b = 0; b < buckets.size(); ++b) {
+            buckets[b] += other.buckets[b];
+        }
+        min_ = std::min(min_, other.min_);
+        max_ = std::max(max_, other.max_);
+        num += other.num;
+        sum += other.sum;
+    }
+
+    uint64_t count() const {return num;}
+    double average() const {return num == 0 ? 0 : sum / num;}
+    double min() const {return num == 0 ? 0 : min_;}
+    double max() const {return max_;}
+
+    // Interpolated within the bucket holding the p-th percentile (0 <= p <= 100)
+    double percentile(double p) const {
+        const std::vector<double>& bounds = limits();
+        double threshold = num * (p / 100.0);
+        uint64_t seen = 0;
+        for (size_t b = 0; b < buckets.size(); ++b) {
+            if (buckets[b] == 0) continue;
+            if (seen + buckets[b] >= threshold) {
+                double left = b == 0 ? 0 : bounds[b - 1];
+                double right = bounds[b];
+                double pos = (threshold - seen) / buckets[b];
+                double value = left + (right - left) * pos;
+                return std::min(std::max(value, min_), max_);
+            }
+            seen += buckets[b];
+        }
+        return max_;
+    }
+
+    // One line: count, average and the usual percentiles
+    std::string summary() const {
+        char line[256];
+        std::snprintf(line, sizeof(line),
+                      "count %llu  avg %.2f  p50 %.2f  p95 %.2f  p99 %.2f  p99.9 %.2f  max %.2f (us)",
+                      static_cast<unsigned long long>(num), average(), percentile(50), percentile(95),
+                      percentile(99), percentile(99.9), max());
+        return line;
+    }
+
+    // summary() and the non-empty buckets with their share and cumulative share
+    std::string toString() const {
+        const std::vector<double>& bounds = limits();
+        std::ostringstream out;
+        out << summary() << '\n';
+        uint64_t seen = 0;
+        for (size_t b = 0; b < buckets.size(); ++b) {
+            if (buckets[b] == 0) continue;
+            seen += buckets[b];
+            char line[128];
+            std::snprintf(line, sizeof(line), "  [%10.2f, %10.2f) %10llu %7.3f%% %7.3f%%\n",
+                          b == 0 ? 0.0 : bounds[b - 1], bounds[b], static_cast<unsigned long long>(buckets[b]),
+                          100.0 * buckets[b] / num, 100.0 * seen / num);
+            out << line;
+        }
+        return out.str();
+    }
+
+private:
+    static const std::vector<double>& limits() {
+        static const std::vector<double> bounds = [] {
+            std::vector<double> v;
+            for (double limit = 0.1; limit < 1e8; limit *= 1.1) {
+                v.push_back(limit);
+            }
+            v.push_back(1e300);  // everything slower
+            return v;
+        }();
+        return bounds;
+    }
+
+    std::vector<uint64_t> buckets;
+    double min_ = 1e300;
+    double max_ = 0;
+    uint64_t num = 0;
+    double sum = 0;
+};
+
+/*
+ * Key choosers: next() returns a key index in [0, n)
+ */
+class KeyChooser {
+public:
+    virtual ~KeyChooser() = default;
+    virtual uint64_t next(std::mt19937_64& rng) = 0;
+};
+
+class UniformChooser : public KeyChooser {
+public:
+    explicit UniformChooser(uint64_t n) : dist(0, n - 1) {}
+    uint64_t next(std::mt19937_64& rng) override {return dist(rng);}
+private:
+    std::uniform_int_distribution<uint64_t> dist;
+};
+
+// Every thread walks [0, n) in order from its own start
+class SequentialChooser : public KeyChooser {
+public:
+    SequentialChooser(uint64_t n, uint64_t start) : n(n), current(start % n) {}
+    uint64_t next(std::mt19937_64&) override {
+        uint64_t key = current;
+        current = current + 1 == n ? 0 : current + 1;
+        return key;
+    }
+private:
+    uint64_t n;
+    uint64_t current;
+};
+
+// Zipfian over [0, n): item 0 is the most popular (Gray et al., "Quickly Generating
+// Billion-Record Synthetic Databases", as used by YCSB)
+class ZipfianChooser : public KeyChooser {
+public:
+    static constexpr double DEFAULT_THETA = 0.99;
+
+    ZipfianChooser(uint64_t n, double theta = DEFAULT_THETA)
+        : theta(theta), alpha(1.0 / (1.0 - theta)), zeta2(zetaRange(0, 2, theta)) {
+        resize(n);
+    }
+    uint64_t next(std::mt19937_64& rng) override {
+        double u = std::uniform_real_distribution<double>(0, 1)(rng);
+        double uz = u * zetan;
+        if (uz < 1.0) return 0;
+        if (uz < 1.0 + std::pow(0.5, theta)) return std::min<uint64_t>(1, n - 1);
+        return std::min<uint64_t>(n - 1, static_cast<uint64_t>(n * std::pow(eta * u - eta + 1, alpha)));
+    }
+    // Over [0, n) from now on; growing only adds the terms of the new items to zeta
+    void resize(uint64_t new_n) {
+        new_n = std::max<uint64_t>(new_n, 1);
+        zetan = new_n >= n ? zetan + zetaRange(n, new_n, theta) : zetaRange(0, new_n, theta);
+        n = new_n;
+        eta = (1 - std::pow(2.0 / n, 1 - theta)) / (1 - zeta2 / zetan);
+    }
+    uint64_t size() const {return n;}
+private:
+    // Sum of 1 / i^theta for i in (from, to]
+    static double zetaRange(uint64_t from, uint64_t to, double theta) {
+        double sum = 0;
+        for (uint64_t i = from + 1; i <= to; ++i) {
+            sum += 1 / std::pow(static_cast<double>(i), theta);
+        }
+        return sum;
+    }
+    uint64_t n = 0;
+    double theta;
+    double alpha;
+    double zeta2;
+    double zetan = 0;
+    double eta = 0;
+};
+
+// 64-bit FNV-1a of the 8 bytes of v
+inline uint64_t fnvHash64(uint64_t v) {
+    uint64_t hash = 0xCBF29CE484222325ULL;
+    for (int i = 0; i < 8; ++i) {
+        hash ^= v & 0xFF;
+        hash *= 1099511628211ULL;
+        v >>= 8;
+    }
+    return hash;
+}
+
+// Zipfian popularity, with the popular items spread over [0, n) instead of at the front
+class ScrambledZipfianChooser : public KeyChooser {
+public:
+    ScrambledZipfianChooser(uint64_t n, double theta = ZipfianChooser::DEFAULT_THETA) : n(n), zipfian(n, theta) {}
+    uint64_t next(std::mt19937_64& rng) override {return fnvHash64(zipfian.next(rng)) % n;}
+private:
+    uint64_t n;
+    ZipfianChooser zipfian;
+};
+
+// Zipfian over the items inserted so far, the most recent one the most popular (YCSB
+// "latest"); *count is the number of items, which inserts by any thread keep raising
+class LatestChooser : public KeyChooser {
+public:
+    LatestChooser(const std::atomic<uint64_t>* count, double theta = ZipfianChooser::DEFAULT_THETA)
+        : count(count), zipfian(count->load(), theta) {}
+    uint64_t next(std::mt19937_64& rng) override {
+        uint64_t n = std::max<uint64_t>(count->load(std::memory_order_relaxed), 1);
+        if (n != zipfian.size()) {
+            zipfian.resize(n);
+        }
+        return n - 1 - zipfian.next(rng);
+    }
+private:
+    const std::atomic<uint64_t>* count;
+    ZipfianChooser zipfian;
+};
+
+/*
+ * --name=value command line flags
+ */
+class Flags {
+public:
+    Flags(int argc, char** argv) {
+        for (int i = 1; i < argc; ++i) {
+            std::string arg = argv[i];
+            size_t eq = arg.find('=');
+            if (arg.compare(0, 2, "--") != 0 || eq == std::string::npos) {
+                throw std::invalid_argument("Flags::Flags() >>>> Expected --name=value, got " + arg);
+            }
+            values[arg.substr(2, eq - 2)] = arg.substr(eq + 1);
+        }
+    }
+    std::string getString(const std::string& name, const std::string& fallback) {
+        known.push_back(name);
+        auto it = values.find(name);
+        return it == values.end() ? fallback : it->second;
+    }
+    long long getInt(const std::string& name, long long fallback) {
+        std::string value = getString(name, "");
+        return value.empty() ? fallback : std::stoll(value);
+    }
+    double getDouble(const std::string& name, double fallback) {
+        std::string value = getString(name, "");
+        return value.empty() ? fallback : std::stod(value);
+    }
+    // Throws on a flag no get*() asked for (a typo would silently run the defaults)
+    void checkUnknown() const {
+        for (const auto& entry : values) {
+            if (std::find(known.begin(), known.end(), entry.first) == known.end()) {
+                throw std::invalid_argument("Flags::checkUnknown() >>>> Unknown flag --" + entry.first);
+            }
+        }
+    }
+private:
+    std::map<std::string, std::string> values;
+    std::vector<std::string> known;
+};
+
+// Silences std::cout (API::Open/Close report progress there) for its lifetime
+class QuietStdout {
+public:
+    QuietStdout() : saved(std::cout.rdbuf(discard.rdbuf())) {}
+    ~QuietStdout() {std::cout.rdbuf(saved);}
+private:
+    std::ostringstream discard;
+    std::streambuf* saved;
+};
+
+}  // namespace bench
+
+#endif //BENCHUTIL_H
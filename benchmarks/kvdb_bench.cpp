@@ -0,0 +1,473 @@
+//
+// Created by Damian Li on 2024-10-01.
+//
+// db_bench-style workloads against kvdb::API, reporting ops/sec, MB/s and latency percentiles.
+//
+// usage: kvdb_bench [--flag=value ...]   (configure with -DCMAKE_BUILD_TYPE=Release)
+//
+//   --benchmarks=fillseq,fillrandom,overwrite,readrandom,readmissing,readseq,seekrandom,scanrange,readwhilewriting
+//       fillseq          write num keys in key order into a new database
+//       fillrandom       write num random keys (with repeats) into a new database
+//       overwrite        write num keys picked by --distribution into the existing database
+//       readrandom       Get reads keys picked by --distribution
+//       readmissing      Get reads keys that were never written
+//       readseq          iterate over the database in key order
+//       seekrandom       Seek to a key picked by --distribution, then Next scan_length times
+//       scanrange        Scan of scan_length consecutive keys from a key picked by --distribution
+//       readwhilewriting readrandom on every thread while one more thread keeps overwriting
+//   --num=100000            keys in the database
+//   --reads=-1              operations of the read benchmarks (-1 = num)
+//   --threads=1             client threads; each runs its share of the operations
+//   --key_type=int          int | long | double | string
+//   --key_size=16           string keys: zero-padded decimal of at least this many bytes
+//   --value_type=string     string | int | double
+//   --value_size=100        string values: bytes per value
+//   --distribution=uniform  uniform | zipfian | sequential key choice of the read and overwrite benchmarks
+//   --zipf_theta=0.99
+//   --scan_length=100
+//   --memtable_size=10000   entries per memtable
+//   --memtable_rep=rbtree   rbtree | skiplist
+//   --write_buffer_size=0   bytes per memtable (0 = API default)
+//   --bloom_bits=-1         Bloom filter bits per key (-1 = API default, 0 = off)
+//   --cache_size=-1         block cache bytes (-1 = API default, 0 = off)
+//   --wal_sync=none         none | per_write | group_commit
+//   --wait_for_compaction=1 let flushes and compactions finish (untimed) after each write benchmark
+//   --histogram=0           print the latency buckets, not only the percentiles
+//   --statistics=0          attach a Statistics object to the database and print it at the end
+//   --use_existing_db=0     keep the database from a previous run instead of starting empty
+//   --db=kvdb_bench_db
+//   --seed=301
+//
+
+#include <atomic>
+#include <cinttypes>
+#include <cstdio>
+#include <filesystem>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include "api.h"
+#include "BenchUtil.h"
+
+namespace fs = std::filesystem;
+using namespace bench;
+
+namespace {
+
+    struct Options {
+        std::string benchmarks;
+        uint64_t num;
+        uint64_t reads;
+        int threads;
+        std::string key_type;
+        int key_size;
+        std::string value_type;
+        int value_size;
+        std::string distribution;
+        double zipf_theta;
+        int scan_length;
+        int memtable_size;
+        MemtableRep memtable_rep;
+        size_t write_buffer_size;
+        int bloom_bits;
+        long long cache_size;
+        WALSyncMode wal_sync;
+        bool wait_for_compaction;
+        bool histogram;
+        bool statistics;
+        bool use_existing_db;
+        std::string db;
+        uint64_t seed;
+    };
+
+    Options parseOptions(int argc, char** argv) {
+        Flags flags(argc, argv);
+        Options o;
+        o.benchmarks = flags.getString("benchmarks", "fillseq,fillrandom,overwrite,readrandom,readmissing,"
+                                                     "readseq,seekrandom,scanrange,readwhilewriting");
+        o.num = flags.getInt("num", 100000);
+        long long reads = flags.getInt("reads", -1);
+        o.reads = reads < 0 ? o.num : reads;
+        o.threads = std::max<long long>(1, flags.getInt("threads", 1));
+        o.key_type = flags.getString("key_type", "int");
+        o.key_size = flags.getInt("key_size", 16);
+        o.value_type = flags.getString("value_type", "string");
+        o.value_size = flags.getInt("value_size", 100);
+        o.distribution = flags.getString("distribution", "uniform");
+        o.zipf_theta = flags.getDouble("zipf_theta", ZipfianChooser::DEFAULT_THETA);
+        o.scan_length = flags.getInt("scan_length", 100);
+        o.memtable_size = flags.getInt("memtable_size", 10000);
+        std::string rep = flags.getString("memtable_rep", "rbtree");
+        o.memtable_rep = rep == "skiplist" ? MemtableRep::SKIPLIST : MemtableRep::RED_BLACK_TREE;
+        o.write_buffer_size = flags.getInt("write_buffer_size", 0);
+        o.bloom_bits = flags.getInt("bloom_bits", -1);
+        o.cache_size = flags.getInt("cache_size", -1);
+        std::string sync = flags.getString("wal_sync", "none");
+        o.wal_sync = sync == "per_write" ? WALSyncMode::PER_WRITE
+                   : sync == "group_commit" ? WALSyncMode::GROUP_COMMIT : WALSyncMode::NONE;
+        o.wait_for_compaction = flags.getInt("wait_for_compaction", 1);
+        o.histogram = flags.getInt("histogram", 0);
+        o.statistics = flags.getInt("statistics", 0);
+        o.use_existing_db = flags.getInt("use_existing_db", 0);
+        o.db = flags.getString("db", "kvdb_bench_db");
+        o.seed = flags.getInt("seed", 301);
+        flags.checkUnknown();
+
+        if (o.key_type != "int" && o.key_type != "long" && o.key_type != "double" && o.key_type != "string") {
+            throw std::invalid_argument("kvdb_bench >>>> Unknown --key_type=" + o.key_type);
+        }
+        if (o.value_type != "int" && o.value_type != "double" && o.value_type != "string") {
+            throw std::invalid_argument("kvdb_bench >>>> Unknown --value_type=" + o.value_type);
+        }
+        if (o.distribution != "uniform" && o.distribution != "zipfian" && o.distribution != "sequential") {
+            throw std::invalid_argument("kvdb_bench >>>> Unknown --distribution=" + o.distribution);
+        }
+        if (o.key_type == "int" && 2 * o.num >= INT32_MAX) {
+            throw std::invalid_argument("kvdb_bench >>>> --num too large for int keys, use --key_type=long");
+        }
+        return o;
+    }
+
+    // What the threads of one benchmark did
+    struct Stats {
+        Histogram latency;
+        uint64_t ops = 0;
+        uint64_t bytes = 0;
+        uint64_t found = 0;
+        void merge(const Stats& other) {
+            latency.merge(other.latency);
+            ops += other.ops;
+            bytes += other.bytes;
+            found += other.found;
+        }
+    };
+
+    class Benchmark {
+    public:
+        explicit Benchmark(Options options) : o(std::move(options)) {
+            // Random bytes values are cut from, like db_bench's RandomGenerator
+            std::mt19937_64 rng(o.seed);
+            std::uniform_int_distribution<int> byte(' ', '~');
+            value_data.resize(std::max(1 << 20, 2 * o.value_size));
+            for (char& c : value_data) {
+                c = static_cast<char>(byte(rng));
+            }
+        }
+
+        ~Benchmark() {
+            close();
+        }
+
+        void run() {
+            printHeader();
+            if (!o.use_existing_db) {
+                fs::remove_all(o.db);
+            }
+            open();
+            std::stringstream names(o.benchmarks);
+            std::string name;
+            while (std::getline(names, name, ',')) {
+                if (name.empty()) continue;
+                runBenchmark(name);
+            }
+            close();
+            if (statistics) {
+                std::cout << "\nSTATISTICS:\n" << statistics->toString();
+            }
+        }
+
+    private:
+        Options o;
+        std::unique_ptr<kvdb::API> db;
+        std::shared_ptr<Statistics> statistics;  // --statistics: kept across reopens
+        std::string value_data;
+
+        void open() {
+            db = std::make_unique<kvdb::API>(o.memtable_size, o.memtable_rep);
+            if (o.write_buffer_size > 0) db->SetWriteBufferSize(o.write_buffer_size);
+            if (o.bloom_bits >= 0) db->SetBloomFilterBitsPerKey(o.bloom_bits);
+            if (o.cache_size >= 0) db->SetBlockCacheCapacity(o.cache_size);
+            db->SetWALSyncMode(o.wal_sync);
+            if (o.statistics) {
+                if (!statistics) statistics = std::make_shared<Statistics>();
+                db->SetStatistics(statistics);
+            }
+            QuietStdout quiet;
+            db->Open(o.db);
+        }
+
+        void close() {
+            if (db) {
+                QuietStdout quiet;
+                db->Close();
+                db.reset();
+            }
+        }
+
+        // Key index i as a key of --key_type; indexes start at 1 (an int key 0 reads as empty)
+        KeyValue::KeyType key(uint64_t i) const {
+            i += 1;
+            if (o.key_type == "int") return static_cast<int>(i);
+            if (o.key_type == "long") return static_cast<long long>(i);
+            if (o.key_type == "double") return static_cast<double>(i) + 0.5;
+            char buf[64];
+            std::snprintf(buf, sizeof(buf), "%0*" PRIu64, o.key_size, i);
+            return std::string(buf);
+        }
+
+        size_t keyBytes() const {
+            if (o.key_type == "int") return sizeof(int);
+            if (o.key_type == "string") return std::max<size_t>(o.key_size, 1);
+            return 8;
+        }
+
+        KeyValue::ValueType value(std::mt19937_64& rng) const {
+            if (o.value_type == "int") return static_cast<int>(rng() >> 33) + 1;
+            if (o.value_type == "double") return std::uniform_real_distribution<double>(1, 1e6)(rng);
+            size_t offset = rng() % (value_data.size() - o.value_size + 1);
+            return value_data.substr(offset, o.value_size);
+        }
+
+        size_t valueBytes() const {
+            if (o.value_type == "int") return sizeof(int);
+            if (o.value_type == "double") return sizeof(double);
+            return o.value_size;
+        }
+
+        std::unique_ptr<KeyChooser> chooser(const std::string& distribution, uint64_t thread) const {
+            if (distribution == "zipfian") return std::make_unique<ZipfianChooser>(o.num, o.zipf_theta);
+            if (distribution == "sequential") return std::make_unique<SequentialChooser>(o.num, thread * o.num / o.threads);
+            return std::make_unique<UniformChooser>(o.num);
+        }
+
+        // Run body on num_threads threads started together; the wall time goes to elapsed
+        Stats runThreads(int num_threads, const std::function<void(int, Stats&)>& body, double& elapsed) {
+            std::vector<Stats> stats(num_threads);
+            std::vector<std::thread> threads;
+            std::mutex error_mutex;
+            std::exception_ptr error;
+            Clock::time_point start = Clock::now();
+            for (int t = 0; t < num_threads; ++t) {
+                threads.emplace_back([&, t] {
+                    try {
+                        body(t, stats[t]);
+                    } catch (...) {
+                        std::lock_guard<std::mutex> lock(error_mutex);
+                        error = std::current_exception();
+                    }
+                });
+            }
+            for (std::thread& thread : threads) {
+                thread.join();
+            }
+            elapsed = microsSince(start);
+            if (error) {
+                std::rethrow_exception(error);
+            }
+            Stats total;
+            for (const Stats& s : stats) {
+                total.merge(s);
+            }
+            return total;
+        }
+
+        // Operations of thread t when total are split over the threads
+        uint64_t share(uint64_t total, int t) const {
+            return total / o.threads + (static_cast<uint64_t>(t) < total % o.threads ? 1 : 0);
+        }
+
+        void write(uint64_t index, std::mt19937_64& rng, Stats& s) {
+            KeyValue::KeyType k = key(index);
+            KeyValue::ValueType v = value(rng);
+            Clock::time_point start = Clock::now();
+            db->Put(k, v);
+            s.latency.add(microsSince(start));
+            s.ops++;
+            s.bytes += keyBytes() + valueBytes();
+        }
+
+        void read(uint64_t index, Stats& s) {
+            KeyValue k(key(index), 0);
+            Clock::time_point start = Clock::now();
+            KeyValue result = db->Get(k);
+            s.latency.add(microsSince(start));
+            s.ops++;
+            if (!result.isEmpty()) {
+                s.found++;
+                s.bytes += keyBytes() + valueBytes();
+            }
+        }
+
+        void runBenchmark(const std::string& name) {
+            Stats stats;
+            double elapsed = 0;
+            std::string message;
+            bool writes = false;
+
+            if (name == "fillseq" || name == "fillrandom") {
+                // Always into an empty database
+                close();
+                fs::remove_all(o.db);
+                open();
+                writes = true;
+                bool sequential = name == "fillseq";
+                stats = runThreads(o.threads, [&](int t, Stats& s) {
+                    std::mt19937_64 rng(o.seed + t);
+                    UniformChooser random(o.num);
+                    uint64_t n = share(o.num, t);
+                    for (uint64_t i = 0; i < n; ++i) {
+                        // fillseq: thread t writes keys t, t + threads, ... in order
+                        write(sequential ? i * o.threads + t : random.next(rng), rng, s);
+                    }
+                }, elapsed);
+            } else if (name == "overwrite") {
+                writes = true;
+                stats = runThreads(o.threads, [&](int t, Stats& s) {
+                    std::mt19937_64 rng(o.seed + t);
+                    std::unique_ptr<KeyChooser> keys = chooser(o.distribution, t);
+                    for (uint64_t i = 0, n = share(o.num, t); i < n; ++i) {
+                        write(keys->next(rng), rng, s);
+                    }
+                }, elapsed);
+            } else if (name == "readrandom" || name == "readmissing") {
+                bool missing = name == "readmissing";
+                stats = runThreads(o.threads, [&](int t, Stats& s) {
+                    std::mt19937_64 rng(o.seed + t);
+                    std::unique_ptr<KeyChooser> keys = chooser(o.distribution, t);
+                    for (uint64_t i = 0, n = share(o.reads, t); i < n; ++i) {
+                        // Missing keys: indexes past the ones ever written
+                        read(keys->next(rng) + (missing ? o.num : 0), s);
+                    }
+                }, elapsed);
+                message = std::to_string(stats.found) + " of " + std::to_string(stats.ops) + " found";
+            } else if (name == "readseq") {
+                stats = runThreads(o.threads, [&](int t, Stats& s) {
+                    std::unique_ptr<Iterator> it = db->NewIterator();
+                    it->SeekToFirst();
+                    for (uint64_t i = 0, n = share(o.reads, t); i < n; ++i) {
+                        Clock::time_point start = Clock::now();
+                        if (!it->Valid()) {
+                            it->SeekToFirst();
+                            if (!it->Valid()) break;
+                        }
+                        it->Next();
+                        s.latency.add(microsSince(start));
+                        s.ops++;
+                        s.bytes += keyBytes() + valueBytes();
+                    }
+                }, elapsed);
+            } else if (name == "seekrandom" || name == "scanrange") {
+                bool iterator = name == "seekrandom";
+                stats = runThreads(o.threads, [&](int t, Stats& s) {
+                    std::mt19937_64 rng(o.seed + t);
+                    std::unique_ptr<KeyChooser> keys = chooser(o.distribution, t);
+                    for (uint64_t i = 0, n = share(o.reads, t); i < n; ++i) {
+                        uint64_t first = keys->next(rng);
+                        size_t entries = 0;
+                        Clock::time_point start = Clock::now();
+                        if (iterator) {
+                            std::unique_ptr<Iterator> it = db->NewIterator();
+                            it->Seek(KeyValue(key(first), 0));
+                            for (; it->Valid() && entries < static_cast<size_t>(o.scan_length); it->Next()) {
+                                entries++;
+                            }
+                        } else {
+                            entries = db->Scan(KeyValue(key(first), 0), KeyValue(key(first + o.scan_length - 1), 0)).size();
+                        }
+                        s.latency.add(microsSince(start));
+                        s.ops++;
+                        s.found += entries;
+                        s.bytes += entries * (keyBytes() + valueBytes());
+                    }
+                }, elapsed);
+                message = std::to_string(stats.found / std::max<uint64_t>(stats.ops, 1)) + " entries per op";
+            } else if (name == "readwhilewriting") {
+                // Readers on --threads threads, timed; one writer overwriting until they are done
+                std::atomic<bool> done(false);
+                Stats writer;
+                std::thread writer_thread([&] {
+                    std::mt19937_64 rng(o.seed + o.threads);
+                    UniformChooser keys(o.num);
+                    while (!done.load(std::memory_order_relaxed)) {
+                        write(keys.next(rng), rng, writer);
+                    }
+                });
+                try {
+                    stats = runThreads(o.threads, [&](int t, Stats& s) {
+                        std::mt19937_64 rng(o.seed + t);
+                        std::unique_ptr<KeyChooser> keys = chooser(o.distribution, t);
+                        for (uint64_t i = 0, n = share(o.reads, t); i < n; ++i) {
+                            read(keys->next(rng), s);
+                        }
+                    }, elapsed);
+                } catch (...) {
+                    done = true;
+                    writer_thread.join();
+                    throw;
+                }
+                done = true;
+                writer_thread.join();
+                char writes[96];
+                std::snprintf(writes, sizeof(writes), ", %" PRIu64 " writes, write p99 %.2f us",
+                              writer.ops, writer.latency.percentile(99));
+                message = std::to_string(stats.found) + " of " + std::to_string(stats.ops) + " found" + writes;
+            } else {
+                std::cerr << "Unknown benchmark '" << name << "'" << std::endl;
+                return;
+            }
+
+            report(name, stats, elapsed, message);
+            if (writes && o.wait_for_compaction) {
+                db->WaitForCompaction();
+            }
+        }
+
+        void report(const std::string& name, const Stats& stats, double elapsed_micros, const std::string& message) {
+            double seconds = elapsed_micros / 1e6;
+            double ops_per_sec = seconds > 0 ? stats.ops / seconds : 0;
+            double mb_per_sec = seconds > 0 ? stats.bytes / 1048576.0 / seconds : 0;
+            // Latency per operation as seen by one thread
+            double micros_per_op = stats.ops > 0 ? elapsed_micros * o.threads / stats.ops : 0;
+            std::printf("%-16s : %11.3f micros/op %10.0f ops/sec %8.1f MB/s", name.c_str(), micros_per_op,
+                        ops_per_sec, mb_per_sec);
+            if (!message.empty()) {
+                std::printf("  (%s)", message.c_str());
+            }
+            std::printf("\n%-16s   %s\n", "", stats.latency.summary().c_str());
+            if (o.histogram) {
+                std::printf("%s\n", stats.latency.toString().c_str());
+            }
+            std::fflush(stdout);
+        }
+
+        void printHeader() const {
+            std::printf("Keys:       %" PRIu64 " (%s, %zu bytes each)\n", o.num, o.key_type.c_str(), keyBytes());
+            std::printf("Values:     %s, %zu bytes each\n", o.value_type.c_str(), valueBytes());
+            std::printf("Reads:      %" PRIu64 " (%s", o.reads, o.distribution.c_str());
+            if (o.distribution == "zipfian") std::printf(", theta %.2f", o.zipf_theta);
+            std::printf(")\n");
+            std::printf("Threads:    %d\n", o.threads);
+            std::printf("Memtable:   %d entries, %s\n", o.memtable_size,
+                        o.memtable_rep == MemtableRep::SKIPLIST ? "skiplist" : "rbtree");
+#ifndef NDEBUG
+            std::printf("WARNING: built without NDEBUG (configure with -DCMAKE_BUILD_TYPE=Release)\n");
+#endif
+            std::printf("------------------------------------------------\n");
+        }
+    };
+}
+
+int main(int argc, char** argv) {
+    try {
+        Benchmark(parseOptions(argc, argv)).run();
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,217 @@
+//
+// Created by Damian Li on 2024-10-03.
+//
+// Google Benchmark micro-benchmarks of the innermost costs: KeyValue comparison and
+// construction, RedBlackTree insert / lookup / flush, SerializedKeyValue (de)serialization.
+//
+// usage: microbench [--benchmark_filter=<regex>] [--benchmark_repetitions=N] ...
+//
+
+#include <benchmark/benchmark.h>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "FileManager.h"
+#include "KeyValue.h"
+#include "RedBlackTree.h"
+
+namespace {
+
+    // Key types, indexed like KeyValue::KeyValueType
+    enum KeyKind { INT, LONG, DOUBLE, CHAR, STRING };
+    const char* KIND_NAMES[] = {"int", "long", "double", "char", "string"};
+
+    // i-th key of kind; string keys are zero-padded to length bytes, so they sort like i
+    KeyValue::KeyType makeKey(int kind, uint64_t i, size_t length = 16) {
+        switch (kind) {
+            case INT: return static_cast<int>(i);
+            case LONG: return static_cast<long long>(i) << 20;
+            case DOUBLE: return static_cast<double>(i) + 0.5;
+            case CHAR: return static_cast<char>('!' + i % 90);
+            default: {
+                std::string key = std::to_string(i);
+                return std::string(length > key.size() ? length - key.size() : 0, '0') + key;
+            }
+        }
+    }
+
+    // n distinct keys of kind in random order
+    std::vector<KeyValue> shuffledKeys(int kind, size_t n, size_t length = 16) {
+        std::vector<KeyValue> kvs;
+        kvs.reserve(n);
+        for (size_t i = 0; i < n; ++i) {
+            kvs.emplace_back(makeKey(kind, i + 1, length), static_cast<int>(i));
+        }
+        std::shuffle(kvs.begin(), kvs.end(), std::mt19937_64(42));
+        return kvs;
+    }
+
+    /*
+     * KeyValue
+     */
+    // operator< between a key of kind range(0) and a key of kind range(1)
+    void BM_KeyValueLess(benchmark::State& state) {
+        const size_t n = 1024;
+        std::vector<KeyValue> a = shuffledKeys(state.range(0), n);
+        std::vector<KeyValue> b = shuffledKeys(state.range(1), n);
+        size_t i = 0;
+        for (auto _ : state) {
+            benchmark::DoNotOptimize(a[i] < b[i]);
+            i = (i + 1) & (n - 1);
+        }
+        state.SetLabel(std::string(KIND_NAMES[state.range(0)]) + " < " + KIND_NAMES[state.range(1)]);
+    }
+    BENCHMARK(BM_KeyValueLess)
+        ->Args({INT, INT})->Args({LONG, LONG})->Args({DOUBLE, DOUBLE})->Args({CHAR, CHAR})
+        ->Args({STRING, STRING})->Args({INT, DOUBLE})->Args({INT, LONG})->Args({CHAR, INT})
+        ->Args({INT, STRING})->Args({STRING, DOUBLE});
+
+    // Strings sharing a prefix of range(0) bytes: the comparison has to look past it
+    void BM_KeyValueLessCommonPrefix(benchmark::State& state) {
+        std::string prefix(state.range(0), 'k');
+        KeyValue a(prefix + "a", 0);
+        KeyValue b(prefix + "b", 0);
+        for (auto _ : state) {
+            benchmark::DoNotOptimize(a < b);
+            benchmark::DoNotOptimize(b < a);
+        }
+    }
+    BENCHMARK(BM_KeyValueLessCommonPrefix)->Arg(0)->Arg(8)->Arg(64)->Arg(512);
+
+    // KeyValue(const char*, const char*) with a key and a value of range(0) bytes
+    void BM_KeyValueFromCString(benchmark::State& state) {
+        std::string key(state.range(0), 'k');
+        std::string value(state.range(0), 'v');
+        for (auto _ : state) {
+            KeyValue kv(key.c_str(), value.c_str());
+            benchmark::DoNotOptimize(kv);
+        }
+        state.SetBytesProcessed(state.iterations() * 2 * state.range(0));
+    }
+    BENCHMARK(BM_KeyValueFromCString)->RangeMultiplier(8)->Range(8, 4096);
+
+    void BM_KeyValueFromInt(benchmark::State& state) {
+        int i = 0;
+        for (auto _ : state) {
+            KeyValue kv(i, i);
+            ++i;
+            benchmark::DoNotOptimize(kv);
+        }
+    }
+    BENCHMARK(BM_KeyValueFromInt);
+
+    // Copy of a KeyValue with string key and value of range(0) bytes
+    void BM_KeyValueCopy(benchmark::State& state) {
+        KeyValue source(std::string(state.range(0), 'k'), std::string(state.range(0), 'v'));
+        for (auto _ : state) {
+            KeyValue copy(source);
+            benchmark::DoNotOptimize(copy);
+        }
+        state.SetBytesProcessed(state.iterations() * 2 * state.range(0));
+    }
+    BENCHMARK(BM_KeyValueCopy)->RangeMultiplier(8)->Range(8, 4096);
+
+    /*
+     * RedBlackTree
+     */
+    // range(1) keys of kind range(0) inserted into an empty tree
+    void BM_RedBlackTreeInsert(benchmark::State& state) {
+        std::vector<KeyValue> kvs = shuffledKeys(state.range(0), state.range(1));
+        for (auto _ : state) {
+            RedBlackTree tree;
+            for (const KeyValue& kv : kvs) {
+                tree.insert(kv);
+            }
+            benchmark::ClobberMemory();
+        }
+        state.SetItemsProcessed(state.iterations() * kvs.size());
+        state.SetLabel(KIND_NAMES[state.range(0)]);
+    }
+    BENCHMARK(BM_RedBlackTreeInsert)->ArgsProduct({{INT, STRING}, {1 << 10, 1 << 14, 1 << 17}});
+
+    // Lookups of present keys in a tree of range(1) keys of kind range(0)
+    void BM_RedBlackTreeGetValue(benchmark::State& state) {
+        std::vector<KeyValue> kvs = shuffledKeys(state.range(0), state.range(1));
+        RedBlackTree tree;
+        for (const KeyValue& kv : kvs) {
+            tree.insert(kv);
+        }
+        size_t i = 0;
+        for (auto _ : state) {
+            benchmark::DoNotOptimize(tree.getValue(kvs[i]));
+            i = i + 1 == kvs.size() ? 0 : i + 1;
+        }
+        state.SetItemsProcessed(state.iterations());
+        state.SetLabel(KIND_NAMES[state.range(0)]);
+    }
+    BENCHMARK(BM_RedBlackTreeGetValue)->ArgsProduct({{INT, STRING}, {1 << 10, 1 << 14, 1 << 17}});
+
+    // In-order copy of a tree of range(1) keys of kind range(0), as a memtable flush does
+    void BM_RedBlackTreeInOrderFlushToSst(benchmark::State& state) {
+        std::vector<KeyValue> kvs = shuffledKeys(state.range(0), state.range(1));
+        RedBlackTree tree;
+        for (const KeyValue& kv : kvs) {
+            tree.insert(kv);
+        }
+        for (auto _ : state) {
+            benchmark::DoNotOptimize(tree.inOrderFlushToSst());
+        }
+        state.SetItemsProcessed(state.iterations() * kvs.size());
+        state.SetLabel(KIND_NAMES[state.range(0)]);
+    }
+    BENCHMARK(BM_RedBlackTreeInOrderFlushToSst)->ArgsProduct({{INT, STRING}, {1 << 10, 1 << 14, 1 << 17}});
+
+    /*
+     * SerializedKeyValue
+     */
+    // Record with a key of kind range(0) and a string value of range(1) bytes
+    SerializedKeyValue makeRecord(int kind, size_t value_size) {
+        SerializedKeyValue record{KeyValue(makeKey(kind, 12345), std::string(value_size, 'v')), 0};
+        record.kv_checksum = record.calculateChecksum();
+        return record;
+    }
+
+    void BM_SerializedKeyValueSerialize(benchmark::State& state) {
+        SerializedKeyValue record = makeRecord(state.range(0), state.range(1));
+        std::ostringstream out;
+        for (auto _ : state) {
+            out.seekp(0);
+            record.serialize(out);
+        }
+        state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(out.tellp()));
+        state.SetLabel(KIND_NAMES[state.range(0)]);
+    }
+    BENCHMARK(BM_SerializedKeyValueSerialize)->ArgsProduct({{INT, DOUBLE, STRING}, {8, 100, 4096}});
+
+    // From a stream, as the SST and WAL readers did before mapping
+    void BM_SerializedKeyValueDeserialize(benchmark::State& state) {
+        std::ostringstream out;
+        makeRecord(state.range(0), state.range(1)).serialize(out);
+        std::istringstream in(out.str());
+        for (auto _ : state) {
+            in.clear();
+            in.seekg(0);
+            benchmark::DoNotOptimize(SerializedKeyValue::deserialize(in));
+        }
+        state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(out.str().size()));
+        state.SetLabel(KIND_NAMES[state.range(0)]);
+    }
+    BENCHMARK(BM_SerializedKeyValueDeserialize)->ArgsProduct({{INT, DOUBLE, STRING}, {8, 100, 4096}});
+
+    // From mapped bytes, as SSTable block reads do
+    void BM_SerializedKeyValueDecode(benchmark::State& state) {
+        std::ostringstream out;
+        makeRecord(state.range(0), state.range(1)).serialize(out);
+        const std::string bytes = out.str();
+        for (auto _ : state) {
+            const char* ptr = bytes.data();
+            benchmark::DoNotOptimize(SerializedKeyValue::decode(ptr, bytes.data() + bytes.size()));
+        }
+        state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(bytes.size()));
+        state.SetLabel(KIND_NAMES[state.range(0)]);
+    }
+    BENCHMARK(BM_SerializedKeyValueDecode)->ArgsProduct({{INT, DOUBLE, STRING}, {8, 100, 4096}});
+}
+
+BENCHMARK_MAIN();
@@ -0,0 +1,117 @@
+//
+// Created by Damian Li on 2024-09-30.
+//
+// Reopen time of a database with many SSTs, per SSTLoadMode.
+//
+// usage: open_benchmark [num_files = 20000] [keys_per_file = 8]
+//
+
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "api.h"
+#include "FileManager.h"
+#include "Manifest.h"
+
+namespace fs = std::filesystem;
+using Clock = std::chrono::steady_clock;
+
+namespace {
+    const fs::path DB_PATH = "open_benchmark_db";
+
+    double millisSince(Clock::time_point start) {
+        return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    }
+
+    // num_files non-overlapping SSTs in the last level, listed in a single MANIFEST snapshot
+    void createDatabase(int num_files, int keys_per_file) {
+        fs::remove_all(DB_PATH);
+        fs::create_directories(DB_PATH);
+        FileManager fileManager(DB_PATH);
+        VersionEdit snapshot;
+        uint64_t sequence = 0;
+        for (int f = 0; f < num_files; ++f) {
+            std::vector<KeyValue> kvs;
+            for (int k = 0; k < keys_per_file; ++k) {
+                KeyValue kv(f * keys_per_file + k, "value_" + std::to_string(k));
+                kv.setSequence(++sequence);
+                kvs.push_back(kv);
+            }
+            FlushSSTInfo info = fileManager.flushToDisk(kvs);
+            snapshot.new_files.push_back({CompactionOptions().num_levels - 1, info.fileName, info.smallest_key,
+                                          info.largest_key, fs::file_size(DB_PATH / info.fileName), info.largest_sequence});
+        }
+        Manifest manifest(DB_PATH, 1, snapshot);
+    }
+
+    // One row of the report
+    std::string run(const char* name, SSTLoadMode mode, int num_keys) {
+        auto db = std::make_unique<kvdb::API>();
+        db->SetSSTLoadMode(mode);
+        Clock::time_point start = Clock::now();
+        db->Open(DB_PATH.string());
+        double open_ms = millisSince(start);
+
+        std::mt19937 rng(42);
+        std::uniform_int_distribution<int> key(0, num_keys - 1);
+        start = Clock::now();
+        db->Get(KeyValue(key(rng), ""));
+        double first_get_ms = millisSince(start);
+
+        const int gets = 10000;
+        int found = 0;
+        start = Clock::now();
+        for (int i = 0; i < gets; ++i) {
+            found += !db->Get(KeyValue(key(rng), "")).isEmpty();
+        }
+        double get_us = millisSince(start) * 1000 / gets;
+        // No Close(): it would flush the empty memtable into one more SST
+        db.reset();
+
+        std::ostringstream row;
+        row << std::left << std::setw(12) << name << std::right << std::fixed << std::setprecision(2)
+            << std::setw(12) << open_ms << std::setw(16) << first_get_ms
+            << std::setw(14) << get_us << std::setw(10) << found;
+        return row.str();
+    }
+}
+
+int main(int argc, char** argv) {
+    int num_files = argc > 1 ? std::atoi(argv[1]) : 20000;
+    int keys_per_file = argc > 2 ? std::atoi(argv[2]) : 8;
+
+    Clock::time_point start = Clock::now();
+    createDatabase(num_files, keys_per_file);
+    std::cout << "Created " << num_files << " SSTs in " << millisSince(start) << " ms" << std::endl;
+
+    // Open prints progress; keep the table readable
+    std::streambuf* out = std::cout.rdbuf();
+    std::ostringstream discard;
+    auto report = [&](const char* name, SSTLoadMode mode) {
+        std::cout.rdbuf(discard.rdbuf());
+        std::string row;
+        try {
+            row = run(name, mode, num_files * keys_per_file);
+        } catch (...) {
+            std::cout.rdbuf(out);
+            throw;
+        }
+        std::cout.rdbuf(out);
+        std::cout << row << std::endl;
+    };
+    std::cout << std::left << std::setw(12) << "mode" << std::right << std::setw(12) << "open (ms)"
+              << std::setw(16) << "first Get (ms)" << std::setw(14) << "Get (us)" << std::setw(10) << "found" << std::endl;
+    report("EAGER", SSTLoadMode::EAGER);
+    report("LAZY", SSTLoadMode::LAZY);
+    report("BACKGROUND", SSTLoadMode::BACKGROUND);
+
+    fs::remove_all(DB_PATH);
+    return 0;
+}
@@ -0,0 +1,374 @@
+//
+// Created by Damian Li on 2024-10-02.
+//
+// YCSB core workloads against kvdb::API, with per-operation latency histograms.
+//
+// usage: ycsb_bench [--flag=value ...]   (configure with -DCMAKE_BUILD_TYPE=Release)
+//
+//   --workloads=a,b,c,f,d,e   run in this order on one database loaded with --records keys
+//       a  50% read, 50% update                  zipfian
+//       b  95% read,  5% update                  zipfian
+//       c  100% read                             zipfian
+//       d  95% read,  5% insert                  latest
+//       e  95% scan,  5% insert                  zipfian start key, length uniform in [1, max_scan_length]
+//       f  50% read, 50% read-modify-write       zipfian
+//   --records=100000          keys loaded before the first workload
+//   --operations=100000       operations per workload, split over the threads
+//   --threads=4               client threads
+//   --distribution=           uniform | zipfian | latest: replaces the key chooser of every workload
+//   --zipf_theta=0.99
+//   --value_size=100          bytes per value (YCSB's 10 fields of 100 bytes stored as one string)
+//   --max_scan_length=100
+//   --memtable_size=10000     entries per memtable
+//   --memtable_rep=rbtree     rbtree | skiplist
+//   --write_buffer_size=0     bytes per memtable (0 = API default)
+//   --bloom_bits=-1           Bloom filter bits per key (-1 = API default, 0 = off)
+//   --cache_size=-1           block cache bytes (-1 = API default, 0 = off)
+//   --histogram=0             print the latency buckets of every operation type
+//   --db=ycsb_bench_db
+//   --seed=301
+//
+// Keys are "user" followed by the zero-padded key number (YCSB's ordered inserts), so a
+// scan of n records is API::Scan over n consecutive key numbers. Zipfian choices are
+// scrambled over the key space as in YCSB; "latest" favours the most recent inserts, and may
+// pick one still in flight on another thread (counted as not found).
+//
+
+#include <atomic>
+#include <cinttypes>
+#include <cstdio>
+#include <filesystem>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include "api.h"
+#include "BenchUtil.h"
+
+namespace fs = std::filesystem;
+using namespace bench;
+
+namespace {
+
+    enum class Op { READ, UPDATE, INSERT, SCAN, READ_MODIFY_WRITE };
+    const char* opName(Op op) {
+        switch (op) {
+            case Op::READ: return "READ";
+            case Op::UPDATE: return "UPDATE";
+            case Op::INSERT: return "INSERT";
+            case Op::SCAN: return "SCAN";
+            case Op::READ_MODIFY_WRITE: return "READ-MODIFY-WRITE";
+        }
+        return "UNKNOWN";
+    }
+
+    // One of the YCSB core workloads: operation mix and key chooser
+    struct Workload {
+        char name;
+        std::vector<std::pair<Op, double>> mix;  // proportions add up to 1
+        std::string distribution;
+    };
+
+    const std::vector<Workload>& coreWorkloads() {
+        static const std::vector<Workload> workloads = {
+            {'a', {{Op::READ, 0.5}, {Op::UPDATE, 0.5}}, "zipfian"},
+            {'b', {{Op::READ, 0.95}, {Op::UPDATE, 0.05}}, "zipfian"},
+            {'c', {{Op::READ, 1.0}}, "zipfian"},
+            {'d', {{Op::READ, 0.95}, {Op::INSERT, 0.05}}, "latest"},
+            {'e', {{Op::SCAN, 0.95}, {Op::INSERT, 0.05}}, "zipfian"},
+            {'f', {{Op::READ, 0.5}, {Op::READ_MODIFY_WRITE, 0.5}}, "zipfian"},
+        };
+        return workloads;
+    }
+
+    struct Options {
+        std::string workloads;
+        uint64_t records;
+        uint64_t operations;
+        int threads;
+        std::string distribution;
+        double zipf_theta;
+        int value_size;
+        int max_scan_length;
+        int memtable_size;
+        MemtableRep memtable_rep;
+        size_t write_buffer_size;
+        int bloom_bits;
+        long long cache_size;
+        bool histogram;
+        std::string db;
+        uint64_t seed;
+    };
+
+    Options parseOptions(int argc, char** argv) {
+        Flags flags(argc, argv);
+        Options o;
+        o.workloads = flags.getString("workloads", "a,b,c,f,d,e");
+        o.records = std::max<long long>(1, flags.getInt("records", 100000));
+        o.operations = flags.getInt("operations", 100000);
+        o.threads = std::max<long long>(1, flags.getInt("threads", 4));
+        o.distribution = flags.getString("distribution", "");
+        o.zipf_theta = flags.getDouble("zipf_theta", ZipfianChooser::DEFAULT_THETA);
+        o.value_size = flags.getInt("value_size", 100);
+        o.max_scan_length = std::max<long long>(1, flags.getInt("max_scan_length", 100));
+        o.memtable_size = flags.getInt("memtable_size", 10000);
+        std::string rep = flags.getString("memtable_rep", "rbtree");
+        o.memtable_rep = rep == "skiplist" ? MemtableRep::SKIPLIST : MemtableRep::RED_BLACK_TREE;
+        o.write_buffer_size = flags.getInt("write_buffer_size", 0);
+        o.bloom_bits = flags.getInt("bloom_bits", -1);
+        o.cache_size = flags.getInt("cache_size", -1);
+        o.histogram = flags.getInt("histogram", 0);
+        o.db = flags.getString("db", "ycsb_bench_db");
+        o.seed = flags.getInt("seed", 301);
+        flags.checkUnknown();
+        if (!o.distribution.empty() && o.distribution != "uniform" && o.distribution != "zipfian"
+            && o.distribution != "latest") {
+            throw std::invalid_argument("ycsb_bench >>>> Unknown --distribution=" + o.distribution);
+        }
+        return o;
+    }
+
+    // Per-operation latencies of one thread, or of all of them once merged
+    struct Stats {
+        std::map<Op, Histogram> latency;
+        uint64_t ops = 0;
+        uint64_t not_found = 0;
+        void merge(const Stats& other) {
+            for (const auto& entry : other.latency) {
+                latency[entry.first].merge(entry.second);
+            }
+            ops += other.ops;
+            not_found += other.not_found;
+        }
+    };
+
+    class Driver {
+    public:
+        explicit Driver(Options options) : o(std::move(options)) {
+            std::mt19937_64 rng(o.seed);
+            std::uniform_int_distribution<int> byte(' ', '~');
+            value_data.resize(std::max(1 << 20, 2 * o.value_size));
+            for (char& c : value_data) {
+                c = static_cast<char>(byte(rng));
+            }
+        }
+
+        ~Driver() {
+            close();
+        }
+
+        void run() {
+            std::printf("Records:    %" PRIu64 ", %d-byte values\n", o.records, o.value_size);
+            std::printf("Operations: %" PRIu64 " per workload, %d threads\n", o.operations, o.threads);
+            std::printf("Memtable:   %d entries, %s\n", o.memtable_size,
+                        o.memtable_rep == MemtableRep::SKIPLIST ? "skiplist" : "rbtree");
+#ifndef NDEBUG
+            std::printf("WARNING: built without NDEBUG (configure with -DCMAKE_BUILD_TYPE=Release)\n");
+#endif
+            std::printf("------------------------------------------------\n");
+
+            fs::remove_all(o.db);
+            open();
+            load();
+            std::stringstream names(o.workloads);
+            std::string name;
+            while (std::getline(names, name, ',')) {
+                if (name.empty()) continue;
+                auto it = std::find_if(coreWorkloads().begin(), coreWorkloads().end(),
+                                       [&](const Workload& w) {return name.size() == 1 && w.name == name[0];});
+                if (it == coreWorkloads().end()) {
+                    std::cerr << "Unknown workload '" << name << "'" << std::endl;
+                    continue;
+                }
+                runWorkload(*it);
+            }
+            close();
+            fs::remove_all(o.db);
+        }
+
+    private:
+        Options o;
+        std::unique_ptr<kvdb::API> db;
+        std::string value_data;
+        // Keys [0, inserted) have been handed out to inserts (the load, then workloads d and e)
+        std::atomic<uint64_t> inserted{0};
+
+        void open() {
+            db = std::make_unique<kvdb::API>(o.memtable_size, o.memtable_rep);
+            if (o.write_buffer_size > 0) db->SetWriteBufferSize(o.write_buffer_size);
+            if (o.bloom_bits >= 0) db->SetBloomFilterBitsPerKey(o.bloom_bits);
+            if (o.cache_size >= 0) db->SetBlockCacheCapacity(o.cache_size);
+            QuietStdout quiet;
+            db->Open(o.db);
+        }
+
+        void close() {
+            if (db) {
+                QuietStdout quiet;
+                db->Close();
+                db.reset();
+            }
+        }
+
+        static std::string key(uint64_t number) {
+            char buf[32];
+            std::snprintf(buf, sizeof(buf), "user%012" PRIu64, number);
+            return buf;
+        }
+
+        std::string value(std::mt19937_64& rng) const {
+            size_t offset = rng() % (value_data.size() - o.value_size + 1);
+            return value_data.substr(offset, o.value_size);
+        }
+
+        std::unique_ptr<KeyChooser> chooser(const std::string& distribution) const {
+            if (distribution == "uniform") return std::make_unique<UniformChooser>(o.records);
+            if (distribution == "latest") return std::make_unique<LatestChooser>(&inserted, o.zipf_theta);
+            // Over the loaded records, like YCSB's request distribution without insertstart
+            return std::make_unique<ScrambledZipfianChooser>(o.records, o.zipf_theta);
+        }
+
+        // Run body on every thread (started together) with its own Stats; the wall time goes to elapsed
+        Stats runThreads(const std::function<void(int, Stats&)>& body, double& elapsed) {
+            std::vector<Stats> stats(o.threads);
+            std::vector<std::thread> threads;
+            std::mutex error_mutex;
+            std::exception_ptr error;
+            Clock::time_point start = Clock::now();
+            for (int t = 0; t < o.threads; ++t) {
+                threads.emplace_back([&, t] {
+                    try {
+                        body(t, stats[t]);
+                    } catch (...) {
+                        std::lock_guard<std::mutex> lock(error_mutex);
+                        error = std::current_exception();
+                    }
+                });
+            }
+            for (std::thread& thread : threads) {
+                thread.join();
+            }
+            elapsed = microsSince(start);
+            if (error) {
+                std::rethrow_exception(error);
+            }
+            Stats total;
+            for (const Stats& s : stats) {
+                total.merge(s);
+            }
+            return total;
+        }
+
+        uint64_t share(uint64_t total, int t) const {
+            return total / o.threads + (static_cast<uint64_t>(t) < total % o.threads ? 1 : 0);
+        }
+
+        void load() {
+            double elapsed;
+            Stats stats = runThreads([&](int t, Stats& s) {
+                std::mt19937_64 rng(o.seed + t);
+                for (uint64_t i = 0, n = share(o.records, t); i < n; ++i) {
+                    insert(rng, s);
+                }
+            }, elapsed);
+            report("load", stats, elapsed);
+            db->WaitForCompaction();
+        }
+
+        void insert(std::mt19937_64& rng, Stats& s) {
+            uint64_t number = inserted.fetch_add(1);
+            std::string v = value(rng);
+            Clock::time_point start = Clock::now();
+            db->Put(key(number), v);
+            s.latency[Op::INSERT].add(microsSince(start));
+            s.ops++;
+        }
+
+        void runWorkload(const Workload& workload) {
+            const std::string distribution = o.distribution.empty() ? workload.distribution : o.distribution;
+            double elapsed;
+            Stats stats = runThreads([&](int t, Stats& s) {
+                std::mt19937_64 rng(o.seed + 1000 * (workload.name - 'a' + 1) + t);
+                std::unique_ptr<KeyChooser> keys = chooser(distribution);
+                std::uniform_real_distribution<double> coin(0, 1);
+                std::uniform_int_distribution<int> scan_length(1, o.max_scan_length);
+                for (uint64_t i = 0, n = share(o.operations, t); i < n; ++i) {
+                    // Pick the operation by the workload's proportions
+                    double r = coin(rng);
+                    Op op = workload.mix.back().first;
+                    for (const auto& entry : workload.mix) {
+                        if (r < entry.second) {
+                            op = entry.first;
+                            break;
+                        }
+                        r -= entry.second;
+                    }
+                    if (op == Op::INSERT) {
+                        insert(rng, s);
+                        continue;
+                    }
+
+                    uint64_t number = keys->next(rng);
+                    std::string v = op == Op::READ || op == Op::SCAN ? std::string() : value(rng);
+                    int length = op == Op::SCAN ? scan_length(rng) : 0;
+                    Clock::time_point start = Clock::now();
+                    switch (op) {
+                        case Op::READ:
+                            s.not_found += db->Get(KeyValue(key(number), 0)).isEmpty();
+                            break;
+                        case Op::UPDATE:
+                            db->Put(key(number), v);
+                            break;
+                        case Op::SCAN:
+                            db->Scan(KeyValue(key(number), 0), KeyValue(key(number + length - 1), 0));
+                            break;
+                        case Op::READ_MODIFY_WRITE: {
+                            KeyValue current = db->Get(KeyValue(key(number), 0));
+                            s.not_found += current.isEmpty();
+                            db->Put(key(number), v);
+                            break;
+                        }
+                        default:
+                            break;
+                    }
+                    s.latency[op].add(microsSince(start));
+                    s.ops++;
+                }
+            }, elapsed);
+            report(std::string("workload ") + workload.name + " (" + distribution + ")", stats, elapsed);
+            db->WaitForCompaction();
+        }
+
+        void report(const std::string& name, const Stats& stats, double elapsed_micros) {
+            double seconds = elapsed_micros / 1e6;
+            std::printf("%-28s %10.0f ops/sec  %" PRIu64 " ops in %.2f s", name.c_str(),
+                        seconds > 0 ? stats.ops / seconds : 0, stats.ops, seconds);
+            if (stats.not_found > 0) {
+                std::printf("  (%" PRIu64 " reads not found)", stats.not_found);
+            }
+            std::printf("\n");
+            for (const auto& entry : stats.latency) {
+                std::printf("  %-18s %s\n", opName(entry.first), entry.second.summary().c_str());
+                if (o.histogram) {
+                    std::printf("%s", entry.second.toString().c_str());
+                }
+            }
+            std::fflush(stdout);
+        }
+    };
+}
+
+int main(int argc, char** argv) {
+    try {
+        Driver(parseOptions(argc, argv)).run();
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
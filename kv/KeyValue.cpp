@@ -5,6 +5,9 @@
 #include <iostream>
 #include <stdexcept>
 #include <fstream>
+#include <algorithm>
+#include <climits>
+#include <cstring>
 using namespace std;
 // Accessor methods
 KeyValue::KeyType KeyValue::getKey() const {
@@ -23,36 +26,89 @@ KeyValue::KeyValueType KeyValue::getValueType() const {
     return valueType;
 }
 
-// Comparison operator
-bool KeyValue::operator<(const KeyValue& other) const {
-    return std::visit([](auto&& arg1, auto&& arg2) -> bool {
-        using T1 = std::decay_t<decltype(arg1)>;
-        using T2 = std::decay_t<decltype(arg2)>;
+KeyValue KeyValue::Tombstone(const KeyType& key) {
+    KeyValue kv;
+    kv.key = key;
+    kv.keyType = fieldType(key);
+    kv.valueType = KeyValueType::DELETION;
+    kv.cacheKey();
+    return kv;
+}
 
-        if constexpr (std::is_same_v<T1, T2>) {
-            // If both types are the same, compare them normally
-            if constexpr (std::is_arithmetic_v<T1>) {
-                return arg1 < arg2;  // Numeric comparison
-            } else {
-                return arg1 < arg2;  // Lexicographical comparison for strings and chars
-            }
-        } else if constexpr (std::is_arithmetic_v<T1> && std::is_arithmetic_v<T2>) {
-            // Handle mixed numeric type comparisons (e.g., int vs double)
-            return static_cast<double>(arg1) < static_cast<double>(arg2);
-        } else {
-            // If types differ, prioritize numeric vs. string/char comparison
-            if constexpr (std::is_arithmetic_v<T1> && (std::is_same_v<T2, std::string> || std::is_same_v<T2, char>)) {
-                return true;  // Numeric is always smaller than string/char
-            } else if constexpr ((std::is_same_v<T1, std::string> || std::is_same_v<T1, char>) && std::is_arithmetic_v<T2>) {
-                return false;  // String/char is always larger than numeric
-            } else {
-                throw std::invalid_argument("Unsupported type comparison");
+KeyValue KeyValue::RangeTombstone(const KeyType& start, const KeyType& end) {
+    KeyValue kv;
+    kv.key = start;
+    kv.keyType = fieldType(start);
+    kv.value = end;
+    kv.valueType = KeyValueType::RANGE_DELETION;
+    kv.cacheKey();
+    return kv;
+}
+
+KeyValue KeyValue::rangeEnd() const {
+    return KeyValue(value, 0);
+}
+
+bool KeyValue::covers(const KeyValue& kv) const {
+    return !(kv < *this) && keyLess(kv.key, value);
+}
+
+int KeyValue::compareStrings(const KeyValue& other) const {
+    // Bytes as unsigned char, a prefix first, like memcmp
+    return std::get<std::string>(key).compare(std::get<std::string>(other.key));
+}
+
+bool KeyValue::keyLess(const KeyType& a, const KeyType& b) {
+    const std::string* sa = std::get_if<std::string>(&a);
+    const std::string* sb = std::get_if<std::string>(&b);
+    if (!sa && !sb) {
+        uint64_t high_a, low_a, high_b, low_b;
+        encodeNumber(a, high_a, low_a);
+        encodeNumber(b, high_b, low_b);
+        return high_a < high_b || (high_a == high_b && low_a < low_b);
+    }
+    if (!sa || !sb) {
+        return !sa;
+    }
+    return *sa < *sb;
+}
+
+void KeyValue::encodeNumber(const KeyType& field, uint64_t& high, uint64_t& low) {
+    // Mixed numeric types compare as doubles
+    double d = 0;
+    long long remainder = 0;
+    std::visit([&](auto&& arg) {
+        using T = std::decay_t<decltype(arg)>;
+        if constexpr (std::is_arithmetic_v<T>) {
+            d = static_cast<double>(arg);
+            if constexpr (std::is_same_v<T, long long>) {
+                // Past 2^53 several long longs round to the same double: order them by the rest
+                long long base = d >= 0x1p63 ? LLONG_MAX : static_cast<long long>(d);
+                remainder = arg - base;
             }
         }
-    }, this->key, other.getKey());
+    }, field);
+    if (d == 0) {
+        d = 0;  // -0.0 == 0.0
+    }
+    uint64_t bits;
+    std::memcpy(&bits, &d, sizeof(bits));
+    // Positive: set the sign bit; negative: flip every bit. Unsigned order is then numeric order
+    high = (bits >> 63) ? ~bits : bits | (1ULL << 63);
+    low = static_cast<uint64_t>(remainder) ^ (1ULL << 63);
 }
 
-
+void KeyValue::cacheKey() {
+    if (const std::string* str = std::get_if<std::string>(&key)) {
+        keyHigh = 0;
+        for (size_t i = 0; i < 8; ++i) {
+            keyHigh = (keyHigh << 8) | (i < str->size() ? static_cast<unsigned char>((*str)[i]) : 0);
+        }
+        keyLow = 0;
+    } else {
+        encodeNumber(key, keyHigh, keyLow);
+    }
+}
 
 // Define operator> in terms of operator<
 bool KeyValue::operator>(const KeyValue& other) const {
@@ -70,27 +126,9 @@ bool KeyValue::operator>=(const KeyValue& other) const {
 }
 
 // Comparison operator for key equality
-// Only for key
+// Only for key; numbers of different types are equal if their values are
 bool KeyValue::operator==(const KeyValue& other) const {
-    // Compare the keys using std::visit
-    bool keysEqual = std::visit([](auto&& arg1, auto&& arg2) -> bool {
-        using T1 = std::decay_t<decltype(arg1)>;
-        using T2 = std::decay_t<decltype(arg2)>;
-        if constexpr (std::is_same_v<T1, T2>) {
-            return arg1 == arg2;  // Compare if both types are the same
-        } else if constexpr (std::is_arithmetic_v<T1> && std::is_arithmetic_v<T2>) {
-            // Compare different numeric types by casting them to double
-            /*
-             * if type matters, comment else if statement
-             */
-            return static_cast<double>(arg1) == static_cast<double>(arg2);
-        } else {
-            return false;  // Different types are not equal
-        }
-    }, this->key, other.getKey());
-
-    // keys must be equal
-    return keysEqual;
+    return compareKey(other) == 0;
 }
 
 
@@ -111,6 +149,8 @@ std::string KeyValue::keyValueTypeToString(KeyValueType type) {
         case KeyValueType::DOUBLE: return "DOUBLE";
         case KeyValueType::CHAR: return "CHAR";
         case KeyValueType::STRING: return "STRING";
+        case KeyValueType::DELETION: return "DELETION";
+        case KeyValueType::RANGE_DELETION: return "RANGE_DELETION";
         default: return "UNKNOWN";
     }
 }
@@ -131,4 +171,27 @@ bool KeyValue::isEmpty() const {
     }, this->key);
 }
 
+size_t KeyValue::byteSize() const {
+    auto bytes = [](auto&& arg) -> size_t {
+        using T = std::decay_t<decltype(arg)>;
+        if constexpr (std::is_same_v<T, std::string>) {
+            return arg.size();
+        } else {
+            return sizeof(T);
+        }
+    };
+    return std::visit(bytes, key) + std::visit(bytes, value);
+}
+
+size_t KeyValue::heapMemoryUsage() const {
+    static const size_t inline_capacity = std::string().capacity();
+    auto heap = [](auto&& arg) -> size_t {
+        using T = std::decay_t<decltype(arg)>;
+        if constexpr (std::is_same_v<T, std::string>) {
+            return arg.capacity() > inline_capacity ? arg.capacity() + 1 : 0;
+        }
+        return 0;
+    };
+    return std::visit(heap, key) + std::visit(heap, value);
+}
 
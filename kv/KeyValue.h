@@ -2,6 +2,7 @@
 // Created by Damian Li on 2024-09-07.
 //
 #include <variant> // c++17 new features
+#include <cstdint>
 #include <string>
 #include <iostream>
 
@@ -15,31 +16,47 @@ using namespace std;
 class KeyValue {
 public:
     // Enum to record the type of key and value
-    enum class KeyValueType { INT, LONG, DOUBLE, CHAR, STRING };
+    // DELETION / RANGE_DELETION only appear as the value type of a tombstone
+    enum class KeyValueType { INT, LONG, DOUBLE, CHAR, STRING, DELETION, RANGE_DELETION };
 
     using KeyType = std::variant<int, long long, double, char, std::string>;
     using ValueType = std::variant<int, long long, double, char, std::string>;
 
     // default constructor
-    KeyValue() : key(0), value(0), keyType(KeyValueType::INT), valueType(KeyValueType::INT) {};
+    KeyValue() : keyType(KeyValueType::INT), valueType(KeyValueType::INT), key(0), value(0) {};
 
     // Templated constructor that automatically deduces the type
     template<typename K, typename V>
     KeyValue(K k, V v);
 
+    // Marks key as deleted; shadows every older version of the key
+    static KeyValue Tombstone(const KeyType& key);
+    // Marks [start, end) as deleted; the value holds end
+    static KeyValue RangeTombstone(const KeyType& start, const KeyType& end);
+
     // Accessor methods
     KeyType getKey() const;
     ValueType getValue() const;
     KeyValueType getKeyType() const;
     KeyValueType getValueType() const;
 
-    // Comparison operator for keys
-    bool operator<(const KeyValue& other) const;
+    // Comparison operator for keys: numbers (any numeric type, by value) before strings
+    bool operator<(const KeyValue& other) const {return compareKey(other) < 0;};
     bool operator>(const KeyValue& other) const;
     bool operator<=(const KeyValue& other) const;
     bool operator>=(const KeyValue& other) const;
     bool operator==(const KeyValue& other) const;
-
+    // Three-way key comparison: < 0, 0 or > 0
+    int compareKey(const KeyValue& other) const {
+        bool string_key = keyType == KeyValueType::STRING;
+        if (string_key != (other.keyType == KeyValueType::STRING)) {
+            return string_key ? 1 : -1;  // Numeric is always smaller than string
+        }
+        // Big-endian words of the cached prefixes compared as integers, like memcmp would
+        if (keyHigh != other.keyHigh) return keyHigh < other.keyHigh ? -1 : 1;
+        if (string_key) return compareStrings(other);
+        return keyLow < other.keyLow ? -1 : (keyLow > other.keyLow ? 1 : 0);
+    };
     // Print key-value
     void printKeyValue() const;
 
@@ -47,15 +64,52 @@ public:
     static std::string keyValueTypeToString(KeyValueType type);
 
     bool isEmpty() const;
+    // Bytes of key and value strings too long for the in-object buffer (they live on the heap)
+    size_t heapMemoryUsage() const;
+    bool ownsHeapMemory() const {return heapMemoryUsage() > 0;};
+    // Bytes of key and value as the user sees them: a number's size, a string's length
+    size_t byteSize() const;
 
+    // Sequence number of the write that produced this entry (0 = written before sequence numbers);
+    // not part of the key: comparisons ignore it
+    static constexpr uint64_t MAX_SEQUENCE = UINT64_MAX;
+    uint64_t getSequence() const {return sequence;};
+    void setSequence(uint64_t seq) {sequence = seq;};
 
+    bool isTombstone() const {return valueType == KeyValueType::DELETION;};
+    bool isRangeTombstone() const {return valueType == KeyValueType::RANGE_DELETION;};
+    // Range tombstone only: end key (exclusive) of the deleted range
+    KeyValue rangeEnd() const;
+    // Range tombstone only: start <= kv < end
+    bool covers(const KeyValue& kv) const;
+    // Type tag of a key or value field
+    static KeyValueType fieldType(const KeyType& field) {return static_cast<KeyValueType>(field.index());};
 
-private:
 
-    KeyType key;
-    ValueType value;
+
+private:
+    // Key order of fields that aren't cached (the end key of a range tombstone)
+    static bool keyLess(const KeyType& a, const KeyType& b);
+    // Encoding of a numeric (int, long long, double, char) field without the class byte,
+    // as its two big-endian words
+    static void encodeNumber(const KeyType& field, uint64_t& high, uint64_t& low);
+    // compareKey() of two string keys with the same first 8 bytes
+    int compareStrings(const KeyValue& other) const;
+    // Refresh keyHigh / keyLow after key changed
+    void cacheKey();
+
+    // What compareKey() reads comes first, on the same cache line
     KeyValueType keyType;
     KeyValueType valueType;
+    // Order-preserving prefix of the key, compared as integers. For a number: its value as a
+    // sign-flipped double, then the exact remainder of a long long the double rounds. For a
+    // string: its first 8 bytes big-endian (zero padded), which decide most comparisons.
+    // Initialized to the prefix of the default key 0
+    uint64_t keyHigh = 1ULL << 63;
+    uint64_t keyLow = 1ULL << 63;
+    KeyType key;
+    ValueType value;
+    uint64_t sequence = 0;
     // Function to deduce the type of the key and value and return the corresponding enum
     template<typename T>
     KeyValueType deduceType(const T& value) const;
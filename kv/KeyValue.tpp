@@ -7,6 +7,7 @@ KeyValue::KeyValue(K k, V v)
     valueType = std::visit([&](auto&& arg) {
         return deduceType(arg);  // Deduce the actual type of the value
     }, value);
+    cacheKey();
 }
 
 
@@ -3,6 +3,8 @@
 //
 
 #include "Memtable.h"
+#include "PerfContext.h"
+#include <algorithm>
 #include <fstream>
 #include <chrono>
 #include <iomanip>
@@ -17,58 +19,238 @@ using namespace std;
 namespace fs = std::filesystem;
 
 // Constructor
-Memtable::Memtable(int threshold) {
+Memtable::Memtable(int threshold, MemtableRep _rep) : rep(_rep) {
     memtable_size = threshold;
     current_size = 0;
-    tree = new RedBlackTree();
+    resetBackend();
     path = fs::path("defaultDB");
 
 }
 
-Memtable::Memtable() {
-    memtable_size = 1e4;
-    current_size = 0;
-    tree = new RedBlackTree();
+Memtable::Memtable() : Memtable(1e4) {
 }
 // Destructor
 Memtable::~Memtable() {
     delete tree;
+    delete skiplist;
+}
+
+void Memtable::resetBackend() {
+    delete tree;
+    delete skiplist;
+    tree = nullptr;
+    skiplist = nullptr;
+    arena = make_unique<Arena>();
+    heap_bytes = 0;
+    overwritten.clear();
+    range_deletions.clear();
+    num_range_deletions = 0;
+    if (rep == MemtableRep::SKIPLIST) {
+        skiplist = new SkipList(arena.get());
+    } else {
+        tree = new RedBlackTree(arena.get());
+    }
 }
 
 FlushSSTInfo Memtable::put(const KeyValue& kv) {
     FlushSSTInfo info;
 
-    // Check if the memtable size limit is not reached
+    // Flush first when kv doesn't fit: byte budget used up, or the tree is full and kv is a new key
+    if (needsFlush(kv)) {
+        if (!fs::exists(path)) {
+            fs::create_directories(path);  // Ensure the directory exists
+        }
+        // Flush the current tree to disk and reset the size
+        info = file_manager.flushToDisk(inOrderEntries(snapshot_list ? snapshot_list->sequences() : vector<uint64_t>()),
+                                        getRangeDeletions());
+        current_size = 0;
+
+        // Drop the backend with its arena and start over
+        resetBackend();
+    }
+
+    // Insert the new key-value pair
+    insert(kv);
+
+    return info;
+}
+
+
+KeyValue Memtable::get(const KeyValue& kv, uint64_t sequence) const {
+    PERF_TIMER_GUARD(get_from_memtable_nanos);
+    PERF_COUNTER_ADD(get_from_memtable_count, 1);
+    KeyValue result = skiplist ? skiplist->get(kv, sequence) : treeGet(kv, sequence);
+    if (num_range_deletions > 0) {
+        return applyRangeDeletions(kv, std::move(result), sequence);
+    }
+    return result;
+}
+
+KeyValue Memtable::treeGet(const KeyValue& kv, uint64_t sequence) const {
+    KeyValue newest = tree->getValue(kv);
+    if (newest.isEmpty() || newest.getSequence() <= sequence) {
+        return newest;
+    }
+    // Too new for the reader: the newest replaced version it can see
+    auto range = overwritten.equal_range(kv);
+    for (auto it = range.second; it != range.first;) {
+        if ((--it)->getSequence() <= sequence) {
+            return *it;
+        }
+    }
+    return KeyValue();
+}
+
+bool Memtable::needsFlush(const KeyValue& kv) const {
+    if (write_buffer_size > 0 && current_size > 0 && approximateMemoryUsage() >= write_buffer_size) {
+        return true;
+    }
     if (current_size < memtable_size) {
-        // Insert the key-value pair into the tree
+        return false;
+    }
+    if (kv.isRangeTombstone()) {
+        return true;
+    }
+    return skiplist ? !skiplist->contains(kv) : !tree->search(kv);
+}
+
+void Memtable::insert(const KeyValue& kv) {
+    current_size++;
+    if (kv.isRangeTombstone()) {
+        addRangeDeletion(kv);
+        return;
+    }
+    if (skiplist) {
+        skiplist->insert(kv);
+    } else {
+        keepOverwritten(kv);
         tree->insert(kv);
-        current_size++;
-    } else if (current_size == memtable_size) {
-        // If the tree is full, check if the key exists to avoid unnecessary flush
-        if (!tree->search(kv)) {
-            if (!fs::exists(path)) {
-                fs::create_directories(path);  // Ensure the directory exists
+    }
+    if (size_t bytes = kv.heapMemoryUsage()) {
+        heap_bytes += bytes;
+    }
+}
+
+void Memtable::insertBatch(const KeyValue* records, size_t count) {
+    // Sort pointers, not kv-pairs; stable so equal keys keep their batch order
+    vector<const KeyValue*> sorted;
+    vector<const KeyValue*> ranges;
+    sorted.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        if (records[i].isRangeTombstone()) {
+            ranges.push_back(records + i);
+            addRangeDeletion(records[i]);
+        } else {
+            sorted.push_back(records + i);
+        }
+    }
+    auto less = [](const KeyValue* a, const KeyValue* b) {return *a < *b;};
+    if (!is_sorted(sorted.begin(), sorted.end(), less)) {
+        stable_sort(sorted.begin(), sorted.end(), less);
+    }
+    // A range tombstone deletes the records before it in the batch, but not the ones after it
+    auto deletedLater = [&ranges](const KeyValue* kv) {
+        for (const KeyValue* range : ranges) {
+            if (kv < range /* earlier in the batch */ && range->covers(*kv)) {
+                return true;
             }
-            // Flush the current tree to disk and reset the size
-            info = file_manager.flushToDisk(tree->inOrderFlushToSst());
-            current_size = 0;
+        }
+        return false;
+    };
 
-            // Reallocate memory for the RedBlackTree
-            delete tree;
-            tree = new RedBlackTree();
+    SkipList::Splice splice;
+    size_t heap = 0;
+    for (size_t i = 0; i < sorted.size(); ++i) {
+        if (i + 1 < sorted.size() && !(*sorted[i] < *sorted[i + 1])) {
+            continue;  // overwritten later in the batch
         }
+        if (!ranges.empty() && deletedLater(sorted[i])) {
+            continue;
+        }
+        if (skiplist) {
+            skiplist->insert(*sorted[i], &splice);
+        } else {
+            keepOverwritten(*sorted[i]);
+            tree->insert(*sorted[i]);
+        }
+        heap += sorted[i]->heapMemoryUsage();
+    }
+    current_size += static_cast<int>(count);
+    heap_bytes += heap;
+}
 
-        // Insert the new key-value pair
-        tree->insert(kv);
-        current_size++;
+bool Memtable::isFull() const {
+    if (current_size == 0) {
+        return false;
     }
+    return current_size >= memtable_size || (write_buffer_size > 0 && approximateMemoryUsage() >= write_buffer_size);
+}
 
-    return info;
+void Memtable::addRangeDeletion(const KeyValue& range) {
+    lock_guard<mutex> lock(range_mutex);
+    range_deletions.insert(upper_bound(range_deletions.begin(), range_deletions.end(), range), range);
+    num_range_deletions++;
+    heap_bytes += sizeof(KeyValue) + range.heapMemoryUsage();
+}
+
+vector<KeyValue> Memtable::getRangeDeletions() const {
+    lock_guard<mutex> lock(range_mutex);
+    return range_deletions;
 }
 
+KeyValue Memtable::applyRangeDeletions(const KeyValue& key, KeyValue point, uint64_t sequence) const {
+    // Newest range tombstone covering key that the reader can see
+    uint64_t newest = 0;
+    bool covered = false;
+    {
+        lock_guard<mutex> lock(range_mutex);
+        for (const KeyValue& range : range_deletions) {
+            if (key < range) {
+                break;  // sorted by start
+            }
+            if (range.getSequence() <= sequence && range.covers(key) && (!covered || newest < range.getSequence())) {
+                newest = range.getSequence();
+                covered = true;
+            }
+        }
+    }
+    if (covered && (point.isEmpty() || point.getSequence() < newest)) {
+        KeyValue tombstone = KeyValue::Tombstone(key.getKey());
+        tombstone.setSequence(newest);
+        return tombstone;
+    }
+    return point;
+}
+
+void Memtable::keepOverwritten(const KeyValue& kv) {
+    if (!snapshot_list || snapshot_list->empty()) {
+        return;
+    }
+    KeyValue old = tree->getValue(kv);
+    if (!old.isEmpty()) {
+        heap_bytes += sizeof(KeyValue) + 4 * sizeof(void*) + old.heapMemoryUsage();  // multiset node
+        overwritten.insert(overwritten.end(), std::move(old));
+    }
+}
 
-KeyValue Memtable::get(const KeyValue& kv) const {
-    return tree->getValue(kv);
+vector<KeyValue> Memtable::inOrderEntries(const vector<uint64_t>& snapshots) const {
+    if (snapshots.empty()) {
+        return skiplist ? skiplist->entries() : tree->inOrderFlushToSst();
+    }
+    vector<KeyValue> entries;
+    if (skiplist) {
+        entries = skiplist->entries(true);
+    } else {
+        entries = tree->inOrderFlushToSst();
+        if (!overwritten.empty()) {
+            entries.insert(entries.end(), overwritten.begin(), overwritten.end());
+            stable_sort(entries.begin(), entries.end(), [](const KeyValue& a, const KeyValue& b) {
+                return a < b || (!(b < a) && a.getSequence() > b.getSequence());
+            });
+        }
+    }
+    SnapshotList::dropShadowed(entries, snapshots);
+    return entries;
 }
 
 void Memtable::set_path(fs::path _path) {
@@ -105,8 +287,120 @@ std::string Memtable::generateSstFilename() {
     return filename;
 }
 
+class MemtableIterator : public Iterator {
+public:
+    MemtableIterator(shared_ptr<const Memtable> _table, uint64_t _sequence)
+        : table(std::move(_table)), sequence(_sequence) {
+        if (table->skiplist) {
+            cursor = make_unique<SkipList::Cursor>(table->skiplist, sequence);
+        }
+    }
+
+    bool Valid() const override {return cursor ? cursor->valid() : current != nullptr;};
+    void SeekToFirst() override {
+        if (cursor) {
+            cursor->seekToFirst();
+            return;
+        }
+        path.clear();
+        pushLeft(table->tree->getRoot());
+        settle();
+    }
+    void Seek(const KeyValue& target) override {
+        if (cursor) {
+            cursor->seek(target);
+            return;
+        }
+        // Ancestors still to visit are the nodes whose key is >= target
+        path.clear();
+        for (TreeNode* node = table->tree->getRoot(); node;) {
+            if (node->keyValue < target) {
+                node = node->right;
+            } else {
+                path.push_back(node);
+                node = node->left;
+            }
+        }
+        settle();
+    }
+    void Next() override {
+        if (cursor) {
+            cursor->next();
+            return;
+        }
+        TreeNode* node = path.back();
+        path.pop_back();
+        pushLeft(node->right);
+        settle();
+    }
+    const KeyValue& kv() const override {return cursor ? cursor->kv() : *current;};
+
+private:
+    shared_ptr<const Memtable> table;
+    uint64_t sequence;
+    unique_ptr<SkipList::Cursor> cursor;  // SKIPLIST
+    // RED_BLACK_TREE: in-order walk, the next node to visit on top
+    vector<TreeNode*> path;
+    const KeyValue* current = nullptr;
+    KeyValue replaced;  // version the tree no longer holds, from overwritten
+
+    void pushLeft(TreeNode* node) {
+        for (; node; node = node->left) {
+            path.push_back(node);
+        }
+    }
+    // Stop at the first node from the top of path that has a version visible at sequence
+    void settle() {
+        for (current = nullptr; !path.empty();) {
+            const KeyValue& newest = path.back()->keyValue;
+            if (newest.getSequence() <= sequence) {
+                current = &newest;
+                return;
+            }
+            replaced = table->treeGet(newest, sequence);
+            if (!replaced.isEmpty()) {
+                current = &replaced;
+                return;
+            }
+            TreeNode* node = path.back();
+            path.pop_back();
+            pushLeft(node->right);
+        }
+    }
+};
+
+unique_ptr<Iterator> Memtable::newIterator(shared_ptr<const Memtable> table, uint64_t sequence) {
+    return make_unique<MemtableIterator>(std::move(table), sequence);
+}
+
 // scan the tree and insert the kv-pairs<k,v> into res where small_key <= k && k <= large_key
 void Memtable::Scan(KeyValue small_key, KeyValue large_key, set<KeyValue>& res) {
+    if (skiplist) {
+        skiplist->scan(small_key, large_key, res);
+        return;
+    }
     tree->Scan(tree->getRoot(), small_key, large_key, res);
 }
 
+void Memtable::Scan(const KeyValue& small_key, const KeyValue& large_key, vector<KeyValue>& res,
+                    uint64_t sequence) {
+    if (skiplist) {
+        skiplist->scan(small_key, large_key, res, sequence);
+        return;
+    }
+    size_t first = res.size();
+    tree->Scan(tree->getRoot(), small_key, large_key, res);
+    if (sequence == KeyValue::MAX_SEQUENCE) {
+        return;
+    }
+    // Swap versions written after the reader's snapshot for the ones it can see
+    size_t kept = first;
+    for (size_t i = first; i < res.size(); ++i) {
+        KeyValue visible = res[i].getSequence() <= sequence ? std::move(res[i]) : treeGet(res[i], sequence);
+        if (!visible.isEmpty()) {
+            res[kept++] = std::move(visible);
+        }
+    }
+    res.resize(kept);
+}
+
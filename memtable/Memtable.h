@@ -5,11 +5,23 @@
 #ifndef MEMTABLE_H
 #define MEMTABLE_H
 #include "RedBlackTree.h"
+#include "SkipList.h"
+#include "Arena.h"
+#include "Snapshot.h"
+#include <atomic>
+#include <mutex>
+#include <set>
 #include <filesystem> // C++17 lib
 #include "FileManager.h"
+#include "Iterator.h"
 namespace fs = std::filesystem;
 using namespace std;
 
+// Data structure behind a Memtable
+enum class MemtableRep {
+    RED_BLACK_TREE,  // single writer (callers serialize inserts and reads)
+    SKIPLIST         // concurrent inserts, lock-free reads
+};
 
 /*
  * Handle in-memory operations.
@@ -17,15 +29,52 @@ using namespace std;
 class Memtable {
     public:
         Memtable();
-        Memtable(int threshold);
+        Memtable(int threshold, MemtableRep rep = MemtableRep::RED_BLACK_TREE);
         ~Memtable();
         void set_path(fs::path);
         fs::path get_path();
 
         // update with KeyValue Class
         void Scan(KeyValue small_key, KeyValue large_key, set<KeyValue>& res);
+        // kv-pairs of [small_key, large_key] in key order, newest version <= sequence of each key
+        void Scan(const KeyValue& small_key, const KeyValue& large_key, vector<KeyValue>& res,
+                  uint64_t sequence = KeyValue::MAX_SEQUENCE);
         FlushSSTInfo put(const KeyValue&);
-        KeyValue get(const KeyValue& kv) const;
+        // Newest entry of kv's key with a sequence number <= sequence; a tombstone when
+        // the key was deleted in this memtable
+        KeyValue get(const KeyValue& kv, uint64_t sequence = KeyValue::MAX_SEQUENCE) const;
+        // True when kv can't go in without a flush: the byte budget is used up, or the
+        // memtable holds memtable_size entries and kv is a new key (a range tombstone
+        // always counts as one)
+        bool needsFlush(const KeyValue& kv) const;
+        // Insert without flushing; callers that flush elsewhere check needsFlush() first.
+        // Thread-safe with the SKIPLIST backend.
+        void insert(const KeyValue& kv);
+        // Insert a batch in one pass: records are sorted by key (the last of equal keys wins),
+        // then go in with one descent per key. Records followed by a range tombstone covering
+        // them are dropped. Thread-safe with the SKIPLIST backend.
+        void insertBatch(const KeyValue* records, size_t count);
+        // Range tombstones of this memtable, sorted by start key; like those of an SST,
+        // each one only deletes the entries with smaller sequence numbers
+        vector<KeyValue> getRangeDeletions() const;
+        // Byte budget used up or memtable_size entries reached (a whole batch is admitted while not full)
+        bool isFull() const;
+        // Every kv-pair in key order (what a flush writes): the newest version of each key,
+        // plus the newest version each of the given snapshots (ascending) can see
+        vector<KeyValue> inOrderEntries(const vector<uint64_t>& snapshots = {}) const;
+        // Live snapshots: while any exists, versions replaced by an overwrite are kept
+        void setSnapshotList(shared_ptr<const SnapshotList> snapshots) {snapshot_list = std::move(snapshots);};
+        MemtableRep getRep() const {return rep;};
+        // Cursor over the kv-pairs of table, newest version <= sequence of each key; keeps table
+        // alive. A SKIPLIST memtable may take inserts meanwhile, a RED_BLACK_TREE one must not
+        // (e.g. an immutable memtable). Range tombstones are not applied.
+        static unique_ptr<Iterator> newIterator(shared_ptr<const Memtable> table, uint64_t sequence);
+        // Bytes used by nodes and kv-pairs: the arena plus key/value strings that live on the heap
+        // (a string replaced by an overwrite stays counted until the memtable is dropped)
+        size_t approximateMemoryUsage() const {return arena->memoryUsage() + heap_bytes.load();};
+        // Byte budget: the memtable is full once it uses this much memory (0 = entry count only)
+        void setWriteBufferSize(size_t bytes) {write_buffer_size = bytes;};
+        size_t getWriteBufferSize() const {return write_buffer_size;};
 
         // helper function
         string generateSstFilename();
@@ -33,16 +82,42 @@ class Memtable {
         int get_currentSize() const {return current_size;};
         int getSSTFileSize() const {return SST_file_size;};
         void increaseSSTFileSize() {SST_file_size++;};
+        // Backend in use; the other one is nullptr
         RedBlackTree* getTree() const {return tree;};
+        SkipList* getSkipList() const {return skiplist;};
         // File Manager
         FileManager file_manager;
 
     private:
-        RedBlackTree* tree;
+        MemtableRep rep = MemtableRep::RED_BLACK_TREE;
+        // Every node of the backend is allocated here; dropping the arena frees them all at once
+        unique_ptr<Arena> arena;
+        RedBlackTree* tree = nullptr;
+        SkipList* skiplist = nullptr;
         int memtable_size; // maximum size of memtable
-        int current_size = 0;
+        atomic<int> current_size{0};
+        size_t write_buffer_size = 0;
+        atomic<size_t> heap_bytes{0};
+        // Range tombstones live beside the backend: they cover keys instead of holding one
+        mutable mutex range_mutex;
+        vector<KeyValue> range_deletions;
+        atomic<int> num_range_deletions{0};
+        void addRangeDeletion(const KeyValue& range);
+        // point (possibly empty) unless a newer range tombstone visible at sequence deletes key
+        KeyValue applyRangeDeletions(const KeyValue& key, KeyValue point, uint64_t sequence) const;
+        shared_ptr<const SnapshotList> snapshot_list;
+        // RED_BLACK_TREE only: versions replaced in the tree while snapshots were live,
+        // oldest first among equal keys (the skiplist keeps every version itself)
+        multiset<KeyValue> overwritten;
+        // Remember the version kv replaces if a snapshot may still read it
+        void keepOverwritten(const KeyValue& kv);
+        // RED_BLACK_TREE lookup of the newest version <= sequence
+        KeyValue treeGet(const KeyValue& kv, uint64_t sequence) const;
+        // Free the current backend and arena, then allocate empty ones
+        void resetBackend();
         fs::path path;
         int SST_file_size = 0;
+        friend class MemtableIterator;
 
 
 };
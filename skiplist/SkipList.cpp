@@ -0,0 +1,206 @@
+//
+// Created by Damian Li on 2024-09-23.
+//
+
+#include "SkipList.h"
+#include <algorithm>
+#include <new>
+#include <random>
+
+SkipList::SkipList(Arena* _arena) : arena(_arena) {
+    if (!arena) {
+        ownArena = std::make_unique<Arena>();
+        arena = ownArena.get();
+    }
+    head = newNode(nullptr, MAX_HEIGHT);
+}
+
+SkipList::Node* SkipList::newNode(Version* version, int height) {
+    // Node ends with a variable number of next pointers
+    size_t bytes = sizeof(Node) + (height - 1) * sizeof(std::atomic<Node*>);
+    Node* node = reinterpret_cast<Node*>(arena->allocate(bytes, alignof(Node)));
+    new (&node->version) std::atomic<Version*>(version);
+    node->height = height;
+    for (int i = 0; i < height; ++i) {
+        new (&node->next[i]) std::atomic<Node*>(nullptr);
+    }
+    return node;
+}
+
+SkipList::Version* SkipList::newVersion(const KeyValue& kv) {
+    Version* version = arena->make<Version>(kv);
+    if (kv.ownsHeapMemory()) {
+        arena->addCleanup(&version->kv);
+    }
+    return version;
+}
+
+int SkipList::randomHeight() {
+    // Each extra level with probability 1/4
+    thread_local std::minstd_rand rng(std::random_device{}());
+    int height = 1;
+    while (height < MAX_HEIGHT && (rng() & 3) == 0) {
+        height++;
+    }
+    return height;
+}
+
+SkipList::Node* SkipList::findPrev(Node* before, const KeyValue& key, int level) {
+    Node* x = before;
+    while (true) {
+        Node* next = x->next[level].load(std::memory_order_acquire);
+        if (!next || !(next->kv() < key)) {
+            return x;
+        }
+        x = next;
+    }
+}
+
+SkipList::Node* SkipList::findGreaterOrEqual(const KeyValue& key) const {
+    Node* x = head;
+    for (int level = maxHeight.load(std::memory_order_acquire) - 1; level >= 0; --level) {
+        x = findPrev(x, key, level);
+    }
+    return x->next[0].load(std::memory_order_acquire);
+}
+
+void SkipList::pushVersion(Node* node, Version* version) {
+    // Usually the newest: goes in front. Concurrent writers of one key may arrive out of
+    // sequence order, then the version is linked further down the list.
+    const uint64_t sequence = version->kv.getSequence();
+    std::atomic<Version*>* link = &node->version;
+    while (true) {
+        Version* current = link->load(std::memory_order_acquire);
+        if (current && current->kv.getSequence() > sequence) {
+            link = &current->older;
+            continue;
+        }
+        version->older.store(current, std::memory_order_relaxed);
+        if (link->compare_exchange_weak(current, version, std::memory_order_acq_rel)) {
+            return;
+        }
+    }
+}
+
+const SkipList::Version* SkipList::visibleVersion(const Node* node, uint64_t sequence) {
+    const Version* version = node->version.load(std::memory_order_acquire);
+    while (version && version->kv.getSequence() > sequence) {
+        version = version->older.load(std::memory_order_acquire);
+    }
+    return version;
+}
+
+void SkipList::Cursor::moveTo(Node* n) {
+    for (node = n, version = nullptr; node; node = node->next[0].load(std::memory_order_acquire)) {
+        if ((version = visibleVersion(node, sequence))) {
+            return;
+        }
+    }
+}
+
+bool SkipList::insert(const KeyValue& kv, Splice* splice) {
+    const int height = randomHeight();
+    int current_max = maxHeight.load(std::memory_order_relaxed);
+    while (height > current_max && !maxHeight.compare_exchange_weak(current_max, height)) {
+    }
+    const int top = std::max(height, current_max);
+
+    // Splice: prev[l] < kv <= next[l] at every level
+    Node* prev[MAX_HEIGHT];
+    Node* next[MAX_HEIGHT];
+    Node* x = head;
+    for (int level = top - 1; level >= 0; --level) {
+        if (splice && level < splice->height) {
+            // Jump ahead to the previous insert's position when it is still before kv
+            Node* hint = splice->prev[level];
+            if (hint != head && hint->kv() < kv && (x == head || x->kv() < hint->kv())) {
+                x = hint;
+            }
+        }
+        x = findPrev(x, kv, level);
+        prev[level] = x;
+        next[level] = x->next[level].load(std::memory_order_acquire);
+    }
+    if (splice) {
+        std::copy(prev, prev + top, splice->prev);
+        splice->height = top;
+    }
+
+    Version* version = newVersion(kv);
+    if (next[0] && !(kv < next[0]->kv())) {
+        pushVersion(next[0], version);
+        return false;
+    }
+
+    Node* node = newNode(version, height);
+    for (int level = 0; level < height; ++level) {
+        while (true) {
+            node->next[level].store(next[level], std::memory_order_relaxed);
+            if (prev[level]->next[level].compare_exchange_strong(next[level], node, std::memory_order_release)) {
+                break;
+            }
+            // Lost a race at this level: recompute the splice from prev, which is still before kv
+            prev[level] = findPrev(prev[level], kv, level);
+            next[level] = prev[level]->next[level].load(std::memory_order_acquire);
+            if (level == 0 && next[0] && !(kv < next[0]->kv())) {
+                // The same key was linked first: overwrite it instead (node stays unused in the arena)
+                pushVersion(next[0], version);
+                return false;
+            }
+        }
+    }
+    if (splice) {
+        std::fill(splice->prev, splice->prev + height, node);
+    }
+    numKeys.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+KeyValue SkipList::get(const KeyValue& kv, uint64_t sequence) const {
+    Node* node = findGreaterOrEqual(kv);
+    if (node && !(kv < node->kv())) {
+        if (const Version* version = visibleVersion(node, sequence)) {
+            return version->kv;
+        }
+    }
+    return KeyValue();
+}
+
+bool SkipList::contains(const KeyValue& kv) const {
+    Node* node = findGreaterOrEqual(kv);
+    return node && !(kv < node->kv());
+}
+
+void SkipList::scan(const KeyValue& small_key, const KeyValue& large_key, std::set<KeyValue>& res) const {
+    for (Node* node = findGreaterOrEqual(small_key); node && !(large_key < node->kv());
+         node = node->next[0].load(std::memory_order_acquire)) {
+        res.insert(res.end(), node->kv());
+    }
+}
+
+void SkipList::scan(const KeyValue& small_key, const KeyValue& large_key, std::vector<KeyValue>& res,
+                    uint64_t sequence) const {
+    for (Node* node = findGreaterOrEqual(small_key); node && !(large_key < node->kv());
+         node = node->next[0].load(std::memory_order_acquire)) {
+        if (const Version* version = visibleVersion(node, sequence)) {
+            res.push_back(version->kv);
+        }
+    }
+}
+
+std::vector<KeyValue> SkipList::entries(bool all_versions) const {
+    std::vector<KeyValue> kv_pairs;
+    kv_pairs.reserve(size());
+    for (Node* node = head->next[0].load(std::memory_order_acquire); node;
+         node = node->next[0].load(std::memory_order_acquire)) {
+        const Version* version = node->version.load(std::memory_order_acquire);
+        if (!all_versions) {
+            kv_pairs.push_back(version->kv);
+            continue;
+        }
+        for (; version; version = version->older.load(std::memory_order_acquire)) {
+            kv_pairs.push_back(version->kv);
+        }
+    }
+    return kv_pairs;
+}
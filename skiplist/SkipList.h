@@ -0,0 +1,114 @@
+//
+// Created by Damian Li on 2024-09-23.
+//
+
+#ifndef SKIPLIST_H
+#define SKIPLIST_H
+
+#include "KeyValue.h"
+#include "Arena.h"
+#include <atomic>
+#include <memory>
+#include <set>
+#include <vector>
+
+/*
+ * Concurrent skiplist keyed on KeyValue keys.
+ *
+ * - insert() may run from many threads at once: nodes are linked level by
+ *   level with compare-and-swap, bottom level first, so a node is visible
+ *   once it is in level 0.
+ * - Readers (get/contains/scan/entries) take no lock and may run alongside
+ *   inserts.
+ * - Overwriting a key adds a new version to the node's version list with
+ *   compare-and-swap. The list is kept newest first by sequence number, so a
+ *   reader can stop at the first version its snapshot can see.
+ * - Nodes and versions live in an arena: nothing is unlinked or freed before
+ *   the arena goes away, so readers never touch freed memory.
+ */
+class SkipList {
+    struct Node;
+    struct Version;
+public:
+    static constexpr int MAX_HEIGHT = 12;
+
+    // Allocate from arena (owned by the caller and outliving the skiplist), or from an own arena
+    explicit SkipList(Arena* arena = nullptr);
+    SkipList(const SkipList&) = delete;
+    SkipList& operator=(const SkipList&) = delete;
+
+    // Position of the previous insert, which speeds up inserting keys in ascending order
+    struct Splice {
+        int height = 0;
+        Node* prev[MAX_HEIGHT];
+    };
+
+    // Insert or overwrite; returns true if the key was not present
+    bool insert(const KeyValue& kv) {return insert(kv, nullptr);};
+    // Same, searching from splice (left by the previous insert of a smaller key) instead of the head
+    bool insert(const KeyValue& kv, Splice* splice);
+    // Newest version of the key with a sequence number <= sequence, or an empty KeyValue
+    KeyValue get(const KeyValue& kv, uint64_t sequence = KeyValue::MAX_SEQUENCE) const;
+    bool contains(const KeyValue& kv) const;
+    // kv-pairs of [small_key, large_key]
+    void scan(const KeyValue& small_key, const KeyValue& large_key, std::set<KeyValue>& res) const;
+    // Same, newest version <= sequence of each key
+    void scan(const KeyValue& small_key, const KeyValue& large_key, std::vector<KeyValue>& res,
+              uint64_t sequence = KeyValue::MAX_SEQUENCE) const;
+    // Every kv-pair in key order; with all_versions every version of a key, newest first
+    std::vector<KeyValue> entries(bool all_versions = false) const;
+    // Number of distinct keys
+    size_t size() const {return numKeys.load(std::memory_order_relaxed);};
+
+    // Forward cursor over the keys, each at its newest version <= sequence (keys without
+    // one are skipped). Takes no lock: may run alongside inserts.
+    class Cursor {
+    public:
+        Cursor(const SkipList* list, uint64_t sequence) : list(list), sequence(sequence) {};
+        bool valid() const {return version != nullptr;};
+        void seekToFirst() {moveTo(list->head->next[0].load(std::memory_order_acquire));};
+        void seek(const KeyValue& target) {moveTo(list->findGreaterOrEqual(target));};
+        void next() {moveTo(node->next[0].load(std::memory_order_acquire));};
+        const KeyValue& kv() const {return version->kv;};
+
+    private:
+        const SkipList* list;
+        uint64_t sequence;
+        Node* node = nullptr;
+        const Version* version = nullptr;
+        // First node from n on with a version visible at sequence
+        void moveTo(Node* n);
+    };
+
+private:
+    struct Version {
+        explicit Version(const KeyValue& kv) : kv(kv) {};
+        KeyValue kv;
+        std::atomic<Version*> older{nullptr};
+    };
+    struct Node {
+        std::atomic<Version*> version;  // newest first; every version has the node's key
+        int height;
+        std::atomic<Node*> next[1];     // really next[height]
+        const KeyValue& kv() const {return version.load(std::memory_order_acquire)->kv;};
+    };
+
+    std::unique_ptr<Arena> ownArena;
+    Arena* arena;
+    Node* head;
+    std::atomic<int> maxHeight{1};
+    std::atomic<size_t> numKeys{0};
+
+    Node* newNode(Version* version, int height);
+    Version* newVersion(const KeyValue& kv);
+    static int randomHeight();
+    // Last node before key at level, starting from before
+    static Node* findPrev(Node* before, const KeyValue& key, int level);
+    // First node whose key is >= key (nullptr if none)
+    Node* findGreaterOrEqual(const KeyValue& key) const;
+    static void pushVersion(Node* node, Version* version);
+    // Newest version of node with a sequence number <= sequence (nullptr if none)
+    static const Version* visibleVersion(const Node* node, uint64_t sequence);
+};
+
+#endif //SKIPLIST_H
@@ -7,6 +7,8 @@
 #include <filesystem>
 #include <chrono>
 #include <iostream>
+#include <thread>
+#include <atomic>
 #include "api.h"
 
 namespace fs = std::filesystem;
@@ -334,3 +336,70 @@ TEST(APITest, LargeScaleInsertAndScanRange) {
     db->Close();
     fs::remove_all("test_db");
 }
+
+// Background flush: full memtables are swapped out and written by the flush thread
+TEST(APITest, BackgroundFlushKeepsDataVisible) {
+    auto db = std::make_unique<kvdb::API>(50);
+    db->Open("test_db");
+
+    for (int i = 1; i <= 2000; ++i) {
+        db->Put(i, i * 10);
+        // Reads go through active, immutable, then SSTs while flushes are in flight
+        EXPECT_EQ(std::get<int>(db->Get(KeyValue(i, "")).getValue()), i * 10);
+    }
+    for (int i = 1; i <= 2000; ++i) {
+        EXPECT_EQ(std::get<int>(db->Get(KeyValue(i, "")).getValue()), i * 10);
+    }
+    EXPECT_EQ(db->Scan(KeyValue(1, ""), KeyValue(2000, "")).size(), 2000);
+
+    db->Close();
+    fs::remove_all("test_db");
+}
+
+TEST(APITest, BackgroundFlushNewestValueWins) {
+    auto db = std::make_unique<kvdb::API>(10);
+    db->Open("test_db");
+
+    // Every key is rewritten after older versions went to the immutable memtable or an SST
+    for (int round = 0; round < 5; ++round) {
+        for (int i = 1; i <= 30; ++i) {
+            db->Put(i, round);
+        }
+    }
+    for (int i = 1; i <= 30; ++i) {
+        EXPECT_EQ(std::get<int>(db->Get(KeyValue(i, "")).getValue()), 4);
+    }
+    set<KeyValue> result = db->Scan(KeyValue(1, ""), KeyValue(30, ""));
+    ASSERT_EQ(result.size(), 30);
+    for (const KeyValue& kv : result) {
+        EXPECT_EQ(std::get<int>(kv.getValue()), 4);
+    }
+
+    db->Close();
+    fs::remove_all("test_db");
+}
+
+TEST(APITest, BackgroundFlushConcurrentReaders) {
+    auto db = std::make_unique<kvdb::API>(100);
+    db->Open("test_db");
+
+    std::atomic<int> written{0};
+    std::atomic<bool> failed{false};
+    std::thread reader([&]() {
+        while (written.load() < 5000) {
+            int upto = written.load();
+            if (upto > 0 && db->Get(KeyValue(upto, "")).isEmpty()) {
+                failed = true;
+            }
+        }
+    });
+    for (int i = 1; i <= 5000; ++i) {
+        db->Put(i, i);
+        written = i;
+    }
+    reader.join();
+    EXPECT_FALSE(failed.load());
+
+    db->Close();
+    fs::remove_all("test_db");
+}
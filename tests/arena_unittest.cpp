@@ -0,0 +1,152 @@
+//
+// Created by Damian Li on 2024-09-24.
+//
+
+#include <gtest/gtest.h>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Arena.h"
+#include "RedBlackTree.h"
+#include "Memtable.h"
+
+namespace {
+    struct Counted {
+        explicit Counted(int* counter) : counter(counter) {}
+        ~Counted() { (*counter)++; }
+        int* counter;
+    };
+}
+
+TEST(ArenaTest, AllocationsAreAlignedAndDistinct) {
+    Arena arena;
+    std::vector<char*> ptrs;
+    for (int i = 1; i <= 1000; ++i) {
+        char* p = arena.allocate(i % 37 + 1, 8);
+        EXPECT_EQ(reinterpret_cast<uintptr_t>(p) % 8, 0);
+        std::memset(p, i & 0xff, i % 37 + 1);
+        ptrs.push_back(p);
+    }
+    // Every allocation kept its bytes: nothing overlapped
+    for (int i = 1; i <= 1000; ++i) {
+        for (int j = 0; j < i % 37 + 1; ++j) {
+            ASSERT_EQ(static_cast<unsigned char>(ptrs[i - 1][j]), i & 0xff);
+        }
+    }
+    EXPECT_GE(arena.memoryUsage(), 1000);
+}
+
+TEST(ArenaTest, LargeAllocationGetsOwnBlock) {
+    Arena arena;
+    arena.allocate(16);
+    EXPECT_EQ(arena.getNumBlocks(), 1);
+    arena.allocate(Arena::BLOCK_SIZE * 2);
+    EXPECT_EQ(arena.getNumBlocks(), 2);
+    EXPECT_GE(arena.memoryUsage(), Arena::BLOCK_SIZE * 3);
+    // Small allocations still fit the first block
+    arena.allocate(16);
+    EXPECT_EQ(arena.getNumBlocks(), 2);
+}
+
+TEST(ArenaTest, CleanupsRunOnDestruction) {
+    int destroyed = 0;
+    {
+        Arena arena;
+        for (int i = 0; i < 10; ++i) {
+            arena.addCleanup(arena.make<Counted>(&destroyed));
+        }
+        arena.make<Counted>(&destroyed);  // not registered: never destroyed
+        EXPECT_EQ(destroyed, 0);
+    }
+    EXPECT_EQ(destroyed, 10);
+}
+
+TEST(ArenaTest, ConcurrentAllocate) {
+    Arena arena;
+    std::vector<std::thread> threads;
+    std::vector<std::vector<uint64_t*>> ptrs(4);
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&arena, &ptrs, t]() {
+            for (uint64_t i = 0; i < 5000; ++i) {
+                auto* p = reinterpret_cast<uint64_t*>(arena.allocate(sizeof(uint64_t), alignof(uint64_t)));
+                *p = t * 100000 + i;
+                ptrs[t].push_back(p);
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    for (int t = 0; t < 4; ++t) {
+        for (uint64_t i = 0; i < 5000; ++i) {
+            ASSERT_EQ(*ptrs[t][i], t * 100000 + i);
+        }
+    }
+}
+
+TEST(ArenaTest, ConcurrentMixedAlignmentsAndBlocks) {
+    Arena arena;
+    std::vector<std::thread> threads;
+    std::vector<std::vector<std::pair<char*, size_t>>> ptrs(4);
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&arena, &ptrs, t]() {
+            for (size_t i = 0; i < 3000; ++i) {
+                size_t bytes = (i * 7 + t) % (Arena::BLOCK_SIZE / 2) + 1;  // some take their own block
+                size_t align = size_t(1) << (i % 5);
+                char* p = arena.allocate(bytes, align);
+                ASSERT_EQ(reinterpret_cast<uintptr_t>(p) % align, 0);
+                std::memset(p, t + 1, bytes);
+                ptrs[t].emplace_back(p, bytes);
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    // No two allocations overlapped
+    for (int t = 0; t < 4; ++t) {
+        for (const auto& [p, bytes] : ptrs[t]) {
+            ASSERT_EQ(p[0], t + 1);
+            ASSERT_EQ(p[bytes - 1], t + 1);
+        }
+    }
+}
+
+TEST(ArenaTest, RedBlackTreeInArena) {
+    Arena arena;
+    const std::string long_value(100, 'v');
+    {
+        RedBlackTree tree(&arena);
+        for (int i = 1; i <= 500; ++i) {
+            tree.insert(KeyValue(i, long_value + std::to_string(i)));
+        }
+        tree.insert(KeyValue(7, "short"));
+        tree.deleteKey(KeyValue(8, ""));
+        EXPECT_EQ(std::get<std::string>(tree.getValue(KeyValue(7, "")).getValue()), "short");
+        EXPECT_EQ(std::get<std::string>(tree.getValue(KeyValue(9, "")).getValue()), long_value + "9");
+        EXPECT_TRUE(tree.getValue(KeyValue(8, "")).isEmpty());
+        EXPECT_EQ(tree.inOrderFlushToSst().size(), 499);
+    }
+    // 500 nodes plus their heap strings are released with the arena
+    EXPECT_GE(arena.memoryUsage(), 500 * sizeof(TreeNode));
+}
+
+TEST(ArenaTest, MemtableFreesArenaOnFlush) {
+    for (MemtableRep rep : {MemtableRep::RED_BLACK_TREE, MemtableRep::SKIPLIST}) {
+        Memtable memtable(200, rep);
+        memtable.set_path("test_db");
+        const size_t empty_usage = memtable.approximateMemoryUsage();
+        for (int i = 1; i <= 200; ++i) {
+            memtable.put(KeyValue("key_with_a_long_prefix_" + std::to_string(i), std::string(64, 'x')));
+        }
+        EXPECT_GT(memtable.approximateMemoryUsage(), empty_usage + 200 * sizeof(KeyValue));
+        // The next new key flushes: the old arena goes away and a fresh one takes the new key
+        memtable.put(KeyValue("z", 1));
+        EXPECT_LE(memtable.approximateMemoryUsage(), 2 * Arena::BLOCK_SIZE);
+        EXPECT_EQ(memtable.get_currentSize(), 1);
+        EXPECT_EQ(std::get<int>(memtable.get(KeyValue("z", "")).getValue()), 1);
+    }
+    std::filesystem::remove_all("test_db");
+}
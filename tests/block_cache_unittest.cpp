@@ -0,0 +1,150 @@
+//
+// Created by Damian Li on 2024-09-17.
+//
+
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <thread>
+#include <vector>
+#include "BlockCache.h"
+#include "FileManager.h"
+#include "SSTable.h"
+#include "api.h"
+
+namespace fs = std::filesystem;
+
+namespace {
+    BlockCache::BlockPtr makeBlock(int first, int n) {
+        auto block = std::make_shared<BlockCache::Block>();
+        for (int i = first; i < first + n; ++i) {
+            block->emplace_back(i, i);
+        }
+        return block;
+    }
+}
+
+TEST(BlockCacheTest, InsertAndLookup) {
+    BlockCache cache(1024, 0);
+    EXPECT_EQ(cache.lookup(1, 0), nullptr);
+
+    cache.insert(1, 0, makeBlock(0, 3), 100);
+    BlockCache::BlockPtr block = cache.lookup(1, 0);
+    ASSERT_NE(block, nullptr);
+    EXPECT_EQ(block->size(), 3);
+
+    // Same offset of another file is a different entry
+    EXPECT_EQ(cache.lookup(2, 0), nullptr);
+    EXPECT_EQ(cache.getHits(), 1);
+    EXPECT_EQ(cache.getMisses(), 2);
+    EXPECT_EQ(cache.getUsage(), 100);
+}
+
+TEST(BlockCacheTest, EvictsLeastRecentlyUsed) {
+    BlockCache cache(300, 0);  // single shard to make the LRU order observable
+    cache.insert(1, 0, makeBlock(0, 1), 100);
+    cache.insert(1, 100, makeBlock(1, 1), 100);
+    cache.insert(1, 200, makeBlock(2, 1), 100);
+
+    // Touch the oldest entry, then overflow the capacity
+    ASSERT_NE(cache.lookup(1, 0), nullptr);
+    cache.insert(1, 300, makeBlock(3, 1), 100);
+
+    EXPECT_NE(cache.lookup(1, 0), nullptr);
+    EXPECT_EQ(cache.lookup(1, 100), nullptr);  // least recently used
+    EXPECT_NE(cache.lookup(1, 200), nullptr);
+    EXPECT_NE(cache.lookup(1, 300), nullptr);
+    EXPECT_LE(cache.getUsage(), 300);
+}
+
+TEST(BlockCacheTest, ReplaceAndErase) {
+    BlockCache cache(1000, 0);
+    cache.insert(1, 0, makeBlock(0, 1), 100);
+    cache.insert(1, 0, makeBlock(5, 2), 200);
+    EXPECT_EQ(cache.getUsage(), 200);
+    EXPECT_EQ(cache.lookup(1, 0)->size(), 2);
+
+    cache.erase(1, 0);
+    EXPECT_EQ(cache.getUsage(), 0);
+    EXPECT_EQ(cache.lookup(1, 0), nullptr);
+}
+
+TEST(BlockCacheTest, ShrinkCapacityEvicts) {
+    BlockCache cache(10000);
+    for (uint64_t i = 0; i < 50; ++i) {
+        cache.insert(1, i * 100, makeBlock(0, 1), 100);
+    }
+    EXPECT_EQ(cache.getUsage(), 5000);
+
+    cache.setCapacity(0);
+    EXPECT_EQ(cache.getUsage(), 0);
+    cache.insert(1, 0, makeBlock(0, 1), 100);
+    EXPECT_EQ(cache.lookup(1, 0), nullptr);
+}
+
+TEST(BlockCacheTest, ConcurrentReadersAndWriters) {
+    BlockCache cache(64 * 1024);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 8; ++t) {
+        threads.emplace_back([&cache, t]() {
+            for (uint64_t i = 0; i < 2000; ++i) {
+                uint64_t offset = (i * 7 + t) % 500;
+                if (!cache.lookup(offset % 4, offset)) {
+                    cache.insert(offset % 4, offset, makeBlock(0, 1), 64);
+                }
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    EXPECT_EQ(cache.getHits() + cache.getMisses(), 16000);
+    EXPECT_LE(cache.getUsage(), 64 * 1024 + 64 * cache.getNumShards());
+}
+
+TEST(BlockCacheTest, SSTableServesRepeatedGetsFromCache) {
+    FileManager fileManager(fs::path("test_db"));
+    fileManager.setBlockSize(256);
+    std::vector<KeyValue> kv_pairs;
+    for (int i = 0; i < 1000; ++i) {
+        kv_pairs.emplace_back(i, "value_" + std::to_string(i));
+    }
+    FlushSSTInfo info = fileManager.flushToDisk(kv_pairs);
+
+    auto cache = std::make_shared<BlockCache>();
+    std::shared_ptr<SSTable> table = SSTable::open(fs::path("test_db") / info.fileName, cache);
+
+    EXPECT_EQ(std::get<std::string>(table->get(KeyValue(500, "")).getValue()), "value_500");
+    EXPECT_EQ(cache->getMisses(), 1);
+    EXPECT_EQ(std::get<std::string>(table->get(KeyValue(500, "")).getValue()), "value_500");
+    EXPECT_EQ(cache->getHits(), 1);
+    EXPECT_TRUE(table->get(KeyValue(2000, "")).isEmpty());
+
+    // Scans read through cached blocks but do not fill the cache
+    size_t usage = cache->getUsage();
+    std::set<KeyValue> res;
+    table->scan(KeyValue(0, ""), KeyValue(999, ""), res);
+    EXPECT_EQ(res.size(), 1000);
+    EXPECT_EQ(cache->getUsage(), usage);
+
+    fs::remove_all("test_db");
+}
+
+TEST(BlockCacheTest, ConfigureCapacityOnAPI) {
+    auto db = std::make_unique<kvdb::API>(100);
+    db->SetBlockCacheCapacity(1 << 20);
+    EXPECT_EQ(db->GetBlockCache()->getCapacity(), 1 << 20);
+
+    db->Open("test_db");
+    for (int i = 1; i <= 1000; ++i) {
+        db->Put(i, i);
+    }
+    for (int round = 0; round < 2; ++round) {
+        for (int i = 1; i <= 500; ++i) {
+            EXPECT_EQ(std::get<int>(db->Get(KeyValue(i, "")).getValue()), i);
+        }
+    }
+    EXPECT_GT(db->GetBlockCache()->getHits(), 0);
+    db->Close();
+
+    fs::remove_all("test_db");
+}
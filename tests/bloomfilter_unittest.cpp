@@ -0,0 +1,176 @@
+//
+// Created by Damian Li on 2024-09-15.
+//
+
+#include <gtest/gtest.h>
+#include <sstream>
+#include <filesystem>
+#include "BloomFilter.h"
+#include "FileManager.h"
+#include "SSTIndex.h"
+#include "api.h"
+
+namespace fs = std::filesystem;
+
+TEST(BloomFilterTest, NoFalseNegatives) {
+    BloomFilter filter(1000, 10);
+    for (int i = 0; i < 1000; ++i) {
+        filter.addKey(KeyValue(i, 0));
+        filter.addKey(KeyValue("key_" + std::to_string(i), 0));
+    }
+    for (int i = 0; i < 1000; ++i) {
+        EXPECT_TRUE(filter.mayContain(KeyValue(i, 0)));
+        EXPECT_TRUE(filter.mayContain(KeyValue("key_" + std::to_string(i), 0)));
+    }
+}
+
+TEST(BloomFilterTest, FalsePositiveRate) {
+    BloomFilter filter(10000, 10);
+    for (int i = 0; i < 10000; ++i) {
+        filter.addKey(KeyValue(i, 0));
+    }
+    int false_positives = 0;
+    for (int i = 10000; i < 20000; ++i) {
+        if (filter.mayContain(KeyValue(i, 0))) {
+            false_positives++;
+        }
+    }
+    // ~1% expected at 10 bits per key
+    EXPECT_LT(false_positives, 300);
+}
+
+TEST(BloomFilterTest, EqualNumericKeysShareBits) {
+    BloomFilter filter(10, 10);
+    filter.addKey(KeyValue(5, 0));
+    filter.addKey(KeyValue('A', 0));
+
+    // Keys equal under KeyValue::operator== must not be rejected
+    EXPECT_TRUE(filter.mayContain(KeyValue(5LL, 0)));
+    EXPECT_TRUE(filter.mayContain(KeyValue(5.0, 0)));
+    EXPECT_TRUE(filter.mayContain(KeyValue(65, 0)));
+}
+
+TEST(BloomFilterTest, SerializeRoundTrip) {
+    BloomFilter filter(100, 8);
+    for (int i = 0; i < 100; ++i) {
+        filter.addKey(KeyValue(i, 0));
+    }
+
+    std::stringstream ss;
+    filter.serialize(ss);
+    BloomFilter restored = BloomFilter::deserialize(ss);
+
+    EXPECT_EQ(restored.getNumBits(), filter.getNumBits());
+    EXPECT_EQ(restored.getNumProbes(), filter.getNumProbes());
+    for (int i = 0; i < 100; ++i) {
+        EXPECT_TRUE(restored.mayContain(KeyValue(i, 0)));
+    }
+}
+
+TEST(BloomFilterTest, EmptyFilterMayContainEverything) {
+    BloomFilter filter;
+    EXPECT_TRUE(filter.empty());
+    EXPECT_TRUE(filter.mayContain(KeyValue(1, 0)));
+}
+
+TEST(BloomFilterTest, FilterBlockWrittenToSST) {
+    FileManager fileManager(fs::path("test_db"));
+    std::vector<KeyValue> kv_pairs;
+    for (int i = 0; i < 100; ++i) {
+        kv_pairs.emplace_back(i * 2, i);
+    }
+
+    FlushSSTInfo info = fileManager.flushToDisk(kv_pairs);
+    ASSERT_NE(info.filter, nullptr);
+
+    // The filter read back from the file matches the one built at flush time
+    std::shared_ptr<BloomFilter> loaded = fileManager.loadFilter(info.fileName);
+    ASSERT_NE(loaded, nullptr);
+    EXPECT_EQ(loaded->getNumBits(), info.filter->getNumBits());
+    for (int i = 0; i < 100; ++i) {
+        EXPECT_TRUE(loaded->mayContain(KeyValue(i * 2, 0)));
+    }
+
+    fs::remove_all("test_db");
+}
+
+TEST(BloomFilterTest, DisabledFilter) {
+    FileManager fileManager(fs::path("test_db"));
+    fileManager.setBloomBitsPerKey(0);
+
+    FlushSSTInfo info = fileManager.flushToDisk({KeyValue(1, 1), KeyValue(2, 2)});
+    EXPECT_EQ(info.filter, nullptr);
+    EXPECT_EQ(fileManager.loadFilter(info.fileName), nullptr);
+    EXPECT_EQ(std::get<int>(fileManager.searchInSST(info.fileName, KeyValue(2, "")).getValue()), 2);
+
+    fs::remove_all("test_db");
+}
+
+TEST(BloomFilterTest, SearchSkipsRejectedSSTs) {
+    FileManager fileManager(fs::path("test_db"));
+    SSTIndex sstIndex;
+    sstIndex.set_path(fs::path("test_db"));
+
+    // Two overlapping SSTs: even keys and odd keys
+    std::vector<KeyValue> even, odd;
+    for (int i = 1; i <= 200; ++i) {
+        (i % 2 == 0 ? even : odd).emplace_back(i, i * 10);
+    }
+    FlushSSTInfo info1 = fileManager.flushToDisk(even);
+    FlushSSTInfo info2 = fileManager.flushToDisk(odd);
+    sstIndex.addSST(info1.fileName, info1.smallest_key, info1.largest_key, info1.filter);
+    sstIndex.addSST(info2.fileName, info2.smallest_key, info2.largest_key, info2.filter);
+
+    // Remove the even file: lookups for odd keys must be answered by the filter alone
+    fs::remove("test_db/" + info1.fileName);
+    int found = 0;
+    for (int i = 1; i <= 200; i += 2) {
+        try {
+            KeyValue result = sstIndex.Search(KeyValue(i, ""));
+            EXPECT_EQ(std::get<int>(result.getValue()), i * 10);
+            found++;
+        } catch (const std::runtime_error&) {
+            // false positive on the removed file
+        }
+    }
+    EXPECT_GT(found, 90);
+
+    fs::remove_all("test_db");
+}
+
+TEST(BloomFilterTest, FiltersReloadedWithIndex) {
+    FileManager fileManager(fs::path("test_db"));
+    SSTIndex sstIndex;
+    sstIndex.set_path(fs::path("test_db"));
+
+    FlushSSTInfo info = fileManager.flushToDisk({KeyValue(1, 1), KeyValue(3, 3)});
+    sstIndex.addSST(info.fileName, info.smallest_key, info.largest_key, info.filter);
+    sstIndex.flushToDisk();
+    sstIndex.getAllSSTs();
+
+    deque<SSTInfo*> index = sstIndex.getSSTsIndex();
+    ASSERT_EQ(index.size(), 1);
+    ASSERT_NE(index.front()->filter, nullptr);
+    EXPECT_TRUE(index.front()->filter->mayContain(KeyValue(3, 0)));
+
+    fs::remove_all("test_db");
+}
+
+TEST(BloomFilterTest, ConfigureBitsPerKeyOnAPI) {
+    auto db = std::make_unique<kvdb::API>(10);
+    db->SetBloomFilterBitsPerKey(16);
+    EXPECT_EQ(db->GetBloomFilterBitsPerKey(), 16);
+    EXPECT_THROW(db->SetBloomFilterBitsPerKey(-1), std::invalid_argument);
+
+    db->Open("test_db");
+    for (int i = 1; i <= 100; ++i) {
+        db->Put(i, i);
+    }
+    for (int i = 1; i <= 100; ++i) {
+        EXPECT_EQ(std::get<int>(db->Get(KeyValue(i, "")).getValue()), i);
+    }
+    EXPECT_TRUE(db->Get(KeyValue(1000, "")).isEmpty());
+    db->Close();
+
+    fs::remove_all("test_db");
+}
@@ -0,0 +1,236 @@
+//
+// Created by Damian Li on 2024-09-20.
+//
+
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <vector>
+#include "Compaction.h"
+#include "SSTIndex.h"
+#include "api.h"
+
+namespace fs = std::filesystem;
+
+namespace {
+    // SST with keys [first, last] all mapped to value
+    FlushSSTInfo writeSST(FileManager& fileManager, int first, int last, int value) {
+        std::vector<KeyValue> kv_pairs;
+        for (int i = first; i <= last; ++i) {
+            kv_pairs.emplace_back(i, value);
+        }
+        return fileManager.flushToDisk(kv_pairs);
+    }
+
+    void expectNonOverlappingLevels(SSTIndex& sstIndex, int num_levels) {
+        for (int level = 1; level < num_levels; ++level) {
+            std::vector<SSTInfo*> files;
+            for (SSTInfo* info : sstIndex.getSSTsIndex()) {
+                if (info->level == level) files.push_back(info);
+            }
+            std::sort(files.begin(), files.end(), [](SSTInfo* a, SSTInfo* b) {return a->smallest_key < b->smallest_key;});
+            for (size_t i = 1; i < files.size(); ++i) {
+                EXPECT_LT(files[i - 1]->largest_key, files[i]->smallest_key) << "level " << level;
+            }
+        }
+    }
+}
+
+TEST(CompactionTest, MergeKeepsNewestVersion) {
+    FileManager fileManager(fs::path("test_db"));
+    FlushSSTInfo older = writeSST(fileManager, 1, 100, 1);
+    FlushSSTInfo newer = writeSST(fileManager, 50, 150, 2);
+
+    std::vector<std::shared_ptr<SSTable>> inputs = {
+        SSTable::open(fs::path("test_db") / newer.fileName),
+        SSTable::open(fs::path("test_db") / older.fileName)};
+    std::vector<FlushSSTInfo> outputs = Compaction::merge(inputs, fileManager, 1 << 20);
+    ASSERT_EQ(outputs.size(), 1);
+
+    std::vector<KeyValue> merged = SSTable::open(fs::path("test_db") / outputs[0].fileName)->readAll();
+    ASSERT_EQ(merged.size(), 150);
+    for (int i = 1; i <= 150; ++i) {
+        EXPECT_EQ(std::get<int>(merged[i - 1].getKey()), i);
+        EXPECT_EQ(std::get<int>(merged[i - 1].getValue()), i < 50 ? 1 : 2);
+    }
+    fs::remove_all("test_db");
+}
+
+TEST(CompactionTest, MergeSplitsOutputByTargetSize) {
+    FileManager fileManager(fs::path("test_db"));
+    FlushSSTInfo info = writeSST(fileManager, 1, 1000, 7);
+    std::vector<std::shared_ptr<SSTable>> inputs = {SSTable::open(fs::path("test_db") / info.fileName)};
+
+    uint64_t target = 100 * Compaction::approximateSize(KeyValue(1, 7));
+    std::vector<FlushSSTInfo> outputs = Compaction::merge(inputs, fileManager, target);
+    ASSERT_EQ(outputs.size(), 10);
+    for (size_t i = 1; i < outputs.size(); ++i) {
+        EXPECT_LT(outputs[i - 1].largest_key, outputs[i].smallest_key);
+    }
+    fs::remove_all("test_db");
+}
+
+TEST(CompactionTest, Level0IntoLevel1) {
+    FileManager fileManager(fs::path("test_db"));
+    SSTIndex sstIndex;
+    sstIndex.set_path(fs::path("test_db"));
+    CompactionOptions options;
+    options.level0_file_num_trigger = 4;
+    sstIndex.setCompactionOptions(options);
+
+    std::vector<std::string> l0_files;
+    for (int round = 0; round < 4; ++round) {
+        FlushSSTInfo info = writeSST(fileManager, round * 10, round * 10 + 50, round);
+        sstIndex.addSST(info.fileName, info.smallest_key, info.largest_key, info.filter);
+        l0_files.push_back(info.fileName);
+        EXPECT_EQ(sstIndex.needsCompaction(), round == 3);
+    }
+
+    EXPECT_TRUE(sstIndex.compactOnce());
+    EXPECT_EQ(sstIndex.getLevelFileCount(0), 0);
+    EXPECT_EQ(sstIndex.getLevelFileCount(1), 1);
+    EXPECT_FALSE(sstIndex.needsCompaction());
+    for (const std::string& filename : l0_files) {
+        EXPECT_FALSE(fs::exists(fs::path("test_db") / filename));
+    }
+
+    // Newest round wins for every key
+    for (int i = 1; i <= 80; ++i) {
+        int expected = std::min(i / 10, 3);
+        EXPECT_EQ(std::get<int>(sstIndex.Search(KeyValue(i, "")).getValue()), expected) << i;
+    }
+    fs::remove_all("test_db");
+}
+
+TEST(CompactionTest, DeeperLevelsStayNonOverlapping) {
+    FileManager fileManager(fs::path("test_db"));
+    SSTIndex sstIndex;
+    sstIndex.set_path(fs::path("test_db"));
+    CompactionOptions options;
+    options.num_levels = 4;
+    options.level0_file_num_trigger = 2;
+    options.max_bytes_for_level_base = 4096;
+    options.max_bytes_for_level_multiplier = 4;
+    options.target_file_size = 1024;
+    sstIndex.setCompactionOptions(options);
+
+    for (int round = 0; round < 40; ++round) {
+        int first = (round * 37) % 300;
+        FlushSSTInfo info = writeSST(fileManager, first, first + 60, round);
+        sstIndex.addSST(info.fileName, info.smallest_key, info.largest_key, info.filter);
+        while (sstIndex.compactOnce()) {}
+        expectNonOverlappingLevels(sstIndex, options.num_levels);
+    }
+    EXPECT_GT(sstIndex.getLevelFileCount(2) + sstIndex.getLevelFileCount(3), 0);
+
+    // Reference: last round that wrote each key
+    std::map<int, int> expected;
+    for (int round = 0; round < 40; ++round) {
+        int first = (round * 37) % 300;
+        for (int i = first; i <= first + 60; ++i) expected[i] = round;
+    }
+    for (const auto& [key, round] : expected) {
+        if (key == 0) continue;  // key 0 reads as empty
+        EXPECT_EQ(std::get<int>(sstIndex.Search(KeyValue(key, "")).getValue()), round) << key;
+    }
+    std::set<KeyValue> res;
+    sstIndex.Scan(KeyValue(1, ""), KeyValue(400, ""), res);
+    EXPECT_EQ(res.size(), expected.size() - 1);
+    fs::remove_all("test_db");
+}
+
+TEST(CompactionTest, TrivialMoveKeepsFile) {
+    FileManager fileManager(fs::path("test_db"));
+    SSTIndex sstIndex;
+    sstIndex.set_path(fs::path("test_db"));
+    CompactionOptions options;
+    options.level0_file_num_trigger = 1;
+    sstIndex.setCompactionOptions(options);
+
+    FlushSSTInfo info = writeSST(fileManager, 1, 10, 1);
+    sstIndex.addSST(info.fileName, info.smallest_key, info.largest_key, info.filter);
+    EXPECT_TRUE(sstIndex.compactOnce());
+    ASSERT_EQ(sstIndex.getSSTsIndex().size(), 1);
+    EXPECT_EQ(sstIndex.getSSTsIndex().front()->filename, info.fileName);
+    EXPECT_EQ(sstIndex.getSSTsIndex().front()->level, 1);
+    EXPECT_TRUE(fs::exists(fs::path("test_db") / info.fileName));
+    fs::remove_all("test_db");
+}
+
+TEST(CompactionTest, IndexFilePersistsLevels) {
+    FileManager fileManager(fs::path("test_db"));
+    {
+        SSTIndex sstIndex;
+        sstIndex.set_path(fs::path("test_db"));
+        FlushSSTInfo deep = writeSST(fileManager, 1, 10, 1);
+        FlushSSTInfo fresh = writeSST(fileManager, 5, 15, 2);
+        sstIndex.addSST(deep.fileName, deep.smallest_key, deep.largest_key, deep.filter, 2);
+        sstIndex.addSST(fresh.fileName, fresh.smallest_key, fresh.largest_key, fresh.filter, 0);
+        sstIndex.flushToDisk();
+    }
+    SSTIndex sstIndex;
+    sstIndex.set_path(fs::path("test_db"));
+    sstIndex.getAllSSTs();
+    EXPECT_EQ(sstIndex.getLevelFileCount(2), 1);
+    EXPECT_EQ(sstIndex.getLevelFileCount(0), 1);
+    EXPECT_EQ(std::get<int>(sstIndex.Search(KeyValue(7, "")).getValue()), 2);
+    fs::remove_all("test_db");
+}
+
+TEST(CompactionTest, LevelLookupsTouchOnlyOverlappingFiles) {
+    FileManager fileManager(fs::path("test_db"));
+    SSTIndex sstIndex;
+    sstIndex.set_path(fs::path("test_db"));
+    // Disjoint files [10i + 1, 10i + 5] added to L1 out of key order
+    for (int i = 49; i >= 0; --i) {
+        FlushSSTInfo info = writeSST(fileManager, i * 10 + 1, i * 10 + 5, i + 1);
+        sstIndex.addSST(info.fileName, info.smallest_key, info.largest_key, info.filter, 1);
+    }
+    expectNonOverlappingLevels(sstIndex, 2);
+    TableCache& tableCache = sstIndex.getTableCache();
+
+    // Between two files: nothing is opened
+    EXPECT_TRUE(sstIndex.Search(KeyValue(257, "")).isEmpty());
+    EXPECT_EQ(tableCache.getNumOpen(), 0);
+    EXPECT_EQ(std::get<int>(sstIndex.Search(KeyValue(253, "")).getValue()), 26);
+    EXPECT_EQ(tableCache.getNumOpen(), 1);
+
+    // Files 10 to 15, and none past the end of the range
+    std::set<KeyValue> res;
+    sstIndex.Scan(KeyValue(103, ""), KeyValue(152, ""), res);
+    EXPECT_EQ(res.size(), 3 + 4 * 5 + 2);
+    EXPECT_EQ(tableCache.getNumOpen(), 7);
+
+    std::vector<KeyValue> keys = {KeyValue(1, ""), KeyValue(8, ""), KeyValue(495, "")};
+    std::vector<KeyValue> results(keys.size());
+    sstIndex.MultiSearch(keys, results);
+    EXPECT_EQ(std::get<int>(results[0].getValue()), 1);
+    EXPECT_TRUE(results[1].isEmpty());
+    EXPECT_EQ(std::get<int>(results[2].getValue()), 50);
+    fs::remove_all("test_db");
+}
+
+TEST(CompactionTest, BackgroundCompactionThroughAPI) {
+    auto db = std::make_unique<kvdb::API>(100);
+    CompactionOptions options;
+    options.level0_file_num_trigger = 2;
+    options.max_bytes_for_level_base = 16 * 1024;
+    options.target_file_size = 4 * 1024;
+    db->SetCompactionOptions(options);
+    db->Open("test_db");
+
+    for (int round = 0; round < 3; ++round) {
+        for (int i = 1; i <= 2000; ++i) {
+            db->Put(i, i + round);
+        }
+    }
+    db->WaitForCompaction();
+    EXPECT_LT(db->GetIndex()->getLevelFileCount(0), 2);
+    expectNonOverlappingLevels(*db->GetIndex(), options.num_levels);
+
+    for (int i = 1; i <= 2000; ++i) {
+        EXPECT_EQ(std::get<int>(db->Get(KeyValue(i, "")).getValue()), i + 2);
+    }
+    EXPECT_EQ(db->Scan(KeyValue(1, ""), KeyValue(2000, "")).size(), 2000);
+    db->Close();
+    fs::remove_all("test_db");
+}
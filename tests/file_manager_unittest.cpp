@@ -6,7 +6,10 @@
 #include <string>
 #include <fstream>
 #include <filesystem>
+#include <sstream>
 #include "FileManager.h"
+#include "SSTable.h"
+#include "SSTIndex.h"
 
 namespace fs = std::filesystem;
 
@@ -90,10 +93,13 @@ TEST(FileManagerTest, VerifyFlushedFileContent) {
     SSTHeader header = SSTHeader::deserialize(file);
     EXPECT_EQ(header.num_key_values, 2);
 
-    // Deserialize and check the first KeyValue pair
+    // Deserialize and check the first KeyValue pair, followed by its sequence number
     SerializedKeyValue skv1 = SerializedKeyValue::deserialize(file);
     EXPECT_EQ(std::get<int>(skv1.kv.getKey()), 1);
     EXPECT_EQ(std::get<int>(skv1.kv.getValue()), 100);
+    uint64_t sequence = 1;
+    file.read(reinterpret_cast<char*>(&sequence), sizeof(sequence));
+    EXPECT_EQ(sequence, 0);
 
     // Deserialize and check the second KeyValue pair
     SerializedKeyValue skv2 = SerializedKeyValue::deserialize(file);
@@ -214,3 +220,209 @@ TEST(FileManagerTest, LoadFromEmptyFile) {
 }
 
 
+/*
+ * Block based SST:
+ * KeyValue FileManager::searchInSST(const std::string&, const KeyValue&)
+ * void FileManager::scanInSST(const std::string&, const KeyValue&, const KeyValue&, std::set<KeyValue>&)
+ */
+TEST(FileManagerTest, FooterAndIndexBlockWritten) {
+    FileManager fileManager(fs::path("test_db"));
+    fileManager.setBlockSize(64);
+    std::vector<KeyValue> kv_pairs;
+    for (int i = 0; i < 100; ++i) {
+        kv_pairs.emplace_back(i, i * 10);
+    }
+
+    FlushSSTInfo info = fileManager.flushToDisk(kv_pairs);
+
+    std::ifstream file("test_db/" + info.fileName, std::ios::binary);
+    ASSERT_TRUE(file.is_open());
+    file.seekg(-SSTFooter::ENCODED_SIZE, std::ios::end);
+    SSTFooter footer = SSTFooter::deserialize(file);
+    EXPECT_EQ(footer.magic, SSTFooter::MAGIC);
+
+    // Index block lists every data block with its first key
+    file.seekg(static_cast<std::streamoff>(footer.index_offset), std::ios::beg);
+    uint32_t num_blocks = 0;
+    file.read(reinterpret_cast<char*>(&num_blocks), sizeof(num_blocks));
+    EXPECT_GT(num_blocks, 1);
+    uint32_t total_entries = 0;
+    for (uint32_t i = 0; i < num_blocks; ++i) {
+        BlockHandle handle = BlockHandle::deserialize(file);
+        KeyValue first_key = SerializedKeyValue::deserializeKey(file);
+        EXPECT_EQ(std::get<int>(first_key.getKey()), static_cast<int>(total_entries));
+        total_entries += handle.num_entries;
+    }
+    EXPECT_EQ(total_entries, 100);
+
+    file.close();
+    fs::remove_all("test_db");
+}
+
+TEST(FileManagerTest, SearchAcrossBlocks) {
+    FileManager fileManager(fs::path("test_db"));
+    fileManager.setBlockSize(128);
+    std::vector<KeyValue> kv_pairs;
+    for (int i = 1; i <= 1000; i += 2) {
+        kv_pairs.emplace_back(i, "value_" + std::to_string(i));
+    }
+
+    FlushSSTInfo info = fileManager.flushToDisk(kv_pairs);
+
+    // Every stored key is found, including first/last keys of each block
+    for (int i = 1; i <= 1000; i += 2) {
+        KeyValue result = fileManager.searchInSST(info.fileName, KeyValue(i, ""));
+        ASSERT_FALSE(result.isEmpty());
+        EXPECT_EQ(std::get<std::string>(result.getValue()), "value_" + std::to_string(i));
+    }
+    // Keys between, below and above the stored keys are not found
+    EXPECT_TRUE(fileManager.searchInSST(info.fileName, KeyValue(500, "")).isEmpty());
+    EXPECT_TRUE(fileManager.searchInSST(info.fileName, KeyValue(-5, "")).isEmpty());
+    EXPECT_TRUE(fileManager.searchInSST(info.fileName, KeyValue(5000, "")).isEmpty());
+    EXPECT_TRUE(fileManager.searchInSST(info.fileName, KeyValue("key", "")).isEmpty());
+
+    fs::remove_all("test_db");
+}
+
+TEST(FileManagerTest, SearchInEmptyFile) {
+    FileManager fileManager(fs::path("test_db"));
+    FlushSSTInfo info = fileManager.flushToDisk({});
+
+    EXPECT_TRUE(fileManager.searchInSST(info.fileName, KeyValue(1, "")).isEmpty());
+
+    fs::remove_all("test_db");
+}
+
+TEST(FileManagerTest, ScanAcrossBlocks) {
+    FileManager fileManager(fs::path("test_db"));
+    fileManager.setBlockSize(100);
+    std::vector<KeyValue> kv_pairs;
+    for (int i = 0; i < 1000; ++i) {
+        kv_pairs.emplace_back(i, i);
+    }
+    kv_pairs.emplace_back("a", 1);
+    kv_pairs.emplace_back("b", 2);
+
+    FlushSSTInfo info = fileManager.flushToDisk(kv_pairs);
+
+    std::set<KeyValue> res;
+    fileManager.scanInSST(info.fileName, KeyValue(250, ""), KeyValue(749, ""), res);
+    ASSERT_EQ(res.size(), 500);
+    EXPECT_EQ(std::get<int>(res.begin()->getKey()), 250);
+    EXPECT_EQ(std::get<int>(res.rbegin()->getKey()), 749);
+
+    res.clear();
+    fileManager.scanInSST(info.fileName, KeyValue(998, ""), KeyValue("a", ""), res);
+    EXPECT_EQ(res.size(), 3);
+
+    res.clear();
+    fileManager.scanInSST(info.fileName, KeyValue("c", ""), KeyValue("d", ""), res);
+    EXPECT_EQ(res.size(), 0);
+
+    fs::remove_all("test_db");
+}
+/*
+ * Memory mapped read path:
+ * std::shared_ptr<SSTable> SSTable::open(const fs::path&)
+ * SerializedKeyValue SerializedKeyValue::decode(const char*&, const char*)
+ */
+TEST(FileManagerTest, DecodeMatchesDeserialize) {
+    std::vector<KeyValue> kv_pairs = {
+        KeyValue(1, "one"), KeyValue(2LL, 3.5), KeyValue(4.25, 'x'), KeyValue('c', 7LL), KeyValue("key", "value")
+    };
+    std::stringstream ss;
+    for (const auto& kv : kv_pairs) {
+        SerializedKeyValue skv{kv, 0};
+        skv.kv_checksum = skv.calculateChecksum();
+        skv.serialize(ss);
+    }
+    std::string bytes = ss.str();
+
+    const char* p = bytes.data();
+    const char* end = p + bytes.size();
+    for (const auto& kv : kv_pairs) {
+        SerializedKeyValue decoded = SerializedKeyValue::decode(p, end);
+        SerializedKeyValue expected = SerializedKeyValue::deserialize(ss);
+        EXPECT_TRUE(decoded.kv == kv);
+        EXPECT_EQ(decoded.kv.getValueType(), kv.getValueType());
+        EXPECT_EQ(decoded.kv.getValue(), expected.kv.getValue());
+        EXPECT_EQ(decoded.kv_checksum, expected.kv_checksum);
+    }
+    EXPECT_EQ(p, end);
+
+    // Truncated input is rejected instead of read past the end
+    const char* q = bytes.data();
+    EXPECT_THROW(SerializedKeyValue::decode(q, bytes.data() + 6), std::runtime_error);
+}
+
+TEST(FileManagerTest, LegacySSTWithoutFooterIsReadable) {
+    fs::create_directories("test_db");
+    {
+        // v1.1 layout: SSTHeader followed by records, no index block or footer
+        std::ofstream file("test_db/legacy.sst", std::ios::binary);
+        SSTHeader header{3, 0};
+        header.header_checksum = header.calculateChecksum();
+        header.serialize(file);
+        for (int i = 1; i <= 3; ++i) {
+            SerializedKeyValue skv{KeyValue(i, i * 100), 0};
+            skv.kv_checksum = skv.calculateChecksum();
+            skv.serialize(file);
+        }
+    }
+
+    FileManager fileManager(fs::path("test_db"));
+    EXPECT_EQ(std::get<int>(fileManager.searchInSST("legacy.sst", KeyValue(2, "")).getValue()), 200);
+    EXPECT_TRUE(fileManager.searchInSST("legacy.sst", KeyValue(4, "")).isEmpty());
+
+    std::set<KeyValue> res;
+    fileManager.scanInSST("legacy.sst", KeyValue(1, ""), KeyValue(3, ""), res);
+    EXPECT_EQ(res.size(), 3);
+
+    fs::remove_all("test_db");
+}
+
+TEST(FileManagerTest, SSTableReadAllAndFileSize) {
+    FileManager fileManager(fs::path("test_db"));
+    fileManager.setBlockSize(64);
+    std::vector<KeyValue> kv_pairs;
+    for (int i = 0; i < 200; ++i) {
+        kv_pairs.emplace_back(i, "v" + std::to_string(i));
+    }
+    FlushSSTInfo info = fileManager.flushToDisk(kv_pairs);
+
+    std::shared_ptr<SSTable> table = SSTable::open(fs::path("test_db") / info.fileName);
+    EXPECT_EQ(table->getFileSize(), fs::file_size(fs::path("test_db") / info.fileName));
+    EXPECT_GT(table->getBlocks().size(), 1);
+
+    std::vector<KeyValue> all = table->readAll();
+    ASSERT_EQ(all.size(), 200);
+    for (int i = 0; i < 200; ++i) {
+        EXPECT_EQ(std::get<int>(all[i].getKey()), i);
+        EXPECT_EQ(std::get<std::string>(all[i].getValue()), "v" + std::to_string(i));
+    }
+
+    fs::remove_all("test_db");
+}
+
+TEST(FileManagerTest, SSTIndexKeepsTableMapped) {
+    FileManager fileManager(fs::path("test_db"));
+    FlushSSTInfo info = fileManager.flushToDisk({KeyValue(1, 10), KeyValue(2, 20)});
+
+    SSTIndex sstIndex;
+    sstIndex.set_path(fs::path("test_db"));
+    sstIndex.addSST(info.fileName, info.smallest_key, info.largest_key, info.filter);
+    EXPECT_EQ(sstIndex.getTableCache().getNumOpen(), 0);
+
+    // First lookup maps the file, later lookups reuse the same mapping
+    EXPECT_EQ(std::get<int>(sstIndex.Search(KeyValue(1, "")).getValue()), 10);
+    std::shared_ptr<SSTable> table = sstIndex.getTableCache().findTable(info.fileName);
+    ASSERT_NE(table, nullptr);
+    EXPECT_EQ(std::get<int>(sstIndex.Search(KeyValue(2, "")).getValue()), 20);
+    std::set<KeyValue> res;
+    sstIndex.Scan(KeyValue(1, ""), KeyValue(2, ""), res);
+    EXPECT_EQ(res.size(), 2);
+    EXPECT_EQ(sstIndex.getTableCache().findTable(info.fileName), table);
+    EXPECT_EQ(sstIndex.getTableCache().getMisses(), 1);
+
+    fs::remove_all("test_db");
+}
@@ -0,0 +1,285 @@
+//
+// Created by Damian Li on 2024-09-21.
+//
+
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <memory>
+#include <vector>
+#include "Iterator.h"
+#include "MergingIterator.h"
+#include "LevelIterator.h"
+#include "SSTable.h"
+#include "Memtable.h"
+#include "Snapshot.h"
+#include "api.h"
+
+namespace fs = std::filesystem;
+
+namespace {
+    std::unique_ptr<Iterator> vectorIterator(std::initializer_list<std::pair<int, int>> kvs) {
+        std::vector<KeyValue> entries;
+        for (const auto& [k, v] : kvs) {
+            entries.emplace_back(k, v);
+        }
+        return std::make_unique<VectorIterator>(std::move(entries));
+    }
+
+    std::vector<std::pair<int, int>> drain(Iterator& it) {
+        std::vector<std::pair<int, int>> out;
+        for (; it.Valid(); it.Next()) {
+            out.emplace_back(std::get<int>(it.key()), std::get<int>(it.value()));
+        }
+        return out;
+    }
+}
+
+TEST(IteratorTest, VectorIteratorSeek) {
+    auto it = vectorIterator({{1, 10}, {3, 30}, {5, 50}});
+    EXPECT_FALSE(it->Valid());
+    it->Seek(KeyValue(2, ""));
+    ASSERT_TRUE(it->Valid());
+    EXPECT_EQ(std::get<int>(it->key()), 3);
+    it->Seek(KeyValue(6, ""));
+    EXPECT_FALSE(it->Valid());
+    it->SeekToFirst();
+    EXPECT_EQ(drain(*it).size(), 3);
+}
+
+TEST(IteratorTest, MergingIteratorNewestWins) {
+    std::vector<std::unique_ptr<Iterator>> children;
+    children.push_back(vectorIterator({{2, 200}, {4, 400}}));          // newest
+    children.push_back(vectorIterator({{1, 10}, {2, 20}, {3, 30}}));
+    children.push_back(vectorIterator({{2, 2}, {3, 3}, {4, 4}, {6, 6}}));  // oldest
+    MergingIterator it(std::move(children));
+
+    it.SeekToFirst();
+    std::vector<std::pair<int, int>> expected = {{1, 10}, {2, 200}, {3, 30}, {4, 400}, {6, 6}};
+    EXPECT_EQ(drain(it), expected);
+
+    it.Seek(KeyValue(3, ""));
+    expected = {{3, 30}, {4, 400}, {6, 6}};
+    EXPECT_EQ(drain(it), expected);
+
+    it.Seek(KeyValue(7, ""));
+    EXPECT_FALSE(it.Valid());
+}
+
+TEST(IteratorTest, MergingIteratorManyRangeTombstones) {
+    // Newer child: keys 0..999 at sequence 2, with tombstones of sequence 3 over every 10th
+    // block of 5 keys; older child: keys 0..999 at sequence 1, with long overlapping tombstones
+    std::vector<KeyValue> newer, older;
+    for (int k = 0; k < 1000; ++k) {
+        newer.emplace_back(k, k);
+        newer.back().setSequence(2);
+        older.emplace_back(k, -k);
+        older.back().setSequence(1);
+    }
+    std::vector<KeyValue> newer_ranges, older_ranges;
+    for (int start = 0; start < 1000; start += 10) {
+        newer_ranges.push_back(KeyValue::RangeTombstone(start, start + 5));
+        newer_ranges.back().setSequence(3);
+    }
+    for (int start = 0; start < 1000; start += 100) {
+        older_ranges.push_back(KeyValue::RangeTombstone(start, start + 250));  // older than newer's keys
+        older_ranges.back().setSequence(1);
+    }
+    auto expected = [](int from) {
+        std::vector<std::pair<int, int>> out;
+        for (int k = from; k < 1000; ++k) {
+            if (k % 10 >= 5) {
+                out.emplace_back(k, k);
+            }
+        }
+        return out;
+    };
+    std::vector<std::unique_ptr<Iterator>> children;
+    children.push_back(std::make_unique<VectorIterator>(newer));
+    children.push_back(std::make_unique<VectorIterator>(older));
+    MergingIterator it(std::move(children), {newer_ranges, older_ranges});
+    it.SeekToFirst();
+    EXPECT_EQ(drain(it), expected(0));
+    // A Seek restarts the tombstone cursors, also backwards
+    it.Seek(KeyValue(503, ""));
+    EXPECT_EQ(drain(it), expected(503));
+    it.Seek(KeyValue(12, ""));
+    EXPECT_EQ(drain(it), expected(12));
+}
+
+TEST(IteratorTest, MemtableIteratorAsOfSequence) {
+    for (MemtableRep rep : {MemtableRep::RED_BLACK_TREE, MemtableRep::SKIPLIST}) {
+        auto snapshots = std::make_shared<SnapshotList>();
+        auto table = std::make_shared<Memtable>(1000, rep);
+        table->setSnapshotList(snapshots);
+        auto snapshot = snapshots->create(100);
+        // Even keys at sequence k, then odd keys overwritten past the snapshot, and key 99
+        // written only past it
+        for (int k = 0; k < 100; k += 2) {
+            KeyValue kv(k, k);
+            kv.setSequence(k);
+            table->insert(kv);
+        }
+        for (int k = 1; k < 99; k += 2) {
+            KeyValue old(k, k);
+            old.setSequence(k);
+            table->insert(old);
+            KeyValue overwrite(k, -k);
+            overwrite.setSequence(200 + k);
+            table->insert(overwrite);
+        }
+        KeyValue late(99, 99);
+        late.setSequence(500);
+        table->insert(late);
+
+        std::unique_ptr<Iterator> it = Memtable::newIterator(table, 100);
+        std::vector<std::pair<int, int>> expected;
+        for (int k = 0; k < 99; ++k) {
+            expected.emplace_back(k, k);
+        }
+        it->SeekToFirst();
+        EXPECT_EQ(drain(*it), expected);
+        it->Seek(KeyValue(41, ""));
+        std::vector<std::pair<int, int>> from_41(expected.begin() + 41, expected.end());
+        EXPECT_EQ(drain(*it), from_41);
+        it->Seek(KeyValue(99, ""));
+        EXPECT_FALSE(it->Valid());
+
+        // The newest versions, and the iterator keeps the memtable alive
+        it = Memtable::newIterator(table, KeyValue::MAX_SEQUENCE);
+        table.reset();
+        it->Seek(KeyValue(97, ""));
+        std::vector<std::pair<int, int>> newest = {{97, -97}, {98, 98}, {99, 99}};
+        EXPECT_EQ(drain(*it), newest);
+    }
+}
+
+TEST(IteratorTest, APIIteratorReadsSkipListMemtableInPlace) {
+    auto db = std::make_unique<kvdb::API>(1000, MemtableRep::SKIPLIST);
+    db->Open("test_db");
+    for (int i = 1; i <= 100; ++i) {
+        db->Put(i, i);
+    }
+    std::unique_ptr<Iterator> it = db->NewIterator();
+    // Writes after NewIterator go into the same skiplist but are past its view
+    for (int i = 1; i <= 150; ++i) {
+        db->Put(i, -i);
+    }
+    db->DeleteRange(10, 20);
+    it->SeekToFirst();
+    int expected = 1;
+    for (; it->Valid(); it->Next(), ++expected) {
+        EXPECT_EQ(std::get<int>(it->key()), expected);
+        EXPECT_EQ(std::get<int>(it->value()), expected);
+    }
+    EXPECT_EQ(expected, 101);
+    it.reset();
+    EXPECT_EQ(db->Scan(KeyValue(1, ""), KeyValue(150, "")).size(), 140);
+    db->Close();
+    fs::remove_all("test_db");
+}
+
+TEST(IteratorTest, SSTableIteratorAcrossBlocks) {
+    FileManager fileManager(fs::path("test_db"));
+    fileManager.setBlockSize(128);
+    std::vector<KeyValue> kv_pairs;
+    for (int i = 0; i < 500; ++i) {
+        kv_pairs.emplace_back(i * 2, i);
+    }
+    FlushSSTInfo info = fileManager.flushToDisk(kv_pairs);
+    std::shared_ptr<SSTable> table = SSTable::open(fs::path("test_db") / info.fileName);
+    ASSERT_GT(table->getBlocks().size(), 1);
+
+    std::unique_ptr<Iterator> it = SSTable::newIterator(table);
+    it->SeekToFirst();
+    std::vector<std::pair<int, int>> all = drain(*it);
+    ASSERT_EQ(all.size(), 500);
+    for (int i = 0; i < 500; ++i) {
+        EXPECT_EQ(all[i].first, i * 2);
+    }
+
+    // Odd targets land on the next even key, possibly in the next block
+    for (int target = -1; target < 999; target += 2) {
+        it->Seek(KeyValue(target, ""));
+        ASSERT_TRUE(it->Valid()) << target;
+        EXPECT_EQ(std::get<int>(it->key()), target + 1);
+    }
+    it->Seek(KeyValue(999, ""));
+    EXPECT_FALSE(it->Valid());
+    fs::remove_all("test_db");
+}
+
+TEST(IteratorTest, LevelIteratorConcatenatesFiles) {
+    FileManager fileManager(fs::path("test_db"));
+    std::vector<LevelIterator::File> files;
+    for (int f = 0; f < 3; ++f) {
+        std::vector<KeyValue> kv_pairs;
+        for (int i = f * 100; i < f * 100 + 50; ++i) {
+            kv_pairs.emplace_back(i, f);
+        }
+        FlushSSTInfo info = fileManager.flushToDisk(kv_pairs);
+        files.push_back({info.largest_key, SSTable::open(fs::path("test_db") / info.fileName)});
+    }
+    LevelIterator it(files);
+    it.SeekToFirst();
+    EXPECT_EQ(drain(it).size(), 150);
+
+    it.Seek(KeyValue(60, ""));  // in the gap between the first two files
+    ASSERT_TRUE(it.Valid());
+    EXPECT_EQ(std::get<int>(it.key()), 100);
+    EXPECT_EQ(std::get<int>(it.value()), 1);
+    it.Seek(KeyValue(249, ""));
+    EXPECT_EQ(std::get<int>(it.key()), 249);
+    it.Next();
+    EXPECT_FALSE(it.Valid());
+    fs::remove_all("test_db");
+}
+
+TEST(IteratorTest, APIIteratorAndScanReturnNewestVersion) {
+    auto db = std::make_unique<kvdb::API>(10);
+    CompactionOptions options;
+    options.level0_file_num_trigger = 3;
+    db->SetCompactionOptions(options);
+    db->Open("test_db");
+
+    // Versions spread over SSTs of several levels, the immutable memtable and the memtable
+    for (int round = 0; round < 4; ++round) {
+        for (int i = 1; i <= 50; i += round + 1) {
+            db->Put(i, round * 1000 + i);
+        }
+    }
+    std::map<int, int> expected;
+    for (int round = 0; round < 4; ++round) {
+        for (int i = 1; i <= 50; i += round + 1) {
+            expected[i] = round * 1000 + i;
+        }
+    }
+
+    std::unique_ptr<Iterator> it = db->NewIterator();
+    it->SeekToFirst();
+    auto entry = expected.begin();
+    for (; it->Valid(); it->Next(), ++entry) {
+        ASSERT_NE(entry, expected.end());
+        EXPECT_EQ(std::get<int>(it->key()), entry->first);
+        EXPECT_EQ(std::get<int>(it->value()), entry->second);
+    }
+    EXPECT_EQ(entry, expected.end());
+
+    set<KeyValue> result = db->Scan(KeyValue(10, ""), KeyValue(20, ""));
+    ASSERT_EQ(result.size(), 11);
+    for (const KeyValue& kv : result) {
+        EXPECT_EQ(std::get<int>(kv.getValue()), expected[std::get<int>(kv.getKey())]);
+    }
+
+    // The iterator keeps reading its view while writes and compactions go on
+    it->Seek(KeyValue(25, ""));
+    for (int i = 1; i <= 200; ++i) {
+        db->Put(i, -i);
+    }
+    db->WaitForCompaction();
+    ASSERT_TRUE(it->Valid());
+    EXPECT_EQ(std::get<int>(it->value()), expected[25]);
+    it.reset();
+
+    db->Close();
+    fs::remove_all("test_db");
+}
@@ -4,6 +4,8 @@
 
 #include <gtest/gtest.h>
 #include <sstream>
+#include <climits>
+#include <vector>
 #include "KeyValue.h"
 
 // Test for Key and Value Type Deduction
@@ -153,6 +155,27 @@ TEST(KeyValueTest, CompareDefaultKeyValues) {
     EXPECT_TRUE(kv1 == kv2);  // Default and explicit 0 should be equal
 }
 
+TEST(KeyValueTest, CachedKeyPrefixKeepsOrder) {
+    // Ascending under operator<: negatives, mixed numeric types, chars, then strings
+    std::vector<KeyValue> keys = {
+        KeyValue(-1e300, 0), KeyValue(LLONG_MIN, 0), KeyValue(-100, 0), KeyValue(-2.5, 0),
+        KeyValue(0, 0), KeyValue(0.5, 0), KeyValue('a', 0), KeyValue(97.5, 0), KeyValue(1LL << 53, 0),
+        KeyValue((1LL << 53) + 1, 0), KeyValue(LLONG_MAX - 1, 0), KeyValue(LLONG_MAX, 0), KeyValue(1e300, 0),
+        KeyValue("", 0), KeyValue("a", 0), KeyValue(std::string("a\0", 2), 0), KeyValue("ab", 0),
+        KeyValue("abcdefgh", 0), KeyValue("abcdefghi", 0), KeyValue("b", 0), KeyValue("\xff", 0)};
+    for (size_t i = 0; i < keys.size(); ++i) {
+        for (size_t j = 0; j < keys.size(); ++j) {
+            EXPECT_EQ(keys[i] < keys[j], i < j) << i << " " << j;
+            EXPECT_EQ(keys[i].compareKey(keys[j]) == 0, i == j) << i << " " << j;
+        }
+    }
+    // Equal values of different numeric types are equal keys; -0.0 is 0
+    EXPECT_TRUE(KeyValue(97, 0) == KeyValue('a', 0));
+    EXPECT_TRUE(KeyValue(-0.0, 0) == KeyValue(0LL, 0));
+    EXPECT_TRUE(KeyValue() == KeyValue(0, 0));
+    EXPECT_TRUE(KeyValue::Tombstone(5) == KeyValue(5.0, 0));
+}
+
 // Test the printKeyValue method
 TEST(KeyValueTest, Print_KeyValue) {
     // Create a KeyValue instance
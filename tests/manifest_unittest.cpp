@@ -0,0 +1,280 @@
+//
+// Created by Damian Li on 2024-09-29.
+//
+
+#include <gtest/gtest.h>
+#include <chrono>
+#include <condition_variable>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Manifest.h"
+#include "SSTIndex.h"
+#include "api.h"
+
+namespace fs = std::filesystem;
+
+TEST(ManifestTest, VersionEditRoundTrip) {
+    VersionEdit edit;
+    edit.deleted_files = {"sst_1.sst", "sst_2.sst"};
+    edit.new_files.push_back({1, "sst_3.sst", KeyValue(1, "a"), KeyValue("zebra", 2.5)});
+    edit.compact_pointers.emplace_back(0, KeyValue(42, 'x'));
+
+    VersionEdit decoded = VersionEdit::decode(edit.encode());
+    EXPECT_EQ(decoded.deleted_files, edit.deleted_files);
+    ASSERT_EQ(decoded.new_files.size(), 1);
+    EXPECT_EQ(decoded.new_files[0].level, 1);
+    EXPECT_EQ(decoded.new_files[0].filename, "sst_3.sst");
+    EXPECT_EQ(std::get<int>(decoded.new_files[0].smallest_key.getKey()), 1);
+    EXPECT_EQ(std::get<string>(decoded.new_files[0].largest_key.getKey()), "zebra");
+    ASSERT_EQ(decoded.compact_pointers.size(), 1);
+    EXPECT_EQ(decoded.compact_pointers[0].first, 0);
+    EXPECT_EQ(std::get<int>(decoded.compact_pointers[0].second.getKey()), 42);
+
+    std::string truncated = edit.encode();
+    truncated.pop_back();
+    EXPECT_THROW(VersionEdit::decode(truncated), std::runtime_error);
+}
+
+TEST(ManifestTest, AddSSTAppendsOneEdit) {
+    {
+        SSTIndex sstIndex;
+        sstIndex.set_path(fs::path("test_db"));
+        sstIndex.getAllSSTs();
+        uint64_t number = sstIndex.getManifest()->getNumber();
+        for (int i = 0; i < 100; ++i) {
+            sstIndex.addSST("sst_" + std::to_string(i) + ".sst", KeyValue(i, 0), KeyValue(i + 10, 0));
+        }
+        // Appended to the same manifest, one synced record per change
+        EXPECT_EQ(sstIndex.getManifest()->getNumber(), number);
+        EXPECT_EQ(sstIndex.getManifest()->getNumEdits(), 100);
+        EXPECT_EQ(sstIndex.getManifest()->getNumSyncs(), 101);
+        EXPECT_FALSE(fs::exists(fs::path("test_db") / "Index.sst"));
+        // no flushToDisk(): the edits are already durable
+    }
+    SSTIndex sstIndex;
+    sstIndex.set_path(fs::path("test_db"));
+    sstIndex.getAllSSTs();
+    deque<SSTInfo*> index = sstIndex.getSSTsIndex();
+    ASSERT_EQ(index.size(), 100);
+    EXPECT_EQ(index.front()->filename, "sst_0.sst");
+    EXPECT_EQ(index.back()->filename, "sst_99.sst");
+    // Recovery starts a new manifest holding a snapshot and drops the old one
+    EXPECT_EQ(Manifest::listManifests("test_db").size(), 1);
+    EXPECT_EQ(sstIndex.getManifest()->getNumEdits(), 0);
+    fs::remove_all("test_db");
+}
+
+TEST(ManifestTest, SnapshotBoundsManifestSize) {
+    SSTIndex sstIndex;
+    sstIndex.set_path(fs::path("test_db"));
+    sstIndex.setManifestSnapshotBytes(0);
+    sstIndex.getAllSSTs();
+    for (int i = 0; i < 200; ++i) {
+        sstIndex.addSST("sst_" + std::to_string(i) + ".sst", KeyValue(i, 0), KeyValue(i, 0));
+    }
+    // A new snapshot each time the edits outgrow the last one: O(log n) snapshots
+    EXPECT_GT(sstIndex.getManifest()->getNumber(), 2);
+    EXPECT_LT(sstIndex.getManifest()->getNumber(), 20);
+    EXPECT_EQ(Manifest::listManifests("test_db").size(), 1);
+
+    SSTIndex reopened;
+    reopened.set_path(fs::path("test_db"));
+    reopened.getAllSSTs();
+    EXPECT_EQ(reopened.getSSTsIndex().size(), 200);
+    fs::remove_all("test_db");
+}
+
+TEST(ManifestTest, SnapshotIsWrittenWithoutHoldingReaders) {
+    auto db = std::make_unique<kvdb::API>(20);
+    db->Open("test_db");
+    db->GetIndex()->setManifestSnapshotBytes(0);  // every flush writes a new snapshot
+    db->Put(1, 1);
+
+    // While the flush thread syncs a snapshot, a Get from another thread must get through
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool probed = false;
+    bool served = false;
+    bool served_in_time = false;
+    std::vector<std::thread> probes;
+    FileManager::setSyncObserver([&](const fs::path& path, bool) {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (probed || path.filename() != "CURRENT.tmp") {
+            return;
+        }
+        probed = true;
+        probes.emplace_back([&]() {
+            db->Get(KeyValue(1, ""));
+            std::lock_guard<std::mutex> done(mutex);
+            served = true;
+            cv.notify_all();
+        });
+        served_in_time = cv.wait_for(lock, std::chrono::seconds(5), [&] {return served;});
+    });
+    for (int i = 2; i <= 100; ++i) {
+        db->Put(i, i);
+    }
+    db->WaitForCompaction();
+    FileManager::setSyncObserver(nullptr);
+    for (std::thread& probe : probes) {
+        probe.join();
+    }
+    EXPECT_TRUE(probed);
+    EXPECT_TRUE(served_in_time);
+    EXPECT_EQ(std::get<int>(db->Get(KeyValue(100, "")).getValue()), 100);
+    db->Close();
+    fs::remove_all("test_db");
+}
+
+TEST(ManifestTest, TornEditIsIgnored) {
+    {
+        SSTIndex sstIndex;
+        sstIndex.set_path(fs::path("test_db"));
+        sstIndex.getAllSSTs();
+        sstIndex.addSST("sst_1.sst", KeyValue(1, 0), KeyValue(10, 0));
+        sstIndex.addSST("sst_2.sst", KeyValue(11, 0), KeyValue(20, 0));
+    }
+    // Crash in the middle of appending the next edit
+    std::vector<uint64_t> numbers = Manifest::listManifests("test_db");
+    ASSERT_EQ(numbers.size(), 1);
+    std::ofstream(Manifest::manifestPath("test_db", numbers.back()), std::ios::binary | std::ios::app) << "torn";
+
+    std::vector<VersionEdit> edits;
+    ASSERT_TRUE(Manifest::recover("test_db", edits));
+    EXPECT_EQ(edits.size(), 3);  // snapshot + 2 edits
+
+    SSTIndex sstIndex;
+    sstIndex.set_path(fs::path("test_db"));
+    sstIndex.getAllSSTs();
+    EXPECT_EQ(sstIndex.getSSTsIndex().size(), 2);
+    fs::remove_all("test_db");
+}
+
+TEST(ManifestTest, MigratesIndexFile) {
+    fs::create_directories("test_db");
+    {
+        std::ofstream out(fs::path("test_db") / "Index.sst", std::ios::binary);
+        SSTIndexHeader header;
+        header.num_files = 2;
+        header.header_checksum = header.calculateChecksum();
+        header.serialize(out);
+        for (int i = 0; i < 2; ++i) {
+            SerializedIndexSSTInfo info;
+            info.filename = "sst_" + std::to_string(i) + ".sst";
+            info.level = i;
+            info.smallest_key = SerializedKeyValue{KeyValue(i * 10, 0), 0};
+            info.largest_key = SerializedKeyValue{KeyValue(i * 10 + 5, 0), 0};
+            info.serialize(out);
+        }
+    }
+    SSTIndex sstIndex;
+    sstIndex.set_path(fs::path("test_db"));
+    sstIndex.getAllSSTs();
+    EXPECT_EQ(sstIndex.getLevelFileCount(0), 1);
+    EXPECT_EQ(sstIndex.getLevelFileCount(1), 1);
+    EXPECT_FALSE(fs::exists(fs::path("test_db") / "Index.sst"));
+    EXPECT_TRUE(fs::exists(Manifest::currentPath("test_db")));
+
+    SSTIndex reopened;
+    reopened.set_path(fs::path("test_db"));
+    reopened.getAllSSTs();
+    EXPECT_EQ(reopened.getSSTsIndex().size(), 2);
+    fs::remove_all("test_db");
+}
+
+TEST(ManifestTest, FlushesAndCompactionsSurviveCrash) {
+    CompactionOptions options;
+    options.level0_file_num_trigger = 2;
+    options.max_bytes_for_level_base = 16 * 1024;
+    options.target_file_size = 4 * 1024;
+    {
+        auto db = std::make_unique<kvdb::API>(100);
+        db->SetCompactionOptions(options);
+        db->Open("test_db");
+        for (int i = 0; i < 2000; ++i) {
+            db->Put(i, i);
+        }
+        db->WaitForCompaction();
+        // no Close(): the SSTs are only known through the MANIFEST, the memtable through the WAL
+    }
+    auto db = std::make_unique<kvdb::API>(100);
+    db->SetCompactionOptions(options);
+    db->Open("test_db");
+    for (int i = 0; i < 2000; i += 37) {
+        EXPECT_EQ(std::get<int>(db->Get(KeyValue(i, "")).getValue()), i);
+    }
+    EXPECT_EQ(db->Scan(KeyValue(0, ""), KeyValue(1999, "")).size(), 2000);
+    db->Close();
+
+    // And again after a clean Close
+    db = std::make_unique<kvdb::API>(100);
+    db->Open("test_db");
+    EXPECT_EQ(db->Scan(KeyValue(0, ""), KeyValue(1999, "")).size(), 2000);
+    db->Close();
+    fs::remove_all("test_db");
+}
+
+TEST(ManifestTest, LazyOpenReadsSSTsOnFirstTouch) {
+    // No compaction touching the SSTs behind the test's back
+    CompactionOptions options;
+    options.level0_file_num_trigger = 100;
+    uint64_t sequence;
+    {
+        auto db = std::make_unique<kvdb::API>(100);
+        db->SetCompactionOptions(options);
+        db->Open("test_db");
+        for (int i = 0; i < 1000; ++i) {
+            db->Put(i, i);
+        }
+        sequence = db->GetLatestSequenceNumber();
+        db->Close();
+    }
+    auto db = std::make_unique<kvdb::API>(100);
+    db->SetCompactionOptions(options);
+    db->SetSSTLoadMode(SSTLoadMode::LAZY);
+    db->Open("test_db");
+    SSTIndex* index = db->GetIndex();
+    // Key ranges, sizes and sequence numbers come from the MANIFEST alone
+    EXPECT_EQ(index->getTableCache().getNumOpen(), 0);
+    EXPECT_EQ(db->GetLatestSequenceNumber(), sequence);
+    size_t num_files = index->getSSTsIndex().size();
+    ASSERT_GT(num_files, 1);
+    for (SSTInfo* info : index->getSSTsIndex()) {
+        EXPECT_FALSE(info->filter_loaded);
+        EXPECT_GT(info->file_size, 0);
+    }
+
+    EXPECT_EQ(std::get<int>(db->Get(KeyValue(500, "")).getValue()), 500);
+    size_t touched = index->getTableCache().getNumOpen();
+    EXPECT_GE(touched, 1);
+    EXPECT_LT(touched, num_files);
+    EXPECT_EQ(index->warmUp(num_files), num_files - touched);
+    EXPECT_EQ(index->warmUp(num_files), 0);
+    db->Close();
+    fs::remove_all("test_db");
+}
+
+TEST(ManifestTest, BackgroundWarmUpServesReads) {
+    {
+        auto db = std::make_unique<kvdb::API>(50);
+        db->Open("test_db");
+        for (int i = 0; i < 2000; ++i) {
+            db->Put(i, i);
+        }
+        db->Close();
+    }
+    auto db = std::make_unique<kvdb::API>(50);
+    db->SetSSTLoadMode(SSTLoadMode::BACKGROUND);
+    db->Open("test_db");
+    for (int i = 0; i < 2000; i += 7) {
+        EXPECT_EQ(std::get<int>(db->Get(KeyValue(i, "")).getValue()), i);
+    }
+    db->Put(2000, 2000);
+    db->Close();
+    fs::remove_all("test_db");
+}
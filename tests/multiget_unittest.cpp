@@ -0,0 +1,104 @@
+//
+// Created by Damian Li on 2024-09-22.
+//
+
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <vector>
+#include "SSTable.h"
+#include "SSTIndex.h"
+#include "api.h"
+
+namespace fs = std::filesystem;
+
+TEST(MultiGetTest, SSTableReadsEachBlockOnce) {
+    FileManager fileManager(fs::path("test_db"));
+    fileManager.setBlockSize(256);
+    std::vector<KeyValue> kv_pairs;
+    for (int i = 1; i <= 1000; ++i) {
+        kv_pairs.emplace_back(i, i * 5);
+    }
+    FlushSSTInfo info = fileManager.flushToDisk(kv_pairs);
+    auto cache = std::make_shared<BlockCache>();
+    std::shared_ptr<SSTable> table = SSTable::open(fs::path("test_db") / info.fileName, cache);
+
+    // Ten keys of the first block, plus a missing one
+    std::vector<KeyValue> keys;
+    for (int i = 1; i <= 10; ++i) {
+        keys.emplace_back(i, "");
+    }
+    keys.emplace_back(5000, "");
+    std::vector<KeyValue> results(keys.size());
+    table->multiGet(keys, results);
+
+    for (int i = 0; i < 10; ++i) {
+        EXPECT_EQ(std::get<int>(results[i].getValue()), (i + 1) * 5);
+    }
+    EXPECT_TRUE(results[10].isEmpty());
+    EXPECT_EQ(cache->getMisses(), 2);  // first block, then the last block for the missing key
+    fs::remove_all("test_db");
+}
+
+TEST(MultiGetTest, SSTIndexNewestFileWins) {
+    FileManager fileManager(fs::path("test_db"));
+    SSTIndex sstIndex;
+    sstIndex.set_path(fs::path("test_db"));
+    for (int round = 0; round < 3; ++round) {
+        std::vector<KeyValue> kv_pairs;
+        for (int i = round * 10 + 1; i <= round * 10 + 50; ++i) {
+            kv_pairs.emplace_back(i, round);
+        }
+        FlushSSTInfo info = fileManager.flushToDisk(kv_pairs);
+        sstIndex.addSST(info.fileName, info.smallest_key, info.largest_key, info.filter);
+    }
+
+    std::vector<KeyValue> keys;
+    for (int i = 1; i <= 100; ++i) {
+        keys.emplace_back(i, "");
+    }
+    std::vector<KeyValue> results(keys.size());
+    sstIndex.MultiSearch(keys, results);
+    for (int i = 1; i <= 100; ++i) {
+        KeyValue single = sstIndex.Search(KeyValue(i, ""));
+        EXPECT_EQ(results[i - 1].isEmpty(), single.isEmpty()) << i;
+        if (!single.isEmpty()) {
+            EXPECT_EQ(std::get<int>(results[i - 1].getValue()), std::get<int>(single.getValue())) << i;
+        }
+    }
+    fs::remove_all("test_db");
+}
+
+TEST(MultiGetTest, APIResultsInInputOrder) {
+    auto db = std::make_unique<kvdb::API>(100);
+    db->Open("test_db");
+    for (int i = 1; i <= 1000; ++i) {
+        db->Put(i, "value_" + std::to_string(i));
+    }
+    db->Put(7, "newest");
+    db->Put("str", 1.5);
+
+    std::vector<KeyValue> keys = {KeyValue(900, ""), KeyValue(7, ""), KeyValue(5000, ""),
+                                  KeyValue("str", ""), KeyValue(1, ""), KeyValue(900, "")};
+    std::vector<KeyValue> results = db->MultiGet(keys);
+    ASSERT_EQ(results.size(), keys.size());
+    EXPECT_EQ(std::get<std::string>(results[0].getValue()), "value_900");
+    EXPECT_EQ(std::get<std::string>(results[1].getValue()), "newest");
+    EXPECT_TRUE(results[2].isEmpty());
+    EXPECT_EQ(std::get<double>(results[3].getValue()), 1.5);
+    EXPECT_EQ(std::get<std::string>(results[4].getValue()), "value_1");
+    EXPECT_EQ(std::get<std::string>(results[5].getValue()), "value_900");
+
+    // Same answers as one Get per key
+    std::vector<KeyValue> all;
+    for (int i = 1000; i >= 1; i -= 3) {
+        all.emplace_back(i, "");
+    }
+    results = db->MultiGet(all);
+    for (size_t i = 0; i < all.size(); ++i) {
+        EXPECT_EQ(std::get<std::string>(results[i].getValue()),
+                  std::get<std::string>(db->Get(all[i]).getValue()));
+    }
+
+    db->Close();
+    fs::remove_all("test_db");
+}
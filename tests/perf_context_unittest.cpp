@@ -0,0 +1,127 @@
+//
+// Created by Damian Li on 2024-10-05.
+//
+
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <memory>
+#include <thread>
+#include "PerfContext.h"
+#include "api.h"
+
+namespace fs = std::filesystem;
+
+namespace {
+    // Database with keys 1..1000 in SSTs and 1001..1050 in the memtable, reopened so no SST is open yet
+    std::unique_ptr<kvdb::API> openTestDB() {
+        fs::remove_all("test_db");
+        auto db = std::make_unique<kvdb::API>(100);
+        db->Open("test_db");
+        for (int i = 1; i <= 1000; ++i) {
+            db->Put(i, i);
+        }
+        db->Close();
+        db = std::make_unique<kvdb::API>(100);
+        db->Open("test_db");
+        for (int i = 1001; i <= 1050; ++i) {
+            db->Put(i, i);
+        }
+        return db;
+    }
+
+    // Restores the thread's level, which outlives the test otherwise
+    struct PerfLevelGuard {
+        explicit PerfLevelGuard(PerfLevel level) {setPerfLevel(level); getPerfContext()->reset();}
+        ~PerfLevelGuard() {setPerfLevel(PerfLevel::DISABLE);}
+    };
+}
+
+TEST(PerfContextTest, DisabledByDefault) {
+    auto db = openTestDB();
+    EXPECT_EQ(getPerfLevel(), PerfLevel::DISABLE);
+    getPerfContext()->reset();
+    EXPECT_EQ(std::get<int>(db->Get(KeyValue(10, "")).getValue()), 10);
+    EXPECT_EQ(getPerfContext()->toString(true), "");
+    db->Close();
+    fs::remove_all("test_db");
+}
+
+TEST(PerfContextTest, CountsGetSteps) {
+    auto db = openTestDB();
+    PerfLevelGuard guard(PerfLevel::ENABLE_COUNT);
+
+    // Memtable hit: the SSTs aren't touched
+    EXPECT_EQ(std::get<int>(db->Get(KeyValue(1020, "")).getValue()), 1020);
+    EXPECT_EQ(getPerfContext()->get_from_memtable_count, 1);
+    EXPECT_EQ(getPerfContext()->sst_read_count, 0);
+
+    // One SST holds the key: opened, one block decoded
+    getPerfContext()->reset();
+    EXPECT_EQ(std::get<int>(db->Get(KeyValue(10, "")).getValue()), 10);
+    const PerfContext& perf = *getPerfContext();
+    EXPECT_EQ(perf.get_from_memtable_count, 1);
+    EXPECT_EQ(perf.sst_read_count, 1);
+    EXPECT_EQ(perf.bloom_sst_hit_count, 1);
+    EXPECT_GE(perf.file_open_count, 1);
+    EXPECT_EQ(perf.block_decode_count, 1);
+    EXPECT_GT(perf.records_decoded_count, 0);
+    // Every other file is pruned by its key range
+    EXPECT_GT(perf.sst_range_pruned_count, 0);
+    // Counters only
+    EXPECT_EQ(perf.get_from_memtable_nanos, 0);
+    EXPECT_EQ(perf.get_from_output_files_nanos, 0);
+
+    // Again: the file is open and the block cached
+    getPerfContext()->reset();
+    db->Get(KeyValue(10, ""));
+    EXPECT_EQ(perf.file_open_count, 0);
+    EXPECT_EQ(perf.block_decode_count, 0);
+    EXPECT_EQ(perf.block_cache_hit_count, 1);
+
+    db->Close();
+    fs::remove_all("test_db");
+}
+
+TEST(PerfContextTest, TimesGetSteps) {
+    auto db = openTestDB();
+    PerfLevelGuard guard(PerfLevel::ENABLE_TIME);
+
+    EXPECT_EQ(std::get<int>(db->Get(KeyValue(500, "")).getValue()), 500);
+    const PerfContext& perf = *getPerfContext();
+    EXPECT_GT(perf.get_from_memtable_nanos, 0);
+    EXPECT_GT(perf.get_from_output_files_nanos, 0);
+    EXPECT_GT(perf.file_open_nanos, 0);
+    EXPECT_GT(perf.block_decode_nanos, 0);
+    // Nested steps fit in the SST search
+    EXPECT_LE(perf.find_file_nanos + perf.file_open_nanos + perf.block_decode_nanos + perf.block_seek_nanos,
+              perf.get_from_output_files_nanos);
+
+    std::string report = perf.toString(true);
+    EXPECT_NE(report.find("get_from_output_files_nanos = "), std::string::npos);
+    EXPECT_NE(report.find("sst_read_count = 1"), std::string::npos);
+    EXPECT_EQ(report.find("bloom_sst_miss_count"), std::string::npos);
+
+    db->Close();
+    fs::remove_all("test_db");
+}
+
+TEST(PerfContextTest, ThreadLocal) {
+    auto db = openTestDB();
+    PerfLevelGuard guard(PerfLevel::ENABLE_COUNT);
+
+    // Another thread has its own level (disabled) and context
+    std::thread other([&db] {
+        EXPECT_EQ(getPerfLevel(), PerfLevel::DISABLE);
+        db->Get(KeyValue(10, ""));
+        EXPECT_EQ(getPerfContext()->get_from_memtable_count, 0);
+        setPerfLevel(PerfLevel::ENABLE_COUNT);
+        db->Get(KeyValue(10, ""));
+        db->Get(KeyValue(11, ""));
+        EXPECT_EQ(getPerfContext()->get_from_memtable_count, 2);
+    });
+    other.join();
+    EXPECT_EQ(getPerfContext()->get_from_memtable_count, 0);
+
+    db->Close();
+    fs::remove_all("test_db");
+}
@@ -0,0 +1,177 @@
+//
+// Created by Damian Li on 2024-09-23.
+//
+
+#include <gtest/gtest.h>
+#include <atomic>
+#include <filesystem>
+#include <thread>
+#include <vector>
+#include "SkipList.h"
+#include "Memtable.h"
+#include "api.h"
+
+namespace fs = std::filesystem;
+
+TEST(SkipListTest, InsertGetAndOrder) {
+    SkipList list;
+    for (int i = 100; i >= 1; --i) {
+        EXPECT_TRUE(list.insert(KeyValue(i, i * 2)));
+    }
+    EXPECT_EQ(list.size(), 100);
+    EXPECT_EQ(std::get<int>(list.get(KeyValue(42, "")).getValue()), 84);
+    EXPECT_TRUE(list.get(KeyValue(500, "")).isEmpty());
+    EXPECT_FALSE(list.contains(KeyValue(0.5, "")));
+
+    std::vector<KeyValue> all = list.entries();
+    ASSERT_EQ(all.size(), 100);
+    for (int i = 0; i < 100; ++i) {
+        EXPECT_EQ(std::get<int>(all[i].getKey()), i + 1);
+    }
+
+    std::vector<KeyValue> range;
+    list.scan(KeyValue(10, ""), KeyValue(19, ""), range);
+    ASSERT_EQ(range.size(), 10);
+    EXPECT_EQ(std::get<int>(range.front().getKey()), 10);
+    EXPECT_EQ(std::get<int>(range.back().getKey()), 19);
+}
+
+TEST(SkipListTest, OverwriteKeepsNewestVersion) {
+    SkipList list;
+    EXPECT_TRUE(list.insert(KeyValue("key", "v1")));
+    EXPECT_FALSE(list.insert(KeyValue("key", "v2")));
+    EXPECT_EQ(list.size(), 1);
+    EXPECT_EQ(std::get<std::string>(list.get(KeyValue("key", "")).getValue()), "v2");
+    std::set<KeyValue> res;
+    list.scan(KeyValue("a", ""), KeyValue("z", ""), res);
+    ASSERT_EQ(res.size(), 1);
+    EXPECT_EQ(std::get<std::string>(res.begin()->getValue()), "v2");
+}
+
+TEST(SkipListTest, ConcurrentInsertersAndReaders) {
+    SkipList list;
+    const int num_threads = 8;
+    const int per_thread = 2000;
+    std::atomic<bool> done{false};
+    std::atomic<bool> failed{false};
+
+    // Reader checks that a scan is always sorted while inserts are running
+    std::thread reader([&]() {
+        while (!done.load()) {
+            std::vector<KeyValue> all = list.entries();
+            for (size_t i = 1; i < all.size(); ++i) {
+                if (!(all[i - 1] < all[i])) {
+                    failed = true;
+                }
+            }
+        }
+    });
+    std::vector<std::thread> writers;
+    for (int t = 0; t < num_threads; ++t) {
+        writers.emplace_back([&list, t]() {
+            // Interleaved keys so threads race on the same neighbourhoods
+            for (int i = 0; i < per_thread; ++i) {
+                int key = i * num_threads + t;
+                list.insert(KeyValue(key, key));
+            }
+        });
+    }
+    for (auto& writer : writers) {
+        writer.join();
+    }
+    done = true;
+    reader.join();
+
+    EXPECT_FALSE(failed.load());
+    EXPECT_EQ(list.size(), num_threads * per_thread);
+    std::vector<KeyValue> all = list.entries();
+    ASSERT_EQ(all.size(), num_threads * per_thread);
+    for (int i = 0; i < num_threads * per_thread; ++i) {
+        EXPECT_EQ(std::get<int>(all[i].getValue()), i);
+    }
+}
+
+TEST(SkipListTest, MemtableWithSkipListBackend) {
+    Memtable memtable(100, MemtableRep::SKIPLIST);
+    ASSERT_NE(memtable.getSkipList(), nullptr);
+    EXPECT_EQ(memtable.getTree(), nullptr);
+    for (int i = 1; i <= 50; ++i) {
+        memtable.put(KeyValue(i, i + 1));
+    }
+    EXPECT_EQ(std::get<int>(memtable.get(KeyValue(7, "")).getValue()), 8);
+    std::set<KeyValue> res;
+    memtable.Scan(KeyValue(1, ""), KeyValue(10, ""), res);
+    EXPECT_EQ(res.size(), 10);
+    EXPECT_EQ(memtable.inOrderEntries().size(), 50);
+}
+
+TEST(SkipListTest, APIConcurrentPutsWithSkipList) {
+    auto db = std::make_unique<kvdb::API>(500, MemtableRep::SKIPLIST);
+    db->SetWALSyncMode(WALSyncMode::GROUP_COMMIT);
+    db->Open("test_db");
+
+    const int num_threads = 4;
+    const int per_thread = 1000;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < num_threads; ++t) {
+        threads.emplace_back([&db, t]() {
+            for (int i = 0; i < per_thread; ++i) {
+                int key = t * per_thread + i + 1;
+                db->Put(key, key * 3);
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    for (int key = 1; key <= num_threads * per_thread; ++key) {
+        EXPECT_EQ(std::get<int>(db->Get(KeyValue(key, "")).getValue()), key * 3);
+    }
+    EXPECT_EQ(db->Scan(KeyValue(1, ""), KeyValue(num_threads * per_thread, "")).size(), num_threads * per_thread);
+
+    db->Close();
+    fs::remove_all("test_db");
+}
+
+TEST(SkipListTest, APIReadersRaceFlushesAndCompactions) {
+    auto db = std::make_unique<kvdb::API>(200, MemtableRep::SKIPLIST);
+    db->Open("test_db");
+    const int num_keys = 2000;
+    for (int key = 1; key <= num_keys; ++key) {
+        db->Put(key, key);
+    }
+
+    // Overwrites keep flushing and compacting while readers search the SSTs unlocked
+    std::atomic<bool> done{false};
+    std::atomic<int> bad{0};
+    std::vector<std::thread> readers;
+    for (int t = 0; t < 3; ++t) {
+        readers.emplace_back([&db, &done, &bad, t]() {
+            for (int i = 0; !done; ++i) {
+                int key = (i * 7 + t * 13) % num_keys + 1;
+                KeyValue kv = db->Get(KeyValue(key, ""));
+                int value = kv.isEmpty() ? 0 : std::get<int>(kv.getValue());
+                if (value != key && value != -key) {
+                    bad++;
+                }
+                if (i % 200 == 0 && db->Scan(KeyValue(key, ""), KeyValue(key + 20, "")).empty()) {
+                    bad++;
+                }
+            }
+        });
+    }
+    for (int key = 1; key <= num_keys; ++key) {
+        db->Put(key, -key);
+    }
+    done = true;
+    for (auto& reader : readers) {
+        reader.join();
+    }
+    EXPECT_EQ(bad, 0);
+    for (int key = 1; key <= num_keys; ++key) {
+        EXPECT_EQ(std::get<int>(db->Get(KeyValue(key, "")).getValue()), -key);
+    }
+
+    db->Close();
+    fs::remove_all("test_db");
+}
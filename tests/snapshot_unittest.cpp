@@ -0,0 +1,300 @@
+//
+// Created by Damian Li on 2024-09-28.
+//
+
+#include <gtest/gtest.h>
+#include <atomic>
+#include <filesystem>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "Compaction.h"
+#include "Memtable.h"
+#include "SSTable.h"
+#include "SkipList.h"
+#include "Snapshot.h"
+#include "api.h"
+
+namespace fs = std::filesystem;
+
+namespace {
+    KeyValue versioned(int key, int value, uint64_t sequence) {
+        KeyValue kv(key, value);
+        kv.setSequence(sequence);
+        return kv;
+    }
+}
+
+TEST(SnapshotTest, SnapshotListStripes) {
+    auto list = std::make_shared<SnapshotList>();
+    auto s10 = list->create(10);
+    {
+        auto s20 = list->create(20);
+        EXPECT_EQ(list->sequences(), (std::vector<uint64_t>{10, 20}));
+    }
+    // Released with the last copy of the pointer
+    EXPECT_EQ(list->sequences(), (std::vector<uint64_t>{10}));
+
+    std::vector<uint64_t> snapshots = {10, 20};
+    EXPECT_EQ(SnapshotList::stripe(snapshots, 5), 10);
+    EXPECT_EQ(SnapshotList::stripe(snapshots, 10), 10);
+    EXPECT_EQ(SnapshotList::stripe(snapshots, 15), 20);
+    EXPECT_EQ(SnapshotList::stripe(snapshots, 25), KeyValue::MAX_SEQUENCE);
+
+    // Key 1: 30 is the newest, 18 is what snapshot 20 reads, 8 what snapshot 10 reads
+    std::vector<KeyValue> entries = {versioned(1, 30, 30), versioned(1, 25, 25), versioned(1, 18, 18),
+                                     versioned(1, 12, 12), versioned(1, 8, 8), versioned(1, 3, 3),
+                                     versioned(2, 7, 7)};
+    SnapshotList::dropShadowed(entries, snapshots);
+    ASSERT_EQ(entries.size(), 4);
+    EXPECT_EQ(entries[0].getSequence(), 30);
+    EXPECT_EQ(entries[1].getSequence(), 18);
+    EXPECT_EQ(entries[2].getSequence(), 8);
+    EXPECT_EQ(entries[3].getSequence(), 7);
+}
+
+TEST(SnapshotTest, SkipListVersions) {
+    SkipList list;
+    list.insert(versioned(1, 10, 10));
+    list.insert(versioned(1, 30, 30));
+    list.insert(versioned(1, 20, 20));  // arrives late: linked behind 30
+    list.insert(versioned(2, 5, 5));
+
+    EXPECT_EQ(std::get<int>(list.get(KeyValue(1, 0)).getValue()), 30);
+    EXPECT_EQ(std::get<int>(list.get(KeyValue(1, 0), 25).getValue()), 20);
+    EXPECT_EQ(std::get<int>(list.get(KeyValue(1, 0), 10).getValue()), 10);
+    EXPECT_TRUE(list.get(KeyValue(1, 0), 9).isEmpty());
+
+    std::vector<KeyValue> res;
+    list.scan(KeyValue(0, 0), KeyValue(10, 0), res, 15);
+    ASSERT_EQ(res.size(), 2);
+    EXPECT_EQ(std::get<int>(res[0].getValue()), 10);
+    EXPECT_EQ(list.entries().size(), 2);
+    std::vector<KeyValue> all = list.entries(true);
+    ASSERT_EQ(all.size(), 4);
+    EXPECT_EQ(all[0].getSequence(), 30);
+    EXPECT_EQ(all[1].getSequence(), 20);
+    EXPECT_EQ(all[2].getSequence(), 10);
+}
+
+TEST(SnapshotTest, MemtableKeepsVersionsForSnapshots) {
+    for (MemtableRep rep : {MemtableRep::RED_BLACK_TREE, MemtableRep::SKIPLIST}) {
+        auto list = std::make_shared<SnapshotList>();
+        Memtable memtable(1000, rep);
+        memtable.setSnapshotList(list);
+        memtable.insert(versioned(1, 100, 1));
+        memtable.insert(versioned(2, 200, 2));
+        auto snapshot = list->create(2);
+        memtable.insert(versioned(1, 101, 3));
+        KeyValue deleted = KeyValue::Tombstone(2);
+        deleted.setSequence(4);
+        memtable.insert(deleted);
+
+        EXPECT_EQ(std::get<int>(memtable.get(KeyValue(1, 0)).getValue()), 101);
+        EXPECT_TRUE(memtable.get(KeyValue(2, 0)).isTombstone());
+        EXPECT_EQ(std::get<int>(memtable.get(KeyValue(1, 0), 2).getValue()), 100);
+        EXPECT_EQ(std::get<int>(memtable.get(KeyValue(2, 0), 2).getValue()), 200);
+
+        std::vector<KeyValue> res;
+        memtable.Scan(KeyValue(0, 0), KeyValue(10, 0), res, 2);
+        ASSERT_EQ(res.size(), 2);
+        EXPECT_EQ(std::get<int>(res[0].getValue()), 100);
+
+        // A flush keeps what the snapshot reads, newest first
+        EXPECT_EQ(memtable.inOrderEntries().size(), 2);
+        std::vector<KeyValue> entries = memtable.inOrderEntries(list->sequences());
+        ASSERT_EQ(entries.size(), 4);
+        EXPECT_EQ(entries[0].getSequence(), 3);
+        EXPECT_EQ(entries[1].getSequence(), 1);
+    }
+}
+
+TEST(SnapshotTest, SSTableReadsAtSequence) {
+    FileManager fileManager(fs::path("test_db"));
+    fileManager.setBlockSize(64);  // many blocks: versions of a key must not be split
+    std::vector<KeyValue> kv_pairs;
+    for (int key = 0; key < 20; ++key) {
+        for (int version = 3; version >= 1; --version) {
+            kv_pairs.push_back(versioned(key, key * 10 + version, key * 10 + version));
+        }
+    }
+    KeyValue range = KeyValue::RangeTombstone(5, 8);
+    range.setSequence(60);  // newer than keys 0..5, older than the rest
+    FlushSSTInfo info = fileManager.flushToDisk(kv_pairs, {range});
+    EXPECT_EQ(info.largest_sequence, 193);
+
+    for (auto cache : {std::shared_ptr<BlockCache>(), std::make_shared<BlockCache>()}) {
+        auto table = SSTable::open(fs::path("test_db") / info.fileName, cache);
+        EXPECT_EQ(table->getLargestSequence(), 193);
+        for (size_t i = 1; i < table->getBlocks().size(); ++i) {
+            EXPECT_FALSE(table->getBlocks()[i].first_key == table->getBlocks()[i - 1].first_key);
+        }
+        EXPECT_EQ(std::get<int>(table->get(KeyValue(3, 0)).getValue()), 33);
+        EXPECT_EQ(std::get<int>(table->get(KeyValue(3, 0), 32).getValue()), 32);
+        EXPECT_TRUE(table->get(KeyValue(3, 0), 30).isEmpty());
+        // The range tombstone deletes key 5, but not for a reader from before it
+        EXPECT_TRUE(table->get(KeyValue(5, 0)).isTombstone());
+        EXPECT_EQ(std::get<int>(table->get(KeyValue(5, 0), 51).getValue()), 51);
+        EXPECT_EQ(std::get<int>(table->get(KeyValue(6, 0)).getValue()), 63);
+
+        std::vector<KeyValue> keys = {KeyValue(3, 0), KeyValue(5, 0), KeyValue(15, 0)};
+        std::vector<KeyValue> results(keys.size());
+        table->multiGet(keys, results, 60);
+        EXPECT_EQ(std::get<int>(results[0].getValue()), 33);
+        EXPECT_TRUE(results[1].isTombstone());
+        EXPECT_TRUE(results[2].isEmpty());
+        EXPECT_EQ(table->readAll().size(), kv_pairs.size());
+    }
+    fs::remove_all("test_db");
+}
+
+TEST(SnapshotTest, CompactionKeepsSnapshotVersions) {
+    FileManager fileManager(fs::path("test_db"));
+    auto older = SSTable::open(fs::path("test_db") / fileManager.flushToDisk(
+        {versioned(1, 1, 1), versioned(2, 2, 2), versioned(3, 3, 3)}).fileName);
+    KeyValue deleted = KeyValue::Tombstone(2);
+    deleted.setSequence(5);
+    auto newer = SSTable::open(fs::path("test_db") / fileManager.flushToDisk(
+        {versioned(1, 4, 4), deleted, versioned(3, 6, 6)}).fileName);
+
+    // Snapshot 4: key 1 is read at 4 either way, keys 2 and 3 need their old versions
+    std::vector<FlushSSTInfo> outputs = Compaction::merge({newer, older}, fileManager, 1 << 20, true, {4});
+    ASSERT_EQ(outputs.size(), 1);
+    auto merged = SSTable::open(fs::path("test_db") / outputs[0].fileName);
+    EXPECT_EQ(merged->readAll().size(), 5);
+    EXPECT_TRUE(merged->get(KeyValue(2, 0)).isTombstone());
+    EXPECT_EQ(std::get<int>(merged->get(KeyValue(2, 0), 4).getValue()), 2);
+    EXPECT_EQ(std::get<int>(merged->get(KeyValue(3, 0), 4).getValue()), 3);
+
+    // Without snapshots only the newest versions are left, and the bottommost tombstone goes
+    outputs = Compaction::merge({newer, older}, fileManager, 1 << 20, true);
+    merged = SSTable::open(fs::path("test_db") / outputs[0].fileName);
+    EXPECT_EQ(merged->readAll().size(), 2);
+    EXPECT_TRUE(merged->get(KeyValue(2, 0)).isEmpty());
+    fs::remove_all("test_db");
+}
+
+TEST(SnapshotTest, GetAndScanAtSnapshot) {
+    for (MemtableRep rep : {MemtableRep::RED_BLACK_TREE, MemtableRep::SKIPLIST}) {
+        auto db = std::make_unique<kvdb::API>(50, rep);
+        db->Open("test_db");
+        for (int i = 0; i < 100; ++i) {
+            db->Put(i, i);
+        }
+        auto snapshot = db->GetSnapshot();
+        EXPECT_EQ(snapshot->getSequence(), 100);
+        // Overwrites and deletes spread over the memtable and flushed SSTs
+        for (int i = 0; i < 100; ++i) {
+            db->Put(i, i + 1000);
+        }
+        db->Delete(7);
+        db->DeleteRange(20, 30);
+        db->Put(25, 25);
+
+        EXPECT_EQ(std::get<int>(db->Get(KeyValue(5, 0)).getValue()), 1005);
+        EXPECT_TRUE(db->Get(KeyValue(7, 0)).isEmpty());
+        EXPECT_TRUE(db->Get(KeyValue(21, 0)).isEmpty());
+        EXPECT_EQ(std::get<int>(db->Get(KeyValue(5, 0), snapshot).getValue()), 5);
+        EXPECT_EQ(std::get<int>(db->Get(KeyValue(7, 0), snapshot).getValue()), 7);
+        EXPECT_EQ(std::get<int>(db->Get(KeyValue(21, 0), snapshot).getValue()), 21);
+
+        std::vector<KeyValue> found = db->MultiGet({KeyValue(7, 0), KeyValue(25, 0)}, snapshot);
+        EXPECT_EQ(std::get<int>(found[0].getValue()), 7);
+        EXPECT_EQ(std::get<int>(found[1].getValue()), 25);
+
+        EXPECT_EQ(db->Scan(KeyValue(0, 0), KeyValue(99, 0)).size(), 90);
+        std::set<KeyValue> old = db->Scan(KeyValue(0, 0), KeyValue(99, 0), snapshot);
+        ASSERT_EQ(old.size(), 100);
+        for (const KeyValue& kv : old) {
+            EXPECT_EQ(kv.getValue(), kv.getKey());
+        }
+
+        auto it = db->NewIterator(snapshot);
+        int count = 0;
+        for (it->SeekToFirst(); it->Valid(); it->Next()) {
+            EXPECT_EQ(std::get<int>(it->kv().getValue()), count++);
+        }
+        EXPECT_EQ(count, 100);
+        db->Close();
+        fs::remove_all("test_db");
+    }
+}
+
+TEST(SnapshotTest, CompactionHonorsLiveSnapshots) {
+    auto db = std::make_unique<kvdb::API>(100);
+    db->Open("test_db");
+    CompactionOptions options;
+    options.level0_file_num_trigger = 2;
+    db->SetCompactionOptions(options);
+    for (int i = 0; i < 300; ++i) {
+        db->Put(i, i);
+    }
+    auto snapshot = db->GetSnapshot();
+    for (int round = 1; round <= 3; ++round) {
+        for (int i = 0; i < 300; ++i) {
+            db->Put(i, i + round * 1000);
+        }
+    }
+    db->Delete(42);
+    db->WaitForCompaction();
+    EXPECT_EQ(std::get<int>(db->Get(KeyValue(150, 0)).getValue()), 3150);
+    EXPECT_EQ(std::get<int>(db->Get(KeyValue(150, 0), snapshot).getValue()), 150);
+    EXPECT_EQ(std::get<int>(db->Get(KeyValue(42, 0), snapshot).getValue()), 42);
+    EXPECT_EQ(db->Scan(KeyValue(0, 0), KeyValue(299, 0), snapshot).size(), 300);
+    db->Close();
+    fs::remove_all("test_db");
+}
+
+TEST(SnapshotTest, SequenceNumbersSurviveRecovery) {
+    uint64_t sequence;
+    {
+        auto db = std::make_unique<kvdb::API>(1000);
+        db->Open("test_db");
+        for (int i = 0; i < 10; ++i) {
+            db->Put(1, i);
+        }
+        sequence = db->GetLatestSequenceNumber();
+        EXPECT_EQ(sequence, 10);
+        // no Close(): recovered from the WAL
+    }
+    auto db = std::make_unique<kvdb::API>(1000);
+    db->Open("test_db");
+    EXPECT_EQ(db->GetLatestSequenceNumber(), sequence);
+    db->Put(1, 100);
+    EXPECT_EQ(db->GetLatestSequenceNumber(), sequence + 1);
+    EXPECT_EQ(std::get<int>(db->Get(KeyValue(1, 0)).getValue()), 100);
+    db->Close();
+    fs::remove_all("test_db");
+}
+
+TEST(SnapshotTest, ScanSeesConsistentViewDuringWrites) {
+    auto db = std::make_unique<kvdb::API>(200, MemtableRep::SKIPLIST);
+    db->SetWALSyncMode(WALSyncMode::GROUP_COMMIT);
+    db->Open("test_db");
+    for (int i = 0; i < 100; ++i) {
+        db->Put(i, 0);
+    }
+    // Every batch sets all keys to the same value: a consistent view never mixes two batches
+    std::atomic<bool> stop{false};
+    std::thread writer([&] {
+        for (int round = 1; !stop; ++round) {
+            WriteBatch batch;
+            for (int i = 0; i < 100; ++i) {
+                batch.Put(i, round);
+            }
+            db->Write(batch);
+        }
+    });
+    for (int reads = 0; reads < 50; ++reads) {
+        auto snapshot = db->GetSnapshot();
+        std::set<KeyValue> view = db->Scan(KeyValue(0, 0), KeyValue(99, 0), snapshot);
+        ASSERT_EQ(view.size(), 100);
+        for (const KeyValue& kv : view) {
+            EXPECT_EQ(kv.getValue(), view.begin()->getValue());
+        }
+    }
+    stop = true;
+    writer.join();
+    db->Close();
+    fs::remove_all("test_db");
+}
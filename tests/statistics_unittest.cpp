@@ -0,0 +1,145 @@
+//
+// Created by Damian Li on 2024-10-04.
+//
+
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "Statistics.h"
+#include "api.h"
+
+namespace fs = std::filesystem;
+
+TEST(StatisticsTest, HistogramBucketsBoundTheError) {
+    for (uint64_t value : std::vector<uint64_t>{0, 1, 15, 16, 17, 31, 32, 1000, 123456789, UINT64_MAX}) {
+        size_t b = AtomicHistogram::bucketIndex(value);
+        ASSERT_LT(b, AtomicHistogram::NUM_BUCKETS);
+        EXPECT_LE(AtomicHistogram::bucketStart(b), value);
+        if (b + 1 < AtomicHistogram::NUM_BUCKETS) {
+            EXPECT_LT(value, AtomicHistogram::bucketLimit(b));
+        }
+        // Buckets are at most 1/16 of their values wide
+        EXPECT_LE(AtomicHistogram::bucketLimit(b) - AtomicHistogram::bucketStart(b) - 1,
+                  AtomicHistogram::bucketStart(b) / 16);
+    }
+    // Consecutive buckets, in value order
+    for (size_t b = 1; b < AtomicHistogram::NUM_BUCKETS; ++b) {
+        ASSERT_EQ(AtomicHistogram::bucketStart(b), AtomicHistogram::bucketLimit(b - 1));
+    }
+}
+
+TEST(StatisticsTest, HistogramPercentiles) {
+    AtomicHistogram histogram;
+    EXPECT_EQ(histogram.getData().count, 0);
+    EXPECT_EQ(histogram.percentile(50), 0);
+
+    for (uint64_t value = 1; value <= 10000; ++value) {
+        histogram.add(value);
+    }
+    HistogramData data = histogram.getData();
+    EXPECT_EQ(data.count, 10000);
+    EXPECT_EQ(data.sum, 10000ULL * 10001 / 2);
+    EXPECT_EQ(data.min, 1);
+    EXPECT_EQ(data.max, 10000);
+    EXPECT_DOUBLE_EQ(data.average, 5000.5);
+    EXPECT_NEAR(data.median, 5000, 5000 / 16.0);
+    EXPECT_NEAR(data.p99, 9900, 9900 / 16.0);
+    EXPECT_LE(data.p999, 10000);
+
+    histogram.reset();
+    EXPECT_EQ(histogram.getData().count, 0);
+    histogram.add(7);
+    EXPECT_EQ(histogram.getData().min, 7);
+    EXPECT_EQ(histogram.getData().max, 7);
+}
+
+TEST(StatisticsTest, ConcurrentTickersAndReset) {
+    Statistics stats;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&stats] {
+            for (int i = 0; i < 10000; ++i) {
+                stats.recordTick(Ticker::MEMTABLE_HIT);
+                stats.recordTick(Ticker::BYTES_READ, 10);
+                stats.recordInHistogram(HistogramType::GET_NANOS, i);
+            }
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    EXPECT_EQ(stats.getTickerCount(Ticker::MEMTABLE_HIT), 40000);
+    EXPECT_EQ(stats.getTickerCount(Ticker::BYTES_READ), 400000);
+    EXPECT_EQ(stats.getHistogramData(HistogramType::GET_NANOS).count, 40000);
+    EXPECT_EQ(stats.getHistogramData(HistogramType::GET_NANOS).max, 9999);
+
+    std::string report = stats.toString();
+    EXPECT_NE(report.find("kvdb.memtable.hit COUNT : 40000"), std::string::npos);
+    EXPECT_NE(report.find("kvdb.get.nanos P50 :"), std::string::npos);
+    // Empty histograms are left out
+    EXPECT_EQ(report.find("kvdb.flush.nanos"), std::string::npos);
+
+    stats.reset();
+    EXPECT_EQ(stats.getTickerCount(Ticker::MEMTABLE_HIT), 0);
+    EXPECT_EQ(stats.getHistogramData(HistogramType::GET_NANOS).count, 0);
+}
+
+TEST(StatisticsTest, RecordedByAPI) {
+    auto stats = std::make_shared<Statistics>();
+    auto db = std::make_unique<kvdb::API>(100);
+    CompactionOptions options;
+    options.level0_file_num_trigger = 2;
+    db->SetCompactionOptions(options);
+    db->SetStatistics(stats);
+    db->Open("test_db");
+
+    // Even keys only: odd keys fall inside the SSTs' ranges and are turned away by their filters
+    for (int i = 2; i <= 2000; i += 2) {
+        db->Put(i, i);
+    }
+    db->WaitForCompaction();
+    EXPECT_EQ(stats->getTickerCount(Ticker::NUMBER_KEYS_WRITTEN), 1000);
+    EXPECT_EQ(stats->getTickerCount(Ticker::BYTES_WRITTEN), 1000 * 2 * sizeof(int));
+    EXPECT_EQ(stats->getHistogramData(HistogramType::WRITE_NANOS).count, 1000);
+    EXPECT_GE(stats->getTickerCount(Ticker::FLUSH_COUNT), 9);
+    EXPECT_GT(stats->getTickerCount(Ticker::FLUSH_BYTES_WRITTEN), 0);
+    EXPECT_EQ(stats->getHistogramData(HistogramType::FLUSH_NANOS).count, stats->getTickerCount(Ticker::FLUSH_COUNT));
+    EXPECT_GE(stats->getTickerCount(Ticker::COMPACTION_COUNT), 1);
+
+    // In the memtable
+    EXPECT_EQ(std::get<int>(db->Get(KeyValue(2000, "")).getValue()), 2000);
+    EXPECT_EQ(stats->getTickerCount(Ticker::MEMTABLE_HIT), 1);
+    EXPECT_EQ(stats->getHistogramData(HistogramType::SST_FILES_PER_GET).count, 0);
+
+    // In an SST: one file read, the second time from the block cache
+    EXPECT_EQ(std::get<int>(db->Get(KeyValue(2, "")).getValue()), 2);
+    EXPECT_EQ(std::get<int>(db->Get(KeyValue(2, "")).getValue()), 2);
+    EXPECT_EQ(stats->getTickerCount(Ticker::MEMTABLE_MISS), 2);
+    EXPECT_EQ(stats->getTickerCount(Ticker::SST_FILES_PROBED), 2);
+    EXPECT_EQ(stats->getHistogramData(HistogramType::SST_FILES_PER_GET).max, 1);
+    EXPECT_GE(stats->getTickerCount(Ticker::BLOCK_CACHE_HIT), 1);
+
+    for (int i = 1; i < 2000; i += 2) {
+        EXPECT_TRUE(db->Get(KeyValue(i, "")).isEmpty());
+    }
+    EXPECT_GT(stats->getTickerCount(Ticker::BLOOM_FILTER_USEFUL), 800);
+    EXPECT_EQ(stats->getTickerCount(Ticker::NUMBER_KEYS_READ), 1003);
+    EXPECT_EQ(stats->getTickerCount(Ticker::NUMBER_KEYS_FOUND), 3);
+    EXPECT_EQ(stats->getTickerCount(Ticker::BYTES_READ), 3 * 2 * sizeof(int));
+    EXPECT_EQ(stats->getHistogramData(HistogramType::GET_NANOS).count, 1003);
+
+    EXPECT_EQ(db->Scan(KeyValue(1, ""), KeyValue(100, "")).size(), 50);
+    EXPECT_EQ(stats->getTickerCount(Ticker::NUMBER_SCANS), 1);
+    EXPECT_EQ(stats->getTickerCount(Ticker::NUMBER_KEYS_SCANNED), 50);
+    EXPECT_EQ(stats->getHistogramData(HistogramType::SCAN_NANOS).count, 1);
+
+    db->MultiGet({KeyValue(4, ""), KeyValue(5, ""), KeyValue(2000, "")});
+    EXPECT_EQ(stats->getTickerCount(Ticker::NUMBER_KEYS_READ), 1006);
+    EXPECT_EQ(stats->getTickerCount(Ticker::NUMBER_KEYS_FOUND), 5);
+    EXPECT_EQ(stats->getHistogramData(HistogramType::MULTIGET_NANOS).count, 1);
+
+    db->Close();
+    fs::remove_all("test_db");
+}
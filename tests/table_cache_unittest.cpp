@@ -0,0 +1,150 @@
+//
+// Created by Damian Li on 2024-09-18.
+//
+
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <thread>
+#include <vector>
+#include "TableCache.h"
+#include "FileManager.h"
+#include "SSTIndex.h"
+#include "api.h"
+
+namespace fs = std::filesystem;
+
+namespace {
+    // Flush n SSTs of 10 keys each into test_db
+    std::vector<FlushSSTInfo> flushTables(FileManager& fileManager, int n) {
+        std::vector<FlushSSTInfo> infos;
+        for (int t = 0; t < n; ++t) {
+            std::vector<KeyValue> kv_pairs;
+            for (int i = t * 10; i < t * 10 + 10; ++i) {
+                kv_pairs.emplace_back(i, i * 2);
+            }
+            infos.push_back(fileManager.flushToDisk(kv_pairs));
+        }
+        return infos;
+    }
+}
+
+TEST(TableCacheTest, ReusesOpenTable) {
+    FileManager fileManager(fs::path("test_db"));
+    std::vector<FlushSSTInfo> infos = flushTables(fileManager, 1);
+
+    TableCache tableCache(fs::path("test_db"));
+    std::shared_ptr<SSTable> first = tableCache.findTable(infos[0].fileName);
+    std::shared_ptr<SSTable> second = tableCache.findTable(infos[0].fileName);
+    EXPECT_EQ(first, second);
+    EXPECT_EQ(tableCache.getMisses(), 1);
+    EXPECT_EQ(tableCache.getHits(), 1);
+    EXPECT_EQ(std::get<int>(second->get(KeyValue(3, "")).getValue()), 6);
+
+    fs::remove_all("test_db");
+}
+
+TEST(TableCacheTest, EvictsLeastRecentlyUsedBeyondMaxOpenFiles) {
+    FileManager fileManager(fs::path("test_db"));
+    std::vector<FlushSSTInfo> infos = flushTables(fileManager, 3);
+
+    TableCache tableCache(fs::path("test_db"), 2);
+    std::shared_ptr<SSTable> t0 = tableCache.findTable(infos[0].fileName);
+    tableCache.findTable(infos[1].fileName);
+    tableCache.findTable(infos[0].fileName);  // t1 is now least recently used
+    tableCache.findTable(infos[2].fileName);
+    EXPECT_EQ(tableCache.getNumOpen(), 2);
+
+    uint64_t misses = tableCache.getMisses();
+    EXPECT_EQ(tableCache.findTable(infos[0].fileName), t0);
+    EXPECT_EQ(tableCache.getMisses(), misses);
+    tableCache.findTable(infos[1].fileName);
+    EXPECT_EQ(tableCache.getMisses(), misses + 1);
+
+    // An evicted reader handed out earlier stays usable
+    tableCache.setMaxOpenFiles(0);
+    EXPECT_EQ(tableCache.getNumOpen(), 0);
+    EXPECT_EQ(std::get<int>(t0->get(KeyValue(9, "")).getValue()), 18);
+
+    fs::remove_all("test_db");
+}
+
+TEST(TableCacheTest, ReopenedTableKeepsItsCachedBlocks) {
+    FileManager fileManager(fs::path("test_db"));
+    std::vector<FlushSSTInfo> infos = flushTables(fileManager, 2);
+
+    auto blockCache = std::make_shared<BlockCache>();
+    TableCache tableCache(fs::path("test_db"), 1, blockCache);
+    EXPECT_EQ(std::get<int>(tableCache.findTable(infos[0].fileName)->get(KeyValue(5, "")).getValue()), 10);
+    tableCache.findTable(infos[1].fileName);  // closes the reader of infos[0]
+    uint64_t hits = blockCache->getHits();
+    uint64_t misses = blockCache->getMisses();
+
+    // A new reader of the same file finds its blocks
+    EXPECT_EQ(std::get<int>(tableCache.findTable(infos[0].fileName)->get(KeyValue(5, "")).getValue()), 10);
+    EXPECT_EQ(blockCache->getHits(), hits + 1);
+    EXPECT_EQ(blockCache->getMisses(), misses);
+
+    // A rewritten file doesn't
+    tableCache.evict(infos[0].fileName);
+    EXPECT_EQ(std::get<int>(tableCache.findTable(infos[0].fileName)->get(KeyValue(5, "")).getValue()), 10);
+    EXPECT_EQ(blockCache->getMisses(), misses + 1);
+
+    fs::remove_all("test_db");
+}
+
+TEST(TableCacheTest, MissingFileThrows) {
+    fs::create_directories("test_db");
+    TableCache tableCache(fs::path("test_db"));
+    EXPECT_THROW(tableCache.findTable("sst_404.sst"), std::runtime_error);
+    EXPECT_EQ(tableCache.getNumOpen(), 0);
+    fs::remove_all("test_db");
+}
+
+TEST(TableCacheTest, ConcurrentLookups) {
+    FileManager fileManager(fs::path("test_db"));
+    std::vector<FlushSSTInfo> infos = flushTables(fileManager, 8);
+
+    TableCache tableCache(fs::path("test_db"), 4);
+    std::vector<std::thread> threads;
+    std::atomic<int> found{0};
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&, t]() {
+            for (int i = 0; i < 200; ++i) {
+                int key = (i * 13 + t) % 80;
+                KeyValue kv = tableCache.findTable(infos[key / 10].fileName)->get(KeyValue(key, ""));
+                if (!kv.isEmpty() || key == 0) {
+                    found++;
+                }
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    EXPECT_EQ(found.load(), 800);
+    EXPECT_LE(tableCache.getNumOpen(), 4);
+
+    fs::remove_all("test_db");
+}
+
+TEST(TableCacheTest, SSTIndexSearchWithFewOpenFiles) {
+    FileManager fileManager(fs::path("test_db"));
+    std::vector<FlushSSTInfo> infos = flushTables(fileManager, 6);
+
+    SSTIndex sstIndex;
+    sstIndex.set_path(fs::path("test_db"));
+    sstIndex.setMaxOpenFiles(2);
+    for (const FlushSSTInfo& info : infos) {
+        sstIndex.addSST(info.fileName, info.smallest_key, info.largest_key, info.filter);
+    }
+    for (int i = 1; i < 60; ++i) {
+        EXPECT_EQ(std::get<int>(sstIndex.Search(KeyValue(i, "")).getValue()), i * 2);
+    }
+    EXPECT_LE(sstIndex.getTableCache().getNumOpen(), 2);
+
+    std::set<KeyValue> res;
+    sstIndex.Scan(KeyValue(0, ""), KeyValue(59, ""), res);
+    EXPECT_EQ(res.size(), 60);
+
+    fs::remove_all("test_db");
+}
@@ -0,0 +1,326 @@
+//
+// Created by Damian Li on 2024-09-27.
+//
+
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+#include "Compaction.h"
+#include "Memtable.h"
+#include "SSTIndex.h"
+#include "SSTable.h"
+#include "api.h"
+
+namespace fs = std::filesystem;
+
+TEST(TombstoneTest, SSTEncodesTombstones) {
+    FileManager fileManager(fs::path("test_db"));
+    std::vector<KeyValue> kv_pairs = {KeyValue(1, 10), KeyValue::Tombstone(2), KeyValue(3, "three")};
+    std::vector<KeyValue> ranges = {KeyValue::RangeTombstone(10, 20)};
+    FlushSSTInfo info = fileManager.flushToDisk(kv_pairs, ranges);
+    EXPECT_EQ(std::get<int>(info.smallest_key.getKey()), 1);
+    EXPECT_EQ(std::get<int>(info.largest_key.getKey()), 20);  // the file spans its range tombstones
+    // The filter holds the point keys; lookups it turns away still see the range tombstone
+    ASSERT_NE(info.filter, nullptr);
+    EXPECT_TRUE(info.filter->mayContain(KeyValue(3, "")));
+    EXPECT_TRUE(info.has_range_deletions);
+
+    auto table = SSTable::open(fs::path("test_db") / info.fileName);
+    EXPECT_EQ(std::get<int>(table->get(KeyValue(1, "")).getValue()), 10);
+    EXPECT_TRUE(table->get(KeyValue(2, "")).isTombstone());
+    EXPECT_TRUE(table->get(KeyValue(15, "")).isTombstone());
+    EXPECT_TRUE(table->get(KeyValue(20, "")).isEmpty());  // end is exclusive
+    ASSERT_EQ(table->getRangeDeletions().size(), 1);
+    EXPECT_EQ(std::get<int>(table->getRangeDeletions()[0].rangeEnd().getKey()), 20);
+    std::vector<KeyValue> all = table->readAll();
+    ASSERT_EQ(all.size(), 3);
+    EXPECT_TRUE(all[1].isTombstone());
+
+    // Only range tombstones: still a readable file
+    FlushSSTInfo only_ranges = fileManager.flushToDisk({}, {KeyValue::RangeTombstone("a", "c")});
+    auto range_table = SSTable::open(fs::path("test_db") / only_ranges.fileName);
+    EXPECT_TRUE(range_table->get(KeyValue("b", "")).isTombstone());
+    EXPECT_TRUE(range_table->readAll().empty());
+    fs::remove_all("test_db");
+}
+
+TEST(TombstoneTest, MemtableRangeDeletions) {
+    for (MemtableRep rep : {MemtableRep::RED_BLACK_TREE, MemtableRep::SKIPLIST}) {
+        Memtable memtable(1000, rep);
+        uint64_t sequence = 0;
+        auto insert = [&](KeyValue kv) {
+            kv.setSequence(++sequence);
+            memtable.insert(kv);
+        };
+        insert(KeyValue(12, 0));
+        insert(KeyValue::RangeTombstone(10, 20));
+        insert(KeyValue(15, 1));  // newer than the range tombstone
+        insert(KeyValue::Tombstone(30));
+        // A range tombstone after other entries goes into the same memtable
+        EXPECT_FALSE(memtable.needsFlush(KeyValue::RangeTombstone(40, 50)));
+        insert(KeyValue(45, 2));
+        insert(KeyValue::RangeTombstone(40, 50));
+
+        EXPECT_EQ(std::get<int>(memtable.get(KeyValue(15, "")).getValue()), 1);
+        EXPECT_TRUE(memtable.get(KeyValue(12, "")).isTombstone());
+        EXPECT_TRUE(memtable.get(KeyValue(30, "")).isTombstone());
+        EXPECT_TRUE(memtable.get(KeyValue(20, "")).isEmpty());
+        EXPECT_TRUE(memtable.get(KeyValue(45, "")).isTombstone());
+        // Readers before the range tombstone still see what it deletes
+        EXPECT_EQ(std::get<int>(memtable.get(KeyValue(45, ""), sequence - 1).getValue()), 2);
+        EXPECT_EQ(std::get<int>(memtable.get(KeyValue(12, ""), 1).getValue()), 0);
+        EXPECT_FALSE(memtable.needsFlush(KeyValue(60, 1)));
+    }
+}
+
+TEST(TombstoneTest, BatchRangeDeletesOnlyEarlierRecords) {
+    Memtable memtable(1000);
+    std::vector<KeyValue> records = {KeyValue(1, 1), KeyValue(5, 5),
+                                     KeyValue::RangeTombstone(0, 10), KeyValue(6, 6)};
+    memtable.insertBatch(records.data(), records.size());
+    EXPECT_TRUE(memtable.get(KeyValue(1, "")).isTombstone());
+    EXPECT_TRUE(memtable.get(KeyValue(5, "")).isTombstone());
+    EXPECT_EQ(std::get<int>(memtable.get(KeyValue(6, "")).getValue()), 6);
+    EXPECT_EQ(memtable.inOrderEntries().size(), 1);
+}
+
+TEST(TombstoneTest, DeleteHidesKeyEverywhere) {
+    auto db = std::make_unique<kvdb::API>(100);
+    db->Open("test_db");
+    for (int i = 1; i <= 500; ++i) {
+        db->Put(i, i);
+    }
+    db->Delete(42);   // value in an SST
+    db->Delete(499);  // value still in a memtable
+    db->Put(7, 70);
+    db->Delete(7);
+    db->Put(8, 80);
+    db->Delete(8);
+    db->Put(8, 81);   // written again after the delete
+
+    EXPECT_TRUE(db->Get(KeyValue(42, "")).isEmpty());
+    EXPECT_TRUE(db->Get(KeyValue(499, "")).isEmpty());
+    EXPECT_TRUE(db->Get(KeyValue(7, "")).isEmpty());
+    EXPECT_EQ(std::get<int>(db->Get(KeyValue(8, "")).getValue()), 81);
+    EXPECT_EQ(std::get<int>(db->Get(KeyValue(43, "")).getValue()), 43);
+
+    std::vector<KeyValue> values = db->MultiGet({KeyValue(42, ""), KeyValue(43, ""), KeyValue(7, "")});
+    EXPECT_TRUE(values[0].isEmpty());
+    EXPECT_EQ(std::get<int>(values[1].getValue()), 43);
+    EXPECT_TRUE(values[2].isEmpty());
+
+    std::set<KeyValue> range = db->Scan(KeyValue(1, ""), KeyValue(500, ""));
+    EXPECT_EQ(range.size(), 497);
+    EXPECT_EQ(range.count(KeyValue(42, "")), 0);
+    db->Close();
+    fs::remove_all("test_db");
+}
+
+TEST(TombstoneTest, DeleteRangeAcrossMemtableAndSSTs) {
+    for (MemtableRep rep : {MemtableRep::RED_BLACK_TREE, MemtableRep::SKIPLIST}) {
+        auto db = std::make_unique<kvdb::API>(100, rep);
+        db->Open("test_db");
+        for (int i = 0; i < 1000; ++i) {
+            db->Put(i, i);
+        }
+        db->DeleteRange(100, 900);
+        db->Put(500, -1);  // newer than the range tombstone
+
+        EXPECT_EQ(std::get<int>(db->Get(KeyValue(99, "")).getValue()), 99);
+        EXPECT_TRUE(db->Get(KeyValue(100, "")).isEmpty());
+        EXPECT_TRUE(db->Get(KeyValue(899, "")).isEmpty());
+        EXPECT_EQ(std::get<int>(db->Get(KeyValue(900, "")).getValue()), 900);
+        EXPECT_EQ(std::get<int>(db->Get(KeyValue(500, "")).getValue()), -1);
+
+        std::vector<int> keys;
+        auto it = db->NewIterator();
+        for (it->SeekToFirst(); it->Valid(); it->Next()) {
+            keys.push_back(std::get<int>(it->key()));
+        }
+        ASSERT_EQ(keys.size(), 201);
+        EXPECT_EQ(keys[99], 99);
+        EXPECT_EQ(keys[100], 500);
+        EXPECT_EQ(keys[101], 900);
+        EXPECT_EQ(db->Scan(KeyValue(0, ""), KeyValue(2000, "")).size(), 201);
+        db->Close();
+
+        // Flushed beside the puts into an SST with a Bloom filter: keys the filter
+        // turns away are still deleted by the file's range tombstone
+        db = std::make_unique<kvdb::API>(100, rep);
+        db->Open("test_db");
+        EXPECT_TRUE(db->Get(KeyValue(100, "")).isEmpty());
+        EXPECT_TRUE(db->Get(KeyValue(899, "")).isEmpty());
+        EXPECT_EQ(std::get<int>(db->Get(KeyValue(500, "")).getValue()), -1);
+        std::vector<KeyValue> values = db->MultiGet({KeyValue(99, ""), KeyValue(100, ""), KeyValue(500, "")});
+        EXPECT_EQ(std::get<int>(values[0].getValue()), 99);
+        EXPECT_TRUE(values[1].isEmpty());
+        EXPECT_EQ(std::get<int>(values[2].getValue()), -1);
+        db->Close();
+        fs::remove_all("test_db");
+    }
+}
+
+TEST(TombstoneTest, WriteBatchDeletes) {
+    auto db = std::make_unique<kvdb::API>(1000);
+    db->Open("test_db");
+    for (int i = 0; i < 100; ++i) {
+        db->Put(i, i);
+    }
+    WriteBatch batch;
+    batch.Put(200, 200);
+    batch.DeleteRange(0, 50);
+    batch.Put(10, -10);  // after the range delete: survives
+    batch.Delete(60);
+    EXPECT_TRUE(batch.HasRangeDeletions());
+    db->Write(batch);
+
+    EXPECT_TRUE(db->Get(KeyValue(0, "")).isEmpty());
+    EXPECT_TRUE(db->Get(KeyValue(60, "")).isEmpty());
+    EXPECT_EQ(std::get<int>(db->Get(KeyValue(10, "")).getValue()), -10);
+    EXPECT_EQ(std::get<int>(db->Get(KeyValue(50, "")).getValue()), 50);
+    EXPECT_EQ(std::get<int>(db->Get(KeyValue(200, "")).getValue()), 200);
+    EXPECT_EQ(db->Scan(KeyValue(0, ""), KeyValue(300, "")).size(), 51);
+    db->Close();
+    fs::remove_all("test_db");
+}
+
+TEST(TombstoneTest, DeletesSurviveRecovery) {
+    {
+        auto db = std::make_unique<kvdb::API>(1000);
+        db->Open("test_db");
+        for (int i = 1; i <= 100; ++i) {
+            db->Put(i, i);
+        }
+        db->DeleteRange(10, 20);
+        db->Put(15, 15);
+        db->Delete(50);
+        // The range delete shares the memtable with the puts before it
+        EXPECT_TRUE(db->GetIndex()->getSSTsIndex().empty());
+        // no Close(): recovered from the WAL
+    }
+    auto db = std::make_unique<kvdb::API>(1000);
+    db->Open("test_db");
+    EXPECT_TRUE(db->Get(KeyValue(12, "")).isEmpty());
+    EXPECT_EQ(std::get<int>(db->Get(KeyValue(15, "")).getValue()), 15);
+    EXPECT_TRUE(db->Get(KeyValue(50, "")).isEmpty());
+    EXPECT_EQ(db->Scan(KeyValue(1, ""), KeyValue(100, "")).size(), 90);
+    db->Close();
+    fs::remove_all("test_db");
+}
+
+TEST(TombstoneTest, CompactionDropsDeletedData) {
+    FileManager fileManager(fs::path("test_db"));
+    std::vector<KeyValue> old_pairs;
+    for (int i = 0; i < 100; ++i) {
+        old_pairs.emplace_back(i, i);
+    }
+    auto older = SSTable::open(fs::path("test_db") / fileManager.flushToDisk(old_pairs).fileName);
+    auto newer = SSTable::open(fs::path("test_db") / fileManager.flushToDisk(
+        {KeyValue::Tombstone(5), KeyValue(30, -30)}, {KeyValue::RangeTombstone(20, 40)}).fileName);
+
+    // Data below remains: tombstones are kept (and still hide their keys)
+    std::vector<FlushSSTInfo> kept = Compaction::merge({newer, older}, fileManager, 1 << 20, false);
+    ASSERT_EQ(kept.size(), 1);
+    auto kept_table = SSTable::open(fs::path("test_db") / kept[0].fileName);
+    EXPECT_EQ(kept_table->readAll().size(), 100 - 20 + 1);  // 0..99 minus [20, 40), plus 30
+    EXPECT_TRUE(kept_table->get(KeyValue(5, "")).isTombstone());
+    EXPECT_TRUE(kept_table->get(KeyValue(25, "")).isTombstone());
+    EXPECT_EQ(std::get<int>(kept_table->get(KeyValue(30, "")).getValue()), -30);
+
+    // Bottommost: the tombstones go too
+    std::vector<FlushSSTInfo> dropped = Compaction::merge({newer, older}, fileManager, 1 << 20, true);
+    ASSERT_EQ(dropped.size(), 1);
+    auto dropped_table = SSTable::open(fs::path("test_db") / dropped[0].fileName);
+    EXPECT_EQ(dropped_table->readAll().size(), 100 - 20);
+    EXPECT_TRUE(dropped_table->getRangeDeletions().empty());
+    EXPECT_TRUE(dropped_table->get(KeyValue(5, "")).isEmpty());
+    fs::remove_all("test_db");
+}
+
+TEST(TombstoneTest, CompactionSplitsRangeTombstonesAcrossOutputs) {
+    FileManager fileManager(fs::path("test_db"));
+    std::vector<KeyValue> pairs;
+    for (int i = 0; i < 300; i += 2) {
+        pairs.emplace_back(i, i);
+    }
+    auto older = SSTable::open(fs::path("test_db") / fileManager.flushToDisk(pairs).fileName);
+    std::vector<KeyValue> odd;
+    for (int i = 1; i < 300; i += 2) {
+        odd.emplace_back(i, i);
+    }
+    auto newer = SSTable::open(fs::path("test_db") / fileManager.flushToDisk(
+        odd, {KeyValue::RangeTombstone(1000, 2000)}).fileName);
+    auto newest = SSTable::open(fs::path("test_db") / fileManager.flushToDisk(
+        {}, {KeyValue::RangeTombstone(50, 250)}).fileName);
+
+    uint64_t target = 40 * Compaction::approximateSize(KeyValue(1, 1));
+    std::vector<FlushSSTInfo> outputs = Compaction::merge({newest, newer, older}, fileManager, target, false);
+    ASSERT_GT(outputs.size(), 1);
+    size_t records = 0;
+    for (size_t i = 0; i < outputs.size(); ++i) {
+        auto table = SSTable::open(fs::path("test_db") / outputs[i].fileName);
+        records += table->readAll().size();
+        // Every piece stays inside its file's range, and files only touch at their boundary
+        for (const KeyValue& range : table->getRangeDeletions()) {
+            EXPECT_FALSE(range < outputs[i].smallest_key);
+            EXPECT_FALSE(outputs[i].largest_key < range.rangeEnd());
+        }
+        if (i > 0) {
+            EXPECT_FALSE(outputs[i].smallest_key < outputs[i - 1].largest_key);
+        }
+    }
+    EXPECT_EQ(records, 300 - 200);
+    fs::remove_all("test_db");
+}
+
+TEST(TombstoneTest, LookupsOnCompactionOutputBoundaries) {
+    FileManager fileManager(fs::path("test_db"));
+    SSTIndex sstIndex;
+    sstIndex.set_path(fs::path("test_db"));
+    // Old versions of every key below, in L2
+    std::vector<KeyValue> old_pairs;
+    for (int i = 1; i <= 300; ++i) {
+        old_pairs.emplace_back(i, i);
+    }
+    FlushSSTInfo deep = fileManager.flushToDisk(old_pairs);
+    sstIndex.addSST(deep.fileName, deep.smallest_key, deep.largest_key, deep.filter, 2);
+
+    // Put, DeleteRange, Put compacted into L1: each output keeps the tombstone up to
+    // the next output's first key, so adjacent files share that boundary key
+    std::vector<KeyValue> new_pairs;
+    for (int i = 1; i <= 300; ++i) {
+        new_pairs.emplace_back(i, -i);
+        new_pairs.back().setSequence(2);
+    }
+    KeyValue range = KeyValue::RangeTombstone(1, 301);
+    range.setSequence(1);
+    auto newer = SSTable::open(fs::path("test_db") / fileManager.flushToDisk(new_pairs, {range}).fileName);
+    uint64_t target = 40 * Compaction::approximateSize(KeyValue(1, 1));
+    std::vector<FlushSSTInfo> outputs = Compaction::merge({newer}, fileManager, target, false);
+    ASSERT_GT(outputs.size(), 1);
+    for (const FlushSSTInfo& output : outputs) {
+        sstIndex.addSST(output.fileName, output.smallest_key, output.largest_key, output.filter, 1);
+    }
+    EXPECT_FALSE(outputs[0].largest_key < outputs[1].smallest_key);
+
+    std::vector<KeyValue> keys;
+    for (int i = 1; i <= 300; ++i) {
+        KeyValue result = sstIndex.Search(KeyValue(i, ""));
+        ASSERT_FALSE(result.isEmpty()) << i;
+        EXPECT_EQ(std::get<int>(result.getValue()), -i) << i;
+        keys.emplace_back(i, "");
+    }
+    std::vector<KeyValue> results(keys.size());
+    sstIndex.MultiSearch(keys, results);
+    for (int i = 1; i <= 300; ++i) {
+        EXPECT_EQ(std::get<int>(results[i - 1].getValue()), -i) << i;
+    }
+    std::set<KeyValue> res;
+    sstIndex.Scan(KeyValue(1, ""), KeyValue(300, ""), res);
+    ASSERT_EQ(res.size(), 300);
+    EXPECT_EQ(std::get<int>(res.rbegin()->getValue()), -300);
+    fs::remove_all("test_db");
+}
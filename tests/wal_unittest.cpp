@@ -0,0 +1,219 @@
+//
+// Created by Damian Li on 2024-09-19.
+//
+
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <filesystem>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "WAL.h"
+#include "api.h"
+
+namespace fs = std::filesystem;
+
+TEST(WALTest, AddRecordAndReplay) {
+    fs::create_directories("test_db");
+    fs::path log_path = WAL::logPath(fs::path("test_db"), 1);
+    {
+        WAL wal(log_path);
+        wal.addRecord({KeyValue(1, 10)});
+        wal.addRecord({KeyValue("two", 2.5), KeyValue(3LL, 'c')});
+        EXPECT_EQ(wal.getNumRecords(), 2);
+    }
+
+    std::vector<KeyValue> records = WAL::replay(log_path);
+    ASSERT_EQ(records.size(), 3);
+    EXPECT_EQ(std::get<int>(records[0].getValue()), 10);
+    EXPECT_EQ(std::get<std::string>(records[1].getKey()), "two");
+    EXPECT_EQ(std::get<double>(records[1].getValue()), 2.5);
+    EXPECT_EQ(std::get<char>(records[2].getValue()), 'c');
+
+    fs::remove_all("test_db");
+}
+
+TEST(WALTest, TornTailIsIgnored) {
+    fs::create_directories("test_db");
+    fs::path log_path = WAL::logPath(fs::path("test_db"), 1);
+    {
+        WAL wal(log_path);
+        wal.addRecord({KeyValue(1, 10)});
+        wal.addRecord({KeyValue(2, 20)});
+    }
+    // Crash in the middle of the second write
+    fs::resize_file(log_path, fs::file_size(log_path) - 3);
+    std::vector<KeyValue> records = WAL::replay(log_path);
+    ASSERT_EQ(records.size(), 1);
+    EXPECT_EQ(std::get<int>(records[0].getKey()), 1);
+
+    // A corrupted payload fails its checksum
+    {
+        std::fstream file(log_path, std::ios::binary | std::ios::in | std::ios::out);
+        file.seekp(12);
+        file.put('\x7f');
+    }
+    EXPECT_TRUE(WAL::replay(log_path).empty());
+
+    fs::remove_all("test_db");
+}
+
+TEST(WALTest, ResetDropsRecords) {
+    fs::create_directories("test_db");
+    fs::path log_path = WAL::logPath(fs::path("test_db"), 1);
+    WAL wal(log_path);
+    wal.addRecord({KeyValue(1, 10)});
+    wal.reset();
+    wal.addRecord({KeyValue(2, 20)});
+    wal.sync();
+
+    std::vector<KeyValue> records = WAL::replay(log_path);
+    ASSERT_EQ(records.size(), 1);
+    EXPECT_EQ(std::get<int>(records[0].getKey()), 2);
+    EXPECT_EQ(wal.getNumSyncs(), 1);
+
+    fs::remove_all("test_db");
+}
+
+TEST(WALTest, RecoverMemtableAfterCrash) {
+    {
+        auto db = std::make_unique<kvdb::API>(1000);
+        db->Open("test_db");
+        for (int i = 1; i <= 100; ++i) {
+            db->Put(i, i * 3);
+        }
+        db->Put("key", "value");
+        // no Close(): the memtable is lost with the process
+    }
+
+    auto db = std::make_unique<kvdb::API>(1000);
+    db->Open("test_db");
+    for (int i = 1; i <= 100; ++i) {
+        EXPECT_EQ(std::get<int>(db->Get(KeyValue(i, "")).getValue()), i * 3);
+    }
+    EXPECT_EQ(std::get<std::string>(db->Get(KeyValue("key", "")).getValue()), "value");
+    db->Close();
+
+    // Close flushed everything, nothing is left to replay
+    EXPECT_TRUE(WAL::listLogs(fs::path("test_db")).empty());
+    fs::remove_all("test_db");
+}
+
+TEST(WALTest, FlushRotatesLog) {
+    auto db = std::make_unique<kvdb::API>(10);
+    db->Open("test_db");
+    for (int i = 1; i <= 25; ++i) {
+        db->Put(i, i);
+    }
+    // Every memtable switch starts a new log holding only the new memtable's records
+    std::vector<uint64_t> logs = WAL::listLogs(fs::path("test_db"));
+    ASSERT_FALSE(logs.empty());
+    EXPECT_GE(logs.back(), 3);
+    std::vector<KeyValue> records = WAL::replay(WAL::logPath(fs::path("test_db"), logs.back()));
+    EXPECT_EQ(records.size(), db->GetMemtable()->get_currentSize());
+    db->Close();
+    fs::remove_all("test_db");
+}
+
+TEST(WALTest, NewLogIsDurableBeforeOldLogsGo) {
+    fs::path dir("test_db");
+    {
+        auto db = std::make_unique<kvdb::API>(1000);
+        db->Open("test_db");
+        for (int i = 1; i <= 50; ++i) {
+            db->Put(i, i);
+        }
+        // no Close(): the records are only in the log
+    }
+    std::vector<uint64_t> old_logs = WAL::listLogs(dir);
+    ASSERT_EQ(old_logs.size(), 1);
+    fs::path old_log = WAL::logPath(dir, old_logs[0]);
+    fs::path new_log = WAL::logPath(dir, old_logs[0] + 1);
+
+    // What was on disk at each sync of the database directory
+    std::mutex mutex;
+    std::vector<std::pair<bool, bool>> dir_syncs;  // (new log exists, old log exists)
+    FileManager::setSyncObserver([&](const fs::path& path, bool directory) {
+        if (directory && fs::equivalent(path, dir)) {
+            std::lock_guard<std::mutex> lock(mutex);
+            dir_syncs.emplace_back(fs::exists(new_log), fs::exists(old_log));
+        }
+    });
+    auto db = std::make_unique<kvdb::API>(10);
+    db->Open("test_db");
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        // The new log's entry was synced while the old log could still be replayed
+        // (recovery flushes SSTs first, which sync the directory too)
+        EXPECT_NE(std::find(dir_syncs.begin(), dir_syncs.end(), std::make_pair(true, true)), dir_syncs.end());
+        EXPECT_FALSE(fs::exists(old_log));
+        dir_syncs.clear();
+    }
+    // A memtable switch syncs the entry of the log it starts
+    for (int i = 51; i <= 80; ++i) {
+        db->Put(i, i);
+    }
+    uint64_t current = WAL::listLogs(dir).back();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        EXPECT_GE(dir_syncs.size(), current - old_logs[0] - 1);
+    }
+    FileManager::setSyncObserver(nullptr);
+    for (int i = 1; i <= 80; ++i) {
+        EXPECT_EQ(std::get<int>(db->Get(KeyValue(i, "")).getValue()), i);
+    }
+    db->Close();
+    fs::remove_all("test_db");
+}
+
+TEST(WALTest, ListLogsInOrder) {
+    fs::create_directories("test_db");
+    for (uint64_t number : {10, 2, 7}) {
+        WAL wal(WAL::logPath(fs::path("test_db"), number));
+    }
+    std::ofstream(fs::path("test_db") / "WAL_x.log").close();
+    EXPECT_EQ(WAL::listLogs(fs::path("test_db")), std::vector<uint64_t>({2, 7, 10}));
+    fs::remove_all("test_db");
+}
+
+TEST(WALTest, PerWriteSyncsEveryPut) {
+    auto db = std::make_unique<kvdb::API>(1000);
+    db->SetWALSyncMode(WALSyncMode::PER_WRITE);
+    db->Open("test_db");
+    for (int i = 1; i <= 20; ++i) {
+        db->Put(i, i);
+    }
+    EXPECT_EQ(db->GetWAL()->getNumSyncs(), 20);
+    db->Close();
+    fs::remove_all("test_db");
+}
+
+TEST(WALTest, GroupCommitConcurrentWriters) {
+    auto db = std::make_unique<kvdb::API>(500);
+    db->SetWALSyncMode(WALSyncMode::GROUP_COMMIT);
+    db->Open("test_db");
+
+    const int num_threads = 8;
+    const int puts_per_thread = 200;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < num_threads; ++t) {
+        threads.emplace_back([&db, t]() {
+            for (int i = 0; i < puts_per_thread; ++i) {
+                int key = t * puts_per_thread + i + 1;
+                db->Put(key, key * 2);
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    // Every group is one record and one sync
+    EXPECT_LE(db->GetWAL()->getNumSyncs(), num_threads * puts_per_thread);
+    EXPECT_GE(db->GetWAL()->getNumRecords(), db->GetWAL()->getNumSyncs());
+    for (int key = 1; key <= num_threads * puts_per_thread; ++key) {
+        EXPECT_EQ(std::get<int>(db->Get(KeyValue(key, "")).getValue()), key * 2);
+    }
+    db->Close();
+    fs::remove_all("test_db");
+}
@@ -0,0 +1,134 @@
+//
+// Created by Damian Li on 2024-09-26.
+//
+
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <string>
+#include <thread>
+#include <vector>
+#include "WriteBatch.h"
+#include "Memtable.h"
+#include "api.h"
+
+namespace fs = std::filesystem;
+
+TEST(WriteBatchTest, MemtableInsertBatchSortsAndKeepsLast) {
+    for (MemtableRep rep : {MemtableRep::RED_BLACK_TREE, MemtableRep::SKIPLIST}) {
+        Memtable memtable(1000, rep);
+        std::vector<KeyValue> records;
+        for (int i = 100; i >= 1; --i) {
+            records.emplace_back(i, i);
+        }
+        records.emplace_back(50, -1);  // overwrites the earlier 50
+        memtable.insertBatch(records.data(), records.size());
+
+        std::vector<KeyValue> entries = memtable.inOrderEntries();
+        ASSERT_EQ(entries.size(), 100);
+        for (int i = 0; i < 100; ++i) {
+            EXPECT_EQ(std::get<int>(entries[i].getKey()), i + 1);
+        }
+        EXPECT_EQ(std::get<int>(memtable.get(KeyValue(50, "")).getValue()), -1);
+    }
+}
+
+TEST(WriteBatchTest, WriteAppliesEveryUpdate) {
+    auto db = std::make_unique<kvdb::API>(1000);
+    db->Open("test_db");
+    WriteBatch batch;
+    for (int i = 1; i <= 500; ++i) {
+        batch.Put(i, i * 2);
+    }
+    batch.Put("name", "kvdb");
+    batch.Put(7, 0);  // last Put of a key wins
+    EXPECT_EQ(batch.Count(), 502);
+
+    uint64_t records = db->GetWAL()->getNumRecords();
+    db->Write(batch);
+    EXPECT_EQ(db->GetWAL()->getNumRecords(), records + 1);  // one WAL record for the batch
+
+    EXPECT_EQ(std::get<int>(db->Get(KeyValue(7, "")).getValue()), 0);
+    EXPECT_EQ(std::get<int>(db->Get(KeyValue(8, "")).getValue()), 16);
+    EXPECT_EQ(std::get<std::string>(db->Get(KeyValue("name", "")).getValue()), "kvdb");
+    EXPECT_EQ(db->Scan(KeyValue(1, ""), KeyValue(500, "")).size(), 500);
+    db->Close();
+    fs::remove_all("test_db");
+}
+
+TEST(WriteBatchTest, BatchIsNotSplitAcrossMemtables) {
+    auto db = std::make_unique<kvdb::API>(100);
+    db->Open("test_db");
+    for (int i = 1; i <= 90; ++i) {
+        db->Put(i, i);
+    }
+    WriteBatch batch;
+    for (int i = 1001; i <= 1050; ++i) {
+        batch.Put(i, i);
+    }
+    db->Write(batch);
+    // The memtable wasn't full: the whole batch went in, past memtable_size
+    EXPECT_EQ(db->GetMemtable()->get_currentSize(), 140);
+    // Now it is full: the next batch starts a new memtable
+    db->Write(batch);
+    EXPECT_EQ(db->GetMemtable()->get_currentSize(), 50);
+    db->WaitForCompaction();
+    for (int i = 1001; i <= 1050; ++i) {
+        EXPECT_EQ(std::get<int>(db->Get(KeyValue(i, "")).getValue()), i);
+    }
+    db->Close();
+    fs::remove_all("test_db");
+}
+
+TEST(WriteBatchTest, RecoverBatchAfterCrash) {
+    {
+        auto db = std::make_unique<kvdb::API>(1000);
+        db->Open("test_db");
+        WriteBatch batch;
+        for (int i = 1; i <= 200; ++i) {
+            batch.Put(i, std::to_string(i));
+        }
+        db->Write(batch);
+        // no Close(): the batch only lives in the WAL
+    }
+    auto db = std::make_unique<kvdb::API>(1000);
+    db->Open("test_db");
+    for (int i = 1; i <= 200; ++i) {
+        EXPECT_EQ(std::get<std::string>(db->Get(KeyValue(i, "")).getValue()), std::to_string(i));
+    }
+    db->Close();
+    fs::remove_all("test_db");
+}
+
+TEST(WriteBatchTest, ConcurrentBatchesAndPuts) {
+    for (MemtableRep rep : {MemtableRep::RED_BLACK_TREE, MemtableRep::SKIPLIST}) {
+        auto db = std::make_unique<kvdb::API>(300, rep);
+        db->SetWALSyncMode(WALSyncMode::GROUP_COMMIT);
+        db->Open("test_db");
+        std::vector<std::thread> threads;
+        for (int t = 0; t < 4; ++t) {
+            threads.emplace_back([&db, t]() {
+                for (int b = 0; b < 10; ++b) {
+                    WriteBatch batch;
+                    for (int i = 0; i < 50; ++i) {
+                        int key = t * 10000 + b * 100 + i;
+                        batch.Put(key, key);
+                    }
+                    db->Write(batch);
+                    db->Put(t * 10000 + b * 100 + 99, -1);
+                }
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        for (int t = 0; t < 4; ++t) {
+            for (int b = 0; b < 10; ++b) {
+                EXPECT_EQ(std::get<int>(db->Get(KeyValue(t * 10000 + b * 100 + 7, "")).getValue()), t * 10000 + b * 100 + 7);
+                EXPECT_EQ(std::get<int>(db->Get(KeyValue(t * 10000 + b * 100 + 99, "")).getValue()), -1);
+            }
+        }
+        EXPECT_EQ(db->Scan(KeyValue(0, ""), KeyValue(100000, "")).size(), 4 * 10 * 51);
+        db->Close();
+        fs::remove_all("test_db");
+    }
+}
@@ -0,0 +1,131 @@
+//
+// Created by Damian Li on 2024-09-25.
+//
+
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <string>
+#include <thread>
+#include "WriteBufferManager.h"
+#include "Memtable.h"
+#include "api.h"
+
+namespace fs = std::filesystem;
+
+TEST(WriteBufferManagerTest, MemtableTracksBytes) {
+    Memtable memtable(1000000);
+    const size_t empty_usage = memtable.approximateMemoryUsage();
+    memtable.insert(KeyValue(1, 2));
+    const size_t small_usage = memtable.approximateMemoryUsage();
+    EXPECT_GT(small_usage, empty_usage);
+
+    // A 10 KB value is counted in full even though the node is small
+    memtable.insert(KeyValue(2, std::string(10000, 'v')));
+    EXPECT_GE(memtable.approximateMemoryUsage(), small_usage + 10000);
+}
+
+TEST(WriteBufferManagerTest, MemtableFullOnByteBudget) {
+    Memtable memtable(1000000);
+    memtable.setWriteBufferSize(64 * 1024);
+    int inserted = 0;
+    while (!memtable.needsFlush(KeyValue(inserted + 1, ""))) {
+        ++inserted;
+        memtable.insert(KeyValue(inserted, std::string(1000, 'x')));
+    }
+    // Far below the entry limit, close to the byte budget
+    EXPECT_GT(inserted, 32);
+    EXPECT_LT(inserted, 70);
+    EXPECT_GE(memtable.approximateMemoryUsage(), 64 * 1024);
+    // An overwrite needs a flush too once the bytes are used up
+    EXPECT_TRUE(memtable.needsFlush(KeyValue(1, "")));
+}
+
+TEST(WriteBufferManagerTest, AccountingAndShouldFlush) {
+    WriteBufferManager manager(1000);
+    manager.reserveMem(500);
+    EXPECT_FALSE(manager.shouldFlush());
+    manager.reserveMem(400);
+    EXPECT_TRUE(manager.shouldFlush());  // active memtables over 7/8
+    manager.scheduleFreeMem(900);
+    EXPECT_EQ(manager.mutableMemtableMemoryUsage(), 0);
+    EXPECT_EQ(manager.memoryUsage(), 900);
+    EXPECT_FALSE(manager.shouldFlush());  // immutable memory is already being flushed
+    manager.reserveMem(600);
+    EXPECT_TRUE(manager.shouldFlush());  // over budget with half of it active
+    manager.freeMem(900);
+    EXPECT_EQ(manager.memoryUsage(), 600);
+    EXPECT_FALSE(manager.shouldFlush());
+
+    WriteBufferManager unlimited(0);
+    unlimited.reserveMem(1 << 30);
+    EXPECT_FALSE(unlimited.shouldFlush());
+}
+
+TEST(WriteBufferManagerTest, StallUntilFreed) {
+    WriteBufferManager manager(1000, true);
+    manager.reserveMem(1000);
+    std::atomic<bool> resumed{false};
+    std::thread writer([&]() {
+        manager.maybeStall();
+        resumed = true;
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    EXPECT_FALSE(resumed.load());
+    manager.scheduleFreeMem(1000);
+    manager.freeMem(500);
+    writer.join();
+    EXPECT_TRUE(resumed.load());
+    EXPECT_EQ(manager.getNumStalls(), 1);
+}
+
+TEST(WriteBufferManagerTest, APIFlushesOnByteBudget) {
+    auto db = std::make_unique<kvdb::API>(1000000);
+    db->SetWriteBufferSize(32 * 1024);
+    db->Open("test_db");
+    const std::string value(1000, 'v');
+    for (int i = 1; i <= 300; ++i) {
+        db->Put(i, value + std::to_string(i));
+    }
+    db->WaitForCompaction();
+    EXPECT_GT(db->GetIndex()->getSSTsIndex().size(), 0);
+    EXPECT_LE(db->GetMemtable()->approximateMemoryUsage(), 48 * 1024);
+    for (int i = 1; i <= 300; i += 37) {
+        EXPECT_EQ(std::get<std::string>(db->Get(KeyValue(i, "")).getValue()), value + std::to_string(i));
+    }
+    db->Close();
+    fs::remove_all("test_db");
+}
+
+TEST(WriteBufferManagerTest, SharedBudgetAcrossDatabases) {
+    auto manager = std::make_shared<WriteBufferManager>(128 * 1024);
+    auto db1 = std::make_unique<kvdb::API>(1000000);
+    auto db2 = std::make_unique<kvdb::API>(1000000);
+    db1->SetWriteBufferManager(manager);
+    db2->SetWriteBufferManager(manager);
+    db1->Open("test_db1");
+    db2->Open("test_db2");
+
+    const std::string value(1000, 'v');
+    size_t peak = 0;
+    for (int i = 1; i <= 500; ++i) {
+        db1->Put(i, value);
+        db2->Put(i, value);
+        peak = std::max(peak, manager->memoryUsage());
+    }
+    // The per-database byte budget (64 MB) is never reached: the shared budget flushes
+    EXPECT_GT(manager->memoryUsage(), 0);
+    EXPECT_LE(peak, 2 * 128 * 1024 + 16 * 1024);  // active memtables plus ones being flushed
+    db1->WaitForCompaction();
+    db2->WaitForCompaction();
+    EXPECT_GT(db1->GetIndex()->getSSTsIndex().size() + db2->GetIndex()->getSSTsIndex().size(), 0);
+    EXPECT_EQ(std::get<std::string>(db2->Get(KeyValue(250, "")).getValue()), value);
+
+    db1->Close();
+    db2->Close();
+    EXPECT_EQ(manager->memoryUsage(), 0);
+    EXPECT_EQ(manager->mutableMemtableMemoryUsage(), 0);
+    fs::remove_all("test_db1");
+    fs::remove_all("test_db2");
+}
@@ -7,9 +7,39 @@
 // Constructor
 BinaryTree::BinaryTree() : root(nullptr) {}
 
+BinaryTree::BinaryTree(Arena* arena) : root(nullptr), arena(arena) {}
+
 // Destructor
 BinaryTree::~BinaryTree() {
-    destroyTree(root);
+    if (!arena) {
+        destroyTree(root);
+    }
+}
+
+TreeNode* BinaryTree::newNode(const KeyValue& kv) {
+    if (!arena) {
+        return new TreeNode(kv);
+    }
+    TreeNode* node = arena->make<TreeNode>(kv);
+    if (kv.ownsHeapMemory()) {
+        node->arenaCleanup = true;
+        arena->addCleanup(&node->keyValue);
+    }
+    return node;
+}
+
+void BinaryTree::freeNode(TreeNode* node) {
+    if (!arena) {
+        delete node;
+    }
+}
+
+void BinaryTree::setKeyValue(TreeNode* node, const KeyValue& kv) {
+    node->keyValue = kv;
+    if (arena && !node->arenaCleanup && node->keyValue.ownsHeapMemory()) {
+        node->arenaCleanup = true;
+        arena->addCleanup(&node->keyValue);
+    }
 }
 
 TreeNode*& BinaryTree::getRoot() {
@@ -29,7 +59,7 @@ void BinaryTree::destroyTree(const TreeNode* node) {
 void BinaryTree::insert(TreeNode*& node, KeyValue kv) {
     if (node == nullptr) {
         // If the node is null, create a new TreeNode with the KeyValue
-        node = new TreeNode(kv);
+        node = newNode(kv);
     } else if (kv < node->keyValue) {
         // Compare KeyValue instances directly using operator<
         insert(node->left, kv);
@@ -120,5 +150,19 @@ void BinaryTree::Scan(TreeNode* node, const KeyValue& small_key, const KeyValue&
     }
 }
 
+void BinaryTree::Scan(TreeNode* node, const KeyValue& small_key, const KeyValue& large_key, std::vector<KeyValue>& res) {
+    if (!node) return;
+
+    if (node->keyValue > small_key) {
+        Scan(node->left, small_key, large_key, res);
+    }
+    if (!(node->keyValue < small_key) && !(large_key < node->keyValue)) {
+        res.push_back(node->keyValue);
+    }
+    if (node->keyValue < large_key) {
+        Scan(node->right, small_key, large_key, res);
+    }
+}
+
 
 
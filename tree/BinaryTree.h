@@ -7,12 +7,16 @@
 
 #include "TreeNode.h"
 #include "KeyValue.h"
+#include "Arena.h"
 #include <set>
+#include <vector>
 using namespace std;
 
 class BinaryTree {
 public:
     BinaryTree();
+    // Nodes are allocated in arena and released with it instead of one by one
+    explicit BinaryTree(Arena* arena);
     virtual ~BinaryTree();
 
     // Templated insert method
@@ -32,9 +36,17 @@ public:
 
     // void Scan(TreeNode* node, long long small_key, long long large_key, unordered_map<long long, KeyValue>& res);
     void Scan(TreeNode* node, const KeyValue& small_key, const KeyValue& large_key, std::set<KeyValue>& res);
+    // In-order variant: appends the kv-pairs of the range to res in key order
+    void Scan(TreeNode* node, const KeyValue& small_key, const KeyValue& large_key, std::vector<KeyValue>& res);
 
 protected:
     TreeNode *root;
+    Arena* arena = nullptr;
+
+    TreeNode* newNode(const KeyValue& kv);
+    void freeNode(TreeNode* node);
+    // Replace the kv-pair of a node; arena nodes holding heap strings get a cleanup
+    void setKeyValue(TreeNode* node, const KeyValue& kv);
 
     // Internal insert method using KeyValue
     void insert(TreeNode*& node, KeyValue kv);
@@ -98,17 +98,26 @@ KeyValue RedBlackTree::getValue(TreeNode *&node, const KeyValue& kv) {
  *  - fixInsertRBTree
  */
 // RBTree insert method
-void RedBlackTree::insert(KeyValue kv) {
-    // First, search for the key in the tree
-    if (search(kv)) {
-        // If the key exists, update the value
-        updateExistedKeyValue(root, kv);
-    } else {
-        // Create a new TreeNode with the KeyValue
-        TreeNode* newNode = new TreeNode(kv);
-        root = insert(root, newNode);  // Insert the new node in the tree
-        fixInsertRBTree(newNode);      // Fix any red-black tree property violations
+void RedBlackTree::insert(const KeyValue& kv) {
+    // One descent: overwrite the value if the key exists, otherwise link a new leaf there
+    TreeNode* parent = nullptr;
+    TreeNode** link = &root;
+    while (*link != nullptr) {
+        parent = *link;
+        if (kv < parent->keyValue) {
+            link = &parent->left;
+        } else if (parent->keyValue < kv) {
+            link = &parent->right;
+        } else {
+            setKeyValue(parent, kv);
+            return;
+        }
     }
+    // Create a new TreeNode with the KeyValue
+    TreeNode* node = newNode(kv);
+    node->parent = parent;
+    *link = node;
+    fixInsertRBTree(node);      // Fix any red-black tree property violations
 }
 
 
@@ -117,7 +126,7 @@ void RedBlackTree::updateExistedKeyValue(TreeNode *&node, KeyValue& kv) {
         return;  // If node is null, there's nothing to update
     } else if (node->keyValue == kv) {
         // If the key matches, update the value
-        node->keyValue = kv;  // Replace the whole KeyValue
+        setKeyValue(node, kv);  // Replace the whole KeyValue
     } else if (kv < node->keyValue) {
         // If the key is smaller, traverse the left subtree
         updateExistedKeyValue(node->left, kv);
@@ -267,7 +276,7 @@ TreeNode* RedBlackTree::deleteBST(TreeNode *&root, KeyValue kv) {
     TreeNode *temp = minValueNode(root->right);
 
     // Replace the current node's key-value with the inorder successor's key-value
-    root->keyValue = temp->keyValue;
+    setKeyValue(root, temp->keyValue);
 
     // Delete the inorder successor
     return deleteBST(root->right, temp->keyValue);
@@ -291,13 +300,13 @@ void RedBlackTree::fixDeleteRBTree(TreeNode *&node) {
             if (child != nullptr)
                 child->parent = node->parent;
             setColor(child, BLACK);
-            delete (node);
+            freeNode(node);
         } else {
             node->parent->right = child;
             if (child != nullptr)
                 child->parent = node->parent;
             setColor(child, BLACK);
-            delete (node);
+            freeNode(node);
         }
     } else {
         TreeNode *sibling = nullptr;
@@ -368,7 +377,7 @@ void RedBlackTree::fixDeleteRBTree(TreeNode *&node) {
             node->parent->left = nullptr;
         else
             node->parent->right = nullptr;
-        delete(node);
+        freeNode(node);
         setColor(root, BLACK);
     }
 }
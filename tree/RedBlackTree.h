@@ -15,13 +15,15 @@ using namespace std;
 
 class RedBlackTree final : public BinaryTree {
     public:
+        RedBlackTree() = default;
+        explicit RedBlackTree(Arena* arena) : BinaryTree(arena) {};
         void merge(RedBlackTree);
         void inorderTraversal() override;
         void preorder();
         // update with KeyValue Class
         vector<KeyValue> inOrderFlushToSst(); // tested
         KeyValue getValue(const KeyValue& kv); // tested
-        void insert(KeyValue kv);   // done tested
+        void insert(const KeyValue& kv);   // done tested
         void updateExistedKeyValue(TreeNode *&root, KeyValue& kv); // tested
         void deleteKey(KeyValue kv);  // added
         int getColor(TreeNode *&);  // done tested
@@ -15,6 +15,7 @@ class TreeNode {
         TreeNode* right;
         TreeNode* parent;
         int color;
+        bool arenaCleanup = false;  // keyValue is destroyed by the arena
 
         // Constructor that directly takes key and value
         TreeNode(KeyValue kv);  // Insert RED node as default